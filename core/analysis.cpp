@@ -0,0 +1,349 @@
+#include "analysis.h"
+#include "simd.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace ld {
+
+namespace {
+
+constexpr size_t BAND_BYTES = 1024 * 1024; // 每个并行块大约处理的字节数
+constexpr double MIN_EXPECTED = 5.0;
+
+// 水平相邻的同通道样本对 (u, v)
+struct PairCounts {
+    uint64_t pairs = 0;
+    uint64_t equal = 0;    // u == v
+    uint64_t sameHigh = 0; // 高 7 位相同
+    uint64_t x = 0;        // 差为奇数，较大者为偶数
+    uint64_t y = 0;        // 差为奇数，较大者为奇数
+
+    void add(const PairCounts &other) {
+        pairs += other.pairs;
+        equal += other.equal;
+        sameHigh += other.sameHigh;
+        x += other.x;
+        y += other.y;
+    }
+};
+
+// RS 分析的 8 个计数：[原图/全部 LSB 翻转][M/-M][规则/奇异]
+struct RsCounts {
+    uint64_t groups = 0;
+    uint64_t counts[2][2][2] = {};
+
+    void add(const RsCounts &other) {
+        groups += other.groups;
+        for (int i = 0; i < 8; ++i) {
+            (&counts[0][0][0])[i] += (&other.counts[0][0][0])[i];
+        }
+    }
+};
+
+struct Partial {
+    std::vector<uint64_t> histograms; // 每个 profile 段一张 256 项的直方图
+    PairCounts pairs;
+    RsCounts rs;
+};
+
+inline unsigned popcount32(uint32_t value) {
+    value = value - ((value >> 1) & 0x55555555u);
+    value = (value & 0x33333333u) + ((value >> 2) & 0x33333333u);
+    return (((value + (value >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+}
+
+// 四张子表交错计数，相邻的相同取值不会互相等待同一个计数器
+void histogramRow(const uint8_t *row, size_t bytes, uint64_t *histogram) {
+    uint32_t tables[4][256] = {};
+    size_t i = 0;
+    for (; i + 4 <= bytes; i += 4) {
+        ++tables[0][row[i]];
+        ++tables[1][row[i + 1]];
+        ++tables[2][row[i + 2]];
+        ++tables[3][row[i + 3]];
+    }
+    for (; i < bytes; ++i) {
+        ++tables[0][row[i]];
+    }
+    for (int value = 0; value < 256; ++value) {
+        histogram[value] += static_cast<uint64_t>(tables[0][value]) + tables[1][value] + tables[2][value] +
+                            tables[3][value];
+    }
+}
+
+// 统计 (row[i], row[i + offset])，i ∈ [begin, end)
+void countPairsScalar(const uint8_t *row, size_t begin, size_t end, size_t offset, PairCounts &counts) {
+    for (size_t i = begin; i < end; ++i) {
+        unsigned u = row[i];
+        unsigned v = row[i + offset];
+        unsigned odd = (u ^ v) & 1;
+        unsigned maxOdd = std::max(u, v) & 1;
+        counts.equal += u == v;
+        counts.sameHigh += (u >> 1) == (v >> 1);
+        counts.x += odd & (maxOdd ^ 1);
+        counts.y += odd & maxOdd;
+    }
+    counts.pairs += end > begin ? end - begin : 0;
+}
+
+#ifdef LD_X86
+
+LD_TARGET("sse2")
+void countPairsSSE2(const uint8_t *row, size_t count, size_t offset, PairCounts &counts) {
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i high = _mm_set1_epi8(static_cast<char>(0xFE));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i u = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i + offset));
+        __m128i odd = _mm_cmpeq_epi8(_mm_and_si128(_mm_xor_si128(u, v), one), one);
+        __m128i maxOdd = _mm_cmpeq_epi8(_mm_and_si128(_mm_max_epu8(u, v), one), one);
+        counts.equal += popcount32(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(u, v))));
+        counts.sameHigh += popcount32(static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(u, high), _mm_and_si128(v, high)))));
+        counts.x += popcount32(static_cast<uint32_t>(_mm_movemask_epi8(_mm_andnot_si128(maxOdd, odd))));
+        counts.y += popcount32(static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(maxOdd, odd))));
+    }
+    counts.pairs += i;
+    countPairsScalar(row, i, count, offset, counts);
+}
+
+LD_TARGET("avx2")
+void countPairsAVX2(const uint8_t *row, size_t count, size_t offset, PairCounts &counts) {
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i high = _mm256_set1_epi8(static_cast<char>(0xFE));
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i u = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i));
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i + offset));
+        __m256i odd = _mm256_cmpeq_epi8(_mm256_and_si256(_mm256_xor_si256(u, v), one), one);
+        __m256i maxOdd = _mm256_cmpeq_epi8(_mm256_and_si256(_mm256_max_epu8(u, v), one), one);
+        counts.equal += popcount32(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(u, v))));
+        counts.sameHigh += popcount32(static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(u, high), _mm256_and_si256(v, high)))));
+        counts.x += popcount32(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_andnot_si256(maxOdd, odd))));
+        counts.y += popcount32(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(maxOdd, odd))));
+    }
+    counts.pairs += i;
+    countPairsScalar(row, i, count, offset, counts);
+}
+
+#endif // LD_X86
+
+void countPairs(const uint8_t *row, size_t count, size_t offset, PairCounts &counts) {
+#ifdef LD_X86
+    switch (activeSimdLevel()) {
+    case SimdLevel::AVX2:
+        return countPairsAVX2(row, count, offset, counts);
+    case SimdLevel::SSE2:
+        return countPairsSSE2(row, count, offset, counts);
+    default:
+        break;
+    }
+#endif
+    countPairsScalar(row, 0, count, offset, counts);
+}
+
+// 平滑度：相邻样本差的绝对值之和
+inline int smoothness(int a, int b, int c, int d) {
+    return std::abs(b - a) + std::abs(c - b) + std::abs(d - c);
+}
+
+// F1: 2k <-> 2k+1；F-1: 2k-1 <-> 2k（可能得到 -1 或 256，只用来计算平滑度）
+inline int flipPositive(int value) {
+    return value ^ 1;
+}
+
+inline int flipNegative(int value) {
+    return ((value + 1) ^ 1) - 1;
+}
+
+inline void classify(int before, int after, uint64_t *counts) {
+    counts[0] += after > before;
+    counts[1] += after < before;
+}
+
+// 一行中每 4 个相邻像素、每个通道一组
+void countRsRow(const uint8_t *row, size_t rowBytes, size_t channels, RsCounts &rs) {
+    size_t groupBytes = 4 * channels;
+    for (size_t start = 0; start + groupBytes <= rowBytes; start += groupBytes) {
+        for (size_t channel = 0; channel < channels; ++channel) {
+            const uint8_t *sample = row + start + channel;
+            for (int flipped = 0; flipped < 2; ++flipped) {
+                int a = sample[0] ^ flipped;
+                int b = sample[channels] ^ flipped;
+                int c = sample[2 * channels] ^ flipped;
+                int d = sample[3 * channels] ^ flipped;
+                int base = smoothness(a, b, c, d);
+                classify(base, smoothness(a, flipPositive(b), flipPositive(c), d), rs.counts[flipped][0]);
+                classify(base, smoothness(a, flipNegative(b), flipNegative(c), d), rs.counts[flipped][1]);
+            }
+        }
+        rs.groups += channels;
+    }
+}
+
+// 上不完全伽马函数的正则化形式 Q(a, x)，级数和连分式两种展开（Numerical Recipes 6.2）
+double gammaQ(double a, double x) {
+    if (x <= 0 || a <= 0) {
+        return 1.0;
+    }
+    double logPrefix = a * std::log(x) - x - std::lgamma(a);
+    if (x < a + 1) {
+        double term = 1.0 / a;
+        double sum = term;
+        for (int n = 1; n < 1000; ++n) {
+            term *= x / (a + n);
+            sum += term;
+            if (std::fabs(term) < std::fabs(sum) * 1e-15) {
+                break;
+            }
+        }
+        return std::max(0.0, 1.0 - sum * std::exp(logPrefix));
+    }
+    const double tiny = 1e-300;
+    double b = x + 1 - a;
+    double c = 1 / tiny;
+    double d = 1 / b;
+    double h = d;
+    for (int n = 1; n < 1000; ++n) {
+        double an = -n * (n - a);
+        b += 2;
+        d = an * d + b;
+        d = std::fabs(d) < tiny ? tiny : d;
+        c = b + an / c;
+        c = std::fabs(c) < tiny ? tiny : c;
+        d = 1 / d;
+        double delta = d * c;
+        h *= delta;
+        if (std::fabs(delta - 1) < 1e-15) {
+            break;
+        }
+    }
+    return std::exp(logPrefix) * h;
+}
+
+// a z² + b z + c = 0 中绝对值较小的实根；没有实根时取抛物线顶点
+double smallerRoot(double a, double b, double c) {
+    if (std::fabs(a) < 1e-12) {
+        return std::fabs(b) < 1e-12 ? 0.0 : -c / b;
+    }
+    double discriminant = b * b - 4 * a * c;
+    if (discriminant < 0) {
+        return -b / (2 * a);
+    }
+    double root = std::sqrt(discriminant);
+    double first = (-b + root) / (2 * a);
+    double second = (-b - root) / (2 * a);
+    return std::fabs(first) < std::fabs(second) ? first : second;
+}
+
+RsResult rsEstimate(const RsCounts &rs) {
+    RsResult result;
+    if (rs.groups == 0) {
+        return result;
+    }
+    double groups = static_cast<double>(rs.groups);
+    auto share = [&](int flipped, int mask, int kind) { return static_cast<double>(rs.counts[flipped][mask][kind]) / groups; };
+    result.regular = share(0, 0, 0);
+    result.singular = share(0, 0, 1);
+    result.regularNegative = share(0, 1, 0);
+    result.singularNegative = share(0, 1, 1);
+
+    // Fridrich, Goljan, Du: "Reliable detection of LSB steganography in color and grayscale images"
+    double d0 = share(0, 0, 0) - share(0, 0, 1);
+    double d1 = share(1, 0, 0) - share(1, 0, 1);
+    double negative0 = share(0, 1, 0) - share(0, 1, 1);
+    double negative1 = share(1, 1, 0) - share(1, 1, 1);
+    double z = smallerRoot(2 * (d1 + d0), negative0 - negative1 - d1 - 3 * d0, d0 - negative0);
+    result.estimate = std::fabs(z - 0.5) < 1e-12 ? 1.0 : z / (z - 0.5);
+    return result;
+}
+
+// Dumitrescu, Wu, Wang: "Detection of LSB steganography via sample pair analysis"，
+// 各 m 的方程求和后：C0/2 p² - (D0 + Y - X) p + (Y - X) = 0
+double samplePairEstimate(const PairCounts &counts) {
+    if (counts.pairs == 0) {
+        return 0;
+    }
+    double c0 = static_cast<double>(counts.sameHigh);
+    double d0 = static_cast<double>(counts.equal);
+    double difference = static_cast<double>(counts.y) - static_cast<double>(counts.x);
+    return smallerRoot(c0 / 2, -(d0 + difference), difference);
+}
+
+} // namespace
+
+ChiSquareResult chiSquareAttack(const uint64_t histogram[256]) {
+    ChiSquareResult result;
+    int categories = 0;
+    for (int k = 0; k < 128; ++k) {
+        double expected = (static_cast<double>(histogram[2 * k]) + static_cast<double>(histogram[2 * k + 1])) / 2;
+        if (expected < MIN_EXPECTED) {
+            continue;
+        }
+        double difference = static_cast<double>(histogram[2 * k]) - expected;
+        result.statistic += difference * difference / expected;
+        ++categories;
+    }
+    if (categories < 2) {
+        return result;
+    }
+    result.degreesOfFreedom = categories - 1;
+    result.pValue = gammaQ(result.degreesOfFreedom / 2.0, result.statistic / 2);
+    return result;
+}
+
+AnalysisReport analyzeImage(const ConstImageView &view, int profileSteps) {
+    AnalysisReport report;
+    profileSteps = std::max(profileSteps, 1);
+    if (view.empty()) {
+        return report;
+    }
+
+    size_t channels = view.swapChannels ? 3 : 1;
+    uint64_t rowsPerBand = std::max<uint64_t>(1, BAND_BYTES / std::max<size_t>(view.rowBytes, 1));
+    std::vector<Partial> partials(static_cast<size_t>((view.rows + rowsPerBand - 1) / rowsPerBand));
+    parallelFor(view.rows, rowsPerBand, [&](uint64_t begin, uint64_t end) {
+        Partial &partial = partials[static_cast<size_t>(begin / rowsPerBand)];
+        partial.histograms.assign(static_cast<size_t>(profileSteps) * 256, 0);
+        for (uint64_t r = begin; r < end; ++r) {
+            const uint8_t *row = view.row(r);
+            size_t segment = static_cast<size_t>(r * static_cast<uint64_t>(profileSteps) / view.rows);
+            histogramRow(row, view.rowBytes, &partial.histograms[segment * 256]);
+            if (view.rowBytes > channels) {
+                countPairs(row, view.rowBytes - channels, channels, partial.pairs);
+            }
+            countRsRow(row, view.rowBytes, channels, partial.rs);
+        }
+    });
+
+    // 按块的顺序合并，结果与线程数无关
+    std::vector<uint64_t> segments(static_cast<size_t>(profileSteps) * 256, 0);
+    PairCounts pairs;
+    RsCounts rs;
+    for (const Partial &partial : partials) {
+        for (size_t i = 0; i < segments.size(); ++i) {
+            segments[i] += partial.histograms[i];
+        }
+        pairs.add(partial.pairs);
+        rs.add(partial.rs);
+    }
+
+    uint64_t cumulative[256] = {};
+    for (int step = 0; step < profileSteps; ++step) {
+        for (int value = 0; value < 256; ++value) {
+            cumulative[value] += segments[static_cast<size_t>(step) * 256 + value];
+        }
+        report.chiSquareProfile.push_back(chiSquareAttack(cumulative).pValue);
+    }
+    std::copy(cumulative, cumulative + 256, report.histogram);
+    report.chiSquare = chiSquareAttack(report.histogram);
+    report.rs = rsEstimate(rs);
+    report.samplePairEstimate = samplePairEstimate(pairs);
+    return report;
+}
+
+} // namespace ld
@@ -0,0 +1,50 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "imageview.h"
+#include <cstdint>
+#include <vector>
+
+namespace ld {
+
+// LSB 隐写分析，用来评估嵌入结果有多容易被检测到。
+// 直接在像素行上计算，24 位图按通道分别取相邻样本（同一通道相邻像素），不使用填充字节。
+//
+//   卡方攻击（Westfeld & Pfitzmann）：LSB 替换使每对取值 (2k, 2k+1) 的频数趋于相等，
+//     pValue 接近 1 表示频数对已被“拉平”，很可能有嵌入；
+//     profile 依次只统计前 1/n、2/n ... 的行，顺序嵌入时 p 值在信息结束处下降。
+//   RS 分析（Fridrich 等）：4 个样本一组，掩码 [0 1 1 0]，估计被修改的 LSB 比例。
+//   样本对分析 SPA（Dumitrescu 等）：水平相邻样本对，估计嵌入率。
+// RS 和 SPA 的估计值是嵌入率（每个样本携带信息的比例），自然图像约为 0，满容量嵌入约为 1。
+struct ChiSquareResult {
+    double statistic = 0;
+    int degreesOfFreedom = 0;
+    double pValue = 0;
+};
+
+struct RsResult {
+    // 掩码 M 和 -M 下规则组、奇异组占全部组的比例
+    double regular = 0;
+    double singular = 0;
+    double regularNegative = 0;
+    double singularNegative = 0;
+    double estimate = 0;
+};
+
+struct AnalysisReport {
+    uint64_t histogram[256] = {};
+    ChiSquareResult chiSquare;
+    std::vector<double> chiSquareProfile;
+    RsResult rs;
+    double samplePairEstimate = 0;
+};
+
+// 只由直方图计算，频数太少（期望值不足 5）的取值对不计入
+ChiSquareResult chiSquareAttack(const uint64_t histogram[256]);
+
+// 按行带在 sharedPool() 上并行；直方图用多张子表交错计数，样本对统计按 activeSimdLevel() 选择 AVX2/SSE2/标量内核
+AnalysisReport analyzeImage(const ConstImageView &view, int profileSteps = 10);
+
+} // namespace ld
+
+#endif // ANALYSIS_H
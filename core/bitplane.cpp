@@ -0,0 +1,282 @@
+#include "bitplane.h"
+#include "simd.h"
+#include <algorithm>
+#include <cstring>
+
+namespace ld {
+
+namespace {
+
+constexpr uint64_t REPEAT = 0x0101010101010101ULL;
+constexpr uint64_t BIT_SELECT = 0x8040201008040201ULL; // 第 j 个字节只保留第 j 位
+
+// 标量内核：一次处理 8 个载体字节（SWAR），依赖小端序
+inline uint64_t spreadBits(uint8_t byte) {
+    uint64_t selected = (byte * REPEAT) & BIT_SELECT;
+    return ((selected + 0x7F7F7F7F7F7F7F7FULL) >> 7) & REPEAT;
+}
+
+inline uint8_t gatherBits(uint64_t carrier) {
+    return static_cast<uint8_t>(((carrier & REPEAT) * 0x0102040810204080ULL) >> 56);
+}
+
+void embedBytesScalar(uint8_t *carrier, const uint8_t *payload, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i, carrier += 8) {
+        uint64_t word;
+        std::memcpy(&word, carrier, 8);
+        word = (word & ~REPEAT) | spreadBits(payload[i]);
+        std::memcpy(carrier, &word, 8);
+    }
+}
+
+void extractBytesScalar(const uint8_t *carrier, uint8_t *payload, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i, carrier += 8) {
+        uint64_t word;
+        std::memcpy(&word, carrier, 8);
+        payload[i] = gatherBits(word);
+    }
+}
+
+#ifdef LD_X86
+
+LD_TARGET("sse2")
+void embedBytesSSE2(uint8_t *carrier, const uint8_t *payload, size_t bytes) {
+    const __m128i select = _mm_set1_epi64x(static_cast<long long>(BIT_SELECT));
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i clear = _mm_set1_epi8(static_cast<char>(0xFE));
+    size_t i = 0;
+    for (; i + 2 <= bytes; i += 2, carrier += 16) {
+        __m128i spread = _mm_set_epi64x(static_cast<long long>(payload[i + 1] * REPEAT),
+                                        static_cast<long long>(payload[i] * REPEAT));
+        __m128i bits = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(spread, select), select), one);
+        __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(carrier));
+        data = _mm_or_si128(_mm_and_si128(data, clear), bits);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(carrier), data);
+    }
+    embedBytesScalar(carrier, payload + i, bytes - i);
+}
+
+LD_TARGET("sse2")
+void extractBytesSSE2(const uint8_t *carrier, uint8_t *payload, size_t bytes) {
+    size_t i = 0;
+    for (; i + 2 <= bytes; i += 2, carrier += 16) {
+        // 左移 7 位后每个字节的最高位就是原来的最低位，movemask 一次收集 16 位
+        __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(carrier));
+        int mask = _mm_movemask_epi8(_mm_slli_epi64(data, 7));
+        payload[i] = static_cast<uint8_t>(mask);
+        payload[i + 1] = static_cast<uint8_t>(mask >> 8);
+    }
+    extractBytesScalar(carrier, payload + i, bytes - i);
+}
+
+LD_TARGET("avx2")
+void embedBytesAVX2(uint8_t *carrier, const uint8_t *payload, size_t bytes) {
+    const __m256i shuffle = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                             2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i select = _mm256_set1_epi64x(static_cast<long long>(BIT_SELECT));
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i clear = _mm256_set1_epi8(static_cast<char>(0xFE));
+    size_t i = 0;
+    for (; i + 4 <= bytes; i += 4, carrier += 32) {
+        uint32_t word;
+        std::memcpy(&word, payload + i, 4);
+        __m256i spread = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(word)), shuffle);
+        __m256i bits = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(spread, select), select), one);
+        __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(carrier));
+        data = _mm256_or_si256(_mm256_and_si256(data, clear), bits);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(carrier), data);
+    }
+    embedBytesScalar(carrier, payload + i, bytes - i);
+}
+
+LD_TARGET("avx2")
+void extractBytesAVX2(const uint8_t *carrier, uint8_t *payload, size_t bytes) {
+    size_t i = 0;
+    for (; i + 4 <= bytes; i += 4, carrier += 32) {
+        __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(carrier));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi64(data, 7)));
+        std::memcpy(payload + i, &mask, 4);
+    }
+    extractBytesScalar(carrier, payload + i, bytes - i);
+}
+
+#endif // LD_X86
+
+void embedBytes(uint8_t *carrier, const uint8_t *payload, size_t bytes) {
+#ifdef LD_X86
+    switch (activeSimdLevel()) {
+    case SimdLevel::AVX2:
+        return embedBytesAVX2(carrier, payload, bytes);
+    case SimdLevel::SSE2:
+        return embedBytesSSE2(carrier, payload, bytes);
+    default:
+        break;
+    }
+#endif
+    embedBytesScalar(carrier, payload, bytes);
+}
+
+void extractBytes(const uint8_t *carrier, uint8_t *payload, size_t bytes) {
+#ifdef LD_X86
+    switch (activeSimdLevel()) {
+    case SimdLevel::AVX2:
+        return extractBytesAVX2(carrier, payload, bytes);
+    case SimdLevel::SSE2:
+        return extractBytesSSE2(carrier, payload, bytes);
+    default:
+        break;
+    }
+#endif
+    extractBytesScalar(carrier, payload, bytes);
+}
+
+// 24 位比特流中每 3 位一组反序，对应一个像素内 RGB <-> BGR
+inline uint32_t swapTriples(uint32_t value) {
+    return (value & 0x492492) | ((value >> 2) & 0x249249) | ((value << 2) & 0x924924);
+}
+
+inline size_t physicalColumn(size_t column) {
+    return column + 2 - 2 * (column % 3);
+}
+
+// 行内 [column, column + count) 逻辑字节，存储顺序为 BGR
+void embedSwapped(uint8_t *row, size_t column, size_t count, const uint8_t *bits, uint64_t bitOffset) {
+    auto single = [&](size_t i) {
+        uint64_t pos = bitOffset + i;
+        uint8_t &target = row[physicalColumn(column + i)];
+        target = static_cast<uint8_t>((target & 0xFE) | ((bits[pos / 8] >> (pos % 8)) & 1));
+    };
+
+    size_t i = 0;
+    for (; i < count && ((column + i) % 3 != 0 || (bitOffset + i) % 8 != 0); ++i) {
+        single(i);
+    }
+    // 对齐之后每 3 个载荷字节对应 8 个像素，先在比特流上交换通道再走批量内核
+    uint8_t chunk[3 * 64];
+    while (count - i >= 24) {
+        size_t groups = std::min<size_t>((count - i) / 24, 64);
+        const uint8_t *src = bits + (bitOffset + i) / 8;
+        for (size_t g = 0; g < groups; ++g) {
+            uint32_t value = swapTriples(src[3 * g] | src[3 * g + 1] << 8 | src[3 * g + 2] << 16);
+            chunk[3 * g] = static_cast<uint8_t>(value);
+            chunk[3 * g + 1] = static_cast<uint8_t>(value >> 8);
+            chunk[3 * g + 2] = static_cast<uint8_t>(value >> 16);
+        }
+        embedBytes(row + column + i, chunk, groups * 3);
+        i += groups * 24;
+    }
+    for (; i < count; ++i) {
+        single(i);
+    }
+}
+
+void extractSwapped(const uint8_t *row, size_t column, size_t count, uint8_t *bits, uint64_t bitOffset) {
+    auto single = [&](size_t i) {
+        uint64_t pos = bitOffset + i;
+        uint8_t mask = static_cast<uint8_t>(1u << (pos % 8));
+        uint8_t bit = static_cast<uint8_t>((row[physicalColumn(column + i)] & 1) << (pos % 8));
+        bits[pos / 8] = static_cast<uint8_t>((bits[pos / 8] & ~mask) | bit);
+    };
+
+    size_t i = 0;
+    for (; i < count && ((column + i) % 3 != 0 || (bitOffset + i) % 8 != 0); ++i) {
+        single(i);
+    }
+    uint8_t chunk[3 * 64];
+    while (count - i >= 24) {
+        size_t groups = std::min<size_t>((count - i) / 24, 64);
+        extractBytes(row + column + i, chunk, groups * 3);
+        uint8_t *dst = bits + (bitOffset + i) / 8;
+        for (size_t g = 0; g < groups; ++g) {
+            uint32_t value = swapTriples(chunk[3 * g] | chunk[3 * g + 1] << 8 | chunk[3 * g + 2] << 16);
+            dst[3 * g] = static_cast<uint8_t>(value);
+            dst[3 * g + 1] = static_cast<uint8_t>(value >> 8);
+            dst[3 * g + 2] = static_cast<uint8_t>(value >> 16);
+        }
+        i += groups * 24;
+    }
+    for (; i < count; ++i) {
+        single(i);
+    }
+}
+
+} // namespace
+
+void embedBits(uint8_t *carrier, const uint8_t *bits, uint64_t bitOffset, size_t count) {
+    size_t i = 0;
+    // 开头不满一个字节的部分逐位处理
+    for (; i < count && (bitOffset + i) % 8 != 0; ++i) {
+        uint64_t pos = bitOffset + i;
+        carrier[i] = static_cast<uint8_t>((carrier[i] & 0xFE) | ((bits[pos / 8] >> (pos % 8)) & 1));
+    }
+    size_t bytes = (count - i) / 8;
+    embedBytes(carrier + i, bits + (bitOffset + i) / 8, bytes);
+    i += bytes * 8;
+    for (; i < count; ++i) {
+        uint64_t pos = bitOffset + i;
+        carrier[i] = static_cast<uint8_t>((carrier[i] & 0xFE) | ((bits[pos / 8] >> (pos % 8)) & 1));
+    }
+}
+
+void extractBits(const uint8_t *carrier, uint8_t *bits, uint64_t bitOffset, size_t count) {
+    size_t i = 0;
+    for (; i < count && (bitOffset + i) % 8 != 0; ++i) {
+        uint64_t pos = bitOffset + i;
+        uint8_t mask = static_cast<uint8_t>(1u << (pos % 8));
+        bits[pos / 8] = static_cast<uint8_t>((bits[pos / 8] & ~mask) | ((carrier[i] & 1) << (pos % 8)));
+    }
+    size_t bytes = (count - i) / 8;
+    extractBytes(carrier + i, bits + (bitOffset + i) / 8, bytes);
+    i += bytes * 8;
+    for (; i < count; ++i) {
+        uint64_t pos = bitOffset + i;
+        uint8_t mask = static_cast<uint8_t>(1u << (pos % 8));
+        bits[pos / 8] = static_cast<uint8_t>((bits[pos / 8] & ~mask) | ((carrier[i] & 1) << (pos % 8)));
+    }
+}
+
+void embedSequential(const ImageView &view, uint64_t carrierIndex, const uint8_t *bytes, size_t byteCount) {
+    embedSequential(view, carrierIndex, bytes, 0, static_cast<uint64_t>(byteCount) * 8);
+}
+
+void embedSequential(const ImageView &view, uint64_t carrierIndex, const uint8_t *bits, uint64_t firstBit,
+                     uint64_t bitCount) {
+    bool contiguous = view.stride == view.rowBytes && !view.swapChannels;
+    uint64_t done = 0;
+    while (done < bitCount) {
+        uint64_t index = carrierIndex + done;
+        uint64_t rowIndex = index / view.rowBytes;
+        size_t column = static_cast<size_t>(index - rowIndex * view.rowBytes);
+        uint64_t count = contiguous ? bitCount - done : std::min<uint64_t>(view.rowBytes - column, bitCount - done);
+        if (view.swapChannels) {
+            embedSwapped(view.row(rowIndex), column, static_cast<size_t>(count), bits, firstBit + done);
+        } else {
+            embedBits(view.row(rowIndex) + column, bits, firstBit + done, static_cast<size_t>(count));
+        }
+        done += count;
+    }
+}
+
+void extractSequential(const ConstImageView &view, uint64_t carrierIndex, uint8_t *bytes, size_t byteCount) {
+    extractSequential(view, carrierIndex, bytes, 0, static_cast<uint64_t>(byteCount) * 8);
+}
+
+void extractSequential(const ConstImageView &view, uint64_t carrierIndex, uint8_t *bits, uint64_t firstBit,
+                       uint64_t bitCount) {
+    bool contiguous = view.stride == view.rowBytes && !view.swapChannels;
+    uint64_t done = 0;
+    while (done < bitCount) {
+        uint64_t index = carrierIndex + done;
+        uint64_t rowIndex = index / view.rowBytes;
+        size_t column = static_cast<size_t>(index - rowIndex * view.rowBytes);
+        uint64_t count = contiguous ? bitCount - done : std::min<uint64_t>(view.rowBytes - column, bitCount - done);
+        if (view.swapChannels) {
+            extractSwapped(view.row(rowIndex), column, static_cast<size_t>(count), bits, firstBit + done);
+        } else {
+            extractBits(view.row(rowIndex) + column, bits, firstBit + done, static_cast<size_t>(count));
+        }
+        done += count;
+    }
+}
+
+} // namespace ld
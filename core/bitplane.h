@@ -0,0 +1,53 @@
+#ifndef BITPLANE_H
+#define BITPLANE_H
+
+#include "imageview.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace ld {
+
+// 最低位平面的批量读写。比特流按字节内低位在前排列（与 embedMessage 的格式一致），
+// 第 bitOffset + i 位对应 carrier[i] 的最低位。按 activeSimdLevel() 选择 AVX2/SSE2/标量内核。
+void embedBits(uint8_t *carrier, const uint8_t *bits, uint64_t bitOffset, size_t count);
+void extractBits(const uint8_t *carrier, uint8_t *bits, uint64_t bitOffset, size_t count);
+
+// 在图像视图上从逻辑下标 carrierIndex 开始顺序读写 byteCount 个字节，
+// 按行分段调用上面的内核，24 位图的通道映射在比特流上完成
+void embedSequential(const ImageView &view, uint64_t carrierIndex, const uint8_t *bytes, size_t byteCount);
+void extractSequential(const ConstImageView &view, uint64_t carrierIndex, uint8_t *bytes, size_t byteCount);
+
+// 同上，只读写比特流中 [firstBit, firstBit + bitCount) 这一段，用于按行带分段处理
+void embedSequential(const ImageView &view, uint64_t carrierIndex, const uint8_t *bits, uint64_t firstBit,
+                     uint64_t bitCount);
+void extractSequential(const ConstImageView &view, uint64_t carrierIndex, uint8_t *bits, uint64_t firstBit,
+                       uint64_t bitCount);
+
+// 按位置序列读写：比特流第 firstBit + i 位写到 carrier[positions(firstBit + i)] 的最低位。
+// carrier 可以是指针或 ImageView，positions 可以是 KeyedPermutation 等任何可调用对象。
+template <typename Carrier, typename Positions>
+void embedBitsAt(const Carrier &carrier, const Positions &positions, uint64_t firstBit, const uint8_t *bytes, size_t byteCount) {
+    uint64_t index = firstBit;
+    for (size_t i = 0; i < byteCount; ++i) {
+        for (int bit = 0; bit < 8; ++bit, ++index) {
+            uint64_t position = positions(index);
+            carrier[position] = static_cast<uint8_t>((carrier[position] & 0xFE) | ((bytes[i] >> bit) & 1));
+        }
+    }
+}
+
+template <typename Carrier, typename Positions>
+void extractBitsAt(const Carrier &carrier, const Positions &positions, uint64_t firstBit, uint8_t *bytes, size_t byteCount) {
+    uint64_t index = firstBit;
+    for (size_t i = 0; i < byteCount; ++i) {
+        uint8_t byte = 0;
+        for (int bit = 0; bit < 8; ++bit, ++index) {
+            byte |= static_cast<uint8_t>((carrier[positions(index)] & 1) << bit);
+        }
+        bytes[i] = byte;
+    }
+}
+
+} // namespace ld
+
+#endif // BITPLANE_H
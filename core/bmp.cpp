@@ -0,0 +1,267 @@
+#include "bmp.h"
+#include "ldutil.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <system_error>
+
+namespace ld {
+
+namespace {
+
+constexpr size_t FILE_HEADER_SIZE = 14;
+constexpr size_t INFO_HEADER_SIZE = 40;
+
+inline uint32_t readLE32(const uint8_t *p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16
+           | static_cast<uint32_t>(p[3]) << 24;
+}
+
+inline uint16_t readLE16(const uint8_t *p) {
+    return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+inline void writeLE32(uint8_t *p, uint32_t value) {
+    p[0] = static_cast<uint8_t>(value & 0xFF);
+    p[1] = static_cast<uint8_t>((value >> 8) & 0xFF);
+    p[2] = static_cast<uint8_t>((value >> 16) & 0xFF);
+    p[3] = static_cast<uint8_t>((value >> 24) & 0xFF);
+}
+
+inline bool fitsInMemory(const BmpInfo &info) {
+    return info.pixelBytes() <= std::numeric_limits<size_t>::max() - info.dataOffset;
+}
+
+// 文件的总字节数，读取位置回到开头
+uint64_t streamSize(std::istream &file) {
+    file.seekg(0, std::ios::end);
+    uint64_t size = static_cast<uint64_t>(static_cast<std::streamoff>(file.tellg()));
+    file.seekg(0);
+    return size;
+}
+
+// 程序生成的图像没有原始头部时使用
+std::vector<uint8_t> makeHeader(const BmpInfo &info, const std::vector<uint8_t> &colorTable) {
+    uint32_t dataOffset = FILE_HEADER_SIZE + INFO_HEADER_SIZE + (info.bitCount == 8 ? 256 * 4 : 0);
+    std::vector<uint8_t> header(dataOffset, 0);
+    header[0] = 'B';
+    header[1] = 'M';
+    writeLE32(&header[2], static_cast<uint32_t>(dataOffset + info.pixelBytes())); // File size
+    writeLE32(&header[10], dataOffset);
+    writeLE32(&header[14], INFO_HEADER_SIZE);
+    writeLE32(&header[18], static_cast<uint32_t>(info.width));
+    writeLE32(&header[22], static_cast<uint32_t>(info.topDown ? -info.height : info.height));
+    header[26] = 1; // Planes
+    header[28] = static_cast<uint8_t>(info.bitCount);
+
+    // color table
+    if (info.bitCount == 8) {
+        uint8_t *palette = &header[FILE_HEADER_SIZE + INFO_HEADER_SIZE];
+        if (colorTable.size() >= 256 * 4) {
+            std::copy(colorTable.begin(), colorTable.begin() + 256 * 4, palette);
+        } else {
+            for (int i = 0; i < 256; ++i) {
+                palette[i * 4] = palette[i * 4 + 1] = palette[i * 4 + 2] = static_cast<uint8_t>(i);
+            }
+        }
+    }
+    return header;
+}
+
+} // namespace
+
+bool parseBmpInfo(const uint8_t *data, size_t size, uint64_t fileSize, BmpInfo &info, std::string *error) {
+    if (size < FILE_HEADER_SIZE + INFO_HEADER_SIZE) {
+        return fail(error, "Unable to read BMP header");
+    }
+    if (data[0] != 'B' || data[1] != 'M') {
+        return fail(error, "Not a BMP file");
+    }
+
+    const uint8_t *dibHeader = data + FILE_HEADER_SIZE;
+    uint32_t dibSize = readLE32(dibHeader);
+    int32_t height = static_cast<int32_t>(readLE32(&dibHeader[8]));
+    info.width = static_cast<int32_t>(readLE32(&dibHeader[4]));
+    info.bitCount = readLE16(&dibHeader[14]);
+    info.dataOffset = readLE32(&data[10]);
+    uint32_t compression = readLE32(&dibHeader[16]);
+
+    // 检查BMP格式是否为24真彩或256灰度图
+    if (dibSize < INFO_HEADER_SIZE || (info.bitCount != 24 && info.bitCount != 8) || compression != 0) {
+        return fail(error, "Unsupported BMP format. Only uncompressed 24-bit and 8-bit BMP files are supported.");
+    }
+    if (info.width <= 0 || height == 0 || height == std::numeric_limits<int32_t>::min()) {
+        return fail(error, "Invalid BMP dimensions");
+    }
+    if (info.dataOffset < FILE_HEADER_SIZE + dibSize) {
+        return fail(error, "Invalid BMP data offset");
+    }
+
+    info.topDown = height < 0;
+    info.height = info.topDown ? -height : height;
+    // 行宽最多 2^31 * 3 字节，64 位运算不会溢出；整幅图的大小可以超过 size_t，
+    // 只有需要整体放进内存时（readBMP、MappedBmp）才检查
+    info.stride = static_cast<size_t>((static_cast<uint64_t>(info.width) * info.bitCount + 31) / 32 * 4);
+    // 头部中的偏移和尺寸不可信，按它们分配内存之前先与文件大小比较
+    if (info.dataOffset > fileSize) {
+        return fail(error, "Invalid BMP data offset");
+    }
+    if (info.pixelBytes() > fileSize - info.dataOffset) {
+        return fail(error, "Unable to read BMP image data");
+    }
+    return true;
+}
+
+bool readBMP(const std::string &filePath, BmpImage &image, std::string *error, Progress *progress) {
+    LD_TRACE_SCOPE("read");
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        return fail(error, "Unable to open file");
+    }
+
+    uint64_t fileSize = streamSize(file);
+    uint8_t prefix[FILE_HEADER_SIZE + INFO_HEADER_SIZE];
+    file.read(reinterpret_cast<char *>(prefix), sizeof(prefix));
+    BmpInfo &info = image;
+    if (!parseBmpInfo(prefix, static_cast<size_t>(file.gcount()), fileSize, info, error)) {
+        return false;
+    }
+
+    // 文件头、信息头和调色板原样保留
+    image.header.assign(prefix, prefix + sizeof(prefix));
+    image.header.resize(image.dataOffset);
+    file.read(reinterpret_cast<char *>(image.header.data() + sizeof(prefix)), image.dataOffset - sizeof(prefix));
+    if (file.gcount() != static_cast<std::streamsize>(image.dataOffset - sizeof(prefix))) {
+        return fail(error, "Unable to read BMP header");
+    }
+
+    image.colorTable.clear();
+    if (image.bitCount == 8) {
+        size_t paletteOffset = FILE_HEADER_SIZE + readLE32(&prefix[FILE_HEADER_SIZE]);
+        size_t available = image.dataOffset - paletteOffset;
+        image.colorTable.assign(image.header.begin() + paletteOffset,
+                                image.header.begin() + paletteOffset + std::min<size_t>(available, 256 * 4));
+    }
+
+    if (!fitsInMemory(image)) {
+        return fail(error, "BMP image too large for this platform");
+    }
+    image.pixels.resize(static_cast<size_t>(image.pixelBytes()));
+    size_t chunk = progress ? PROGRESS_CHUNK : image.pixels.size();
+    for (size_t done = 0; done < image.pixels.size();) {
+        size_t count = std::min(chunk, image.pixels.size() - done);
+        file.read(reinterpret_cast<char *>(image.pixels.data() + done), static_cast<std::streamsize>(count));
+        if (file.gcount() != static_cast<std::streamsize>(count)) {
+            return fail(error, "Unable to read BMP image data");
+        }
+        done += count;
+        if (progress && !progress->report(done, image.pixels.size())) {
+            return fail(error, "Cancelled");
+        }
+    }
+    LD_TRACE_COUNT("read-bytes", image.pixels.size());
+    return true;
+}
+
+bool readBmpInfo(const std::string &filePath, BmpInfo &info, std::string *error) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        return fail(error, "Unable to open file");
+    }
+    uint64_t fileSize = streamSize(file);
+    uint8_t prefix[FILE_HEADER_SIZE + INFO_HEADER_SIZE];
+    file.read(reinterpret_cast<char *>(prefix), sizeof(prefix));
+    return parseBmpInfo(prefix, static_cast<size_t>(file.gcount()), fileSize, info, error);
+}
+
+bool writeBMP(const std::string &filePath, const BmpImage &image, std::string *error, Progress *progress) {
+    LD_TRACE_SCOPE("write");
+    if (image.pixels.size() != image.pixelBytes()) {
+        return fail(error, "Pixel buffer does not match BMP layout");
+    }
+    std::ofstream file(filePath, std::ios::binary);
+    if (!file) {
+        return fail(error, "Unable to write file");
+    }
+
+    if (!image.header.empty() && image.header.size() == image.dataOffset) {
+        file.write(reinterpret_cast<const char *>(image.header.data()), image.header.size());
+    } else {
+        std::vector<uint8_t> header = makeHeader(image, image.colorTable);
+        file.write(reinterpret_cast<const char *>(header.data()), header.size());
+    }
+    size_t chunk = progress ? PROGRESS_CHUNK : image.pixels.size();
+    for (size_t done = 0; done < image.pixels.size();) {
+        size_t count = std::min(chunk, image.pixels.size() - done);
+        file.write(reinterpret_cast<const char *>(image.pixels.data() + done), static_cast<std::streamsize>(count));
+        done += count;
+        if (progress && !progress->report(done, image.pixels.size())) {
+            file.close();
+            std::remove(filePath.c_str());
+            return fail(error, "Cancelled");
+        }
+    }
+    LD_TRACE_COUNT("written-bytes", image.pixels.size());
+    return static_cast<bool>(file) || fail(error, "Unable to write BMP image data");
+}
+
+bool MappedBmp::open(const std::string &filePath, MappedFile::Mode mode, std::string *error) {
+    LD_TRACE_SCOPE("map");
+    if (!file.open(filePath, mode, error)) {
+        return false;
+    }
+    if (!parseBmpInfo(file.data(), static_cast<size_t>(file.size()), file.size(), bmpInfo, error)) {
+        file.close();
+        return false;
+    }
+    if (!fitsInMemory(bmpInfo)) {
+        file.close();
+        return fail(error, "BMP image too large for this platform");
+    }
+    return true;
+}
+
+ImageView MappedBmp::view() {
+    return ImageView(file.data() + bmpInfo.dataOffset, bmpInfo.rowBytes(), bmpInfo.stride,
+                     static_cast<uint64_t>(bmpInfo.height), bmpInfo.bitCount == 24);
+}
+
+ConstImageView MappedBmp::constView() const {
+    return ConstImageView(file.data() + bmpInfo.dataOffset, bmpInfo.rowBytes(), bmpInfo.stride,
+                          static_cast<uint64_t>(bmpInfo.height), bmpInfo.bitCount == 24);
+}
+
+bool MappedBmp::flush(std::string *error) {
+    LD_TRACE_SCOPE("write");
+    return file.flush(error);
+}
+
+bool MappedBmp::saveAs(const std::string &filePath, std::string *error) const {
+    LD_TRACE_SCOPE("write");
+    // 目标可能就是映射着的源文件，直接打开会先截断它、写出的全是空数据；
+    // 先写同目录下的临时文件，写完再改名覆盖目标
+    const std::string tempPath = filePath + ".ldtmp";
+    std::ofstream out(tempPath, std::ios::binary);
+    if (!out) {
+        return fail(error, "Unable to write file");
+    }
+    out.write(reinterpret_cast<const char *>(file.data()), static_cast<std::streamsize>(file.size()));
+    out.close();
+    std::error_code ec;
+    if (!out) {
+        std::filesystem::remove(tempPath, ec);
+        return fail(error, "Unable to write BMP image data");
+    }
+    std::filesystem::rename(tempPath, filePath, ec);
+    if (ec) {
+        std::error_code ignored;
+        std::filesystem::remove(tempPath, ignored);
+        return fail(error, "Unable to replace file: " + ec.message());
+    }
+    return true;
+}
+
+} // namespace ld
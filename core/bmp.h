@@ -0,0 +1,75 @@
+#ifndef BMP_H
+#define BMP_H
+
+#include "imageview.h"
+#include "mappedfile.h"
+#include "progress.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ld {
+
+// 只支持未压缩的 24 位真彩图和 8 位灰度图
+struct BmpInfo {
+    int32_t width = 0;
+    int32_t height = 0;   // 行数，总是正数
+    int bitCount = 0;
+    bool topDown = false; // 文件中高度为负数：第一行存储的是图像顶部
+    uint32_t dataOffset = 0;
+    size_t stride = 0;    // 每行存储字节数，按 4 字节对齐
+
+    size_t rowBytes() const { return static_cast<size_t>(width) * static_cast<size_t>(bitCount / 8); }
+    uint64_t pixelBytes() const { return static_cast<uint64_t>(stride) * static_cast<uint64_t>(height); }
+};
+
+// 解析文件开头的 BMP 文件头和信息头，data 至少要有 54 字节。
+// fileSize 为整个文件的字节数，dataOffset 或像素数组超出文件时失败
+bool parseBmpInfo(const uint8_t *data, size_t size, uint64_t fileSize, BmpInfo &info,
+                  std::string *error = nullptr);
+
+// 整个文件读入内存，像素数组按文件中的布局原样保存（BGR、含行填充），
+// 通道顺序和填充由 view() 处理
+struct BmpImage : BmpInfo {
+    std::vector<uint8_t> header;     // dataOffset 之前的原始字节，写回时原样输出
+    std::vector<uint8_t> colorTable; // 8 位图的调色板，BGRA
+    std::vector<uint8_t> pixels;
+
+    ImageView view() { return ImageView(pixels.data(), rowBytes(), stride, height, bitCount == 24); }
+    ConstImageView view() const { return ConstImageView(pixels.data(), rowBytes(), stride, height, bitCount == 24); }
+};
+
+// progress 不为空时按块读写并报告进度；取消后返回 false，error 为 "Cancelled"，
+// 取消的写入会删除未写完的文件
+bool readBMP(const std::string &filePath, BmpImage &image, std::string *error = nullptr,
+             Progress *progress = nullptr);
+
+// 只读文件头，不读像素
+bool readBmpInfo(const std::string &filePath, BmpInfo &info, std::string *error = nullptr);
+
+// header 为空时（例如程序生成的图像）按 BmpInfo 生成 54 字节的头部
+bool writeBMP(const std::string &filePath, const BmpImage &image, std::string *error = nullptr,
+              Progress *progress = nullptr);
+
+// 内存映射的 BMP，直接在文件的像素行上嵌入和提取，不复制像素
+class MappedBmp {
+public:
+    bool open(const std::string &filePath, MappedFile::Mode mode, std::string *error = nullptr);
+
+    const BmpInfo &info() const { return bmpInfo; }
+    ImageView view(); // ReadOnly 模式下只能读
+    ConstImageView constView() const;
+
+    // ReadWrite：同步到原文件；CopyOnWrite：把整个映射一次写到新文件。
+    // saveAs 先写临时文件再改名，filePath 可以是打开的源文件
+    bool flush(std::string *error = nullptr);
+    bool saveAs(const std::string &filePath, std::string *error = nullptr) const;
+
+private:
+    MappedFile file;
+    BmpInfo bmpInfo;
+};
+
+} // namespace ld
+
+#endif // BMP_H
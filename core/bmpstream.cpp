@@ -0,0 +1,402 @@
+#include "bmpstream.h"
+#include "bitplane.h"
+#include "compress.h"
+#include "crc32c.h"
+#include "keyedpermutation.h"
+#include "ldutil.h"
+#include "threadpool.h"
+#include "trace.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+namespace ld {
+
+namespace {
+
+constexpr size_t FILE_PREFIX_SIZE = 54;                   // 文件头 + BITMAPINFOHEADER
+constexpr uint64_t MAX_SORTED_BITS = uint64_t(1) << 22;   // 排序表最多 64 MiB，超过后改用逆置换
+constexpr uint64_t HEADER_BITS = PAYLOAD_HEADER_SIZE * 8;
+constexpr uint64_t PARALLEL_GRAIN = 64 * 1024;            // 计算置换时每个并行块的位置数
+
+inline uint64_t carrierSize(const BmpInfo &info) {
+    return static_cast<uint64_t>(info.rowBytes()) * static_cast<uint64_t>(info.height);
+}
+
+inline KeyedPermutation::Kind permutationKind(uint8_t version) {
+    return version == PAYLOAD_VERSION_PHILOX ? KeyedPermutation::Kind::Philox : KeyedPermutation::Kind::SplitMix;
+}
+
+// 打开文件，解析头部并确认像素数据完整，header 保存 dataOffset 之前的原始字节
+bool openBmp(std::ifstream &file, const std::string &filePath, BmpInfo &info, std::vector<uint8_t> &header,
+             std::string *error) {
+    file.open(filePath, std::ios::binary);
+    if (!file) {
+        return fail(error, "Unable to open file");
+    }
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(static_cast<std::streamoff>(file.tellg()));
+    file.seekg(0);
+
+    uint8_t prefix[FILE_PREFIX_SIZE];
+    file.read(reinterpret_cast<char *>(prefix), sizeof(prefix));
+    if (!parseBmpInfo(prefix, static_cast<size_t>(file.gcount()), fileSize, info, error)) {
+        return false;
+    }
+
+    header.assign(prefix, prefix + sizeof(prefix));
+    header.resize(info.dataOffset);
+    file.read(reinterpret_cast<char *>(header.data() + sizeof(prefix)), info.dataOffset - sizeof(prefix));
+    return static_cast<bool>(file) || fail(error, "Unable to read BMP header");
+}
+
+// 一个行带的缓冲区，按存储顺序读写连续的若干行（含行填充）
+class Band {
+public:
+    Band(std::istream &file, const BmpInfo &info, size_t bandBytes)
+        : file(file), info(info),
+          maxRows(std::max<uint64_t>(1, std::min<uint64_t>(bandBytes / info.stride, info.height))),
+          buffer(static_cast<size_t>(maxRows * info.stride)) {}
+
+    uint64_t capacityRows() const { return maxRows; }
+
+    bool read(uint64_t row, uint64_t rowCount) {
+        firstRow = row;
+        rows = std::min(rowCount, maxRows);
+        file.seekg(static_cast<std::streamoff>(info.dataOffset + row * info.stride));
+        file.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(bytes()));
+        return static_cast<bool>(file);
+    }
+
+    bool write(std::ostream &out) const {
+        out.write(reinterpret_cast<const char *>(buffer.data()), static_cast<std::streamsize>(bytes()));
+        return static_cast<bool>(out);
+    }
+
+    ImageView view() { return ImageView(buffer.data(), info.rowBytes(), info.stride, rows, info.bitCount == 24); }
+    uint64_t firstIndex() const { return firstRow * info.rowBytes(); }
+    uint64_t endRow() const { return firstRow + rows; }
+
+private:
+    size_t bytes() const { return static_cast<size_t>(rows * info.stride); }
+
+    std::istream &file;
+    const BmpInfo &info;
+    uint64_t maxRows;
+    std::vector<uint8_t> buffer;
+    uint64_t firstRow = 0;
+    uint64_t rows = 0;
+};
+
+// 比特序号 bit 对应的载体位置，按位置排序后可以顺着行带一次处理完
+struct Target {
+    uint64_t position;
+    uint64_t bit;
+    bool operator<(const Target &other) const { return position < other.position; }
+};
+
+std::vector<Target> sortedTargets(const KeyedPermutation &permutation, uint64_t firstBit, uint64_t bitCount) {
+    LD_TRACE_SCOPE("permutation");
+    std::vector<Target> targets(static_cast<size_t>(bitCount));
+    parallelFor(bitCount, PARALLEL_GRAIN, [&](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; ++i) {
+            targets[static_cast<size_t>(i)] = Target{permutation(firstBit + i), firstBit + i};
+        }
+    });
+    std::sort(targets.begin(), targets.end());
+    return targets;
+}
+
+// 嵌入的比特流由头部和正文两段组成，分开存放，不为拼接复制正文
+struct Segment {
+    const uint8_t *bytes;
+    uint64_t firstBit; // 在比特流中的起始序号
+    uint64_t bitCount;
+};
+
+inline int streamBit(const Segment (&segments)[2], uint64_t bit) {
+    const Segment &segment = bit < segments[1].firstBit ? segments[0] : segments[1];
+    uint64_t offset = bit - segment.firstBit;
+    return (segment.bytes[offset / 8] >> (offset % 8)) & 1;
+}
+
+inline void setLsb(uint8_t &target, int bit) {
+    target = static_cast<uint8_t>((target & 0xFE) | bit);
+}
+
+// 读出比特流中 [firstBit, firstBit + bitCount) 写入 out，out 的第 0 位对应 firstBit
+class Gatherer {
+public:
+    Gatherer(std::istream &file, const BmpInfo &info, const std::string &key, uint8_t version, size_t bandBytes)
+        : info(info), keyed(!key.empty()), permutation(key, keyed ? carrierSize(info) : 0, permutationKind(version)),
+          band(file, info, bandBytes) {}
+
+    bool read(uint64_t firstBit, uint64_t bitCount, uint8_t *out) {
+        if (!keyed) {
+            return readSequential(firstBit, bitCount, out);
+        }
+        if (bitCount <= MAX_SORTED_BITS) {
+            return readSorted(firstBit, bitCount, out);
+        }
+        return readInverse(firstBit, bitCount, out);
+    }
+
+private:
+    bool readSequential(uint64_t firstBit, uint64_t bitCount, uint8_t *out) {
+        uint64_t endBit = firstBit + bitCount;
+        uint64_t lastRow = (endBit - 1) / info.rowBytes();
+        for (uint64_t row = firstBit / info.rowBytes(); row <= lastRow; row = band.endRow()) {
+            if (!band.read(row, lastRow + 1 - row)) {
+                return false;
+            }
+            ImageView view = band.view();
+            uint64_t begin = std::max(firstBit, band.firstIndex());
+            uint64_t end = std::min(endBit, band.firstIndex() + view.size());
+            extractSequential(view, begin - band.firstIndex(), out, begin - firstBit, end - begin);
+        }
+        return true;
+    }
+
+    // 只读入包含目标位置的行；位置很少时（例如头部）每次只读一行
+    bool readSorted(uint64_t firstBit, uint64_t bitCount, uint8_t *out) {
+        std::fill(out, out + (bitCount + 7) / 8, uint8_t(0));
+        std::vector<Target> targets = sortedTargets(permutation, firstBit, bitCount);
+        uint64_t rowsPerRead = bitCount < band.capacityRows() ? 1 : band.capacityRows();
+        size_t next = 0;
+        while (next < targets.size()) {
+            uint64_t row = targets[next].position / info.rowBytes();
+            if (!band.read(row, std::min<uint64_t>(rowsPerRead, info.height - row))) {
+                return false;
+            }
+            ImageView view = band.view();
+            uint64_t end = band.firstIndex() + view.size();
+            for (; next < targets.size() && targets[next].position < end; ++next) {
+                uint64_t bit = targets[next].bit - firstBit;
+                out[bit / 8] |= static_cast<uint8_t>((view[targets[next].position - band.firstIndex()] & 1) << (bit % 8));
+            }
+        }
+        return true;
+    }
+
+    bool readInverse(uint64_t firstBit, uint64_t bitCount, uint8_t *out) {
+        std::fill(out, out + (bitCount + 7) / 8, uint8_t(0));
+        for (uint64_t row = 0; row < static_cast<uint64_t>(info.height); row = band.endRow()) {
+            if (!band.read(row, info.height - row)) {
+                return false;
+            }
+            // 不同位置可能落在 out 的同一个字节上，各块先收集命中的比特再统一写入
+            ImageView view = band.view();
+            std::mutex outMutex;
+            parallelFor(view.size(), PARALLEL_GRAIN, [&](uint64_t begin, uint64_t end) {
+                std::vector<uint64_t> ones;
+                for (uint64_t i = begin; i < end; ++i) {
+                    uint64_t bit = permutation.inverse(band.firstIndex() + i) - firstBit;
+                    if (bit < bitCount && (view[i] & 1)) {
+                        ones.push_back(bit);
+                    }
+                }
+                std::lock_guard<std::mutex> lock(outMutex);
+                for (uint64_t bit : ones) {
+                    out[bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+                }
+            });
+        }
+        return true;
+    }
+
+    const BmpInfo &info;
+    bool keyed;
+    KeyedPermutation permutation;
+    Band band;
+};
+
+} // namespace
+
+uint64_t streamPayloadCapacity(const BmpInfo &info) {
+    uint64_t capacity = carrierSize(info) / 8;
+    return capacity > PAYLOAD_HEADER_SIZE ? capacity - PAYLOAD_HEADER_SIZE : 0;
+}
+
+bool streamEmbedPayload(const std::string &inputPath, const std::string &outputPath, ConstByteSpan payload,
+                        const std::string &key, std::string *error, size_t bandBytes) {
+    LD_TRACE_SCOPE("embed");
+    // 同一文件可能有不同写法（相对路径、符号链接、硬链接）；输出文件还不存在时 equivalent 报错，
+    // 返回 false
+    std::error_code ec;
+    if (inputPath == outputPath || std::filesystem::equivalent(inputPath, outputPath, ec)) {
+        return fail(error, "Input and output must be different files");
+    }
+    std::ifstream in;
+    BmpInfo info;
+    std::vector<uint8_t> fileHeader;
+    if (!openBmp(in, inputPath, info, fileHeader, error)) {
+        return false;
+    }
+    bool keyed = !key.empty();
+    uint64_t storedSize = payload.size() + (keyed ? PAYLOAD_CIPHER_OVERHEAD : 0);
+    if (carrierSize(info) / 8 < PAYLOAD_HEADER_SIZE || storedSize > streamPayloadCapacity(info)) {
+        return fail(error, "Message too long for this image");
+    }
+
+    // 带密钥时正文整段加密，与 embedPayload 的格式相同
+    PayloadHeader header;
+    header.version = keyed ? PAYLOAD_VERSION_PHILOX : PAYLOAD_VERSION;
+    header.flags = keyed ? PAYLOAD_FLAG_ENCRYPTED : 0;
+    uint8_t encoded[PAYLOAD_HEADER_SIZE];
+    encodePayloadHeader(header, encoded);
+    std::vector<uint8_t> sealed;
+    ConstByteSpan body = payload;
+    if (keyed) {
+        sealed = sealPayload(payload, key, encoded);
+        body = sealed;
+    }
+    header.length = body.size();
+    header.crc = crc32c(body);
+    encodePayloadHeader(header, encoded);
+    const Segment segments[2] = {{encoded, 0, HEADER_BITS},
+                                 {body.data(), HEADER_BITS, static_cast<uint64_t>(body.size()) * 8}};
+    uint64_t totalBits = HEADER_BITS + segments[1].bitCount;
+
+    KeyedPermutation permutation(key, keyed ? carrierSize(info) : 0, permutationKind(header.version));
+    std::vector<Target> targets;
+    bool sorted = keyed && totalBits <= MAX_SORTED_BITS;
+    if (sorted) {
+        targets = sortedTargets(permutation, 0, totalBits);
+    }
+
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        return fail(error, "Unable to write file");
+    }
+    out.write(reinterpret_cast<const char *>(fileHeader.data()), static_cast<std::streamsize>(fileHeader.size()));
+
+    Band band(in, info, bandBytes);
+    size_t next = 0;
+    for (uint64_t row = 0; row < static_cast<uint64_t>(info.height); row = band.endRow()) {
+        if (!band.read(row, info.height - row)) {
+            return fail(error, "Unable to read BMP image data");
+        }
+        ImageView view = band.view();
+        uint64_t begin = band.firstIndex();
+        uint64_t end = begin + view.size();
+        if (!keyed) {
+            // 顺序模式下比特序号就是载体下标
+            for (const Segment &segment : segments) {
+                uint64_t first = std::max(begin, segment.firstBit);
+                uint64_t last = std::min(end, segment.firstBit + segment.bitCount);
+                if (first < last) {
+                    embedSequential(view, first - begin, segment.bytes, first - segment.firstBit, last - first);
+                }
+            }
+        } else if (sorted) {
+            for (; next < targets.size() && targets[next].position < end; ++next) {
+                setLsb(view[targets[next].position - begin], streamBit(segments, targets[next].bit));
+            }
+        } else {
+            parallelFor(view.size(), PARALLEL_GRAIN, [&](uint64_t first, uint64_t last) {
+                for (uint64_t i = first; i < last; ++i) {
+                    uint64_t bit = permutation.inverse(begin + i);
+                    if (bit < totalBits) {
+                        setLsb(view[i], streamBit(segments, bit));
+                    }
+                }
+            });
+        }
+        if (!band.write(out)) {
+            return fail(error, "Unable to write BMP image data");
+        }
+    }
+
+    // 像素之后的数据（如果有）原样复制
+    in.seekg(static_cast<std::streamoff>(info.dataOffset + info.pixelBytes()));
+    char chunk[64 * 1024];
+    while (in.read(chunk, sizeof(chunk)) || in.gcount() > 0) {
+        out.write(chunk, in.gcount());
+    }
+    out.flush();
+    return static_cast<bool>(out) || fail(error, "Unable to write BMP image data");
+}
+
+ExtractStatus streamExtractPayload(const std::string &filePath, std::string &payload, const std::string &key,
+                                   std::string *error, size_t bandBytes) {
+    LD_TRACE_SCOPE("extract");
+    payload.clear();
+    std::ifstream file;
+    BmpInfo info;
+    std::vector<uint8_t> fileHeader;
+    if (!openBmp(file, filePath, info, fileHeader, error)) {
+        return ExtractStatus::IoError;
+    }
+    if (carrierSize(info) / 8 < PAYLOAD_HEADER_SIZE) {
+        return ExtractStatus::NoPayload;
+    }
+
+    // 带密钥时先按版本 2 的置换探测，再按版本 1，与 extractPayload 相同
+    const uint8_t versions[] = {PAYLOAD_VERSION_PHILOX, PAYLOAD_VERSION};
+    std::unique_ptr<Gatherer> gatherer;
+    uint8_t encoded[PAYLOAD_HEADER_SIZE];
+    PayloadHeader header;
+    ExtractStatus status = ExtractStatus::NoPayload;
+    for (size_t i = key.empty() ? 1 : 0; i < 2 && status == ExtractStatus::NoPayload; ++i) {
+        gatherer.reset(new Gatherer(file, info, key, versions[i], bandBytes));
+        if (!gatherer->read(0, PAYLOAD_PROBE_SIZE * 8, encoded)) {
+            fail(error, "Unable to read BMP image data");
+            return ExtractStatus::IoError;
+        }
+        status = decodePayloadHeader(encoded, header);
+        if (status != ExtractStatus::NoPayload && encoded[2] != versions[i]) {
+            status = ExtractStatus::NoPayload;
+        }
+    }
+    // 流式读写只实现了默认布局
+    if (status == ExtractStatus::Ok && (header.flags & LAYOUT_FLAGS) != 0) {
+        status = ExtractStatus::Unsupported;
+    }
+    if (status != ExtractStatus::Ok) {
+        return status;
+    }
+
+    if (!gatherer->read(PAYLOAD_PROBE_SIZE * 8, HEADER_BITS - PAYLOAD_PROBE_SIZE * 8, encoded + PAYLOAD_PROBE_SIZE)) {
+        fail(error, "Unable to read BMP image data");
+        return ExtractStatus::IoError;
+    }
+    decodePayloadHeader(encoded, header);
+    if (header.length > streamPayloadCapacity(info) || header.length > payload.max_size()) {
+        return ExtractStatus::BadLength;
+    }
+
+    payload.resize(static_cast<size_t>(header.length));
+    if (!payload.empty()
+        && !gatherer->read(HEADER_BITS, header.length * 8, reinterpret_cast<uint8_t *>(&payload[0]))) {
+        payload.clear();
+        fail(error, "Unable to read BMP image data");
+        return ExtractStatus::IoError;
+    }
+    if (crc32c(asBytes(payload)) != header.crc) {
+        return ExtractStatus::BadChecksum;
+    }
+    if (header.flags & PAYLOAD_FLAG_ENCRYPTED) {
+        if (key.empty()) {
+            payload.clear();
+            return ExtractStatus::Unsupported;
+        }
+        if (!openPayload(payload, key, encoded)) {
+            payload.clear();
+            return ExtractStatus::BadAuthentication;
+        }
+    }
+    if (header.flags & PAYLOAD_FLAG_COMPRESSED) {
+        std::string stored;
+        stored.swap(payload);
+        if (!decompressPayload(asBytes(stored), payload)) {
+            return ExtractStatus::BadCompression;
+        }
+    }
+    return ExtractStatus::Ok;
+}
+
+} // namespace ld
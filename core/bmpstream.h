@@ -0,0 +1,34 @@
+#ifndef BMPSTREAM_H
+#define BMPSTREAM_H
+
+#include "bmp.h"
+#include "ldspan.h"
+#include "payload.h"
+#include <string>
+
+namespace ld {
+
+// 比内存还大的载体：按固定大小的行带（band）读入、处理、写出，像素不整体放进内存，
+// 下标和文件偏移全部是 64 位。格式与 embedPayload / extractPayload 完全相同，但只支持默认的 EmbedLayout。
+//
+// 峰值内存 = 一个行带 + 载荷本身。带密钥时若载荷较小，预先算出每一位的载体位置并排序，
+// 只访问用到的行；载荷较大时不再建表，对每个行带内的位置做逆置换反查比特序号，
+// 内存仍然只有一个行带，代价是要对整幅图逐字节计算一次置换。
+constexpr size_t DEFAULT_BAND_BYTES = size_t(8) << 20;
+
+// 不读像素，只根据文件头计算可嵌入的正文字节数
+uint64_t streamPayloadCapacity(const BmpInfo &info);
+
+// 从 inputPath 读、向 outputPath 写（两者不能是同一个文件），文件头和像素之后的数据原样复制
+bool streamEmbedPayload(const std::string &inputPath, const std::string &outputPath, ConstByteSpan payload,
+                        const std::string &key = std::string(), std::string *error = nullptr,
+                        size_t bandBytes = DEFAULT_BAND_BYTES);
+
+// 不支持旧的 0xFF 终止格式；文件读取失败时返回 IoError，原因写入 error
+ExtractStatus streamExtractPayload(const std::string &filePath, std::string &payload,
+                                   const std::string &key = std::string(), std::string *error = nullptr,
+                                   size_t bandBytes = DEFAULT_BAND_BYTES);
+
+} // namespace ld
+
+#endif // BMPSTREAM_H
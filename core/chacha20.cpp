@@ -0,0 +1,452 @@
+#include "chacha20.h"
+#include "simd.h"
+#include <algorithm>
+#include <cstring>
+
+namespace ld {
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 64;
+constexpr int DOUBLE_ROUNDS = 10;
+
+inline uint32_t readLE32(const uint8_t *in) {
+    return static_cast<uint32_t>(in[0]) | static_cast<uint32_t>(in[1]) << 8 | static_cast<uint32_t>(in[2]) << 16 |
+           static_cast<uint32_t>(in[3]) << 24;
+}
+
+inline void writeLE32(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+inline uint32_t rotl(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+inline void quarterRound(uint32_t &a, uint32_t &b, uint32_t &c, uint32_t &d) {
+    a += b;
+    d = rotl(d ^ a, 16);
+    c += d;
+    b = rotl(b ^ c, 12);
+    a += b;
+    d = rotl(d ^ a, 8);
+    c += d;
+    b = rotl(b ^ c, 7);
+}
+
+// 计数器为 state[12] 的一块密钥流
+void blockScalar(const uint32_t state[16], uint8_t out[BLOCK_SIZE]) {
+    uint32_t x[16];
+    std::copy(state, state + 16, x);
+    for (int r = 0; r < DOUBLE_ROUNDS; ++r) {
+        quarterRound(x[0], x[4], x[8], x[12]);
+        quarterRound(x[1], x[5], x[9], x[13]);
+        quarterRound(x[2], x[6], x[10], x[14]);
+        quarterRound(x[3], x[7], x[11], x[15]);
+        quarterRound(x[0], x[5], x[10], x[15]);
+        quarterRound(x[1], x[6], x[11], x[12]);
+        quarterRound(x[2], x[7], x[8], x[13]);
+        quarterRound(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < 16; ++i) {
+        writeLE32(out + 4 * i, x[i] + state[i]);
+    }
+}
+
+#ifdef LD_X86
+
+// 向量内核按“每个通道一块”排列：x[i] 的第 b 个通道是第 b 块的第 i 个字，
+// 轮函数与标量相同，最后按 4×4 转置成逐块的字节顺序再与数据异或。返回处理的块数
+
+template <int N>
+LD_TARGET("sse2")
+inline __m128i rotlSSE2(__m128i v) {
+    return _mm_or_si128(_mm_slli_epi32(v, N), _mm_srli_epi32(v, 32 - N));
+}
+
+LD_TARGET("sse2")
+inline void quarterRoundSSE2(__m128i &a, __m128i &b, __m128i &c, __m128i &d) {
+    a = _mm_add_epi32(a, b);
+    d = rotlSSE2<16>(_mm_xor_si128(d, a));
+    c = _mm_add_epi32(c, d);
+    b = rotlSSE2<12>(_mm_xor_si128(b, c));
+    a = _mm_add_epi32(a, b);
+    d = rotlSSE2<8>(_mm_xor_si128(d, a));
+    c = _mm_add_epi32(c, d);
+    b = rotlSSE2<7>(_mm_xor_si128(b, c));
+}
+
+LD_TARGET("sse2")
+size_t blocksSSE2(const uint32_t state[16], uint8_t *data, size_t blocks) {
+    size_t done = 0;
+    for (; done + 4 <= blocks; done += 4) {
+        __m128i input[16];
+        for (int i = 0; i < 16; ++i) {
+            input[i] = _mm_set1_epi32(static_cast<int>(state[i]));
+        }
+        input[12] = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(state[12] + static_cast<uint32_t>(done))),
+                                  _mm_set_epi32(3, 2, 1, 0));
+        __m128i x[16];
+        std::copy(input, input + 16, x);
+        for (int r = 0; r < DOUBLE_ROUNDS; ++r) {
+            quarterRoundSSE2(x[0], x[4], x[8], x[12]);
+            quarterRoundSSE2(x[1], x[5], x[9], x[13]);
+            quarterRoundSSE2(x[2], x[6], x[10], x[14]);
+            quarterRoundSSE2(x[3], x[7], x[11], x[15]);
+            quarterRoundSSE2(x[0], x[5], x[10], x[15]);
+            quarterRoundSSE2(x[1], x[6], x[11], x[12]);
+            quarterRoundSSE2(x[2], x[7], x[8], x[13]);
+            quarterRoundSSE2(x[3], x[4], x[9], x[14]);
+        }
+        uint8_t *out = data + done * BLOCK_SIZE;
+        for (int group = 0; group < 4; ++group) {
+            __m128i *w = x + 4 * group;
+            for (int i = 0; i < 4; ++i) {
+                w[i] = _mm_add_epi32(w[i], input[4 * group + i]);
+            }
+            __m128i t0 = _mm_unpacklo_epi32(w[0], w[1]);
+            __m128i t1 = _mm_unpacklo_epi32(w[2], w[3]);
+            __m128i t2 = _mm_unpackhi_epi32(w[0], w[1]);
+            __m128i t3 = _mm_unpackhi_epi32(w[2], w[3]);
+            __m128i rows[4] = {_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1), _mm_unpacklo_epi64(t2, t3),
+                               _mm_unpackhi_epi64(t2, t3)};
+            for (int b = 0; b < 4; ++b) {
+                __m128i *p = reinterpret_cast<__m128i *>(out + b * BLOCK_SIZE + group * 16);
+                _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), rows[b]));
+            }
+        }
+    }
+    return done;
+}
+
+LD_TARGET("avx2")
+inline __m256i rotl16AVX2(__m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                             2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    return _mm256_shuffle_epi8(v, shuffle);
+}
+
+LD_TARGET("avx2")
+inline __m256i rotl8AVX2(__m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+                                             3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+    return _mm256_shuffle_epi8(v, shuffle);
+}
+
+template <int N>
+LD_TARGET("avx2")
+inline __m256i rotlAVX2(__m256i v) {
+    return _mm256_or_si256(_mm256_slli_epi32(v, N), _mm256_srli_epi32(v, 32 - N));
+}
+
+LD_TARGET("avx2")
+inline void quarterRoundAVX2(__m256i &a, __m256i &b, __m256i &c, __m256i &d) {
+    a = _mm256_add_epi32(a, b);
+    d = rotl16AVX2(_mm256_xor_si256(d, a));
+    c = _mm256_add_epi32(c, d);
+    b = rotlAVX2<12>(_mm256_xor_si256(b, c));
+    a = _mm256_add_epi32(a, b);
+    d = rotl8AVX2(_mm256_xor_si256(d, a));
+    c = _mm256_add_epi32(c, d);
+    b = rotlAVX2<7>(_mm256_xor_si256(b, c));
+}
+
+// 128 位半边内的转置与 SSE2 相同，得到的 rows[group][b] 低半是第 b 块、高半是第 b + 4 块的 4 个字，
+// 再用 permute2x128 把同一块相邻的两组拼成 32 字节
+LD_TARGET("avx2")
+size_t blocksAVX2(const uint32_t state[16], uint8_t *data, size_t blocks) {
+    size_t done = 0;
+    for (; done + 8 <= blocks; done += 8) {
+        __m256i input[16];
+        for (int i = 0; i < 16; ++i) {
+            input[i] = _mm256_set1_epi32(static_cast<int>(state[i]));
+        }
+        input[12] = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(state[12] + static_cast<uint32_t>(done))),
+                                     _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        __m256i x[16];
+        std::copy(input, input + 16, x);
+        for (int r = 0; r < DOUBLE_ROUNDS; ++r) {
+            quarterRoundAVX2(x[0], x[4], x[8], x[12]);
+            quarterRoundAVX2(x[1], x[5], x[9], x[13]);
+            quarterRoundAVX2(x[2], x[6], x[10], x[14]);
+            quarterRoundAVX2(x[3], x[7], x[11], x[15]);
+            quarterRoundAVX2(x[0], x[5], x[10], x[15]);
+            quarterRoundAVX2(x[1], x[6], x[11], x[12]);
+            quarterRoundAVX2(x[2], x[7], x[8], x[13]);
+            quarterRoundAVX2(x[3], x[4], x[9], x[14]);
+        }
+        __m256i rows[4][4];
+        for (int group = 0; group < 4; ++group) {
+            __m256i *w = x + 4 * group;
+            for (int i = 0; i < 4; ++i) {
+                w[i] = _mm256_add_epi32(w[i], input[4 * group + i]);
+            }
+            __m256i t0 = _mm256_unpacklo_epi32(w[0], w[1]);
+            __m256i t1 = _mm256_unpacklo_epi32(w[2], w[3]);
+            __m256i t2 = _mm256_unpackhi_epi32(w[0], w[1]);
+            __m256i t3 = _mm256_unpackhi_epi32(w[2], w[3]);
+            rows[group][0] = _mm256_unpacklo_epi64(t0, t1);
+            rows[group][1] = _mm256_unpackhi_epi64(t0, t1);
+            rows[group][2] = _mm256_unpacklo_epi64(t2, t3);
+            rows[group][3] = _mm256_unpackhi_epi64(t2, t3);
+        }
+        uint8_t *out = data + done * BLOCK_SIZE;
+        for (int b = 0; b < 4; ++b) {
+            __m256i keys[4] = {_mm256_permute2x128_si256(rows[0][b], rows[1][b], 0x20),
+                               _mm256_permute2x128_si256(rows[2][b], rows[3][b], 0x20),
+                               _mm256_permute2x128_si256(rows[0][b], rows[1][b], 0x31),
+                               _mm256_permute2x128_si256(rows[2][b], rows[3][b], 0x31)};
+            uint8_t *targets[4] = {out + b * BLOCK_SIZE, out + b * BLOCK_SIZE + 32, out + (b + 4) * BLOCK_SIZE,
+                                   out + (b + 4) * BLOCK_SIZE + 32};
+            for (int i = 0; i < 4; ++i) {
+                __m256i *p = reinterpret_cast<__m256i *>(targets[i]);
+                _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), keys[i]));
+            }
+        }
+    }
+    return done;
+}
+
+#endif // LD_X86
+
+// 从 state[12] 起 blocks 整块密钥流与 data 异或，不修改 state
+void xorBlocks(const uint32_t state[16], uint8_t *data, size_t blocks) {
+    size_t done = 0;
+#ifdef LD_X86
+    switch (activeSimdLevel()) {
+    case SimdLevel::AVX2:
+        done = blocksAVX2(state, data, blocks);
+        break;
+    case SimdLevel::SSE2:
+        done = blocksSSE2(state, data, blocks);
+        break;
+    default:
+        break;
+    }
+#endif
+    uint32_t counterState[16];
+    std::copy(state, state + 16, counterState);
+    uint8_t keystream[BLOCK_SIZE];
+    for (; done < blocks; ++done) {
+        counterState[12] = state[12] + static_cast<uint32_t>(done);
+        blockScalar(counterState, keystream);
+        uint8_t *out = data + done * BLOCK_SIZE;
+        for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+            out[i] ^= keystream[i];
+        }
+    }
+}
+
+} // namespace
+
+ChaCha20::ChaCha20(const uint8_t key[CHACHA20_KEY_SIZE], const uint8_t nonce[CHACHA20_NONCE_SIZE], uint32_t counter)
+    : state{0x61707865, 0x3320646E, 0x79622D32, 0x6B206574} {
+    for (int i = 0; i < 8; ++i) {
+        state[4 + i] = readLE32(key + 4 * i);
+    }
+    state[12] = counter;
+    for (int i = 0; i < 3; ++i) {
+        state[13 + i] = readLE32(nonce + 4 * i);
+    }
+}
+
+void ChaCha20::apply(uint8_t *data, size_t size) {
+    for (; used < sizeof(keystream) && size > 0; --size) {
+        *data++ ^= keystream[used++];
+    }
+    size_t blocks = size / BLOCK_SIZE;
+    if (blocks > 0) {
+        xorBlocks(state, data, blocks);
+        state[12] += static_cast<uint32_t>(blocks);
+        data += blocks * BLOCK_SIZE;
+        size -= blocks * BLOCK_SIZE;
+    }
+    if (size > 0) {
+        blockScalar(state, keystream);
+        ++state[12];
+        for (used = 0; used < size; ++used) {
+            data[used] ^= keystream[used];
+        }
+    }
+}
+
+Poly1305::Poly1305(const uint8_t key[32]) {
+    r[0] = readLE32(key) & 0x3FFFFFF;
+    r[1] = (readLE32(key + 3) >> 2) & 0x3FFFF03;
+    r[2] = (readLE32(key + 6) >> 4) & 0x3FFC0FF;
+    r[3] = (readLE32(key + 9) >> 6) & 0x3F03FFF;
+    r[4] = (readLE32(key + 12) >> 8) & 0x00FFFFF;
+    for (int i = 0; i < 4; ++i) {
+        pad[i] = readLE32(key + 16 + 4 * i);
+    }
+}
+
+// h = (h + 块) * r mod 2^130 - 5，hibit 为每个整块末尾补的 2^128，最后的不完整块已自行补 1
+void Poly1305::blocks(const uint8_t *data, size_t size, uint32_t hibit) {
+    uint64_t r0 = r[0], r1 = r[1], r2 = r[2], r3 = r[3], r4 = r[4];
+    uint64_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+    for (; size >= 16; size -= 16, data += 16) {
+        h0 += readLE32(data) & 0x3FFFFFF;
+        h1 += (readLE32(data + 3) >> 2) & 0x3FFFFFF;
+        h2 += (readLE32(data + 6) >> 4) & 0x3FFFFFF;
+        h3 += (readLE32(data + 9) >> 6) & 0x3FFFFFF;
+        h4 += (readLE32(data + 12) >> 8) | hibit;
+        uint64_t d0 = h0 * r0 + h1 * s4 + h2 * s3 + h3 * s2 + h4 * s1;
+        uint64_t d1 = h0 * r1 + h1 * r0 + h2 * s4 + h3 * s3 + h4 * s2;
+        uint64_t d2 = h0 * r2 + h1 * r1 + h2 * r0 + h3 * s4 + h4 * s3;
+        uint64_t d3 = h0 * r3 + h1 * r2 + h2 * r1 + h3 * r0 + h4 * s4;
+        uint64_t d4 = h0 * r4 + h1 * r3 + h2 * r2 + h3 * r1 + h4 * r0;
+        uint32_t carry = static_cast<uint32_t>(d0 >> 26);
+        h0 = static_cast<uint32_t>(d0) & 0x3FFFFFF;
+        d1 += carry;
+        carry = static_cast<uint32_t>(d1 >> 26);
+        h1 = static_cast<uint32_t>(d1) & 0x3FFFFFF;
+        d2 += carry;
+        carry = static_cast<uint32_t>(d2 >> 26);
+        h2 = static_cast<uint32_t>(d2) & 0x3FFFFFF;
+        d3 += carry;
+        carry = static_cast<uint32_t>(d3 >> 26);
+        h3 = static_cast<uint32_t>(d3) & 0x3FFFFFF;
+        d4 += carry;
+        carry = static_cast<uint32_t>(d4 >> 26);
+        h4 = static_cast<uint32_t>(d4) & 0x3FFFFFF;
+        h0 += carry * 5;
+        carry = h0 >> 26;
+        h0 &= 0x3FFFFFF;
+        h1 += carry;
+    }
+    h[0] = h0;
+    h[1] = h1;
+    h[2] = h2;
+    h[3] = h3;
+    h[4] = h4;
+}
+
+void Poly1305::update(const uint8_t *data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (buffered > 0) {
+        size_t count = std::min(size, sizeof(buffer) - buffered);
+        std::memcpy(buffer + buffered, data, count);
+        buffered += count;
+        data += count;
+        size -= count;
+        if (buffered < sizeof(buffer)) {
+            return;
+        }
+        blocks(buffer, sizeof(buffer), 1u << 24);
+        buffered = 0;
+    }
+    size_t whole = size & ~size_t(15);
+    blocks(data, whole, 1u << 24);
+    std::memcpy(buffer, data + whole, size - whole);
+    buffered = size - whole;
+}
+
+void Poly1305::finish(uint8_t tag[POLY1305_TAG_SIZE]) {
+    if (buffered > 0) {
+        buffer[buffered] = 1;
+        std::fill(buffer + buffered + 1, buffer + sizeof(buffer), uint8_t(0));
+        blocks(buffer, sizeof(buffer), 0);
+    }
+    uint32_t h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+    uint32_t carry = h1 >> 26;
+    h1 &= 0x3FFFFFF;
+    h2 += carry;
+    carry = h2 >> 26;
+    h2 &= 0x3FFFFFF;
+    h3 += carry;
+    carry = h3 >> 26;
+    h3 &= 0x3FFFFFF;
+    h4 += carry;
+    carry = h4 >> 26;
+    h4 &= 0x3FFFFFF;
+    h0 += carry * 5;
+    carry = h0 >> 26;
+    h0 &= 0x3FFFFFF;
+    h1 += carry;
+
+    // g = h - (2^130 - 5)，不小于 0 时取 g，用掩码选择以免分支
+    uint32_t g0 = h0 + 5;
+    carry = g0 >> 26;
+    g0 &= 0x3FFFFFF;
+    uint32_t g1 = h1 + carry;
+    carry = g1 >> 26;
+    g1 &= 0x3FFFFFF;
+    uint32_t g2 = h2 + carry;
+    carry = g2 >> 26;
+    g2 &= 0x3FFFFFF;
+    uint32_t g3 = h3 + carry;
+    carry = g3 >> 26;
+    g3 &= 0x3FFFFFF;
+    uint32_t g4 = h4 + carry - (1u << 26);
+    uint32_t mask = (g4 >> 31) - 1;
+    h0 = (h0 & ~mask) | (g0 & mask);
+    h1 = (h1 & ~mask) | (g1 & mask);
+    h2 = (h2 & ~mask) | (g2 & mask);
+    h3 = (h3 & ~mask) | (g3 & mask);
+    h4 = (h4 & ~mask) | (g4 & mask);
+
+    // 拼成 128 位再加上 pad
+    uint32_t words[4] = {h0 | h1 << 26, h1 >> 6 | h2 << 20, h2 >> 12 | h3 << 14, h3 >> 18 | h4 << 8};
+    uint64_t sum = 0;
+    for (int i = 0; i < 4; ++i) {
+        sum = static_cast<uint64_t>(words[i]) + pad[i] + (sum >> 32);
+        writeLE32(tag + 4 * i, static_cast<uint32_t>(sum));
+    }
+}
+
+Poly1305 ChaCha20Poly1305::macFor(ChaCha20 &cipher) {
+    uint8_t key[BLOCK_SIZE] = {};
+    cipher.apply(key, sizeof(key));
+    return Poly1305(key);
+}
+
+// 成员按声明顺序初始化：macFor() 用掉计数器 0 的一块作为 Poly1305 密钥，正文从计数器 1 开始
+ChaCha20Poly1305::ChaCha20Poly1305(const uint8_t key[CHACHA20_KEY_SIZE], const uint8_t nonce[CHACHA20_NONCE_SIZE],
+                                   ConstByteSpan aad)
+    : cipher(key, nonce, 0), mac(macFor(cipher)), aadSize(aad.size()) {
+    static const uint8_t zeros[16] = {};
+    mac.update(aad.data(), aad.size());
+    mac.update(zeros, (16 - aad.size() % 16) % 16);
+}
+
+void ChaCha20Poly1305::encrypt(uint8_t *data, size_t size) {
+    cipher.apply(data, size);
+    mac.update(data, size);
+    textSize += size;
+}
+
+void ChaCha20Poly1305::decrypt(uint8_t *data, size_t size) {
+    mac.update(data, size);
+    cipher.apply(data, size);
+    textSize += size;
+}
+
+void ChaCha20Poly1305::finish(uint8_t tag[POLY1305_TAG_SIZE]) {
+    static const uint8_t zeros[16] = {};
+    mac.update(zeros, (16 - textSize % 16) % 16);
+    uint8_t lengths[16];
+    for (int i = 0; i < 8; ++i) {
+        lengths[i] = static_cast<uint8_t>(aadSize >> (8 * i));
+        lengths[8 + i] = static_cast<uint8_t>(textSize >> (8 * i));
+    }
+    mac.update(lengths, sizeof(lengths));
+    mac.finish(tag);
+}
+
+bool ChaCha20Poly1305::verify(const uint8_t tag[POLY1305_TAG_SIZE]) {
+    uint8_t expected[POLY1305_TAG_SIZE];
+    finish(expected);
+    uint8_t difference = 0;
+    for (size_t i = 0; i < POLY1305_TAG_SIZE; ++i) {
+        difference |= expected[i] ^ tag[i];
+    }
+    return difference == 0;
+}
+
+} // namespace ld
@@ -0,0 +1,71 @@
+#ifndef CHACHA20_H
+#define CHACHA20_H
+
+#include "ldspan.h"
+#include <cstdint>
+
+namespace ld {
+
+constexpr size_t CHACHA20_KEY_SIZE = 32;
+constexpr size_t CHACHA20_NONCE_SIZE = 12;
+constexpr size_t POLY1305_TAG_SIZE = 16;
+
+// ChaCha20（RFC 8439）：32 位块计数器 + 96 位 nonce。整块部分按 activeSimdLevel() 选择内核，
+// AVX2 一次算 8 块、SSE2 一次算 4 块，各块只由计数器决定，结果与等级无关。
+class ChaCha20 {
+public:
+    ChaCha20(const uint8_t key[CHACHA20_KEY_SIZE], const uint8_t nonce[CHACHA20_NONCE_SIZE], uint32_t counter = 0);
+
+    // data 与密钥流异或（加密和解密相同）。可以分任意长度多次调用，结果与一次处理整段相同
+    void apply(uint8_t *data, size_t size);
+
+private:
+    uint32_t state[16];
+    uint8_t keystream[64];
+    size_t used = sizeof(keystream); // keystream 中已经用掉的字节
+};
+
+// Poly1305 一次性消息认证码，5 个 26 位分量的 32 位实现，不依赖 128 位整数
+class Poly1305 {
+public:
+    explicit Poly1305(const uint8_t key[32]);
+
+    void update(const uint8_t *data, size_t size);
+    // 调用后对象不能再使用
+    void finish(uint8_t tag[POLY1305_TAG_SIZE]);
+
+private:
+    void blocks(const uint8_t *data, size_t size, uint32_t hibit);
+
+    uint32_t r[5];
+    uint32_t h[5] = {};
+    uint32_t pad[4];
+    uint8_t buffer[16];
+    size_t buffered = 0;
+};
+
+// ChaCha20-Poly1305 AEAD（RFC 8439 第 2.8 节）。正文可以分块 encrypt()/decrypt()，
+// 全部处理完后用 finish() 取得标签，或用 verify() 与收到的标签比较（比较时间与内容无关）。
+// 解密时标签要等全部正文处理完才能验证，调用方在 verify() 成功之前不应信任明文
+class ChaCha20Poly1305 {
+public:
+    ChaCha20Poly1305(const uint8_t key[CHACHA20_KEY_SIZE], const uint8_t nonce[CHACHA20_NONCE_SIZE],
+                     ConstByteSpan aad);
+
+    void encrypt(uint8_t *data, size_t size);
+    void decrypt(uint8_t *data, size_t size);
+    void finish(uint8_t tag[POLY1305_TAG_SIZE]);
+    bool verify(const uint8_t tag[POLY1305_TAG_SIZE]);
+
+private:
+    static Poly1305 macFor(ChaCha20 &cipher);
+
+    ChaCha20 cipher;
+    Poly1305 mac;
+    uint64_t aadSize;
+    uint64_t textSize = 0;
+};
+
+} // namespace ld
+
+#endif // CHACHA20_H
@@ -0,0 +1,392 @@
+#include "compress.h"
+#include "threadpool.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ld {
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t LAST_LITERALS = 5; // 块的最后 5 字节必须是字面量
+constexpr size_t MATCH_LIMIT = 12;  // 最后一个匹配至少在块尾 12 字节之前开始
+constexpr int HASH_BITS = 12;
+constexpr uint32_t STORED_BIT = 0x80000000u;
+constexpr size_t BLOCK_HEADER = 4;
+// 每个并行任务处理的块数
+constexpr uint64_t PARALLEL_BLOCKS = 4;
+
+uint32_t read32(const uint8_t *p) {
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+uint64_t read64(const uint8_t *p) {
+    uint64_t value;
+    std::memcpy(&value, p, 8);
+    return value;
+}
+
+int lowestBit(uint64_t word) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+uint32_t hash4(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+size_t compressBound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+// 从 a、b 开始有多少字节相同，最多比较到 limit（a 之后的位置）
+size_t matchLength(const uint8_t *a, const uint8_t *b, const uint8_t *limit) {
+    const uint8_t *start = a;
+    while (a + 8 <= limit) {
+        uint64_t diff = read64(a) ^ read64(b);
+        if (diff != 0) {
+            return static_cast<size_t>(a - start) + static_cast<size_t>(lowestBit(diff) / 8);
+        }
+        a += 8;
+        b += 8;
+    }
+    while (a < limit && *a == *b) {
+        ++a;
+        ++b;
+    }
+    return static_cast<size_t>(a - start);
+}
+
+uint8_t *writeLength(uint8_t *op, size_t length) {
+    for (; length >= 255; length -= 255) {
+        *op++ = 255;
+    }
+    *op++ = static_cast<uint8_t>(length);
+    return op;
+}
+
+// 一个序列：literals 个字面量之后是长度为 length、距离为 offset 的匹配；length 为 0 时是块尾的字面量
+uint8_t *writeSequence(uint8_t *op, const uint8_t *anchor, size_t literals, size_t offset, size_t length) {
+    uint8_t *token = op++;
+    *token = static_cast<uint8_t>(std::min<size_t>(literals, 15) << 4);
+    if (literals >= 15) {
+        op = writeLength(op, literals - 15);
+    }
+    std::memcpy(op, anchor, literals);
+    op += literals;
+    if (length == 0) {
+        return op;
+    }
+    *op++ = static_cast<uint8_t>(offset);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+    size_t extra = length - MIN_MATCH;
+    *token |= static_cast<uint8_t>(std::min<size_t>(extra, 15));
+    if (extra >= 15) {
+        op = writeLength(op, extra - 15);
+    }
+    return op;
+}
+
+// LZ4 块格式；dst 至少 compressBound(size) 字节，size 不超过 COMPRESS_BLOCK，匹配距离不会超过 65535
+size_t compressBlock(const uint8_t *src, size_t size, uint8_t *dst) {
+    uint8_t *op = dst;
+    const uint8_t *anchor = src;
+    const uint8_t *end = src + size;
+    if (size > MATCH_LIMIT) {
+        uint16_t table[1 << HASH_BITS] = {};
+        const uint8_t *matchEnd = end - LAST_LITERALS;
+        const uint8_t *searchEnd = end - MATCH_LIMIT;
+        const uint8_t *ip = src + 1;
+        // 连续找不到匹配时逐渐加大步长，跳过不可压缩的数据
+        unsigned misses = 1 << 6;
+        while (ip <= searchEnd) {
+            uint32_t sequence = read32(ip);
+            uint32_t h = hash4(sequence);
+            const uint8_t *ref = src + table[h];
+            table[h] = static_cast<uint16_t>(ip - src);
+            if (ref >= ip || read32(ref) != sequence) {
+                ip += misses++ >> 6;
+                continue;
+            }
+            misses = 1 << 6;
+
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                --ip;
+                --ref;
+            }
+            size_t length = MIN_MATCH + matchLength(ip + MIN_MATCH, ref + MIN_MATCH, matchEnd);
+            op = writeSequence(op, anchor, static_cast<size_t>(ip - anchor), static_cast<size_t>(ip - ref), length);
+            ip += length;
+            anchor = ip;
+            if (ip <= searchEnd) {
+                table[hash4(read32(ip - 2))] = static_cast<uint16_t>(ip - 2 - src);
+            }
+        }
+    }
+    op = writeSequence(op, anchor, static_cast<size_t>(end - anchor), 0, 0);
+    return static_cast<size_t>(op - dst);
+}
+
+bool readLength(const uint8_t *&ip, const uint8_t *end, size_t &length) {
+    uint8_t byte;
+    do {
+        if (ip >= end) {
+            return false;
+        }
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// 解出的长度写入 written；输入或输出越界、距离无效时返回 false
+bool decompressBlock(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity, size_t &written) {
+    const uint8_t *ip = src;
+    const uint8_t *end = src + size;
+    size_t op = 0;
+    while (true) {
+        if (ip >= end) {
+            return false;
+        }
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(ip, end, literals)) {
+            return false;
+        }
+        if (literals > static_cast<size_t>(end - ip) || literals > capacity - op) {
+            return false;
+        }
+        std::memcpy(dst + op, ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == end) {
+            break;
+        }
+
+        if (end - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | static_cast<size_t>(ip[1]) << 8;
+        ip += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(ip, end, length)) {
+            return false;
+        }
+        length += MIN_MATCH;
+        if (offset == 0 || offset > op || length > capacity - op) {
+            return false;
+        }
+        uint8_t *out = dst + op;
+        const uint8_t *ref = out - offset;
+        if (offset >= length) {
+            std::memcpy(out, ref, length);
+        } else {
+            for (size_t i = 0; i < length; ++i) {
+                out[i] = ref[i];
+            }
+        }
+        op += length;
+    }
+    written = op;
+    return true;
+}
+
+void writeHeader(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint32_t readHeader(const uint8_t *in) {
+    return in[0] | static_cast<uint32_t>(in[1]) << 8 | static_cast<uint32_t>(in[2]) << 16 |
+           static_cast<uint32_t>(in[3]) << 24;
+}
+
+// 压缩一块并追加到 out，不变小时原样存放
+void appendBlock(const uint8_t *data, size_t count, std::vector<uint8_t> &out) {
+    size_t start = out.size();
+    out.resize(start + BLOCK_HEADER + compressBound(count));
+    size_t size = compressBlock(data, count, out.data() + start + BLOCK_HEADER);
+    if (size >= count) {
+        std::memcpy(out.data() + start + BLOCK_HEADER, data, count);
+        writeHeader(out.data() + start, static_cast<uint32_t>(count) | STORED_BIT);
+        size = count;
+    } else {
+        writeHeader(out.data() + start, static_cast<uint32_t>(size));
+    }
+    out.resize(start + BLOCK_HEADER + size);
+}
+
+// 块头部是否合理：原样存放的块不超过 COMPRESS_BLOCK，压缩块不超过其上界
+bool validHeader(uint32_t header) {
+    size_t size = header & ~STORED_BIT;
+    return size > 0 && size <= ((header & STORED_BIT) ? COMPRESS_BLOCK : compressBound(COMPRESS_BLOCK));
+}
+
+// LZ4 一个字节最多表示 255 字节的匹配长度，满块压缩后至少这么大；
+// 整段解压前据此拒绝会让输出缓冲区膨胀的数据
+constexpr size_t MIN_FULL_BLOCK = COMPRESS_BLOCK / 256;
+
+// 解一块到 dst（容量 COMPRESS_BLOCK）
+bool decodeBlock(uint32_t header, const uint8_t *data, uint8_t *dst, size_t &written) {
+    size_t size = header & ~STORED_BIT;
+    if (header & STORED_BIT) {
+        std::memcpy(dst, data, size);
+        written = size;
+        return true;
+    }
+    return decompressBlock(data, size, dst, COMPRESS_BLOCK, written);
+}
+
+} // namespace
+
+std::vector<uint8_t> compressPayload(ConstByteSpan data) {
+    LD_TRACE_SCOPE("compress");
+    uint64_t blocks = (data.size() + COMPRESS_BLOCK - 1) / COMPRESS_BLOCK;
+    std::vector<std::vector<uint8_t>> parts(static_cast<size_t>(blocks));
+    parallelFor(blocks, PARALLEL_BLOCKS, [&](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; ++i) {
+            size_t offset = static_cast<size_t>(i) * COMPRESS_BLOCK;
+            appendBlock(data.data() + offset, std::min(COMPRESS_BLOCK, data.size() - offset), parts[i]);
+        }
+    });
+
+    size_t total = 0;
+    for (const std::vector<uint8_t> &part : parts) {
+        total += part.size();
+    }
+    std::vector<uint8_t> out;
+    out.reserve(total);
+    for (const std::vector<uint8_t> &part : parts) {
+        out.insert(out.end(), part.begin(), part.end());
+    }
+    return out;
+}
+
+bool decompressPayload(ConstByteSpan stored, std::string &out) {
+    LD_TRACE_SCOPE("decompress");
+    // 先顺序找出每块的位置，再并行解压；除最后一块外输出位置是固定的
+    std::vector<size_t> offsets;
+    for (size_t pos = 0; pos < stored.size();) {
+        if (stored.size() - pos < BLOCK_HEADER) {
+            return false;
+        }
+        uint32_t header = readHeader(stored.data() + pos);
+        size_t size = header & ~STORED_BIT;
+        if (!validHeader(header) || size > stored.size() - pos - BLOCK_HEADER) {
+            return false;
+        }
+        if (!offsets.empty() && !(readHeader(stored.data() + offsets.back()) & STORED_BIT) &&
+            (readHeader(stored.data() + offsets.back()) & ~STORED_BIT) < MIN_FULL_BLOCK) {
+            return false;
+        }
+        offsets.push_back(pos);
+        pos += BLOCK_HEADER + size;
+    }
+
+    out.resize(offsets.size() * COMPRESS_BLOCK);
+    std::vector<size_t> sizes(offsets.size());
+    std::vector<uint8_t> ok(offsets.size());
+    parallelFor(offsets.size(), PARALLEL_BLOCKS, [&](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; ++i) {
+            const uint8_t *block = stored.data() + offsets[i];
+            uint8_t *dst = reinterpret_cast<uint8_t *>(&out[static_cast<size_t>(i) * COMPRESS_BLOCK]);
+            ok[i] = decodeBlock(readHeader(block), block + BLOCK_HEADER, dst, sizes[i]);
+        }
+    });
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        if (!ok[i] || (i + 1 < offsets.size() && sizes[i] != COMPRESS_BLOCK)) {
+            out.clear();
+            return false;
+        }
+    }
+    if (!offsets.empty()) {
+        out.resize((offsets.size() - 1) * COMPRESS_BLOCK + sizes.back());
+    }
+    return true;
+}
+
+void StreamCompressor::update(const uint8_t *data, size_t count, std::vector<uint8_t> &out) {
+    // 输入正好落在块边界上时直接压缩，不经过 pending
+    while (count > 0) {
+        if (pending.empty() && count >= COMPRESS_BLOCK) {
+            appendBlock(data, COMPRESS_BLOCK, out);
+            data += COMPRESS_BLOCK;
+            count -= COMPRESS_BLOCK;
+            continue;
+        }
+        size_t take = std::min(count, COMPRESS_BLOCK - pending.size());
+        pending.insert(pending.end(), data, data + take);
+        data += take;
+        count -= take;
+        if (pending.size() == COMPRESS_BLOCK) {
+            appendBlock(pending.data(), pending.size(), out);
+            pending.clear();
+        }
+    }
+}
+
+void StreamCompressor::finish(std::vector<uint8_t> &out) {
+    if (!pending.empty()) {
+        appendBlock(pending.data(), pending.size(), out);
+        pending.clear();
+    }
+}
+
+bool StreamDecompressor::update(const uint8_t *data, size_t count, std::vector<uint8_t> &out) {
+    while (count > 0 && !failed) {
+        if (headerBytes < BLOCK_HEADER) {
+            header[headerBytes++] = *data++;
+            --count;
+            if (headerBytes < BLOCK_HEADER) {
+                continue;
+            }
+            uint32_t value = readHeader(header);
+            // 不满一块的块只能是最后一块
+            if (!validHeader(value) || sawShortBlock) {
+                failed = true;
+                break;
+            }
+            blockStored = (value & STORED_BIT) != 0;
+            blockSize = value & ~STORED_BIT;
+            block.clear();
+        }
+
+        size_t take = std::min(count, blockSize - block.size());
+        block.insert(block.end(), data, data + take);
+        data += take;
+        count -= take;
+        if (block.size() < blockSize) {
+            continue;
+        }
+
+        size_t start = out.size();
+        out.resize(start + COMPRESS_BLOCK);
+        size_t written = 0;
+        uint32_t value = static_cast<uint32_t>(blockSize) | (blockStored ? STORED_BIT : 0);
+        if (!decodeBlock(value, block.data(), out.data() + start, written)) {
+            out.resize(start);
+            failed = true;
+            break;
+        }
+        out.resize(start + written);
+        sawShortBlock = written != COMPRESS_BLOCK;
+        headerBytes = 0;
+        block.clear();
+    }
+    return !failed;
+}
+
+} // namespace ld
@@ -0,0 +1,57 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "ldspan.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ld {
+
+// 嵌入前的快速无损压缩，自带实现，不依赖外部库。
+//
+// 输入按 COMPRESS_BLOCK 字节分块，各块独立压缩（LZ4 块格式，贪心匹配，单个哈希表），
+// 可以并行压缩和解压。压缩后的流是若干块依次排列：
+//
+//   u32 小端  bit31 为 1 表示这块没有压缩、原样存放；低 31 位为后面数据的字节数
+//   数据
+//
+// 除最后一块外每块解压后正好 COMPRESS_BLOCK 字节。压缩后不变小的块原样存放，
+// 最坏情况每块只多 4 字节。
+constexpr size_t COMPRESS_BLOCK = 64 * 1024;
+
+// 整段压缩 / 解压，块在 sharedPool() 上并行处理。解压时流格式不对返回 false
+std::vector<uint8_t> compressPayload(ConstByteSpan data);
+bool decompressPayload(ConstByteSpan stored, std::string &out);
+
+// 边读边压缩：update() 把凑满的块追加到 out，finish() 输出剩下的不满一块的部分
+class StreamCompressor {
+public:
+    void update(const uint8_t *data, size_t count, std::vector<uint8_t> &out);
+    void finish(std::vector<uint8_t> &out);
+
+private:
+    std::vector<uint8_t> pending;
+};
+
+// 边读边解压：输入可以在任意位置断开，解出的数据追加到 out。
+// 格式错误时返回 false，之后不再接受输入；finish() 检查流是否在块边界上结束
+class StreamDecompressor {
+public:
+    bool update(const uint8_t *data, size_t count, std::vector<uint8_t> &out);
+    bool finish() const { return !failed && headerBytes == 0 && block.empty(); }
+
+private:
+    uint8_t header[4] = {};
+    size_t headerBytes = 0;
+    size_t blockSize = 0;
+    bool blockStored = false;
+    bool sawShortBlock = false;
+    bool failed = false;
+    std::vector<uint8_t> block;
+};
+
+} // namespace ld
+
+#endif // COMPRESS_H
@@ -0,0 +1,145 @@
+#include "costmap.h"
+#include "simd.h"
+#include "threadpool.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace ld {
+
+namespace {
+
+constexpr size_t BAND_BYTES = 256 * 1024;
+
+// 一行的 [begin, end) 列（存储顺序），top、middle、bottom 为上、本、下三行，
+// 同一通道的左右相邻字节相距 step，超出行的一侧用本像素代替
+void sobelScalar(const uint8_t *top, const uint8_t *middle, const uint8_t *bottom, size_t rowBytes, size_t step,
+                 size_t begin, size_t end, uint16_t *out) {
+    for (size_t x = begin; x < end; ++x) {
+        size_t left = x >= step ? x - step : x;
+        size_t right = x + step < rowBytes ? x + step : x;
+        auto at = [](const uint8_t *row, size_t column) { return static_cast<int>(row[column] >> 1); };
+        int gx = (at(top, right) - at(top, left)) + 2 * (at(middle, right) - at(middle, left)) +
+                 (at(bottom, right) - at(bottom, left));
+        int gy = (at(bottom, left) + 2 * at(bottom, x) + at(bottom, right)) -
+                 (at(top, left) + 2 * at(top, x) + at(top, right));
+        out[x] = static_cast<uint16_t>(std::abs(gx) + std::abs(gy));
+    }
+}
+
+#ifdef LD_X86
+
+// 16 位运算，|gx|、|gy| 都不超过 508，不会溢出
+LD_TARGET("sse2")
+inline __m128i loadHalved(const uint8_t *p) {
+    return _mm_srli_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)),
+                                            _mm_setzero_si128()), 1);
+}
+
+LD_TARGET("sse2")
+inline __m128i absSSE2(__m128i v) {
+    __m128i sign = _mm_srai_epi16(v, 15);
+    return _mm_sub_epi16(_mm_xor_si128(v, sign), sign);
+}
+
+LD_TARGET("sse2")
+size_t sobelSSE2(const uint8_t *top, const uint8_t *middle, const uint8_t *bottom, size_t step, size_t begin,
+                 size_t end, uint16_t *out) {
+    size_t x = begin;
+    for (; x + 8 <= end; x += 8) {
+        __m128i tl = loadHalved(top + x - step), tc = loadHalved(top + x), tr = loadHalved(top + x + step);
+        __m128i ml = loadHalved(middle + x - step), mr = loadHalved(middle + x + step);
+        __m128i bl = loadHalved(bottom + x - step), bc = loadHalved(bottom + x), br = loadHalved(bottom + x + step);
+        __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(tr, tl), _mm_sub_epi16(br, bl)),
+                                   _mm_slli_epi16(_mm_sub_epi16(mr, ml), 1));
+        __m128i gy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(bl, br), _mm_slli_epi16(bc, 1)),
+                                   _mm_add_epi16(_mm_add_epi16(tl, tr), _mm_slli_epi16(tc, 1)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), _mm_add_epi16(absSSE2(gx), absSSE2(gy)));
+    }
+    return x;
+}
+
+LD_TARGET("avx2")
+inline __m256i loadHalvedAVX2(const uint8_t *p) {
+    return _mm256_srli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))), 1);
+}
+
+LD_TARGET("avx2")
+size_t sobelAVX2(const uint8_t *top, const uint8_t *middle, const uint8_t *bottom, size_t step, size_t begin,
+                 size_t end, uint16_t *out) {
+    size_t x = begin;
+    for (; x + 16 <= end; x += 16) {
+        __m256i tl = loadHalvedAVX2(top + x - step), tc = loadHalvedAVX2(top + x), tr = loadHalvedAVX2(top + x + step);
+        __m256i ml = loadHalvedAVX2(middle + x - step), mr = loadHalvedAVX2(middle + x + step);
+        __m256i bl = loadHalvedAVX2(bottom + x - step), bc = loadHalvedAVX2(bottom + x),
+                br = loadHalvedAVX2(bottom + x + step);
+        __m256i gx = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(tr, tl), _mm256_sub_epi16(br, bl)),
+                                      _mm256_slli_epi16(_mm256_sub_epi16(mr, ml), 1));
+        __m256i gy = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(bl, br), _mm256_slli_epi16(bc, 1)),
+                                      _mm256_add_epi16(_mm256_add_epi16(tl, tr), _mm256_slli_epi16(tc, 1)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + x),
+                            _mm256_add_epi16(_mm256_abs_epi16(gx), _mm256_abs_epi16(gy)));
+    }
+    return x;
+}
+
+#endif // LD_X86
+
+// 两侧各 step 列需要复制边缘，用标量；中间整向量部分用 SIMD，剩下的不满一个向量的列用标量
+void sobelRow(const uint8_t *top, const uint8_t *middle, const uint8_t *bottom, size_t rowBytes, size_t step,
+              uint16_t *out) {
+    if (rowBytes <= 2 * step) {
+        sobelScalar(top, middle, bottom, rowBytes, step, 0, rowBytes, out);
+        return;
+    }
+    size_t begin = step;
+    size_t end = rowBytes - step;
+    size_t x = begin;
+#ifdef LD_X86
+    switch (activeSimdLevel()) {
+    case SimdLevel::AVX2:
+        x = sobelAVX2(top, middle, bottom, step, begin, end, out);
+        break;
+    case SimdLevel::SSE2:
+        x = sobelSSE2(top, middle, bottom, step, begin, end, out);
+        break;
+    default:
+        break;
+    }
+#endif
+    sobelScalar(top, middle, bottom, rowBytes, step, 0, begin, out);
+    sobelScalar(top, middle, bottom, rowBytes, step, x, rowBytes, out);
+}
+
+} // namespace
+
+void computeTextureMap(const ConstImageView &view, std::vector<uint16_t> &texture) {
+    LD_TRACE_SCOPE("costmap");
+    texture.resize(static_cast<size_t>(view.size()));
+    if (view.empty()) {
+        return;
+    }
+    size_t step = view.swapChannels ? 3 : 1;
+    uint64_t rowsPerBand = std::max<uint64_t>(1, BAND_BYTES / view.rowBytes);
+    parallelFor(view.rows, rowsPerBand, [&](uint64_t begin, uint64_t end) {
+        std::vector<uint16_t> row(view.swapChannels ? view.rowBytes : 0);
+        for (uint64_t r = begin; r < end; ++r) {
+            const uint8_t *top = view.row(r > 0 ? r - 1 : r);
+            const uint8_t *bottom = view.row(r + 1 < view.rows ? r + 1 : r);
+            uint16_t *out = texture.data() + r * view.rowBytes;
+            if (!view.swapChannels) {
+                sobelRow(top, view.row(r), bottom, view.rowBytes, step, out);
+                continue;
+            }
+            // 存储顺序是 BGR，逐像素反序写到逻辑顺序
+            sobelRow(top, view.row(r), bottom, view.rowBytes, step, row.data());
+            for (size_t x = 0; x < view.rowBytes; x += 3) {
+                out[x] = row[x + 2];
+                out[x + 1] = row[x + 1];
+                out[x + 2] = row[x];
+            }
+        }
+    });
+}
+
+} // namespace ld
@@ -0,0 +1,23 @@
+#ifndef COSTMAP_H
+#define COSTMAP_H
+
+#include "imageview.h"
+#include <cstdint>
+#include <vector>
+
+namespace ld {
+
+// 每个逻辑字节的纹理强度：同一通道去掉最低位（v >> 1）后 3×3 Sobel 梯度的 L1 范数 |gx| + |gy|，
+// 范围 0-1016。只依赖高 7 位，嵌入前后算出的结果相同。图像边缘按复制边缘像素处理。
+// 按行带在 sharedPool() 上并行，行内按 activeSimdLevel() 选择 AVX2/SSE2/标量内核，结果与等级无关。
+// texture 按逻辑下标排列，大小为 view.size()
+void computeTextureMap(const ConstImageView &view, std::vector<uint16_t> &texture);
+
+// 修改一个最低位的代价：平坦区域接近 1，纹理越强越小
+inline float textureCost(uint16_t texture) {
+    return 1.0f / (1.0f + static_cast<float>(texture));
+}
+
+} // namespace ld
+
+#endif // COSTMAP_H
@@ -0,0 +1,81 @@
+#include "crc32c.h"
+#include "simd.h"
+#include <cstring>
+
+namespace ld {
+
+namespace {
+
+constexpr uint32_t POLYNOMIAL = 0x82F63B78; // 反射形式
+
+// slicing-by-8 查找表
+struct Crc32cTable {
+    uint32_t entries[8][256];
+
+    Crc32cTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (POLYNOMIAL & (0u - (crc & 1)));
+            }
+            entries[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int slice = 1; slice < 8; ++slice) {
+                uint32_t previous = entries[slice - 1][i];
+                entries[slice][i] = (previous >> 8) ^ entries[0][previous & 0xFF];
+            }
+        }
+    }
+};
+
+uint32_t crc32cTable(const uint8_t *data, size_t size, uint32_t crc) {
+    static const Crc32cTable table;
+    const auto &t = table.entries;
+    for (; size >= 8; size -= 8, data += 8) {
+        uint32_t low;
+        uint32_t high;
+        std::memcpy(&low, data, 4);
+        std::memcpy(&high, data + 4, 4);
+        low ^= crc;
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24]
+              ^ t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+    }
+    for (; size > 0; --size, ++data) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(LD_X86) && (defined(__x86_64__) || defined(_M_X64))
+#define LD_HAVE_CRC32_INSTRUCTION 1
+
+LD_TARGET("sse4.2")
+uint32_t crc32cHardware(const uint8_t *data, size_t size, uint32_t crc) {
+    uint64_t value = crc;
+    for (; size >= 8; size -= 8, data += 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        value = _mm_crc32_u64(value, word);
+    }
+    crc = static_cast<uint32_t>(value);
+    for (; size > 0; --size, ++data) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+}
+#endif
+
+} // namespace
+
+uint32_t crc32c(ConstByteSpan data, uint32_t crc) {
+    crc = ~crc;
+#ifdef LD_HAVE_CRC32_INSTRUCTION
+    if (cpuHasCrc32()) {
+        return ~crc32cHardware(data.data(), data.size(), crc);
+    }
+#endif
+    return ~crc32cTable(data.data(), data.size(), crc);
+}
+
+} // namespace ld
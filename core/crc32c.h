@@ -0,0 +1,14 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include "ldspan.h"
+
+namespace ld {
+
+// CRC-32C (Castagnoli)。支持 SSE4.2 时使用 crc32 指令，否则查表。
+// 可以分段计算：crc32c(b, crc32c(a)) == crc32c(a + b)
+uint32_t crc32c(ConstByteSpan data, uint32_t crc = 0);
+
+} // namespace ld
+
+#endif // CRC32C_H
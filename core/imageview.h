@@ -0,0 +1,55 @@
+#ifndef IMAGEVIEW_H
+#define IMAGEVIEW_H
+
+#include "ldspan.h"
+#include <type_traits>
+
+namespace ld {
+
+// 像素数组上的逻辑字节视图，嵌入算法只通过它访问载体。
+// 逻辑顺序：按存储的行顺序，行内跳过 4 字节对齐填充；24 位图行内按 RGB 顺序编号，
+// 实际存储是 BGR，通过下标映射交换通道，不移动像素数据。
+template <typename T>
+struct BasicImageView {
+    T *base = nullptr;
+    size_t rowBytes = 0;       // 每行有效字节数
+    size_t stride = 0;         // 相邻两行的间距（含填充）
+    uint64_t rows = 0;
+    bool swapChannels = false; // 每 3 个字节为一组反序访问
+
+    BasicImageView() = default;
+    BasicImageView(T *base, size_t rowBytes, size_t stride, uint64_t rows, bool swapChannels)
+        : base(base), rowBytes(rowBytes), stride(stride), rows(rows), swapChannels(swapChannels) {}
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U *, T *>::value>>
+    BasicImageView(const BasicImageView<U> &other)
+        : base(other.base), rowBytes(other.rowBytes), stride(other.stride), rows(other.rows),
+          swapChannels(other.swapChannels) {}
+
+    // 连续、已经是逻辑顺序的缓冲区
+    static BasicImageView fromBytes(Span<T> bytes) {
+        return BasicImageView(bytes.data(), bytes.size(), bytes.size(), bytes.empty() ? 0 : 1, false);
+    }
+
+    uint64_t size() const { return static_cast<uint64_t>(rowBytes) * rows; }
+    bool empty() const { return size() == 0; }
+
+    T *row(uint64_t index) const { return base + index * stride; }
+
+    // 逻辑下标 -> 存储位置
+    T &operator[](uint64_t index) const {
+        uint64_t rowIndex = index / rowBytes;
+        size_t column = static_cast<size_t>(index - rowIndex * rowBytes);
+        if (swapChannels) {
+            column += 2 - 2 * (column % 3);
+        }
+        return base[rowIndex * stride + column];
+    }
+};
+
+using ImageView = BasicImageView<uint8_t>;
+using ConstImageView = BasicImageView<const uint8_t>;
+
+} // namespace ld
+
+#endif // IMAGEVIEW_H
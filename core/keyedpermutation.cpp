@@ -0,0 +1,163 @@
+#include "keyedpermutation.h"
+#include <algorithm>
+
+namespace ld {
+
+namespace {
+
+// splitmix64 的终结函数，用作 Feistel 轮函数
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+inline uint32_t seedTemper(uint32_t x) {
+    return x ^ (x >> 27);
+}
+
+// 与 std::seed_seq seed(key.begin(), key.end()); std::mt19937_64 generator(seed); 前 count 个输出逐位相同。
+// 标准库的 seed_seq::generate 每步做三次取模，生成 624 个字要几十微秒，在口令搜索中占了每个口令的大部分时间；
+// 这里下标递增回绕，不做除法。mt19937_64 的前几个输出只用到状态的第 i、i + 1、i + 156 个字，不必扭转整个状态
+void seedRoundKeys(const std::string &key, uint64_t *out, int count) {
+    constexpr size_t N = 312, M = 156, WORDS = 2 * N;
+    constexpr uint64_t MATRIX_A = 0xB5026F5AA96619E9ULL;
+    constexpr uint64_t UPPER_MASK = ~uint64_t(0) << 31;
+
+    // seed_seq::generate，见 [rand.util.seedseq]
+    uint32_t words[WORDS];
+    std::fill(words, words + WORDS, 0x8b8b8b8bu);
+    const size_t s = key.size();
+    const size_t t = 11, p = (WORDS - t) / 2, q = p + t;
+    const size_t m = std::max(s + 1, WORDS);
+    auto next = [](size_t &index) { index = index + 1 == WORDS ? 0 : index + 1; };
+    size_t k0 = 0, kp = p, kq = q, km = WORDS - 1; // k、k + p、k + q、k - 1 模 WORDS
+    for (size_t k = 0; k < m; ++k) {
+        uint32_t r1 = 1664525u * seedTemper(words[k0] ^ words[kp] ^ words[km]);
+        uint32_t r2 = r1 + static_cast<uint32_t>(k0);
+        if (k == 0) {
+            r2 = r1 + static_cast<uint32_t>(s);
+        } else if (k <= s) {
+            r2 += static_cast<uint32_t>(key[k - 1]); // char 按 seed_seq 的方式转换，负值按模 2^32
+        }
+        words[kp] += r1;
+        words[kq] += r2;
+        words[k0] = r2;
+        next(k0), next(kp), next(kq), next(km);
+    }
+    for (size_t k = m; k < m + WORDS; ++k) {
+        uint32_t r3 = 1566083941u * seedTemper(words[k0] + words[kp] + words[km]);
+        uint32_t r4 = r3 - static_cast<uint32_t>(k0);
+        words[kp] ^= r3;
+        words[kq] ^= r4;
+        words[k0] = r4;
+        next(k0), next(kp), next(kq), next(km);
+    }
+
+    // mersenne_twister_engine::seed(seed_seq&)：每个状态字由两个 32 位字组成，全零时置最高位
+    uint64_t state[N];
+    bool zero = true;
+    for (size_t i = 0; i < N; ++i) {
+        state[i] = static_cast<uint64_t>(words[2 * i]) | static_cast<uint64_t>(words[2 * i + 1]) << 32;
+        // 第 0 个字只看参与扭转的高 33 位
+        zero = zero && (i == 0 ? (state[0] & UPPER_MASK) == 0 : state[i] == 0);
+    }
+    if (zero) {
+        state[0] = uint64_t(1) << 63;
+    }
+    for (int i = 0; i < count; ++i) {
+        uint64_t y = (state[i] & UPPER_MASK) | (state[i + 1] & ~UPPER_MASK);
+        uint64_t z = state[i + M] ^ (y >> 1) ^ ((y & 1) ? MATRIX_A : 0);
+        z ^= (z >> 29) & 0x5555555555555555ULL;
+        z ^= (z << 17) & 0x71D67FFFEDA60000ULL;
+        z ^= (z << 37) & 0xFFF7EEE000000000ULL;
+        z ^= z >> 43;
+        out[i] = z;
+    }
+}
+
+} // namespace
+
+KeyedPermutation::KeyedPermutation(const std::string &key, uint64_t domain, Kind kind)
+    : roundKind(kind), rounds(kind == Kind::Philox ? PHILOX_ROUNDS : SPLITMIX_ROUNDS) {
+    setDomain(domain);
+    seedRoundKeys(key, roundKeys, SPLITMIX_ROUNDS);
+    philox.key[0] = static_cast<uint32_t>(roundKeys[0]);
+    philox.key[1] = static_cast<uint32_t>(roundKeys[0] >> 32);
+}
+
+KeyedPermutation::KeyedPermutation(const KeyedPermutation &keyed, uint64_t domain, Kind kind)
+    : KeyedPermutation(keyed) {
+    roundKind = kind;
+    rounds = kind == Kind::Philox ? PHILOX_ROUNDS : SPLITMIX_ROUNDS;
+    setDomain(domain);
+}
+
+void KeyedPermutation::setDomain(uint64_t domain) {
+    this->domain = domain;
+    // 2 * halfBits 位的空间要能覆盖 [0, domain)，cycle-walking 平均不超过 4 次
+    int bits = 0;
+    while (bits < 64 && (domain - 1) >> bits) {
+        ++bits;
+    }
+    halfBits = std::max(1, (bits + 1) / 2);
+    halfMask = (uint64_t(1) << halfBits) - 1;
+}
+
+inline uint64_t KeyedPermutation::round(int r, uint64_t half) const {
+    if (roundKind == Kind::SplitMix) {
+        return mix64(half ^ roundKeys[r]);
+    }
+    uint32_t block[4] = {static_cast<uint32_t>(half), static_cast<uint32_t>(half >> 32), static_cast<uint32_t>(r), 0};
+    philox(block, block);
+    return static_cast<uint64_t>(block[1]) << 32 | block[0];
+}
+
+uint64_t KeyedPermutation::encrypt(uint64_t value) const {
+    uint64_t left = value >> halfBits;
+    uint64_t right = value & halfMask;
+    for (int r = 0; r < rounds; ++r) {
+        uint64_t next = left ^ (round(r, right) & halfMask);
+        left = right;
+        right = next;
+    }
+    return (left << halfBits) | right;
+}
+
+uint64_t KeyedPermutation::decrypt(uint64_t value) const {
+    uint64_t left = value >> halfBits;
+    uint64_t right = value & halfMask;
+    for (int r = rounds - 1; r >= 0; --r) {
+        uint64_t previous = right ^ (round(r, left) & halfMask);
+        right = left;
+        left = previous;
+    }
+    return (left << halfBits) | right;
+}
+
+uint64_t KeyedPermutation::operator()(uint64_t index) const {
+    if (domain <= 1) {
+        return index;
+    }
+    uint64_t value = index;
+    do {
+        value = encrypt(value);
+    } while (value >= domain);
+    return value;
+}
+
+uint64_t KeyedPermutation::inverse(uint64_t position) const {
+    if (domain <= 1) {
+        return position;
+    }
+    uint64_t value = position;
+    do {
+        value = decrypt(value);
+    } while (value >= domain);
+    return value;
+}
+
+} // namespace ld
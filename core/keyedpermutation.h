@@ -0,0 +1,52 @@
+#ifndef KEYEDPERMUTATION_H
+#define KEYEDPERMUTATION_H
+
+#include "philox.h"
+#include <cstdint>
+#include <string>
+
+namespace ld {
+
+// 由密钥决定的 [0, domain) 上的伪随机置换，可随机访问第 i 个位置。
+// 内部是平衡 Feistel 网络加 cycle-walking，不需要生成整张图大小的索引表，
+// 取前 n 个位置的开销只和 n 有关。每个位置独立计算，可以分块在多个线程上并行。
+//
+// 轮函数有两种，对应载荷格式的两个版本：
+//   SplitMix：6 轮 splitmix64 终结函数，轮密钥来自 seed_seq + mt19937_64（格式版本 1，实现见 .cpp，与标准库逐位相同）
+//   Philox：  4 轮 Philox4x32-10，计数器为 (半块, 轮号)，密钥取同一密钥流的第一个字（格式版本 2）
+class KeyedPermutation {
+public:
+    enum class Kind { SplitMix, Philox };
+
+    KeyedPermutation(const std::string &key, uint64_t domain, Kind kind = Kind::SplitMix);
+    // 同一个密钥换定义域和轮函数，复用 keyed 的轮密钥。由密钥生成轮密钥是构造中最慢的一步，
+    // 同一密钥要在多种布局上探测时（例如口令搜索）只生成一次
+    KeyedPermutation(const KeyedPermutation &keyed, uint64_t domain, Kind kind);
+
+    uint64_t operator()(uint64_t index) const;
+    // 逆置换：载体位置 -> 比特序号，按行带流式处理时逐个位置反查
+    uint64_t inverse(uint64_t position) const;
+    uint64_t size() const { return domain; }
+    Kind kind() const { return roundKind; }
+
+private:
+    static constexpr int SPLITMIX_ROUNDS = 6;
+    static constexpr int PHILOX_ROUNDS = 4;
+
+    void setDomain(uint64_t domain);
+    uint64_t round(int r, uint64_t half) const;
+    uint64_t encrypt(uint64_t value) const;
+    uint64_t decrypt(uint64_t value) const;
+
+    uint64_t domain;
+    Kind roundKind;
+    int rounds;
+    int halfBits;
+    uint64_t halfMask;
+    uint64_t roundKeys[SPLITMIX_ROUNDS];
+    Philox4x32 philox;
+};
+
+} // namespace ld
+
+#endif // KEYEDPERMUTATION_H
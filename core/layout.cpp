@@ -0,0 +1,270 @@
+#include "layout.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+
+namespace ld {
+
+namespace {
+
+constexpr int countChannels(int mask) {
+    return (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1);
+}
+
+// 第 n 个被选中的通道（逻辑顺序 R=0、G=1、B=2）
+constexpr int nthChannel(int mask, int n) {
+    for (int channel = 0; channel < 3; ++channel) {
+        if (mask >> channel & 1) {
+            if (n-- == 0) {
+                return channel;
+            }
+        }
+    }
+    return 0;
+}
+
+template <int Channels, int Planes, int Mask>
+struct Kernel {
+    static constexpr int SELECTED = Channels == 1 ? 1 : countChannels(Mask);
+    static constexpr int BITS_PER_PIXEL = SELECTED * Planes;
+    static constexpr uint8_t LOW = static_cast<uint8_t>((1u << Planes) - 1);
+
+    // 第 n 个样本在像素内的存储偏移（24 位图按 BGR 存储）
+    static constexpr size_t offset(int n) { return Channels == 1 ? 0 : static_cast<size_t>(2 - nthChannel(Mask, n)); }
+
+    template <typename T>
+    static T *sampleAt(const BasicImageView<T> &view, uint64_t width, uint64_t sample) {
+        uint64_t pixel = sample / SELECTED;
+        uint64_t row = pixel / width;
+        return view.row(row) + (pixel - row * width) * Channels + offset(static_cast<int>(sample % SELECTED));
+    }
+
+    // 整像素部分按行处理。位缓冲放在局部变量里：通过 uint8_t 指针写像素可能与任何内存重叠，
+    // 放在对象成员里编译器每个像素都要重新读写一遍
+    static void embed(const ImageView &view, uint64_t streamBit, const uint8_t *bits, uint64_t bitCount) {
+        uint64_t width = view.rowBytes / Channels;
+        uint64_t i = 0;
+        // 不在像素边界上的位逐位处理
+        auto single = [&](uint64_t index) {
+            uint64_t bit = streamBit + index;
+            uint8_t *target = sampleAt(view, width, bit / Planes);
+            int plane = static_cast<int>(bit % Planes);
+            uint8_t value = static_cast<uint8_t>((bits[index / 8] >> (index % 8) & 1) << plane);
+            *target = static_cast<uint8_t>((*target & ~(1u << plane)) | value);
+        };
+        for (; i < bitCount && (streamBit + i) % BITS_PER_PIXEL != 0; ++i) {
+            single(i);
+        }
+
+        uint64_t pixels = (bitCount - i) / BITS_PER_PIXEL;
+        uint64_t pixel = (streamBit + i) / BITS_PER_PIXEL;
+        uint64_t row = pixel / width;
+        uint64_t column = pixel - row * width;
+        const uint8_t *next = bits + i / 8;
+        const uint8_t *end = bits + (bitCount + 7) / 8;
+        uint64_t buffer = 0;
+        int count = 0;
+        if (i % 8 != 0) {
+            buffer = static_cast<uint64_t>(*next++) >> (i % 8);
+            count = 8 - static_cast<int>(i % 8);
+        }
+        i += pixels * BITS_PER_PIXEL;
+        for (; pixels > 0; ++row, column = 0) {
+            uint64_t run = std::min<uint64_t>(pixels, width - column);
+            uint8_t *target = view.row(row) + column * Channels;
+            for (uint64_t p = 0; p < run; ++p, target += Channels) {
+                if (count < BITS_PER_PIXEL) {
+                    for (; count <= 56 && next < end; count += 8) {
+                        buffer |= static_cast<uint64_t>(*next++) << count;
+                    }
+                }
+                uint32_t value = static_cast<uint32_t>(buffer);
+                buffer >>= BITS_PER_PIXEL;
+                count -= BITS_PER_PIXEL;
+                for (int n = 0; n < SELECTED; ++n) {
+                    uint8_t &sample = target[offset(n)];
+                    sample = static_cast<uint8_t>((sample & ~LOW) | ((value >> (n * Planes)) & LOW));
+                }
+            }
+            pixels -= run;
+        }
+
+        for (; i < bitCount; ++i) {
+            single(i);
+        }
+    }
+
+    static void extract(const ConstImageView &view, uint64_t streamBit, uint8_t *bits, uint64_t bitCount) {
+        uint64_t width = view.rowBytes / Channels;
+        uint64_t i = 0;
+        auto single = [&](uint64_t index) {
+            uint64_t bit = streamBit + index;
+            const uint8_t *source = sampleAt(view, width, bit / Planes);
+            uint8_t mask = static_cast<uint8_t>(1u << (index % 8));
+            uint8_t value = static_cast<uint8_t>((*source >> (bit % Planes) & 1) << (index % 8));
+            bits[index / 8] = static_cast<uint8_t>((bits[index / 8] & ~mask) | value);
+        };
+        // 批量部分要从输出的字节边界、像素边界同时开始
+        for (; i < bitCount && ((streamBit + i) % BITS_PER_PIXEL != 0 || i % 8 != 0); ++i) {
+            single(i);
+        }
+
+        uint64_t pixels = (bitCount - i) / BITS_PER_PIXEL;
+        uint64_t pixel = (streamBit + i) / BITS_PER_PIXEL;
+        uint64_t row = pixel / width;
+        uint64_t column = pixel - row * width;
+        uint8_t *next = bits + i / 8;
+        uint64_t buffer = 0;
+        int count = 0;
+        i += pixels * BITS_PER_PIXEL;
+        for (; pixels > 0; ++row, column = 0) {
+            uint64_t run = std::min<uint64_t>(pixels, width - column);
+            const uint8_t *source = view.row(row) + column * Channels;
+            for (uint64_t p = 0; p < run; ++p, source += Channels) {
+                uint64_t value = 0;
+                for (int n = 0; n < SELECTED; ++n) {
+                    value |= static_cast<uint64_t>(source[offset(n)] & LOW) << (n * Planes);
+                }
+                buffer |= value << count;
+                count += BITS_PER_PIXEL;
+                if (count >= 32) {
+                    next[0] = static_cast<uint8_t>(buffer);
+                    next[1] = static_cast<uint8_t>(buffer >> 8);
+                    next[2] = static_cast<uint8_t>(buffer >> 16);
+                    next[3] = static_cast<uint8_t>(buffer >> 24);
+                    next += 4;
+                    buffer >>= 32;
+                    count -= 32;
+                }
+            }
+            pixels -= run;
+        }
+        // 剩余不满一个字节的部分只改对应的位
+        for (; count >= 8; count -= 8, buffer >>= 8) {
+            *next++ = static_cast<uint8_t>(buffer);
+        }
+        if (count > 0) {
+            uint8_t mask = static_cast<uint8_t>((1u << count) - 1);
+            *next = static_cast<uint8_t>((*next & ~mask) | (buffer & mask));
+        }
+
+        for (; i < bitCount; ++i) {
+            single(i);
+        }
+    }
+};
+
+using EmbedKernel = void (*)(const ImageView &, uint64_t, const uint8_t *, uint64_t);
+using ExtractKernel = void (*)(const ConstImageView &, uint64_t, uint8_t *, uint64_t);
+
+struct KernelPair {
+    EmbedKernel embed;
+    ExtractKernel extract;
+};
+
+template <int Channels, int Planes, int Mask>
+constexpr KernelPair kernelPair() {
+    return {&Kernel<Channels, Planes, Mask>::embed, &Kernel<Channels, Planes, Mask>::extract};
+}
+
+template <int Planes>
+constexpr std::array<KernelPair, 8> colorKernels() {
+    return {{{nullptr, nullptr}, kernelPair<3, Planes, 1>(), kernelPair<3, Planes, 2>(), kernelPair<3, Planes, 3>(),
+             kernelPair<3, Planes, 4>(), kernelPair<3, Planes, 5>(), kernelPair<3, Planes, 6>(),
+             kernelPair<3, Planes, 7>()}};
+}
+
+const KernelPair &selectKernels(const ConstImageView &view, const EmbedLayout &layout) {
+    static const std::array<std::array<KernelPair, 8>, MAX_PLANES> color = {
+        {colorKernels<1>(), colorKernels<2>(), colorKernels<3>(), colorKernels<4>()}};
+    static const std::array<KernelPair, MAX_PLANES> grey = {
+        {kernelPair<1, 1, CHANNEL_RGB>(), kernelPair<1, 2, CHANNEL_RGB>(), kernelPair<1, 3, CHANNEL_RGB>(),
+         kernelPair<1, 4, CHANNEL_RGB>()}};
+    return view.swapChannels ? color[layout.planes - 1][layout.channels] : grey[layout.planes - 1];
+}
+
+} // namespace
+
+EmbedLayout EmbedLayout::normalized(const ConstImageView &view) const {
+    EmbedLayout layout = *this;
+    if (!view.swapChannels) {
+        layout.channels = CHANNEL_RGB;
+    }
+    return layout;
+}
+
+int EmbedLayout::samplesPerPixel(const ConstImageView &view) const {
+    return view.swapChannels ? countChannels(channels) : 1;
+}
+
+uint64_t EmbedLayout::sampleCount(const ConstImageView &view) const {
+    uint64_t pixels = view.size() / (view.swapChannels ? 3 : 1);
+    return pixels * static_cast<uint64_t>(samplesPerPixel(view));
+}
+
+uint64_t EmbedLayout::sampleIndex(const ConstImageView &view, uint64_t sample) const {
+    if (!view.swapChannels) {
+        return sample;
+    }
+    int selected = countChannels(channels);
+    uint64_t pixel = sample / static_cast<uint64_t>(selected);
+    return pixel * 3 + static_cast<uint64_t>(nthChannel(channels, static_cast<int>(sample % selected)));
+}
+
+uint8_t EmbedLayout::flags() const {
+    return static_cast<uint8_t>((planes - 1) | ((~channels & CHANNEL_RGB) << 2));
+}
+
+EmbedLayout EmbedLayout::fromFlags(uint8_t flags) {
+    EmbedLayout layout;
+    layout.planes = (flags & 0x03) + 1;
+    layout.channels = static_cast<uint8_t>(~(flags >> 2) & CHANNEL_RGB);
+    return layout;
+}
+
+bool EmbedLayout::parse(const std::string &text, EmbedLayout &layout) {
+    EmbedLayout parsed;
+    if (text.empty() || text[0] < '1' || text[0] > '0' + MAX_PLANES) {
+        return false;
+    }
+    parsed.planes = text[0] - '0';
+    if (text.size() > 1) {
+        if (text[1] != ':' || text.size() == 2) {
+            return false;
+        }
+        parsed.channels = 0;
+        for (size_t i = 2; i < text.size(); ++i) {
+            switch (std::tolower(static_cast<unsigned char>(text[i]))) {
+            case 'r':
+                parsed.channels |= CHANNEL_R;
+                break;
+            case 'g':
+                parsed.channels |= CHANNEL_G;
+                break;
+            case 'b':
+                parsed.channels |= CHANNEL_B;
+                break;
+            default:
+                return false;
+            }
+        }
+    }
+    layout = parsed;
+    return true;
+}
+
+void embedLayoutBits(const ImageView &view, const EmbedLayout &layout, uint64_t streamBit, const uint8_t *bits,
+                     uint64_t bitCount) {
+    if (bitCount > 0) {
+        selectKernels(view, layout).embed(view, streamBit, bits, bitCount);
+    }
+}
+
+void extractLayoutBits(const ConstImageView &view, const EmbedLayout &layout, uint64_t streamBit, uint8_t *bits,
+                       uint64_t bitCount) {
+    if (bitCount > 0) {
+        selectKernels(view, layout).extract(view, streamBit, bits, bitCount);
+    }
+}
+
+} // namespace ld
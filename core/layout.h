@@ -0,0 +1,57 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include "imageview.h"
+#include <cstdint>
+#include <string>
+
+namespace ld {
+
+constexpr uint8_t CHANNEL_R = 1;
+constexpr uint8_t CHANNEL_G = 2;
+constexpr uint8_t CHANNEL_B = 4;
+constexpr uint8_t CHANNEL_RGB = CHANNEL_R | CHANNEL_G | CHANNEL_B;
+constexpr int MAX_PLANES = 4;
+
+// 载荷头部 flags 中记录布局的位：bit0-1 为位平面数 - 1，bit2-4 为不使用的通道（R、G、B），默认布局为 0
+constexpr uint8_t LAYOUT_FLAGS = 0x1F;
+
+// 嵌入使用的位平面数和通道。“样本”是每个像素中被选中的通道，按逻辑顺序 R、G、B 排列；
+// 比特流第 j 位写在第 j / planes 个样本的第 j % planes 位平面（低位在前）。
+// 默认布局（1 个位平面、全部通道）就是原来逐字节写最低位的格式。
+// 8 位灰度图每个像素只有一个样本，忽略 channels。
+struct EmbedLayout {
+    int planes = 1;
+    uint8_t channels = CHANNEL_RGB;
+
+    bool valid() const { return planes >= 1 && planes <= MAX_PLANES && channels != 0 && channels <= CHANNEL_RGB; }
+    bool isDefault() const { return planes == 1 && channels == CHANNEL_RGB; }
+
+    // 灰度图的 channels 统一为 CHANNEL_RGB，同一种布局只有一种 flags
+    EmbedLayout normalized(const ConstImageView &view) const;
+
+    int samplesPerPixel(const ConstImageView &view) const;
+    uint64_t sampleCount(const ConstImageView &view) const;
+    uint64_t bitCapacity(const ConstImageView &view) const { return sampleCount(view) * static_cast<uint64_t>(planes); }
+
+    // 第 sample 个样本的逻辑下标，用于随机访问（带密钥）
+    uint64_t sampleIndex(const ConstImageView &view, uint64_t sample) const;
+
+    uint8_t flags() const;
+    static EmbedLayout fromFlags(uint8_t flags);
+
+    // "k[:通道]"，例如 "2"、"1:rg"、"3:b"；通道省略时为全部
+    static bool parse(const std::string &text, EmbedLayout &layout);
+};
+
+// 顺序读写比特流 [streamBit, streamBit + bitCount)，bits 的第 0 位对应 streamBit。
+// 每种 (位深, 位平面数, 通道) 组合各有一个模板实例，整像素的部分没有运行时分支。
+// 提取时 bits 中 bitCount 之后的位保持不变。
+void embedLayoutBits(const ImageView &view, const EmbedLayout &layout, uint64_t streamBit, const uint8_t *bits,
+                     uint64_t bitCount);
+void extractLayoutBits(const ConstImageView &view, const EmbedLayout &layout, uint64_t streamBit, uint8_t *bits,
+                       uint64_t bitCount);
+
+} // namespace ld
+
+#endif // LAYOUT_H
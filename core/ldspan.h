@@ -0,0 +1,53 @@
+#ifndef LDSPAN_H
+#define LDSPAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace ld {
+
+// C++17 没有 std::span，这里给一个最小的只读/可写视图，不持有内存
+template <typename T>
+class Span {
+    template <typename Container>
+    using EnableIfContainer = std::enable_if_t<
+        std::is_convertible<decltype(std::declval<Container &>().data()), T *>::value>;
+
+public:
+    constexpr Span() = default;
+    constexpr Span(T *data, size_t size) : ptr(data), len(size) {}
+
+    template <typename Container, typename = EnableIfContainer<Container>>
+    constexpr Span(Container &container) : ptr(container.data()), len(container.size()) {}
+
+    template <typename Container, typename = EnableIfContainer<const Container>>
+    constexpr Span(const Container &container) : ptr(container.data()), len(container.size()) {}
+
+    constexpr T *data() const { return ptr; }
+    constexpr size_t size() const { return len; }
+    constexpr bool empty() const { return len == 0; }
+    constexpr T &operator[](size_t index) const { return ptr[index]; }
+    constexpr T *begin() const { return ptr; }
+    constexpr T *end() const { return ptr + len; }
+
+    constexpr Span subspan(size_t offset, size_t count) const { return Span(ptr + offset, count); }
+    constexpr Span subspan(size_t offset) const { return Span(ptr + offset, len - offset); }
+
+private:
+    T *ptr = nullptr;
+    size_t len = 0;
+};
+
+using ByteSpan = Span<uint8_t>;
+using ConstByteSpan = Span<const uint8_t>;
+
+inline ConstByteSpan asBytes(const std::string &text) {
+    return ConstByteSpan(reinterpret_cast<const uint8_t *>(text.data()), text.size());
+}
+
+} // namespace ld
+
+#endif // LDSPAN_H
@@ -0,0 +1,36 @@
+#ifndef LDUTIL_H
+#define LDUTIL_H
+
+#include <cstdint>
+#include <string>
+
+namespace ld {
+
+// ldcore 各源文件共用的小工具，只在 core/ 的 .cpp 中包含，不属于对外接口
+
+// 小端整数的读写，bytes 为 1 到 8
+inline void writeLE(uint8_t *out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+inline uint64_t readLE(const uint8_t *in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+// 失败原因写入 error（可以为空），返回 false
+inline bool fail(std::string *error, const std::string &message) {
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+} // namespace ld
+
+#endif // LDUTIL_H
@@ -0,0 +1,102 @@
+#ifndef LRUCACHE_H
+#define LRUCACHE_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace ld {
+
+// 按最近使用淘汰的缓存，可以从多个线程同时使用。容量按 put() 给出的代价计（条目数或字节数），
+// 超过容量时从最久未用的一端淘汰；代价本身超过容量的条目不保存
+template <typename Key, typename Value>
+class LruCache {
+public:
+    explicit LruCache(uint64_t capacity) : capacity(capacity) {}
+
+    LruCache(const LruCache &) = delete;
+    LruCache &operator=(const LruCache &) = delete;
+
+    // 命中时复制出值并移到最近使用的一端
+    bool get(const Key &key, Value &value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = index.find(key);
+        if (found == index.end()) {
+            ++missCount;
+            return false;
+        }
+        entries.splice(entries.begin(), entries, found->second);
+        value = found->second->value;
+        ++hitCount;
+        return true;
+    }
+
+    void put(const Key &key, Value value, uint64_t cost = 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        remove(key);
+        if (cost > capacity) {
+            return;
+        }
+        entries.push_front(Entry{key, std::move(value), cost});
+        index[key] = entries.begin();
+        used += cost;
+        while (used > capacity) {
+            remove(entries.back().key);
+        }
+    }
+
+    void erase(const Key &key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        remove(key);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        index.clear();
+        used = 0;
+    }
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t entries = 0;
+        uint64_t used = 0; // 已用的代价
+    };
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return Stats{hitCount, missCount, static_cast<uint64_t>(entries.size()), used};
+    }
+
+private:
+    struct Entry {
+        Key key;
+        Value value;
+        uint64_t cost;
+    };
+
+    void remove(const Key &key) {
+        auto found = index.find(key);
+        if (found == index.end()) {
+            return;
+        }
+        used -= found->second->cost;
+        entries.erase(found->second);
+        index.erase(found);
+    }
+
+    mutable std::mutex mutex;
+    std::list<Entry> entries; // 头部是最近使用的
+    std::unordered_map<Key, typename std::list<Entry>::iterator> index;
+    uint64_t capacity;
+    uint64_t used = 0;
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+};
+
+} // namespace ld
+
+#endif // LRUCACHE_H
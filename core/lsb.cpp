@@ -0,0 +1,101 @@
+#include "lsb.h"
+#include "bitplane.h"
+#include "keyedpermutation.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace ld {
+
+size_t calculateMaxEmbedLength(ConstByteSpan imageData) {
+    return imageData.size() / 8;
+}
+
+size_t calculateMaxEmbedLength(const ConstImageView &view) {
+    // 32 位平台上超大载体的容量超过 size_t，截断到能放进内存的长度
+    return static_cast<size_t>(std::min<uint64_t>(view.size() / 8, std::numeric_limits<size_t>::max()));
+}
+
+size_t embedMessage(ByteSpan imageData, ConstByteSpan message) {
+    return embedMessage(ImageView::fromBytes(imageData), message);
+}
+
+size_t embedMessage(const ImageView &view, ConstByteSpan message) {
+    LD_TRACE_SCOPE("embed");
+    size_t embedded = std::min(message.size(), calculateMaxEmbedLength(view));
+    embedSequential(view, 0, message.data(), embedded);
+
+    // 判断是否有空间嵌入文件尾
+    if ((embedded + 1) * 8 <= view.size()) {
+        embedSequential(view, embedded * 8, &END_MARKER, 1);
+    }
+    return embedded;
+}
+
+std::string extractMessage(ConstByteSpan imageData) {
+    return extractMessage(ConstImageView::fromBytes(imageData));
+}
+
+std::string extractMessage(const ConstImageView &view) {
+    LD_TRACE_SCOPE("extract");
+    std::string message;
+    uint8_t block[256];
+    size_t length = calculateMaxEmbedLength(view);
+
+    // 按块提取后查找终止符，避免逐位判断
+    for (size_t offset = 0; offset < length; offset += sizeof(block)) {
+        size_t count = std::min(sizeof(block), length - offset);
+        extractSequential(view, offset * 8, block, count);
+
+        const void *end = std::memchr(block, END_MARKER, count);
+        size_t found = end ? static_cast<size_t>(static_cast<const uint8_t *>(end) - block) : count;
+        message.append(reinterpret_cast<const char *>(block), found);
+        if (end) {
+            break;
+        }
+    }
+
+    return message;
+}
+
+size_t embedMessageWithKey(ByteSpan imageData, ConstByteSpan message, const std::string &key) {
+    return embedMessageWithKey(ImageView::fromBytes(imageData), message, key);
+}
+
+size_t embedMessageWithKey(const ImageView &view, ConstByteSpan message, const std::string &key) {
+    LD_TRACE_SCOPE("embed");
+    KeyedPermutation sequence(key, view.size());
+
+    size_t embedded = std::min(message.size(), calculateMaxEmbedLength(view));
+    embedBitsAt(view, sequence, 0, message.data(), embedded);
+
+    if ((embedded + 1) * 8 <= sequence.size()) {
+        embedBitsAt(view, sequence, embedded * 8, &END_MARKER, 1);
+    }
+    return embedded;
+}
+
+std::string extractMessageWithKey(ConstByteSpan imageData, const std::string &key) {
+    return extractMessageWithKey(ConstImageView::fromBytes(imageData), key);
+}
+
+std::string extractMessageWithKey(const ConstImageView &view, const std::string &key) {
+    LD_TRACE_SCOPE("extract");
+    std::string message;
+    KeyedPermutation sequence(key, view.size());
+
+    size_t length = calculateMaxEmbedLength(view);
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t byte;
+        extractBitsAt(view, sequence, i * 8, &byte, 1);
+        if (byte == END_MARKER) {
+            break;
+        }
+        message.push_back(static_cast<char>(byte));
+    }
+
+    return message;
+}
+
+} // namespace ld
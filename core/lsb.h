@@ -0,0 +1,30 @@
+#ifndef LSB_H
+#define LSB_H
+
+#include "imageview.h"
+#include "ldspan.h"
+#include <string>
+
+namespace ld {
+
+constexpr uint8_t END_MARKER = 0xFF; // 定义终止符
+
+// 旧的 0xFF 终止格式。所有函数都直接在调用方的像素缓冲区上原地读写，不做额外拷贝；
+// ByteSpan 版本把缓冲区当作一行连续的逻辑字节。
+// embed 返回实际嵌入的消息字节数（空间不足时会截断）。
+size_t calculateMaxEmbedLength(ConstByteSpan imageData);
+size_t calculateMaxEmbedLength(const ConstImageView &view);
+
+size_t embedMessage(ByteSpan imageData, ConstByteSpan message);
+size_t embedMessage(const ImageView &view, ConstByteSpan message);
+std::string extractMessage(ConstByteSpan imageData);
+std::string extractMessage(const ConstImageView &view);
+
+size_t embedMessageWithKey(ByteSpan imageData, ConstByteSpan message, const std::string &key);
+size_t embedMessageWithKey(const ImageView &view, ConstByteSpan message, const std::string &key);
+std::string extractMessageWithKey(ConstByteSpan imageData, const std::string &key);
+std::string extractMessageWithKey(const ConstImageView &view, const std::string &key);
+
+} // namespace ld
+
+#endif // LSB_H
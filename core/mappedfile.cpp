@@ -0,0 +1,160 @@
+#include "mappedfile.h"
+#include "ldutil.h"
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ld {
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(address, other.address);
+        std::swap(length, other.length);
+        std::swap(openMode, other.openMode);
+#ifdef _WIN32
+        std::swap(fileHandle, other.fileHandle);
+        std::swap(mappingHandle, other.mappingHandle);
+#else
+        std::swap(fd, other.fd);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &filePath, Mode mode, std::string *error) {
+    close();
+    bool writable = mode == Mode::ReadWrite;
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ | (writable ? GENERIC_WRITE : 0), FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return fail(error, "Unable to open file");
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return fail(error, "Unable to map an empty file");
+    }
+
+    DWORD protect = mode == Mode::ReadWrite ? PAGE_READWRITE : (mode == Mode::CopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY);
+    HANDLE mapping = CreateFileMappingA(file, nullptr, protect, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return fail(error, "Unable to create file mapping");
+    }
+    DWORD access = mode == Mode::ReadWrite ? FILE_MAP_WRITE : (mode == Mode::CopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ);
+    void *view = MapViewOfFile(mapping, access, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return fail(error, "Unable to map file");
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    address = static_cast<uint8_t *>(view);
+    length = static_cast<uint64_t>(fileSize.QuadPart);
+    openMode = mode;
+    return true;
+}
+
+void MappedFile::close() {
+    if (address) {
+        UnmapViewOfFile(address);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+    }
+    address = nullptr;
+    length = 0;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+}
+
+bool MappedFile::flush(std::string *error) {
+    if (!address || openMode != Mode::ReadWrite) {
+        return true;
+    }
+    if (!FlushViewOfFile(address, 0) || !FlushFileBuffers(fileHandle)) {
+        return fail(error, "Unable to flush mapped file");
+    }
+    return true;
+}
+
+#else
+
+bool MappedFile::open(const std::string &filePath, Mode mode, std::string *error) {
+    close();
+    int descriptor = ::open(filePath.c_str(), mode == Mode::ReadWrite ? O_RDWR : O_RDONLY);
+    if (descriptor < 0) {
+        return fail(error, "Unable to open file");
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+        ::close(descriptor);
+        return fail(error, "Unable to map an empty file");
+    }
+
+    int protect = mode == Mode::ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = mode == Mode::ReadWrite ? MAP_SHARED : MAP_PRIVATE;
+    void *view = mmap(nullptr, static_cast<size_t>(status.st_size), protect, flags, descriptor, 0);
+    if (view == MAP_FAILED) {
+        ::close(descriptor);
+        return fail(error, "Unable to map file");
+    }
+
+    fd = descriptor;
+    address = static_cast<uint8_t *>(view);
+    length = static_cast<uint64_t>(status.st_size);
+    openMode = mode;
+    return true;
+}
+
+void MappedFile::close() {
+    if (address) {
+        munmap(address, static_cast<size_t>(length));
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    address = nullptr;
+    length = 0;
+    fd = -1;
+}
+
+bool MappedFile::flush(std::string *error) {
+    if (!address || openMode != Mode::ReadWrite) {
+        return true;
+    }
+    if (msync(address, static_cast<size_t>(length), MS_SYNC) != 0) {
+        return fail(error, "Unable to flush mapped file");
+    }
+    return true;
+}
+
+#endif
+
+} // namespace ld
@@ -0,0 +1,52 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ld {
+
+// 整个文件的内存映射（POSIX mmap / Windows 文件映射）
+class MappedFile {
+public:
+    enum class Mode {
+        ReadOnly,
+        CopyOnWrite, // 可写，但修改只在本进程内可见，不写回文件
+        ReadWrite,   // 修改直接写回文件
+    };
+
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    bool open(const std::string &filePath, Mode mode, std::string *error = nullptr);
+    void close();
+
+    // ReadWrite 模式下把修改同步到磁盘
+    bool flush(std::string *error = nullptr);
+
+    uint8_t *data() const { return address; }
+    uint64_t size() const { return length; }
+    bool isOpen() const { return address != nullptr; }
+    Mode mode() const { return openMode; }
+
+private:
+    uint8_t *address = nullptr;
+    uint64_t length = 0;
+    Mode openMode = Mode::ReadOnly;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+} // namespace ld
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,654 @@
+#include "matrix.h"
+#include "bitplane.h"
+#include "costmap.h"
+#include "crc32c.h"
+#include "keyedpermutation.h"
+#include "ldutil.h"
+#include "philox.h"
+#include "simd.h"
+#include "threadpool.h"
+#include "trace.h"
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace ld {
+
+namespace {
+
+constexpr uint8_t MAGIC_0 = 'L';
+constexpr uint8_t MAGIC_1 = 'M';
+constexpr uint64_t HEADER_CARRIER_BYTES = MATRIX_HEADER_SIZE * 8;
+// Hamming 每个并行块至少处理这么多载体位
+constexpr uint64_t HAMMING_GRAIN_BITS = 64 * 1024;
+constexpr float INFINITE_COST = std::numeric_limits<float>::infinity();
+
+uint64_t bodyBits(const ConstImageView &view) {
+    return view.size() > HEADER_CARRIER_BYTES ? view.size() - HEADER_CARRIER_BYTES : 0;
+}
+
+inline uint8_t messageBit(ConstByteSpan message, uint64_t bit) {
+    return bit / 8 < message.size() ? static_cast<uint8_t>(message[static_cast<size_t>(bit / 8)] >> (bit % 8) & 1) : 0;
+}
+
+// 逻辑下标 [first, first + count) 的最低位，每字节一个比特，按行成段读取
+void gatherLsb(const ConstImageView &view, uint64_t first, uint64_t count, uint8_t *out) {
+    uint64_t row = first / view.rowBytes;
+    size_t column = static_cast<size_t>(first - row * view.rowBytes);
+    while (count > 0) {
+        const uint8_t *data = view.row(row);
+        size_t run = static_cast<size_t>(std::min<uint64_t>(view.rowBytes - column, count));
+        if (view.swapChannels) {
+            for (size_t i = 0; i < run; ++i) {
+                size_t c = column + i;
+                out[i] = data[c + 2 - 2 * (c % 3)] & 1;
+            }
+        } else {
+            for (size_t i = 0; i < run; ++i) {
+                out[i] = data[column + i] & 1;
+            }
+        }
+        out += run;
+        count -= run;
+        column = 0;
+        ++row;
+    }
+}
+
+// 第 i 个载体位所在的逻辑下标。无密钥时就是 i；有密钥时为整幅图上的 Philox 置换，
+// 头部也写在置换后的前 HEADER_CARRIER_BYTES 个位置上
+class CarrierOrder {
+public:
+    CarrierOrder(const ConstImageView &view, const std::string &key)
+        : keyed(!key.empty()), permutation(key, keyed ? view.size() : 0, KeyedPermutation::Kind::Philox) {}
+
+    uint64_t operator()(uint64_t index) const { return keyed ? permutation(index) : index; }
+
+    // 第 first 个起 count 个载体位的最低位，每字节一个比特。positions 不为空时同时写出各位的逻辑下标，
+    // 后面查代价和回写修改时不必再算一遍置换
+    void gather(const ConstImageView &view, uint64_t first, uint64_t count, uint8_t *out,
+                uint64_t *positions = nullptr) const {
+        if (!keyed) {
+            gatherLsb(view, first, count, out);
+            if (positions) {
+                std::iota(positions, positions + count, first);
+            }
+            return;
+        }
+        LD_TRACE_DETAIL("permutation");
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t position = permutation(first + i);
+            out[i] = view[position] & 1;
+            if (positions) {
+                positions[i] = position;
+            }
+        }
+    }
+
+private:
+    bool keyed;
+    KeyedPermutation permutation;
+};
+
+// Hamming：组内第 i 位（从 0 起）对应校验矩阵的第 i + 1 列，校验子为所有为 1 的位的列号异或
+inline uint32_t hammingSyndrome(const uint8_t *bits, uint32_t groupSize) {
+    uint32_t syndrome = 0;
+    for (uint32_t i = 0; i < groupSize; ++i) {
+        syndrome ^= (i + 1) & (0u - bits[i]);
+    }
+    return syndrome;
+}
+
+// 能放下 messageBits 的最大 p，0 表示放不下
+int chooseHammingP(uint64_t messageBits, uint64_t coverBits) {
+    for (int p = HAMMING_MAX_P; p >= 1; --p) {
+        uint64_t groups = (messageBits + p - 1) / p;
+        if (groups * ((uint64_t(1) << p) - 1) <= coverBits) {
+            return p;
+        }
+    }
+    return 0;
+}
+
+// 网格码子矩阵的列：由 (h, w) 决定的伪随机数，最高位和最低位固定为 1，
+// 保证每个消息比特都能被它所在块的任一列改变，任何消息都有解
+std::vector<uint32_t> stcColumns(int height, uint64_t width) {
+    Philox4x32 philox{{0x4C44534Du, static_cast<uint32_t>(height)}};
+    uint32_t mask = (1u << height) - 1;
+    std::vector<uint32_t> columns(static_cast<size_t>(width));
+    for (uint64_t j = 0; j < width; ++j) {
+        uint32_t counter[4] = {static_cast<uint32_t>(width), static_cast<uint32_t>(j), 0, 0};
+        uint32_t out[4];
+        philox(counter, out);
+        columns[static_cast<size_t>(j)] = (out[0] & mask) | 1u | (1u << (height - 1));
+    }
+    return columns;
+}
+
+// 第 block 块的列只保留还存在的校验行，最后 h - 1 块的子矩阵被截断
+inline uint32_t rowMask(uint64_t block, uint64_t messageCount, int height) {
+    uint64_t rows = messageCount - block;
+    return rows >= static_cast<uint64_t>(height) ? (1u << height) - 1 : static_cast<uint32_t>((uint64_t(1) << rows) - 1);
+}
+
+// Viterbi 的一块：w 列依次处理，状态为尚未结束的 h 行校验子。第 j 位不变时状态不变，代价加 keep[j]；
+// 这一位为 1 时状态异或 columns[j]，代价加 flip[j]。path 每列 states / 8 字节，
+// 第 s 位记录状态 s 是否由“为 1”转移而来。cost、next 两行轮流使用，返回时 cost 指向结果
+using BlockKernel = void (*)(float *&cost, float *&next, uint32_t states, const uint32_t *columns, size_t width,
+                             const float *keep, const float *flip, uint8_t *path);
+
+void blockScalar(float *&cost, float *&next, uint32_t states, const uint32_t *columns, size_t width,
+                 const float *keep, const float *flip, uint8_t *path) {
+    for (size_t j = 0; j < width; ++j, path += states / 8) {
+        uint32_t column = columns[j];
+        for (uint32_t base = 0; base < states; base += 8) {
+            uint8_t bits = 0;
+            for (uint32_t lane = 0; lane < 8; ++lane) {
+                uint32_t s = base + lane;
+                float unchanged = cost[s] + keep[j];
+                float changed = cost[s ^ column] + flip[j];
+                bool take = changed < unchanged;
+                next[s] = take ? changed : unchanged;
+                bits |= static_cast<uint8_t>(take) << lane;
+            }
+            path[base / 8] = bits;
+        }
+        std::swap(cost, next);
+    }
+}
+
+#ifdef LD_X86
+
+// s ^ column 拆成两部分：高位改变读取的向量，低 2 位在向量内按固定方式交换通道
+template <int Low>
+LD_TARGET("sse2")
+void columnSSE2(const float *cost, float *next, uint32_t states, uint32_t column, float add0, float add1,
+                uint8_t *path) {
+    constexpr int order = Low == 0 ? _MM_SHUFFLE(3, 2, 1, 0)
+                          : Low == 1 ? _MM_SHUFFLE(2, 3, 0, 1)
+                          : Low == 2 ? _MM_SHUFFLE(1, 0, 3, 2)
+                                     : _MM_SHUFFLE(0, 1, 2, 3);
+    const __m128 keepAdd = _mm_set1_ps(add0);
+    const __m128 flipAdd = _mm_set1_ps(add1);
+    uint32_t high = column & ~3u;
+    for (uint32_t base = 0; base < states; base += 8) {
+        int bits = 0;
+        for (uint32_t half = 0; half < 8; half += 4) {
+            uint32_t s = base + half;
+            __m128 unchanged = _mm_add_ps(_mm_load_ps(cost + s), keepAdd);
+            __m128 partner = _mm_load_ps(cost + (s ^ high));
+            __m128 changed = _mm_add_ps(_mm_shuffle_ps(partner, partner, order), flipAdd);
+            __m128 take = _mm_cmplt_ps(changed, unchanged);
+            _mm_store_ps(next + s, _mm_or_ps(_mm_and_ps(take, changed), _mm_andnot_ps(take, unchanged)));
+            bits |= _mm_movemask_ps(take) << half;
+        }
+        path[base / 8] = static_cast<uint8_t>(bits);
+    }
+}
+
+void blockSSE2(float *&cost, float *&next, uint32_t states, const uint32_t *columns, size_t width,
+               const float *keep, const float *flip, uint8_t *path) {
+    for (size_t j = 0; j < width; ++j, path += states / 8) {
+        switch (columns[j] & 3) {
+        case 0:
+            columnSSE2<0>(cost, next, states, columns[j], keep[j], flip[j], path);
+            break;
+        case 1:
+            columnSSE2<1>(cost, next, states, columns[j], keep[j], flip[j], path);
+            break;
+        case 2:
+            columnSSE2<2>(cost, next, states, columns[j], keep[j], flip[j], path);
+            break;
+        default:
+            columnSSE2<3>(cost, next, states, columns[j], keep[j], flip[j], path);
+            break;
+        }
+        std::swap(cost, next);
+    }
+}
+
+LD_TARGET("avx2")
+void blockAVX2(float *&cost, float *&next, uint32_t states, const uint32_t *columns, size_t width,
+               const float *keep, const float *flip, uint8_t *path) {
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    float *a = cost;
+    float *b = next;
+    for (size_t j = 0; j < width; ++j, path += states / 8) {
+        const __m256 keepAdd = _mm256_set1_ps(keep[j]);
+        const __m256 flipAdd = _mm256_set1_ps(flip[j]);
+        const __m256i order = _mm256_xor_si256(lanes, _mm256_set1_epi32(static_cast<int>(columns[j] & 7)));
+        uint32_t high = columns[j] & ~7u;
+        for (uint32_t s = 0; s < states; s += 8) {
+            __m256 unchanged = _mm256_add_ps(_mm256_load_ps(a + s), keepAdd);
+            __m256 changed = _mm256_add_ps(_mm256_permutevar8x32_ps(_mm256_load_ps(a + (s ^ high)), order), flipAdd);
+            __m256 take = _mm256_cmp_ps(changed, unchanged, _CMP_LT_OQ);
+            _mm256_store_ps(b + s, _mm256_blendv_ps(unchanged, changed, take));
+            path[s / 8] = static_cast<uint8_t>(_mm256_movemask_ps(take));
+        }
+        std::swap(a, b);
+    }
+    cost = a;
+    next = b;
+}
+
+#endif // LD_X86
+
+BlockKernel selectBlockKernel() {
+#ifdef LD_X86
+    switch (activeSimdLevel()) {
+    case SimdLevel::AVX2:
+        return blockAVX2;
+    case SimdLevel::SSE2:
+        return blockSSE2;
+    default:
+        break;
+    }
+#endif
+    return blockScalar;
+}
+
+void writeHeader(const ImageView &view, const CarrierOrder &order, MatrixCode code, int parameter,
+                 ConstByteSpan message) {
+    uint8_t header[MATRIX_HEADER_SIZE];
+    header[0] = MAGIC_0;
+    header[1] = MAGIC_1;
+    header[2] = static_cast<uint8_t>(code);
+    header[3] = static_cast<uint8_t>(parameter);
+    writeLE(header + 4, message.size(), 8);
+    writeLE(header + 12, crc32c(message), 4);
+    embedBitsAt(view, order, 0, header, MATRIX_HEADER_SIZE);
+}
+
+// 各组互不重叠，并行计算校验子，每组至多改 1 位
+void embedHamming(const ImageView &view, const CarrierOrder &order, ConstByteSpan message, int p,
+                  MatrixStats &stats) {
+    uint64_t messageBits = static_cast<uint64_t>(message.size()) * 8;
+    uint32_t groupSize = (1u << p) - 1;
+    uint64_t groups = (messageBits + p - 1) / p;
+    std::vector<uint8_t> changed(static_cast<size_t>(groups));
+    parallelFor(groups, std::max<uint64_t>(1, HAMMING_GRAIN_BITS / groupSize), [&](uint64_t begin, uint64_t end) {
+        std::vector<uint8_t> bits(groupSize);
+        for (uint64_t group = begin; group < end; ++group) {
+            uint64_t first = HEADER_CARRIER_BYTES + group * groupSize;
+            order.gather(view, first, groupSize, bits.data());
+            uint32_t target = 0;
+            for (int k = 0; k < p; ++k) {
+                target |= static_cast<uint32_t>(messageBit(message, group * p + k)) << k;
+            }
+            uint32_t difference = hammingSyndrome(bits.data(), groupSize) ^ target;
+            if (difference != 0) {
+                view[order(first + difference - 1)] ^= 1;
+                changed[static_cast<size_t>(group)] = 1;
+            }
+        }
+    });
+    stats.coverBits = groups * groupSize;
+    stats.changes = static_cast<uint64_t>(std::count(changed.begin(), changed.end(), 1));
+}
+
+void extractHamming(const ConstImageView &view, const CarrierOrder &order, uint64_t messageBits, int p,
+                    uint8_t *out) {
+    uint32_t groupSize = (1u << p) - 1;
+    uint64_t groups = (messageBits + p - 1) / p;
+    std::fill(out, out + (messageBits + 7) / 8, 0);
+    // 相邻两组的比特可能落在同一个输出字节里，按 8 组（8p 个比特，整字节）分块
+    uint64_t grain = std::max<uint64_t>(1, HAMMING_GRAIN_BITS / groupSize / 8) * 8;
+    parallelFor(groups, grain, [&](uint64_t begin, uint64_t end) {
+        std::vector<uint8_t> bits(groupSize);
+        for (uint64_t group = begin; group < end; ++group) {
+            order.gather(view, HEADER_CARRIER_BYTES + group * groupSize, groupSize, bits.data());
+            uint32_t syndrome = hammingSyndrome(bits.data(), groupSize);
+            for (int k = 0; k < p; ++k) {
+                uint64_t bit = group * p + k;
+                if (bit < messageBits) {
+                    out[bit / 8] |= static_cast<uint8_t>((syndrome >> k & 1) << (bit % 8));
+                }
+            }
+        }
+    });
+}
+
+uint64_t trellisWidth(uint64_t messageBits, uint64_t coverBits) {
+    return messageBits ? std::min(STC_MAX_WIDTH, coverBits / messageBits) : 0;
+}
+
+// 每段先全部编码，都成功后才修改图像。texture 不为空时按纹理给每位代价，否则每位代价为 1
+bool embedTrellis(const ImageView &view, const CarrierOrder &order, ConstByteSpan message, int height,
+                  const std::vector<uint16_t> *texture, MatrixStats &stats) {
+    uint64_t messageBits = static_cast<uint64_t>(message.size()) * 8;
+    uint64_t width = trellisWidth(messageBits, stats.coverBits);
+    uint64_t segments = (messageBits + STC_SEGMENT_BITS - 1) / STC_SEGMENT_BITS;
+    std::vector<std::vector<uint64_t>> flips(static_cast<size_t>(segments));
+    std::vector<uint8_t> failed(static_cast<size_t>(segments));
+    parallelFor(segments, 1, [&](uint64_t begin, uint64_t end) {
+        std::vector<uint8_t> cover;
+        std::vector<uint8_t> stego;
+        std::vector<uint8_t> bits;
+        std::vector<float> costs;
+        std::vector<uint64_t> positions;
+        for (uint64_t segment = begin; segment < end; ++segment) {
+            uint64_t firstBit = segment * STC_SEGMENT_BITS;
+            uint64_t count = std::min(STC_SEGMENT_BITS, messageBits - firstBit);
+            uint64_t first = HEADER_CARRIER_BYTES + firstBit * width;
+            size_t coverCount = static_cast<size_t>(count * width);
+            cover.resize(coverCount);
+            stego.resize(coverCount);
+            bits.resize(static_cast<size_t>(count));
+            positions.resize(coverCount);
+            order.gather(view, first, coverCount, cover.data(), positions.data());
+            for (uint64_t i = 0; i < count; ++i) {
+                bits[static_cast<size_t>(i)] = messageBit(message, firstBit + i);
+            }
+            if (texture) {
+                costs.resize(coverCount);
+                for (size_t i = 0; i < coverCount; ++i) {
+                    costs[i] = textureCost((*texture)[static_cast<size_t>(positions[i])]);
+                }
+            }
+            if (!stcEncode(cover.data(), texture ? costs.data() : nullptr, coverCount, bits.data(), count, height,
+                           stego.data())) {
+                failed[static_cast<size_t>(segment)] = 1;
+                continue;
+            }
+            std::vector<uint64_t> &segmentFlips = flips[static_cast<size_t>(segment)];
+            for (size_t i = 0; i < coverCount; ++i) {
+                if (cover[i] != stego[i]) {
+                    segmentFlips.push_back(positions[i]);
+                }
+            }
+        }
+    });
+    if (std::find(failed.begin(), failed.end(), 1) != failed.end()) {
+        return false;
+    }
+    stats.coverBits = messageBits * width;
+    stats.changes = 0;
+    for (const std::vector<uint64_t> &segmentFlips : flips) {
+        for (uint64_t index : segmentFlips) {
+            view[index] ^= 1;
+        }
+        stats.changes += segmentFlips.size();
+    }
+    return true;
+}
+
+void extractTrellis(const ConstImageView &view, const CarrierOrder &order, uint64_t messageBits, int height,
+                    uint8_t *out) {
+    uint64_t width = trellisWidth(messageBits, bodyBits(view));
+    uint64_t segments = (messageBits + STC_SEGMENT_BITS - 1) / STC_SEGMENT_BITS;
+    // STC_SEGMENT_BITS 是 8 的倍数，各段写不同的输出字节
+    parallelFor(segments, 1, [&](uint64_t begin, uint64_t end) {
+        std::vector<uint8_t> stego;
+        std::vector<uint8_t> bits;
+        for (uint64_t segment = begin; segment < end; ++segment) {
+            uint64_t firstBit = segment * STC_SEGMENT_BITS;
+            uint64_t count = std::min(STC_SEGMENT_BITS, messageBits - firstBit);
+            stego.resize(static_cast<size_t>(count * width));
+            bits.resize(static_cast<size_t>(count));
+            order.gather(view, HEADER_CARRIER_BYTES + firstBit * width, stego.size(), stego.data());
+            stcDecode(stego.data(), stego.size(), count, height, bits.data());
+            std::fill(out + firstBit / 8, out + (firstBit + count + 7) / 8, 0);
+            for (uint64_t i = 0; i < count; ++i) {
+                out[(firstBit + i) / 8] |= static_cast<uint8_t>(bits[static_cast<size_t>(i)] << ((firstBit + i) % 8));
+            }
+        }
+    });
+}
+
+} // namespace
+
+const char *matrixCodeName(MatrixCode code) {
+    switch (code) {
+    case MatrixCode::Hamming:
+        return "hamming";
+    case MatrixCode::Trellis:
+        return "stc";
+    }
+    return "unknown";
+}
+
+bool MatrixParams::parse(const std::string &text, MatrixParams &params) {
+    MatrixParams parsed;
+    size_t colon = text.find(':');
+    std::string name = text.substr(0, colon);
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (name == "hamming") {
+        parsed.code = MatrixCode::Hamming;
+    } else if (name == "stc") {
+        parsed.code = MatrixCode::Trellis;
+    } else if (name == "adaptive") {
+        parsed.code = MatrixCode::Trellis;
+        parsed.adaptive = true;
+    } else {
+        return false;
+    }
+    if (colon != std::string::npos) {
+        std::string value = text.substr(colon + 1);
+        if (value.empty() || value.size() > 2 ||
+            !std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c) != 0; })) {
+            return false;
+        }
+        parsed.parameter = std::stoi(value);
+        int low = parsed.code == MatrixCode::Hamming ? 1 : STC_MIN_HEIGHT;
+        int high = parsed.code == MatrixCode::Hamming ? HAMMING_MAX_P : STC_MAX_HEIGHT;
+        if (parsed.parameter < low || parsed.parameter > high) {
+            return false;
+        }
+    }
+    params = parsed;
+    return true;
+}
+
+size_t matrixCapacity(const ConstImageView &view, const std::string &key) {
+    uint64_t capacity = bodyBits(view) / 8;
+    uint64_t overhead = key.empty() ? 0 : PAYLOAD_CIPHER_OVERHEAD;
+    capacity = capacity > overhead ? capacity - overhead : 0;
+    return static_cast<size_t>(std::min<uint64_t>(capacity, std::numeric_limits<size_t>::max()));
+}
+
+bool embedMessageMatrix(const ImageView &view, ConstByteSpan message, const std::string &key,
+                        const MatrixParams &params, MatrixStats *stats, std::string *error) {
+    LD_TRACE_SCOPE("embed");
+    if (params.adaptive && params.code != MatrixCode::Trellis) {
+        return fail(error, "Adaptive embedding needs the trellis code");
+    }
+    if (view.size() < HEADER_CARRIER_BYTES) {
+        return fail(error, "Image too small for the matrix header");
+    }
+    MatrixStats local;
+    local.messageBits = (static_cast<uint64_t>(message.size()) + (key.empty() ? 0 : PAYLOAD_CIPHER_OVERHEAD)) * 8;
+    uint64_t coverBits = bodyBits(view);
+
+    // 先按（加密后的）长度确定参数，头部的前 PAYLOAD_PROBE_SIZE 字节作为加密的附加数据
+    if (params.code == MatrixCode::Hamming) {
+        int p = params.parameter ? params.parameter : chooseHammingP(local.messageBits, coverBits);
+        if (p < 1 || p > HAMMING_MAX_P) {
+            // 自动选择时 p 为 0 表示连 p = 1 都放不下
+            return fail(error, params.parameter ? "Invalid Hamming parameter" : "Message too long to embed");
+        }
+        if ((local.messageBits + p - 1) / p * ((uint64_t(1) << p) - 1) > coverBits) {
+            return fail(error, "Message too long to embed");
+        }
+        local.parameter = p;
+    } else if (params.code == MatrixCode::Trellis) {
+        int height = params.parameter ? params.parameter : STC_DEFAULT_HEIGHT;
+        if (height < STC_MIN_HEIGHT || height > STC_MAX_HEIGHT) {
+            return fail(error, "Invalid trellis height");
+        }
+        if (local.messageBits > coverBits) {
+            return fail(error, "Message too long to embed");
+        }
+        local.parameter = height;
+        local.coverBits = coverBits;
+    } else {
+        return fail(error, "Unknown matrix code");
+    }
+
+    std::vector<uint8_t> sealed;
+    ConstByteSpan stored = message;
+    if (!key.empty()) {
+        const uint8_t probe[PAYLOAD_PROBE_SIZE] = {MAGIC_0, MAGIC_1, static_cast<uint8_t>(params.code),
+                                                   static_cast<uint8_t>(local.parameter)};
+        sealed = sealPayload(message, key, probe);
+        stored = ConstByteSpan(sealed.data(), sealed.size());
+    }
+
+    CarrierOrder order(view, key);
+    if (params.code == MatrixCode::Hamming) {
+        embedHamming(view, order, stored, local.parameter, local);
+    } else {
+        std::vector<uint16_t> texture;
+        if (params.adaptive) {
+            computeTextureMap(view, texture);
+        }
+        if (!embedTrellis(view, order, stored, local.parameter, params.adaptive ? &texture : nullptr, local)) {
+            return fail(error, "No trellis path matches the message");
+        }
+    }
+
+    writeHeader(view, order, params.code, local.parameter, stored);
+    if (stats) {
+        *stats = local;
+    }
+    return true;
+}
+
+ExtractStatus extractMessageMatrix(const ConstImageView &view, std::string &message, const std::string &key) {
+    LD_TRACE_SCOPE("extract");
+    message.clear();
+    if (view.size() < HEADER_CARRIER_BYTES) {
+        return ExtractStatus::NoPayload;
+    }
+    CarrierOrder order(view, key);
+    uint8_t header[MATRIX_HEADER_SIZE];
+    extractBitsAt(view, order, 0, header, MATRIX_HEADER_SIZE);
+    if (header[0] != MAGIC_0 || header[1] != MAGIC_1) {
+        return ExtractStatus::NoPayload;
+    }
+    MatrixCode code = static_cast<MatrixCode>(header[2]);
+    int parameter = header[3];
+    bool known = (code == MatrixCode::Hamming && parameter >= 1 && parameter <= HAMMING_MAX_P) ||
+                 (code == MatrixCode::Trellis && parameter >= STC_MIN_HEIGHT && parameter <= STC_MAX_HEIGHT);
+    if (!known) {
+        return ExtractStatus::Unsupported;
+    }
+
+    uint64_t length = readLE(header + 4, 8);
+    uint64_t coverBits = bodyBits(view);
+    if (length > coverBits / 8) {
+        return ExtractStatus::BadLength;
+    }
+    uint64_t messageBits = length * 8;
+    if (code == MatrixCode::Hamming && (messageBits + parameter - 1) / parameter * ((uint64_t(1) << parameter) - 1) >
+                                           coverBits) {
+        return ExtractStatus::BadLength;
+    }
+
+    message.resize(static_cast<size_t>(length));
+    uint8_t *out = reinterpret_cast<uint8_t *>(&message[0]);
+    if (length > 0) {
+        if (code == MatrixCode::Hamming) {
+            extractHamming(view, order, messageBits, parameter, out);
+        } else {
+            extractTrellis(view, order, messageBits, parameter, out);
+        }
+    }
+    if (crc32c(asBytes(message)) != static_cast<uint32_t>(readLE(header + 12, 4))) {
+        message.clear();
+        return ExtractStatus::BadChecksum;
+    }
+    if (!key.empty() && !openPayload(message, key, header)) {
+        message.clear();
+        return ExtractStatus::BadAuthentication;
+    }
+    return ExtractStatus::Ok;
+}
+
+bool stcEncode(const uint8_t *cover, const float *costs, uint64_t coverCount, const uint8_t *message,
+               uint64_t messageCount, int height, uint8_t *stego) {
+    if (messageCount == 0) {
+        std::copy(cover, cover + coverCount, stego);
+        return true;
+    }
+    uint64_t width = coverCount / messageCount;
+    uint32_t states = 1u << height;
+    std::vector<uint32_t> columns = stcColumns(height, width);
+    // 两行代价按 64 字节对齐：向量读写不跨缓存行，上一列写入的数据可以直接转发给下一列
+    std::vector<float> storage(2 * states + 16);
+    float *cost = storage.data() + (16 - reinterpret_cast<uintptr_t>(storage.data()) / sizeof(float) % 16) % 16;
+    float *next = cost + states;
+    std::fill(cost, cost + states, INFINITE_COST);
+    std::vector<uint8_t> path(static_cast<size_t>(coverCount * (states / 8)));
+    std::vector<uint32_t> masked(static_cast<size_t>(width));
+    std::vector<float> keep(static_cast<size_t>(width));
+    std::vector<float> flip(static_cast<size_t>(width));
+    BlockKernel kernel = selectBlockKernel();
+    cost[0] = 0;
+
+    // 前向：每块 w 列，块末第 block 行已经确定，只保留最低位等于消息比特的状态并右移一位
+    uint64_t k = 0;
+    for (uint64_t block = 0; block < messageCount; ++block, k += width) {
+        uint32_t mask = rowMask(block, messageCount, height);
+        for (size_t j = 0; j < masked.size(); ++j) {
+            float rho = costs ? costs[k + j] : 1.0f;
+            masked[j] = columns[j] & mask;
+            keep[j] = cover[k + j] ? rho : 0.0f;
+            flip[j] = cover[k + j] ? 0.0f : rho;
+        }
+        kernel(cost, next, states, masked.data(), masked.size(), keep.data(), flip.data(),
+               path.data() + k * (states / 8));
+        // 累计代价减去最小值，浮点数不会随长度增长失去精度
+        float best = INFINITE_COST;
+        for (uint32_t s = 0; s < states / 2; ++s) {
+            next[s] = cost[(s << 1) | message[block]];
+            best = std::min(best, next[s]);
+        }
+        if (!(best < INFINITE_COST)) {
+            return false;
+        }
+        for (uint32_t s = 0; s < states / 2; ++s) {
+            next[s] -= best;
+        }
+        std::fill(next + states / 2, next + states, INFINITE_COST);
+        std::swap(cost, next);
+    }
+
+    // 回溯：截断的列不会把状态带到不存在的行，最后只剩状态 0
+    uint32_t state = 0;
+    for (uint64_t block = messageCount; block-- > 0;) {
+        state = (state << 1) | message[block];
+        uint32_t mask = rowMask(block, messageCount, height);
+        for (uint64_t j = width; j-- > 0;) {
+            --k;
+            uint8_t bit = path[static_cast<size_t>(k * (states / 8) + state / 8)] >> (state % 8) & 1;
+            stego[k] = bit;
+            if (bit) {
+                state ^= columns[static_cast<size_t>(j)] & mask;
+            }
+        }
+    }
+    std::copy(cover + messageCount * width, cover + coverCount, stego + messageCount * width);
+    return true;
+}
+
+void stcDecode(const uint8_t *stego, uint64_t coverCount, uint64_t messageCount, int height, uint8_t *message) {
+    if (messageCount == 0) {
+        return;
+    }
+    uint64_t width = coverCount / messageCount;
+    std::vector<uint32_t> columns = stcColumns(height, width);
+    uint32_t state = 0;
+    uint64_t k = 0;
+    for (uint64_t block = 0; block < messageCount; ++block) {
+        uint32_t mask = rowMask(block, messageCount, height);
+        for (uint64_t j = 0; j < width; ++j, ++k) {
+            state ^= columns[static_cast<size_t>(j)] & (0u - stego[k]) & mask;
+        }
+        message[block] = static_cast<uint8_t>(state & 1);
+        state >>= 1;
+    }
+}
+
+} // namespace ld
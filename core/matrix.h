@@ -0,0 +1,85 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include "imageview.h"
+#include "ldspan.h"
+#include "payload.h"
+#include <string>
+
+namespace ld {
+
+// 矩阵嵌入：让载体最低位序列的校验子（syndrome）等于消息，用更少的修改携带同样多的比特。
+//   Hamming：每 2^p - 1 个最低位携带 p 个比特，每组至多改 1 位
+//   Trellis：校验子网格码（STC），约束高度 h，用 Viterbi 找出改动代价最小的最低位序列
+// 只用全部字节的最低位，不支持布局和压缩。无密钥时与 embedMessage 一样按顺序使用载体字节；
+// 有密钥时第 i 个载体位在整幅图的 Philox 置换（KeyedPermutation::Kind::Philox）的第 i 个位置，头部也一样；
+// 消息先按 sealPayload() 加密（头部的前 PAYLOAD_PROBE_SIZE 字节为附加数据），多占 PAYLOAD_CIPHER_OVERHEAD 字节，
+// 头部的长度和 CRC 是加密后的。
+// 自适应模式（MatrixParams::adaptive，只用于 Trellis）按 computeTextureMap() 给每位修改代价，
+// Viterbi 把修改集中到边缘和纹理区域，平坦区域几乎不改；提取与普通 Trellis 相同，不需要代价图。
+//
+// 前 MATRIX_HEADER_SIZE * 8 个载体位按普通 LSB 写入头部，之后的载体位是码字：
+//
+//   0  'L' 'M'       魔数，与载荷容器不同，extractPayload 不会误认
+//   2  code          1：Hamming，2：Trellis
+//   3  parameter     Hamming 为 p，Trellis 为 h
+//   4  length        消息长度，uint64 小端
+//   12 crc32c        消息的 CRC-32C，uint32 小端
+//
+// 消息比特按字节内低位在前排列。Trellis 把消息按 STC_SEGMENT_BITS 比特分段，
+// 每段独立编码、在 sharedPool() 上并行，每个消息比特占用 w = min(STC_MAX_WIDTH, 码字位数 / 消息位数) 个载体位。
+// 头部最后写入。
+constexpr size_t MATRIX_HEADER_SIZE = 16;
+constexpr int HAMMING_MAX_P = 16;
+constexpr int STC_MIN_HEIGHT = 3;
+constexpr int STC_MAX_HEIGHT = 10;
+constexpr int STC_DEFAULT_HEIGHT = 7;
+constexpr uint64_t STC_MAX_WIDTH = 64;
+constexpr uint64_t STC_SEGMENT_BITS = 1024;
+
+enum class MatrixCode : uint8_t { Hamming = 1, Trellis = 2 };
+
+const char *matrixCodeName(MatrixCode code);
+
+struct MatrixParams {
+    MatrixCode code = MatrixCode::Trellis;
+    int parameter = 0; // Hamming 的 p（0 表示能放下的最大值），Trellis 的 h（0 表示 STC_DEFAULT_HEIGHT）
+    bool adaptive = false;
+
+    // "hamming[:p]"、"stc[:h]"、"adaptive[:h]"（自适应的 Trellis）
+    static bool parse(const std::string &text, MatrixParams &params);
+};
+
+struct MatrixStats {
+    int parameter = 0;        // 实际使用的 p 或 h
+    uint64_t messageBits = 0;
+    uint64_t coverBits = 0;   // 参与编码的载体最低位数，不含头部
+    uint64_t changes = 0;     // 码字部分被修改的最低位数
+
+    double changesPerBit() const {
+        return messageBits ? static_cast<double>(changes) / static_cast<double>(messageBits) : 0.0;
+    }
+};
+
+// 扣除头部（带密钥时还有加密开销）之后最多能嵌入的消息字节数（此时每个载体位携带一个比特，没有节省）
+size_t matrixCapacity(const ConstImageView &view, const std::string &key = std::string());
+
+// 消息放不下或参数无效时不修改图像并返回 false，原因写入 error
+bool embedMessageMatrix(const ImageView &view, ConstByteSpan message, const std::string &key = std::string(),
+                        const MatrixParams &params = MatrixParams(), MatrixStats *stats = nullptr,
+                        std::string *error = nullptr);
+// 带密钥时认证标签不符返回 BadAuthentication
+ExtractStatus extractMessageMatrix(const ConstImageView &view, std::string &message,
+                                   const std::string &key = std::string());
+
+// 单个网格码，cover、stego、message 每字节一个比特（0 或 1），coverCount 必须是 messageCount 的整数倍。
+// costs 为空时每位的修改代价为 1，+inf 表示不能修改。找不到满足校验子的序列时返回 false。
+// 前向递推按 activeSimdLevel() 选择 AVX2/SSE2/标量内核，结果与等级无关；
+// 回溯表占 coverCount * 2^height / 8 字节
+bool stcEncode(const uint8_t *cover, const float *costs, uint64_t coverCount, const uint8_t *message,
+               uint64_t messageCount, int height, uint8_t *stego);
+void stcDecode(const uint8_t *stego, uint64_t coverCount, uint64_t messageCount, int height, uint8_t *message);
+
+} // namespace ld
+
+#endif // MATRIX_H
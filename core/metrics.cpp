@@ -0,0 +1,346 @@
+#include "metrics.h"
+#include "ldutil.h"
+#include "simd.h"
+#include "threadpool.h"
+#include "trace.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace ld {
+
+namespace {
+
+constexpr size_t BAND_BYTES = 1024 * 1024;
+constexpr double PEAK = 255.0;
+constexpr double SSIM_C1 = (0.01 * PEAK) * (0.01 * PEAK);
+constexpr double SSIM_C2 = (0.03 * PEAK) * (0.03 * PEAK);
+
+// sums[i % 3] += (a[i] - b[i])²，i 相对于 a 的起点
+void squaredDifferenceScalar(const uint8_t *a, const uint8_t *b, size_t count, uint64_t sums[3]) {
+    uint64_t local[3] = {0, 0, 0};
+    size_t i = 0;
+    for (; i + 3 <= count; i += 3) {
+        for (int k = 0; k < 3; ++k) {
+            int difference = static_cast<int>(a[i + k]) - static_cast<int>(b[i + k]);
+            local[k] += static_cast<uint64_t>(difference * difference);
+        }
+    }
+    for (int k = 0; i < count; ++i, ++k) {
+        int difference = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+        local[k] += static_cast<uint64_t>(difference * difference);
+    }
+    for (int k = 0; k < 3; ++k) {
+        sums[k] += local[k];
+    }
+}
+
+#ifdef LD_X86
+
+// 每 3 个向量（3 的倍数个字节）为一组，同一累加器的同一个 32 位通道总是对应组内同一个字节位置。
+// 字节位置用同样的 unpack 顺序作用在下标向量上得到，最后按位置模 3 分到各通道。
+// 32 位累加器每轮最多增加 255²，每 FLUSH_BLOCKS 组转存一次，不会溢出
+constexpr size_t FLUSH_BLOCKS = 65536;
+
+LD_TARGET("sse2")
+void flushSSE2(__m128i accumulators[3][4], const uint32_t positions[3][4][4], uint64_t sums[3]) {
+    for (int k = 0; k < 3; ++k) {
+        for (int j = 0; j < 4; ++j) {
+            uint32_t lanes[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), accumulators[k][j]);
+            for (int lane = 0; lane < 4; ++lane) {
+                sums[positions[k][j][lane] % 3] += lanes[lane];
+            }
+            accumulators[k][j] = _mm_setzero_si128();
+        }
+    }
+}
+
+LD_TARGET("sse2")
+void squaredDifferenceSSE2(const uint8_t *a, const uint8_t *b, size_t count, uint64_t sums[3]) {
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t positions[3][4][4];
+    __m128i accumulators[3][4];
+    for (int k = 0; k < 3; ++k) {
+        __m128i index = _mm_add_epi8(_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                                     _mm_set1_epi8(static_cast<char>(16 * k)));
+        __m128i low = _mm_unpacklo_epi8(index, zero);
+        __m128i high = _mm_unpackhi_epi8(index, zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(positions[k][0]), _mm_unpacklo_epi16(low, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(positions[k][1]), _mm_unpackhi_epi16(low, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(positions[k][2]), _mm_unpacklo_epi16(high, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(positions[k][3]), _mm_unpackhi_epi16(high, zero));
+    }
+
+    for (int k = 0; k < 3; ++k) {
+        for (int j = 0; j < 4; ++j) {
+            accumulators[k][j] = zero;
+        }
+    }
+
+    size_t i = 0;
+    size_t blocks = 0;
+    for (; i + 48 <= count; i += 48) {
+        for (int k = 0; k < 3; ++k) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + 16 * k));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + 16 * k));
+            __m128i difference = _mm_or_si128(_mm_subs_epu8(x, y), _mm_subs_epu8(y, x));
+            __m128i low = _mm_unpacklo_epi8(difference, zero);
+            __m128i high = _mm_unpackhi_epi8(difference, zero);
+            low = _mm_mullo_epi16(low, low);
+            high = _mm_mullo_epi16(high, high);
+            accumulators[k][0] = _mm_add_epi32(accumulators[k][0], _mm_unpacklo_epi16(low, zero));
+            accumulators[k][1] = _mm_add_epi32(accumulators[k][1], _mm_unpackhi_epi16(low, zero));
+            accumulators[k][2] = _mm_add_epi32(accumulators[k][2], _mm_unpacklo_epi16(high, zero));
+            accumulators[k][3] = _mm_add_epi32(accumulators[k][3], _mm_unpackhi_epi16(high, zero));
+        }
+        if (++blocks == FLUSH_BLOCKS) {
+            flushSSE2(accumulators, positions, sums);
+            blocks = 0;
+        }
+    }
+    flushSSE2(accumulators, positions, sums);
+    squaredDifferenceScalar(a + i, b + i, count - i, sums); // i 是 3 的倍数，通道对齐不变
+}
+
+LD_TARGET("avx2")
+void flushAVX2(__m256i accumulators[3][4], const uint32_t positions[3][4][8], uint64_t sums[3]) {
+    for (int k = 0; k < 3; ++k) {
+        for (int j = 0; j < 4; ++j) {
+            uint32_t lanes[8];
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), accumulators[k][j]);
+            for (int lane = 0; lane < 8; ++lane) {
+                sums[positions[k][j][lane] % 3] += lanes[lane];
+            }
+            accumulators[k][j] = _mm256_setzero_si256();
+        }
+    }
+}
+
+LD_TARGET("avx2")
+void squaredDifferenceAVX2(const uint8_t *a, const uint8_t *b, size_t count, uint64_t sums[3]) {
+    const __m256i zero = _mm256_setzero_si256();
+    uint32_t positions[3][4][8];
+    __m256i accumulators[3][4];
+    for (int k = 0; k < 3; ++k) {
+        __m256i index = _mm256_add_epi8(
+            _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23,
+                             24, 25, 26, 27, 28, 29, 30, 31),
+            _mm256_set1_epi8(static_cast<char>(32 * k)));
+        __m256i low = _mm256_unpacklo_epi8(index, zero);
+        __m256i high = _mm256_unpackhi_epi8(index, zero);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(positions[k][0]), _mm256_unpacklo_epi16(low, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(positions[k][1]), _mm256_unpackhi_epi16(low, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(positions[k][2]), _mm256_unpacklo_epi16(high, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(positions[k][3]), _mm256_unpackhi_epi16(high, zero));
+        for (int j = 0; j < 4; ++j) {
+            accumulators[k][j] = zero;
+        }
+    }
+
+
+    size_t i = 0;
+    size_t blocks = 0;
+    for (; i + 96 <= count; i += 96) {
+        for (int k = 0; k < 3; ++k) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i + 32 * k));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i + 32 * k));
+            __m256i difference = _mm256_or_si256(_mm256_subs_epu8(x, y), _mm256_subs_epu8(y, x));
+            __m256i low = _mm256_unpacklo_epi8(difference, zero);
+            __m256i high = _mm256_unpackhi_epi8(difference, zero);
+            low = _mm256_mullo_epi16(low, low);
+            high = _mm256_mullo_epi16(high, high);
+            accumulators[k][0] = _mm256_add_epi32(accumulators[k][0], _mm256_unpacklo_epi16(low, zero));
+            accumulators[k][1] = _mm256_add_epi32(accumulators[k][1], _mm256_unpackhi_epi16(low, zero));
+            accumulators[k][2] = _mm256_add_epi32(accumulators[k][2], _mm256_unpacklo_epi16(high, zero));
+            accumulators[k][3] = _mm256_add_epi32(accumulators[k][3], _mm256_unpackhi_epi16(high, zero));
+        }
+        if (++blocks == FLUSH_BLOCKS) {
+            flushAVX2(accumulators, positions, sums);
+            blocks = 0;
+        }
+    }
+    flushAVX2(accumulators, positions, sums);
+    squaredDifferenceScalar(a + i, b + i, count - i, sums);
+}
+
+#endif // LD_X86
+
+void squaredDifference(const uint8_t *a, const uint8_t *b, size_t count, uint64_t sums[3]) {
+#ifdef LD_X86
+    switch (activeSimdLevel()) {
+    case SimdLevel::AVX2:
+        return squaredDifferenceAVX2(a, b, count, sums);
+    case SimdLevel::SSE2:
+        return squaredDifferenceSSE2(a, b, count, sums);
+    default:
+        break;
+    }
+#endif
+    squaredDifferenceScalar(a, b, count, sums);
+}
+
+// 一块区域内 cover、stego 的和、平方和之和、乘积之和
+struct BlockSums {
+    uint32_t cover = 0;
+    uint32_t stego = 0;
+    uint32_t squares = 0;
+    uint32_t product = 0;
+
+    void add(const BlockSums &other) {
+        cover += other.cover;
+        stego += other.stego;
+        squares += other.squares;
+        product += other.product;
+    }
+};
+
+double ssimOf(const BlockSums &sums, double count) {
+    double meanCover = sums.cover / count;
+    double meanStego = sums.stego / count;
+    double variances = sums.squares / count - meanCover * meanCover - meanStego * meanStego;
+    double covariance = sums.product / count - meanCover * meanStego;
+    return (2 * meanCover * meanStego + SSIM_C1) * (2 * covariance + SSIM_C2) /
+           ((meanCover * meanCover + meanStego * meanStego + SSIM_C1) * (variances + SSIM_C2));
+}
+
+// 整幅图一个通道的和，用于小于 8×8 的图像
+BlockSums sumChannel(const ConstImageView &cover, const ConstImageView &stego, size_t channels, size_t channel) {
+    BlockSums sums;
+    for (uint64_t r = 0; r < cover.rows; ++r) {
+        const uint8_t *a = cover.row(r) + channel;
+        const uint8_t *b = stego.row(r) + channel;
+        for (size_t x = 0; x < cover.rowBytes / channels; ++x) {
+            uint32_t p = a[x * channels];
+            uint32_t q = b[x * channels];
+            sums.cover += p;
+            sums.stego += q;
+            sums.squares += p * p + q * q;
+            sums.product += p * q;
+        }
+    }
+    return sums;
+}
+
+// 一行 4×4 块的和，按 [块][通道] 排列
+void blockRowSums(const ConstImageView &cover, const ConstImageView &stego, size_t channels, uint64_t blockRow,
+                  size_t blockColumns, std::vector<BlockSums> &out) {
+    out.assign(blockColumns * channels, BlockSums());
+    for (uint64_t r = blockRow * 4; r < blockRow * 4 + 4; ++r) {
+        const uint8_t *a = cover.row(r);
+        const uint8_t *b = stego.row(r);
+        for (size_t block = 0; block < blockColumns; ++block) {
+            for (size_t channel = 0; channel < channels; ++channel) {
+                BlockSums &sums = out[block * channels + channel];
+                for (size_t x = 0; x < 4; ++x) {
+                    size_t offset = (block * 4 + x) * channels + channel;
+                    uint32_t p = a[offset];
+                    uint32_t q = b[offset];
+                    sums.cover += p;
+                    sums.stego += q;
+                    sums.squares += p * p + q * q;
+                    sums.product += p * q;
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+bool measureQuality(const ConstImageView &cover, const ConstImageView &stego, QualityReport &report,
+                    std::string *error) {
+    LD_TRACE_SCOPE("quality");
+    report = QualityReport();
+    if (cover.rowBytes != stego.rowBytes || cover.rows != stego.rows || cover.swapChannels != stego.swapChannels) {
+        return fail(error, "Images have different sizes or formats");
+    }
+    if (cover.empty()) {
+        return fail(error, "Empty image");
+    }
+
+    size_t channels = cover.swapChannels ? 3 : 1;
+    size_t width = cover.rowBytes / channels;
+    report.channels = static_cast<int>(channels);
+
+    // 平方差：每个块按存储通道 (B, G, R) 累加
+    uint64_t rowsPerBand = std::max<uint64_t>(1, BAND_BYTES / cover.rowBytes);
+    std::vector<std::array<uint64_t, 3>> squared(static_cast<size_t>((cover.rows + rowsPerBand - 1) / rowsPerBand));
+    parallelFor(cover.rows, rowsPerBand, [&](uint64_t begin, uint64_t end) {
+        std::array<uint64_t, 3> &sums = squared[static_cast<size_t>(begin / rowsPerBand)];
+        sums = {0, 0, 0};
+        for (uint64_t r = begin; r < end; ++r) {
+            squaredDifference(cover.row(r), stego.row(r), cover.rowBytes, sums.data());
+        }
+    });
+
+    // SSIM：第 w 行窗口由第 w、w+1 行 4×4 块组成
+    uint64_t blockRows = cover.rows / 4;
+    size_t blockColumns = width / 4;
+    double ssimSums[3] = {0, 0, 0};
+    if (blockRows >= 2 && blockColumns >= 2) {
+        uint64_t windowRows = blockRows - 1;
+        size_t windowColumns = blockColumns - 1;
+        uint64_t windowsPerBand = std::max<uint64_t>(1, BAND_BYTES / (4 * cover.rowBytes));
+        std::vector<std::array<double, 3>> partial(static_cast<size_t>((windowRows + windowsPerBand - 1) / windowsPerBand));
+        parallelFor(windowRows, windowsPerBand, [&](uint64_t begin, uint64_t end) {
+            std::array<double, 3> &sums = partial[static_cast<size_t>(begin / windowsPerBand)];
+            sums = {0, 0, 0};
+            std::vector<BlockSums> upper;
+            std::vector<BlockSums> lower;
+            blockRowSums(cover, stego, channels, begin, blockColumns, lower);
+            for (uint64_t w = begin; w < end; ++w) {
+                upper.swap(lower);
+                blockRowSums(cover, stego, channels, w + 1, blockColumns, lower);
+                for (size_t x = 0; x < windowColumns; ++x) {
+                    for (size_t channel = 0; channel < channels; ++channel) {
+                        BlockSums window = upper[x * channels + channel];
+                        window.add(upper[(x + 1) * channels + channel]);
+                        window.add(lower[x * channels + channel]);
+                        window.add(lower[(x + 1) * channels + channel]);
+                        sums[channel] += ssimOf(window, 64.0);
+                    }
+                }
+            }
+        });
+        double windows = static_cast<double>(windowRows) * static_cast<double>(windowColumns);
+        for (const std::array<double, 3> &sums : partial) {
+            for (size_t channel = 0; channel < channels; ++channel) {
+                ssimSums[channel] += sums[channel] / windows;
+            }
+        }
+    } else {
+        double count = static_cast<double>(width) * static_cast<double>(cover.rows);
+        for (size_t channel = 0; channel < channels; ++channel) {
+            ssimSums[channel] = ssimOf(sumChannel(cover, stego, channels, channel), count);
+        }
+    }
+
+    // 24 位图存储顺序是 BGR，报告按 RGB
+    double samples = static_cast<double>(width) * static_cast<double>(cover.rows);
+    for (size_t stored = 0; stored < channels; ++stored) {
+        uint64_t total = 0;
+        for (const std::array<uint64_t, 3> &sums : squared) {
+            total += channels == 1 ? sums[0] + sums[1] + sums[2] : sums[stored];
+        }
+        ChannelQuality &quality = report.channel[channels == 1 ? 0 : 2 - stored];
+        quality.mse = static_cast<double>(total) / samples;
+        quality.ssim = ssimSums[stored];
+    }
+
+    auto psnr = [](double mse) {
+        return mse > 0 ? 10 * std::log10(PEAK * PEAK / mse) : std::numeric_limits<double>::infinity();
+    };
+    report.overall.ssim = 0;
+    for (size_t channel = 0; channel < channels; ++channel) {
+        report.channel[channel].psnr = psnr(report.channel[channel].mse);
+        report.overall.mse += report.channel[channel].mse / static_cast<double>(channels);
+        report.overall.ssim += report.channel[channel].ssim / static_cast<double>(channels);
+    }
+    report.overall.psnr = psnr(report.overall.mse);
+    return true;
+}
+
+} // namespace ld
@@ -0,0 +1,33 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "imageview.h"
+#include <string>
+
+namespace ld {
+
+// 载体和嵌入结果之间的失真度量，按通道计算（24 位图按 R、G、B 顺序，灰度图只有一个通道）。
+//   MSE：像素差的平方的平均值
+//   PSNR：10·log10(255² / MSE)，两图相同时为 +inf
+//   SSIM：8×8 窗口、步长 4 的平均 SSIM（窗口由 4×4 块的和拼成），小于 8×8 的图按整幅图算一个窗口
+// overall 中 MSE、SSIM 是各通道的平均值，PSNR 由平均 MSE 算出。
+struct ChannelQuality {
+    double mse = 0;
+    double psnr = 0;
+    double ssim = 1;
+};
+
+struct QualityReport {
+    int channels = 0;
+    ChannelQuality channel[3];
+    ChannelQuality overall;
+};
+
+// 两个视图的行长、行数和通道布局必须一致，否则返回 false。
+// 按行带在 sharedPool() 上并行，平方差之和按 activeSimdLevel() 选择 AVX2/SSE2/标量内核
+bool measureQuality(const ConstImageView &cover, const ConstImageView &stego, QualityReport &report,
+                    std::string *error = nullptr);
+
+} // namespace ld
+
+#endif // METRICS_H
@@ -0,0 +1,216 @@
+#include "noise.h"
+#include "philox.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ld {
+
+namespace {
+
+constexpr double GAUSSIAN_SIGMA = 25.0;
+constexpr int MAX_NOISE = 255; // 更大的偏移截断后效果相同
+
+// Philox4x32 计数器流：第 b 块的 4 个字 = Philox({b 低位, b 高位, stream, 0}, seed)。
+// 每次按 BATCH 块整批生成，各块之间没有依赖，循环可以被编译器向量化
+class RandomStream {
+public:
+    RandomStream(uint64_t seed, uint32_t stream) : stream(stream) {
+        philox.key[0] = static_cast<uint32_t>(seed);
+        philox.key[1] = static_cast<uint32_t>(seed >> 32);
+    }
+
+    uint32_t next32() {
+        if (position == BATCH * 4) {
+            refill();
+        }
+        return buffer[position++];
+    }
+
+    uint64_t next64() {
+        uint64_t low = next32();
+        return low | static_cast<uint64_t>(next32()) << 32;
+    }
+
+    // [0, n) 上的均匀整数，取 53 位精度，偏差可以忽略
+    uint64_t below(uint64_t n) {
+        return static_cast<uint64_t>(static_cast<double>(next64() >> 11) * 0x1.0p-53 * static_cast<double>(n));
+    }
+
+private:
+    static constexpr size_t BATCH = 64;
+
+    void refill() {
+        for (size_t i = 0; i < BATCH; ++i) {
+            uint64_t counterIndex = block + i;
+            uint32_t counter[4] = {static_cast<uint32_t>(counterIndex), static_cast<uint32_t>(counterIndex >> 32),
+                                   stream, 0};
+            philox(counter, buffer + i * 4);
+        }
+        block += BATCH;
+        position = 0;
+    }
+
+    Philox4x32 philox;
+    uint32_t stream;
+    uint64_t block = 0;
+    uint32_t buffer[BATCH * 4];
+    size_t position = BATCH * 4;
+};
+
+// 截断为整数的 N(0, σ²) 的离散分布，按 32 位均匀数查表（逆 CDF + 引导表），每个样本常数时间。
+// 只用整数比较，不依赖 libm 的逐个采样，同一个种子在任何平台上结果相同（阈值由 erfc 在构造时算出）
+class GaussianTable {
+public:
+    explicit GaussianTable(double sigma) {
+        // trunc(x) <= k 等价于 x <= k（k < 0）或 x < k + 1（k >= 0）
+        for (int k = -MAX_NOISE; k < MAX_NOISE; ++k) {
+            double bound = k < 0 ? k : k + 1;
+            double cdf = 0.5 * std::erfc(-bound / (sigma * std::sqrt(2.0)));
+            thresholds[k + MAX_NOISE] = static_cast<uint32_t>(std::min(cdf * 4294967296.0, 4294967295.0));
+        }
+        size_t index = 0;
+        for (size_t bucket = 0; bucket < GUIDE_SIZE; ++bucket) {
+            uint32_t start = static_cast<uint32_t>(bucket << (32 - GUIDE_BITS));
+            while (index < THRESHOLDS && thresholds[index] <= start) {
+                ++index;
+            }
+            guide[bucket] = static_cast<uint16_t>(index);
+        }
+    }
+
+    int sample(uint32_t u) const {
+        size_t index = guide[u >> (32 - GUIDE_BITS)];
+        while (index < THRESHOLDS && thresholds[index] <= u) {
+            ++index;
+        }
+        return static_cast<int>(index) - MAX_NOISE;
+    }
+
+private:
+    static constexpr size_t THRESHOLDS = 2 * MAX_NOISE;
+    static constexpr int GUIDE_BITS = 12;
+    static constexpr size_t GUIDE_SIZE = size_t(1) << GUIDE_BITS;
+
+    uint32_t thresholds[THRESHOLDS]; // thresholds[j] = 2^32 * P(trunc(x) <= j - MAX_NOISE)
+    uint16_t guide[GUIDE_SIZE];      // 桶起点之前的阈值个数
+};
+
+// 独立的两个流：选位置用 0 号，噪声取值用 1 号，改变一种噪声的取值方式不影响选中的位置
+constexpr uint32_t INDEX_STREAM = 0;
+constexpr uint32_t VALUE_STREAM = 1;
+
+int lowestBit(uint64_t word) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+// 从 [0, n) 中不重复地选 k 个，按下标从小到大对每个调用 visit(index)。
+// 先在位图上标记，再顺序扫描位图，对图像的访问是顺序的
+template <typename Visit>
+void sampleDistinct(uint64_t n, uint64_t k, RandomStream &random, std::vector<uint64_t> &bitmap, Visit &&visit) {
+    if (k == 0 || n == 0) {
+        return;
+    }
+    bool complement = k > n / 2;
+    uint64_t draws = complement ? n - k : k;
+
+    size_t words = static_cast<size_t>((n + 63) / 64);
+    bitmap.assign(words, 0);
+    for (uint64_t i = 0; i < draws; ++i) {
+        uint64_t index;
+        do {
+            index = random.below(n);
+        } while (bitmap[index / 64] >> (index % 64) & 1);
+        bitmap[index / 64] |= uint64_t(1) << (index % 64);
+    }
+
+    for (size_t w = 0; w < words; ++w) {
+        uint64_t word = complement ? ~bitmap[w] : bitmap[w];
+        if (w + 1 == words && n % 64 != 0) {
+            word &= (uint64_t(1) << (n % 64)) - 1;
+        }
+        for (; word != 0; word &= word - 1) {
+            visit(static_cast<uint64_t>(w) * 64 + static_cast<uint64_t>(lowestBit(word)));
+        }
+    }
+}
+
+} // namespace
+
+const char *noiseTypeName(NoiseType type) {
+    switch (type) {
+    case NoiseType::SaltAndPepper:
+        return "salt-pepper";
+    case NoiseType::Random:
+        return "random";
+    case NoiseType::Gaussian:
+        return "gaussian";
+    }
+    return "unknown";
+}
+
+bool parseNoiseType(const std::string &name, NoiseType &type) {
+    for (NoiseType candidate : {NoiseType::SaltAndPepper, NoiseType::Random, NoiseType::Gaussian}) {
+        if (name == noiseTypeName(candidate)) {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void addNoise(const ImageView &view, NoiseType type, double level, uint64_t seed, NoiseScratch &scratch) {
+    LD_TRACE_SCOPE("noise");
+    level = std::min(1.0, std::max(0.0, level));
+    RandomStream indices(seed, INDEX_STREAM);
+    RandomStream values(seed, VALUE_STREAM);
+
+    if (type == NoiseType::SaltAndPepper) {
+        // 24 位图的逻辑行长是 3 的倍数，每 3 个逻辑字节是一个像素
+        uint64_t pixelBytes = view.swapChannels ? 3 : 1;
+        uint64_t pixels = view.size() / pixelBytes;
+        uint64_t count = static_cast<uint64_t>(level * static_cast<double>(pixels));
+        // 每个 32 位随机数提供 32 个像素的黑白选择
+        uint32_t bits = 0;
+        int remaining = 0;
+        sampleDistinct(pixels, count, indices, scratch.bitmap, [&](uint64_t pixel) {
+            if (remaining == 0) {
+                bits = values.next32();
+                remaining = 32;
+            }
+            uint8_t value = (bits & 1) ? 255 : 0;
+            bits >>= 1;
+            --remaining;
+            for (uint64_t i = 0; i < pixelBytes; ++i) {
+                view[pixel * pixelBytes + i] = value;
+            }
+        });
+        return;
+    }
+
+    uint64_t count = static_cast<uint64_t>(level * static_cast<double>(view.size()));
+    if (type == NoiseType::Random) {
+        sampleDistinct(view.size(), count, indices, scratch.bitmap, [&](uint64_t index) {
+            view[index] = static_cast<uint8_t>(values.next32());
+        });
+        return;
+    }
+
+    static const GaussianTable table(GAUSSIAN_SIGMA);
+    sampleDistinct(view.size(), count, indices, scratch.bitmap, [&](uint64_t index) {
+        int value = static_cast<int>(view[index]) + table.sample(values.next32());
+        view[index] = static_cast<uint8_t>(std::min(255, std::max(0, value)));
+    });
+}
+
+} // namespace ld
@@ -0,0 +1,36 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include "imageview.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ld {
+
+// Noise_Exp/addnoise.cpp 中的三种噪声，作用在逻辑字节视图上（不触碰行填充）：
+//   SaltAndPepper：随机选 level 比例的像素，整个像素置 0 或 255
+//   Random：       随机选 level 比例的字节，替换为均匀分布的随机值
+//   Gaussian：     随机选 level 比例的字节，加 N(0, 25²) 后截断到 [0, 255]
+// 选中的位置互不相同。每个样本 O(1)：用位图去重，比例超过一半时改为选出不加噪声的位置，
+// 拒绝采样的期望次数不超过 2；选完后按下标顺序扫描位图加噪声。
+//
+// 随机数来自以 seed 为密钥的 Philox4x32 计数器流（位置和取值各用一个流），整批生成；
+// 高斯噪声直接按截断后的整数分布查表，不调用 std::normal_distribution。
+// 结果只由 (图像, 类型, 比例, seed) 决定，与平台和标准库实现无关。
+enum class NoiseType { SaltAndPepper, Random, Gaussian };
+
+const char *noiseTypeName(NoiseType type);
+bool parseNoiseType(const std::string &name, NoiseType &type);
+
+// 反复加噪声时复用的缓冲区，容量够用之后不再分配内存
+struct NoiseScratch {
+    std::vector<uint64_t> bitmap;
+};
+
+// level 在 [0, 1] 之外时截断
+void addNoise(const ImageView &view, NoiseType type, double level, uint64_t seed, NoiseScratch &scratch);
+
+} // namespace ld
+
+#endif // NOISE_H
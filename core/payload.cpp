@@ -0,0 +1,783 @@
+#include "payload.h"
+#include "bitplane.h"
+#include "chacha20.h"
+#include "compress.h"
+#include "crc32c.h"
+#include "keyedpermutation.h"
+#include "ldutil.h"
+#include "lrucache.h"
+#include "lsb.h"
+#include "sha256.h"
+#include "threadpool.h"
+#include "trace.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace ld {
+
+namespace {
+
+constexpr uint8_t MAGIC_0 = 'L';
+constexpr uint8_t MAGIC_1 = 'D';
+constexpr uint8_t KNOWN_FLAGS = LAYOUT_FLAGS | PAYLOAD_FLAG_COMPRESSED | PAYLOAD_FLAG_ENCRYPTED;
+constexpr char KDF_SALT[] = "ld-security payload key";
+
+// 派生很慢（PAYLOAD_KDF_ITERATIONS 次 HMAC），同一个口令只算一次；交替使用多个口令（例如后台服务）时也不会反复派生。
+// 派生在锁外进行，不同口令可以同时派生
+void derivePayloadKey(const std::string &key, uint8_t out[CHACHA20_KEY_SIZE]) {
+    using DerivedKey = std::array<uint8_t, CHACHA20_KEY_SIZE>;
+    static LruCache<std::string, DerivedKey> cache(PAYLOAD_KEY_CACHE_SIZE);
+    DerivedKey derived;
+    if (!cache.get(key, derived)) {
+        LD_TRACE_SCOPE("kdf");
+        pbkdf2Sha256(asBytes(key), ConstByteSpan(reinterpret_cast<const uint8_t *>(KDF_SALT), sizeof(KDF_SALT) - 1),
+                     PAYLOAD_KDF_ITERATIONS, derived.data(), derived.size());
+        cache.put(key, derived);
+    }
+    std::memcpy(out, derived.data(), derived.size());
+}
+
+void randomNonce(uint8_t nonce[PAYLOAD_NONCE_SIZE]) {
+    std::random_device device;
+    for (size_t i = 0; i < PAYLOAD_NONCE_SIZE; i += 4) {
+        uint32_t value = device();
+        for (size_t j = 0; j < 4 && i + j < PAYLOAD_NONCE_SIZE; ++j) {
+            nonce[i + j] = static_cast<uint8_t>(value >> (8 * j));
+        }
+    }
+}
+
+std::unique_ptr<ChaCha20Poly1305> payloadCipher(const std::string &key, const uint8_t *nonce, const uint8_t *header) {
+    uint8_t derived[CHACHA20_KEY_SIZE];
+    derivePayloadKey(key, derived);
+    return std::unique_ptr<ChaCha20Poly1305>(
+        new ChaCha20Poly1305(derived, nonce, ConstByteSpan(header, PAYLOAD_PROBE_SIZE)));
+}
+
+// 文件载荷每次读写的字节数，内存中只保留这么大的一块
+constexpr size_t STREAM_CHUNK = PROGRESS_CHUNK;
+
+// 带密钥时每个并行块的字节数
+constexpr size_t PARALLEL_GRAIN = 16 * 1024;
+// 口令搜索每批探测的口令数（批与批之间报告进度、检查是否已找到）和每个并行块的口令数
+constexpr size_t KEY_SEARCH_BATCH = 4096;
+constexpr uint64_t KEY_SEARCH_GRAIN = 64;
+// 非默认布局带密钥时每块的样本数。块边界取样本序号的整倍数，
+// 边界上的比特序号同时是位平面数和 8 的倍数，相邻块不会写同一个样本或同一个输出字节
+constexpr uint64_t LAYOUT_GRAIN = PARALLEL_GRAIN * 8;
+
+// 非默认布局带密钥：比特 j 在样本 permutation(j / planes) 的第 j % planes 位平面
+template <typename Visit>
+void forLayoutBits(const ConstImageView &view, const EmbedLayout &layout, const KeyedPermutation &permutation,
+                   uint64_t firstBit, uint64_t bitCount, const Visit &visit) {
+    uint64_t planes = static_cast<uint64_t>(layout.planes);
+    uint64_t endBit = firstBit + bitCount;
+    uint64_t firstSample = firstBit / planes;
+    uint64_t endSample = (endBit + planes - 1) / planes;
+    uint64_t firstChunk = firstSample / LAYOUT_GRAIN;
+    uint64_t chunks = (endSample + LAYOUT_GRAIN - 1) / LAYOUT_GRAIN - firstChunk;
+    parallelFor(chunks, 1, [&](uint64_t begin, uint64_t end) {
+        uint64_t sample = std::max(firstSample, (firstChunk + begin) * LAYOUT_GRAIN);
+        uint64_t last = std::min(endSample, (firstChunk + end) * LAYOUT_GRAIN);
+        for (; sample < last; ++sample) {
+            uint64_t index = layout.sampleIndex(view, permutation(sample));
+            uint64_t bit = std::max(firstBit, sample * planes);
+            uint64_t stop = std::min(endBit, (sample + 1) * planes);
+            for (; bit < stop; ++bit) {
+                visit(index, static_cast<int>(bit - sample * planes), bit - firstBit);
+            }
+        }
+    });
+}
+
+KeyedPermutation::Kind permutationKind(uint8_t version) {
+    return version == PAYLOAD_VERSION_PHILOX ? KeyedPermutation::Kind::Philox : KeyedPermutation::Kind::SplitMix;
+}
+
+// 顺序和带密钥两种位置，对上层提供同样的按字节读写
+class BitAccess {
+public:
+    BitAccess(const ConstImageView &view, const std::string &key, uint8_t version, const EmbedLayout &layout)
+        : keyed(!key.empty()), version(version), layout(layout),
+          permutation(key, keyed ? layout.sampleCount(view) : 0, permutationKind(version)) {}
+    // 带密钥，置换由 base 换成这个布局的定义域，同一密钥试多种布局时不必每次由密钥生成轮密钥
+    BitAccess(const ConstImageView &view, const KeyedPermutation &base, uint8_t version, const EmbedLayout &layout)
+        : keyed(true), version(version), layout(layout),
+          permutation(base, layout.sampleCount(view), permutationKind(version)) {}
+
+    uint8_t formatVersion() const { return version; }
+
+    // 置换保证不同比特落在不同的载体字节上，各块可以同时写
+    void write(const ImageView &view, uint64_t firstByte, const uint8_t *bytes, size_t count) const {
+        if (!layout.isDefault()) {
+            if (!keyed) {
+                embedLayoutBits(view, layout, firstByte * 8, bytes, static_cast<uint64_t>(count) * 8);
+                return;
+            }
+            forLayoutBits(view, layout, permutation, firstByte * 8, static_cast<uint64_t>(count) * 8,
+                          [&](uint64_t index, int plane, uint64_t bit) {
+                              uint8_t &target = view[index];
+                              uint8_t value = static_cast<uint8_t>((bytes[bit / 8] >> (bit % 8) & 1) << plane);
+                              target = static_cast<uint8_t>((target & ~(1u << plane)) | value);
+                          });
+            return;
+        }
+        if (!keyed) {
+            embedSequential(view, firstByte * 8, bytes, count);
+            return;
+        }
+        parallelFor(count, PARALLEL_GRAIN, [&](uint64_t begin, uint64_t end) {
+            embedBitsAt(view, permutation, (firstByte + begin) * 8, bytes + begin, static_cast<size_t>(end - begin));
+        });
+    }
+
+    void read(const ConstImageView &view, uint64_t firstByte, uint8_t *bytes, size_t count) const {
+        if (!layout.isDefault()) {
+            if (!keyed) {
+                extractLayoutBits(view, layout, firstByte * 8, bytes, static_cast<uint64_t>(count) * 8);
+                return;
+            }
+            std::fill(bytes, bytes + count, 0);
+            forLayoutBits(view, layout, permutation, firstByte * 8, static_cast<uint64_t>(count) * 8,
+                          [&](uint64_t index, int plane, uint64_t bit) {
+                              bytes[bit / 8] |= static_cast<uint8_t>((view[index] >> plane & 1) << (bit % 8));
+                          });
+            return;
+        }
+        if (!keyed) {
+            extractSequential(view, firstByte * 8, bytes, count);
+            return;
+        }
+        parallelFor(count, PARALLEL_GRAIN, [&](uint64_t begin, uint64_t end) {
+            extractBitsAt(view, permutation, (firstByte + begin) * 8, bytes + begin, static_cast<size_t>(end - begin));
+        });
+    }
+
+    // 读出头部的前 PAYLOAD_PROBE_SIZE 字节（encoded 只需这么大），只检查魔数、版本和标志；
+    // 版本号和布局都必须与所用的一致。
+    // 先只读第一个字节：没有载荷的布局和错误的密钥绝大多数在这里就被排除，只需要 8 个位置
+    ExtractStatus probe(const ConstImageView &view, uint8_t *encoded) const {
+        read(view, 0, encoded, 1);
+        if (encoded[0] != MAGIC_0) {
+            return ExtractStatus::NoPayload;
+        }
+        read(view, 1, encoded + 1, PAYLOAD_PROBE_SIZE - 1);
+        if (encoded[1] != MAGIC_1 || encoded[2] != version || (encoded[3] & LAYOUT_FLAGS) != layout.flags()) {
+            return ExtractStatus::NoPayload;
+        }
+        return (encoded[3] & ~KNOWN_FLAGS) ? ExtractStatus::Unsupported : ExtractStatus::Ok;
+    }
+
+private:
+    bool keyed;
+    uint8_t version;
+    EmbedLayout layout;
+    KeyedPermutation permutation;
+};
+
+// 正文的去向：begin(header) 之后，每块先由 buffer(done, count) 给出读入位置，
+// 读完后 commit(data, count)，全部读完且校验通过后 finish()；
+// 当前布局校验失败换下一个布局时调用 discard()
+class StringSink {
+public:
+    StringSink(std::string &payload, Progress *progress) : payload(payload), progress(progress) {}
+
+    size_t chunkSize(uint64_t length) const { return progress ? PROGRESS_CHUNK : static_cast<size_t>(length); }
+    bool begin(const PayloadHeader &header) {
+        compressed = (header.flags & PAYLOAD_FLAG_COMPRESSED) != 0;
+        payload.resize(static_cast<size_t>(header.length));
+        return true;
+    }
+    uint8_t *buffer(uint64_t done, size_t) { return reinterpret_cast<uint8_t *>(&payload[static_cast<size_t>(done)]); }
+    bool commit(const uint8_t *, size_t) { return true; }
+    ExtractStatus finish() {
+        if (!compressed) {
+            return ExtractStatus::Ok;
+        }
+        std::string stored;
+        stored.swap(payload);
+        return decompressPayload(asBytes(stored), payload) ? ExtractStatus::Ok : ExtractStatus::BadCompression;
+    }
+    void discard() { payload.clear(); }
+
+private:
+    std::string &payload;
+    Progress *progress;
+    bool compressed = false;
+};
+
+// 边读边写入文件，内存中只有一块；压缩的正文边读边解压
+class FileSink {
+public:
+    FileSink(const std::string &path, std::string *error) : path(path), error(error) {}
+
+    size_t chunkSize(uint64_t) const { return STREAM_CHUNK; }
+    bool begin(const PayloadHeader &header) {
+        compressed = (header.flags & PAYLOAD_FLAG_COMPRESSED) != 0;
+        corrupt = false;
+        decompressor = StreamDecompressor();
+        file.open(path, std::ios::binary | std::ios::trunc);
+        data.resize(static_cast<size_t>(std::min<uint64_t>(header.length, STREAM_CHUNK)));
+        opened = true;
+        return file ? true : fail(error, "Unable to create output file");
+    }
+    uint8_t *buffer(uint64_t, size_t) { return data.data(); }
+    bool commit(const uint8_t *bytes, size_t count) {
+        if (compressed) {
+            // 解压失败时继续读完，以便区分校验和错误和压缩数据错误
+            decoded.clear();
+            corrupt = corrupt || !decompressor.update(bytes, count, decoded);
+            if (corrupt) {
+                return true;
+            }
+            bytes = decoded.data();
+            count = decoded.size();
+        }
+        file.write(reinterpret_cast<const char *>(bytes), static_cast<std::streamsize>(count));
+        return file ? true : fail(error, "Unable to write output file");
+    }
+    ExtractStatus finish() {
+        if (compressed && (corrupt || !decompressor.finish())) {
+            return ExtractStatus::BadCompression;
+        }
+        file.close();
+        return file ? ExtractStatus::Ok : (fail(error, "Unable to write output file"), ExtractStatus::IoError);
+    }
+    // 不留下未校验或不完整的文件
+    void discard() {
+        if (file.is_open()) {
+            file.close();
+        }
+        if (opened) {
+            std::remove(path.c_str());
+            opened = false;
+        }
+    }
+
+private:
+    std::string path;
+    std::string *error;
+    std::ofstream file;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> decoded;
+    StreamDecompressor decompressor;
+    bool compressed = false;
+    bool corrupt = false;
+    bool opened = false;
+};
+
+// 按一种版本和布局读出头部和正文
+// 加密的正文先读出开头的 nonce 和末尾的标签，中间的密文逐块解密后交给 sink，sink 看到的长度不含这两段
+template <typename Sink>
+ExtractStatus readPayload(const BitAccess &access, const ConstImageView &view, const EmbedLayout &layout,
+                          const std::string &key, Sink &sink, Progress *progress) {
+    uint8_t encoded[PAYLOAD_HEADER_SIZE];
+    ExtractStatus status = access.probe(view, encoded);
+    if (status != ExtractStatus::Ok) {
+        return status;
+    }
+
+    PayloadHeader header;
+    access.read(view, PAYLOAD_PROBE_SIZE, encoded + PAYLOAD_PROBE_SIZE, PAYLOAD_HEADER_SIZE - PAYLOAD_PROBE_SIZE);
+    decodePayloadHeader(encoded, header);
+    if (header.length > payloadCapacity(view, layout)) {
+        return ExtractStatus::BadLength;
+    }
+
+    bool encrypted = (header.flags & PAYLOAD_FLAG_ENCRYPTED) != 0;
+    if (encrypted && key.empty()) {
+        return ExtractStatus::Unsupported;
+    }
+    if (encrypted && header.length < PAYLOAD_CIPHER_OVERHEAD) {
+        return ExtractStatus::BadLength;
+    }
+    uint32_t crc = 0;
+    uint64_t offset = PAYLOAD_HEADER_SIZE;
+    PayloadHeader text = header;
+    uint8_t tag[PAYLOAD_TAG_SIZE];
+    std::unique_ptr<ChaCha20Poly1305> cipher;
+    if (encrypted) {
+        uint8_t nonce[PAYLOAD_NONCE_SIZE];
+        access.read(view, offset, nonce, sizeof(nonce));
+        access.read(view, offset + header.length - sizeof(tag), tag, sizeof(tag));
+        crc = crc32c(ConstByteSpan(nonce, sizeof(nonce)));
+        cipher = payloadCipher(key, nonce, encoded);
+        offset += sizeof(nonce);
+        text.length -= PAYLOAD_CIPHER_OVERHEAD;
+    }
+
+    if (!sink.begin(text)) {
+        return ExtractStatus::IoError;
+    }
+    size_t chunk = sink.chunkSize(text.length);
+    for (uint64_t done = 0; done < text.length;) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(chunk, text.length - done));
+        uint8_t *data = sink.buffer(done, count);
+        access.read(view, offset + done, data, count);
+        crc = crc32c(ConstByteSpan(data, count), crc);
+        if (cipher) {
+            LD_TRACE_DETAIL("decrypt");
+            cipher->decrypt(data, count);
+        }
+        if (!sink.commit(data, count)) {
+            return ExtractStatus::IoError;
+        }
+        done += count;
+        if (progress && !progress->report(done, text.length)) {
+            return ExtractStatus::Cancelled;
+        }
+    }
+    if (cipher) {
+        crc = crc32c(ConstByteSpan(tag, sizeof(tag)), crc);
+    }
+    if (crc != header.crc) {
+        return ExtractStatus::BadChecksum;
+    }
+    if (cipher && !cipher->verify(tag)) {
+        return ExtractStatus::BadAuthentication;
+    }
+    return sink.finish();
+}
+
+struct Candidate {
+    uint8_t version;
+    EmbedLayout layout;
+};
+
+// 提取时依次探测的版本和布局。带密钥时先按版本 2 的置换，再按版本 1；版本 1 带密钥的格式早于布局，只有默认布局。
+// 每个版本先试默认布局，再按 flags 顺序试其他布局，灰度图只区分位平面数；放不下头部的布局跳过
+std::vector<Candidate> candidateLayouts(const ConstImageView &view, bool keyed) {
+    std::vector<Candidate> candidates;
+    const uint8_t versions[] = {PAYLOAD_VERSION_PHILOX, PAYLOAD_VERSION};
+    for (size_t i = keyed ? 0 : 1; i < 2; ++i) {
+        bool layouts = !keyed || versions[i] == PAYLOAD_VERSION_PHILOX;
+        for (uint8_t flags = 0; flags <= (layouts ? LAYOUT_FLAGS : 0); ++flags) {
+            EmbedLayout layout = EmbedLayout::fromFlags(flags);
+            if (layout.valid() && layout.normalized(view).flags() == flags &&
+                layout.bitCapacity(view) / 8 >= PAYLOAD_HEADER_SIZE) {
+                candidates.push_back(Candidate{versions[i], layout});
+            }
+        }
+    }
+    return candidates;
+}
+
+// 按 candidateLayouts() 的顺序探测。轮密钥由密钥只生成一次，各布局只换置换的定义域。
+// 换布局重新嵌入后旧头部可能残留一部分，与新数据拼出看似有效的头部，
+// 所以某个布局校验失败时继续尝试其余布局，都不成功才返回第一个失败原因
+template <typename Sink>
+ExtractStatus searchPayload(const ConstImageView &view, const std::string &key, Sink &sink, Progress *progress) {
+    ExtractStatus status = ExtractStatus::NoPayload;
+    bool keyed = !key.empty();
+    KeyedPermutation base(key, 0, KeyedPermutation::Kind::Philox);
+    for (const Candidate &candidate : candidateLayouts(view, keyed)) {
+        LD_TRACE_DETAIL("probe");
+        BitAccess access = keyed ? BitAccess(view, base, candidate.version, candidate.layout)
+                                 : BitAccess(view, key, candidate.version, candidate.layout);
+        ExtractStatus result = readPayload(access, view, candidate.layout, key, sink, progress);
+        if (result == ExtractStatus::Ok) {
+            return result;
+        }
+        sink.discard();
+        if (result == ExtractStatus::Cancelled || result == ExtractStatus::IoError) {
+            return result;
+        }
+        if (status == ExtractStatus::NoPayload) {
+            status = result;
+        }
+    }
+    return status;
+}
+
+// 检查布局和容量，layout 为按图像规范化后的布局；length 为正文字节数，带密钥时另加加密的开销
+bool checkCapacity(const ConstImageView &view, uint64_t length, const std::string &key, const EmbedLayout &requested,
+                   EmbedLayout &layout, std::string *error) {
+    if (!requested.valid()) {
+        return fail(error, "Invalid layout");
+    }
+    layout = requested.normalized(view);
+    uint64_t stored = length + (key.empty() ? 0 : PAYLOAD_CIPHER_OVERHEAD);
+    if (layout.bitCapacity(view) / 8 < PAYLOAD_HEADER_SIZE || stored > payloadCapacity(view, layout)) {
+        return fail(error, "Payload too large to embed");
+    }
+    return true;
+}
+
+// 正文按顺序分块写入，CRC 边写边算；头部在 finish() 中最后写入，
+// 没有调用 finish() 时图像中没有有效头部。
+// 带密钥时构造时写入随机 nonce，write() 把每块加密后再写，finish() 在正文末尾补上标签
+class PayloadWriter {
+public:
+    PayloadWriter(const ImageView &view, const std::string &key, const EmbedLayout &layout, uint8_t flags)
+        : view(view), access(view, key, key.empty() ? PAYLOAD_VERSION : PAYLOAD_VERSION_PHILOX, layout),
+          capacity(payloadCapacity(view, layout)) {
+        header.version = access.formatVersion();
+        header.flags = static_cast<uint8_t>(layout.flags() | flags | (key.empty() ? 0 : PAYLOAD_FLAG_ENCRYPTED));
+        if (!key.empty()) {
+            uint8_t encoded[PAYLOAD_HEADER_SIZE];
+            encodePayloadHeader(header, encoded);
+            uint8_t nonce[PAYLOAD_NONCE_SIZE];
+            randomNonce(nonce);
+            cipher = payloadCipher(key, nonce, encoded);
+            reserved = PAYLOAD_TAG_SIZE;
+            store(nonce, sizeof(nonce));
+        }
+    }
+
+    // 超出容量时不写入并返回 false。加密时不修改调用方的数据
+    bool write(const uint8_t *data, size_t count) {
+        if (count > capacity - reserved - header.length) {
+            return false;
+        }
+        if (cipher) {
+            LD_TRACE_DETAIL("encrypt");
+            scratch.assign(data, data + count);
+            cipher->encrypt(scratch.data(), count);
+            data = scratch.data();
+        }
+        store(data, count);
+        return true;
+    }
+
+    void finish() {
+        if (cipher) {
+            uint8_t tag[PAYLOAD_TAG_SIZE];
+            cipher->finish(tag);
+            store(tag, sizeof(tag));
+        }
+        uint8_t encoded[PAYLOAD_HEADER_SIZE];
+        encodePayloadHeader(header, encoded);
+        access.write(view, 0, encoded, PAYLOAD_HEADER_SIZE);
+    }
+
+private:
+    // 调用方已确认容量（checkCapacity 包含了 nonce 和标签）
+    void store(const uint8_t *data, size_t count) {
+        access.write(view, PAYLOAD_HEADER_SIZE + header.length, data, count);
+        header.crc = crc32c(ConstByteSpan(data, count), header.crc);
+        header.length += count;
+    }
+
+    ImageView view;
+    BitAccess access;
+    uint64_t capacity;
+    PayloadHeader header;
+    std::unique_ptr<ChaCha20Poly1305> cipher;
+    uint64_t reserved = 0; // 为标签保留的字节
+    std::vector<uint8_t> scratch;
+};
+
+} // namespace
+
+const char *extractStatusName(ExtractStatus status) {
+    switch (status) {
+    case ExtractStatus::Ok:
+        return "ok";
+    case ExtractStatus::Legacy:
+        return "legacy";
+    case ExtractStatus::NoPayload:
+        return "no payload";
+    case ExtractStatus::Unsupported:
+        return "unsupported";
+    case ExtractStatus::BadLength:
+        return "bad length";
+    case ExtractStatus::BadChecksum:
+        return "bad checksum";
+    case ExtractStatus::BadCompression:
+        return "bad compressed data";
+    case ExtractStatus::BadAuthentication:
+        return "authentication failed";
+    case ExtractStatus::IoError:
+        return "I/O error";
+    case ExtractStatus::Cancelled:
+        return "cancelled";
+    }
+    return "unknown";
+}
+
+void encodePayloadHeader(const PayloadHeader &header, uint8_t *out) {
+    out[0] = MAGIC_0;
+    out[1] = MAGIC_1;
+    out[2] = header.version;
+    out[3] = header.flags;
+    writeLE(out + 4, header.length, 8);
+    writeLE(out + 12, header.crc, 4);
+}
+
+ExtractStatus decodePayloadHeader(const uint8_t *in, PayloadHeader &header) {
+    if (in[0] != MAGIC_0 || in[1] != MAGIC_1 || in[2] < PAYLOAD_VERSION || in[2] > PAYLOAD_VERSION_PHILOX) {
+        return ExtractStatus::NoPayload;
+    }
+    header.version = in[2];
+    header.flags = in[3];
+    if (header.flags & ~KNOWN_FLAGS) {
+        return ExtractStatus::Unsupported;
+    }
+    header.length = readLE(in + 4, 8);
+    header.crc = static_cast<uint32_t>(readLE(in + 12, 4));
+    return ExtractStatus::Ok;
+}
+
+size_t payloadCapacity(ConstByteSpan imageData) {
+    return payloadCapacity(ConstImageView::fromBytes(imageData));
+}
+
+size_t payloadCapacity(const ConstImageView &view, const EmbedLayout &layout) {
+    if (!layout.valid()) {
+        return 0;
+    }
+    uint64_t capacity = layout.normalized(view).bitCapacity(view) / 8;
+    return capacity > PAYLOAD_HEADER_SIZE ? static_cast<size_t>(capacity - PAYLOAD_HEADER_SIZE) : 0;
+}
+
+bool embedPayload(ByteSpan imageData, ConstByteSpan payload, const std::string &key) {
+    return embedPayload(ImageView::fromBytes(imageData), payload, key);
+}
+
+uint64_t storedPayloadSize(ConstByteSpan payload, bool compress, bool encrypt) {
+    uint64_t size = payload.size();
+    if (compress) {
+        size = std::min<uint64_t>(size, compressPayload(payload).size());
+    }
+    return size + (encrypt ? PAYLOAD_CIPHER_OVERHEAD : 0);
+}
+
+std::vector<uint8_t> sealPayload(ConstByteSpan body, const std::string &key, const uint8_t *header) {
+    std::vector<uint8_t> sealed(PAYLOAD_NONCE_SIZE);
+    randomNonce(sealed.data());
+    std::unique_ptr<ChaCha20Poly1305> cipher = payloadCipher(key, sealed.data(), header);
+    sealed.insert(sealed.end(), body.begin(), body.end());
+    cipher->encrypt(sealed.data() + PAYLOAD_NONCE_SIZE, body.size());
+    sealed.resize(sealed.size() + PAYLOAD_TAG_SIZE);
+    cipher->finish(sealed.data() + PAYLOAD_NONCE_SIZE + body.size());
+    return sealed;
+}
+
+bool openPayload(std::string &body, const std::string &key, const uint8_t *header) {
+    if (body.size() < PAYLOAD_CIPHER_OVERHEAD) {
+        return false;
+    }
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(&body[0]);
+    size_t textSize = body.size() - PAYLOAD_CIPHER_OVERHEAD;
+    std::unique_ptr<ChaCha20Poly1305> cipher = payloadCipher(key, bytes, header);
+    cipher->decrypt(bytes + PAYLOAD_NONCE_SIZE, textSize);
+    if (!cipher->verify(bytes + PAYLOAD_NONCE_SIZE + textSize)) {
+        return false;
+    }
+    body.erase(textSize + PAYLOAD_NONCE_SIZE);
+    body.erase(0, PAYLOAD_NONCE_SIZE);
+    return true;
+}
+
+bool embedPayload(const ImageView &view, ConstByteSpan payload, const std::string &key, Progress *progress,
+                  const EmbedLayout &requested, bool compress, std::string *error) {
+    LD_TRACE_SCOPE("embed");
+    std::vector<uint8_t> compressed;
+    ConstByteSpan stored = payload;
+    uint8_t flags = 0;
+    if (compress) {
+        compressed = compressPayload(payload);
+        if (compressed.size() < payload.size()) {
+            stored = compressed;
+            flags = PAYLOAD_FLAG_COMPRESSED;
+        }
+    }
+    EmbedLayout layout;
+    if (!checkCapacity(view, stored.size(), key, requested, layout, error)) {
+        return false;
+    }
+
+    PayloadWriter writer(view, key, layout, flags);
+    size_t chunk = progress ? PROGRESS_CHUNK : stored.size();
+    for (size_t done = 0; done < stored.size();) {
+        size_t count = std::min(chunk, stored.size() - done);
+        writer.write(stored.data() + done, count);
+        done += count;
+        if (progress && !progress->report(done, stored.size())) {
+            return fail(error, "Cancelled");
+        }
+    }
+    writer.finish();
+    LD_TRACE_COUNT("embedded-bytes", payload.size());
+    return true;
+}
+
+bool embedPayloadFile(const ImageView &view, const std::string &inputPath, const std::string &key,
+                      Progress *progress, const EmbedLayout &requested, bool compress, std::string *error) {
+    LD_TRACE_SCOPE("embed");
+    std::ifstream file(inputPath, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return fail(error, "Unable to open payload file");
+    }
+    std::streamoff size = file.tellg();
+    file.seekg(0);
+    if (size < 0 || !file) {
+        return fail(error, "Unable to read payload file");
+    }
+    // 压缩后的大小要写完才知道，只能在写入过程中检查容量
+    uint64_t length = static_cast<uint64_t>(size);
+    EmbedLayout layout;
+    if (!checkCapacity(view, compress ? 0 : length, key, requested, layout, error)) {
+        return false;
+    }
+
+    PayloadWriter writer(view, key, layout, compress ? PAYLOAD_FLAG_COMPRESSED : 0);
+    StreamCompressor compressor;
+    std::vector<uint8_t> buffer(static_cast<size_t>(std::min<uint64_t>(length, STREAM_CHUNK)));
+    std::vector<uint8_t> packed;
+    for (uint64_t done = 0; done < length;) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(STREAM_CHUNK, length - done));
+        if (!file.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(count))) {
+            return fail(error, "Unable to read payload file");
+        }
+        const uint8_t *data = buffer.data();
+        if (compress) {
+            packed.clear();
+            compressor.update(buffer.data(), count, packed);
+            data = packed.data();
+            count = packed.size();
+        }
+        if (!writer.write(data, count)) {
+            return fail(error, "Payload too large to embed");
+        }
+        done += std::min<uint64_t>(STREAM_CHUNK, length - done);
+        if (progress && !progress->report(done, length)) {
+            return fail(error, "Cancelled");
+        }
+    }
+    if (compress) {
+        packed.clear();
+        compressor.finish(packed);
+        if (!writer.write(packed.data(), packed.size())) {
+            return fail(error, "Payload too large to embed");
+        }
+    }
+    writer.finish();
+    return true;
+}
+
+ExtractStatus extractPayload(ConstByteSpan imageData, std::string &payload, const std::string &key,
+                             bool legacyFallback) {
+    return extractPayload(ConstImageView::fromBytes(imageData), payload, key, legacyFallback);
+}
+
+ExtractStatus extractPayload(const ConstImageView &view, std::string &payload, const std::string &key,
+                             bool legacyFallback, Progress *progress) {
+    LD_TRACE_SCOPE("extract");
+    payload.clear();
+    if (calculateMaxEmbedLength(view) < PAYLOAD_HEADER_SIZE) {
+        return ExtractStatus::NoPayload;
+    }
+
+    StringSink sink(payload, progress);
+    ExtractStatus status = searchPayload(view, key, sink, progress);
+    if (status == ExtractStatus::Ok) {
+        LD_TRACE_COUNT("extracted-bytes", payload.size());
+    }
+    if (status == ExtractStatus::NoPayload && legacyFallback) {
+        payload = key.empty() ? extractMessage(view) : extractMessageWithKey(view, key);
+        return ExtractStatus::Legacy;
+    }
+    return status;
+}
+
+ExtractStatus extractPayloadToFile(const ConstImageView &view, const std::string &outputPath, const std::string &key,
+                                   Progress *progress, std::string *error) {
+    LD_TRACE_SCOPE("extract");
+    if (calculateMaxEmbedLength(view) < PAYLOAD_HEADER_SIZE) {
+        return ExtractStatus::NoPayload;
+    }
+    FileSink sink(outputPath, error);
+    return searchPayload(view, key, sink, progress);
+}
+
+KeySearchResult searchPayloadKeys(const ConstImageView &view, const std::vector<std::string> &keys, bool firstOnly,
+                                  Progress *progress) {
+    LD_TRACE_SCOPE("key-search");
+    KeySearchResult result;
+    std::vector<Candidate> keyedLayouts = candidateLayouts(view, true);
+    std::vector<Candidate> plainLayouts = candidateLayouts(view, false);
+    // 只读头部的前几个字节，不派生加密密钥；每个口令的轮密钥只生成一次。
+    // 第一个字节的第 j 位在样本 j / planes 的第 j % planes 位平面，逐位与魔数比较，有一位不符就换下一个布局，
+    // 平均每个布局只要算一两个位置。版本和通道相同、位平面数不同的布局置换相同，算过的位置留给下一个布局。
+    // 第一个字节是魔数时再按完整的探测判断
+    auto headerMatches = [&](const std::string &key) {
+        uint8_t encoded[PAYLOAD_PROBE_SIZE];
+        if (key.empty()) {
+            for (const Candidate &candidate : plainLayouts) {
+                if (BitAccess(view, key, candidate.version, candidate.layout).probe(view, encoded) !=
+                    ExtractStatus::NoPayload) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        KeyedPermutation base(key, 0, KeyedPermutation::Kind::Philox);
+        KeyedPermutation permutation = base;
+        const Candidate *cached = nullptr;
+        uint64_t positions[8];
+        int known = 0;
+        for (const Candidate &candidate : keyedLayouts) {
+            const EmbedLayout &layout = candidate.layout;
+            if (!cached || cached->version != candidate.version || cached->layout.channels != layout.channels) {
+                permutation = KeyedPermutation(base, layout.sampleCount(view), permutationKind(candidate.version));
+                cached = &candidate;
+                known = 0;
+            }
+            bool magic = true;
+            for (int bit = 0; bit < 8 && magic; ++bit) {
+                int sample = bit / layout.planes;
+                for (; known <= sample; ++known) {
+                    positions[known] = layout.isDefault() ? permutation(known)
+                                                          : layout.sampleIndex(view, permutation(known));
+                }
+                magic = (view[positions[sample]] >> (bit % layout.planes) & 1) == (MAGIC_0 >> bit & 1);
+            }
+            if (magic && BitAccess(view, base, candidate.version, layout).probe(view, encoded) !=
+                             ExtractStatus::NoPayload) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::vector<uint8_t> matched;
+    for (size_t first = 0; first < keys.size(); first += KEY_SEARCH_BATCH) {
+        size_t count = std::min(KEY_SEARCH_BATCH, keys.size() - first);
+        matched.assign(count, 0);
+        parallelFor(count, KEY_SEARCH_GRAIN, [&](uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; ++i) {
+                matched[i] = headerMatches(keys[first + i]) ? 1 : 0;
+            }
+        });
+        result.tried += count;
+        LD_TRACE_COUNT("keys-tried", count);
+        // 头部相符的很少（随机数据碰上魔数、版本和布局的概率约为每个布局 2^-29），按顺序完整提取
+        for (size_t i = 0; i < count; ++i) {
+            if (!matched[i]) {
+                continue;
+            }
+            KeySearchMatch match;
+            match.index = first + i;
+            match.status = extractPayload(view, match.payload, keys[match.index]);
+            bool found = match.status == ExtractStatus::Ok;
+            result.matches.push_back(std::move(match));
+            if (found && firstOnly) {
+                return result;
+            }
+        }
+        if (progress && !progress->report(result.tried, keys.size())) {
+            result.cancelled = true;
+            break;
+        }
+    }
+    return result;
+}
+
+} // namespace ld
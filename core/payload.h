@@ -0,0 +1,134 @@
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include "imageview.h"
+#include "layout.h"
+#include "ldspan.h"
+#include "progress.h"
+#include <string>
+#include <vector>
+
+namespace ld {
+
+// 载荷容器：16 字节头部 + 正文，头部和正文都按 LSB 嵌入（有密钥时按置换后的位置）。
+//
+//   0  'L' 'D'       魔数
+//   2  version       1：顺序嵌入，或带密钥时 SplitMix 置换
+//                    2：带密钥，Philox 置换（KeyedPermutation::Kind::Philox）
+//   3  flags         bit0-4：嵌入布局（EmbedLayout::flags()，默认布局为 0）
+//                    bit5：正文经过压缩（compress.h 的格式），length 和 crc32c 都针对压缩后的数据
+//                    bit6：正文经过 ChaCha20-Poly1305 加密（chacha20.h），只在带密钥时使用
+//   4  length        正文长度，uint64 小端
+//   12 crc32c        正文的 CRC-32C，uint32 小端
+//
+// 提取时先读 4 字节判断魔数和版本，密钥错误或图像中没有信息时立即返回；
+// 然后只读 length 个字节，不再扫描整幅图像，正文中也可以出现 0xFF。
+// 带密钥时位置逐个独立计算，较长的正文分块在 sharedPool() 上并行读写。
+// 头部和正文使用同一个布局，带密钥时置换的是样本，同一样本的各位平面连续存放。
+//
+// 带密钥嵌入时正文先压缩（如果要求）再加密，存放为 nonce(12) + 密文 + 标签(16)，length 和 crc32c 针对这整段。
+// 加密密钥由口令经 PBKDF2-HMAC-SHA256（固定盐，PAYLOAD_KDF_ITERATIONS 次）派生，进程内按最近使用缓存 PAYLOAD_KEY_CACHE_SIZE 个口令的结果；
+// nonce 每次嵌入随机生成，头部前 4 字节（魔数、版本、标志）作为附加认证数据。
+constexpr uint8_t PAYLOAD_VERSION = 1;
+constexpr uint8_t PAYLOAD_VERSION_PHILOX = 2;
+constexpr size_t PAYLOAD_HEADER_SIZE = 16;
+constexpr size_t PAYLOAD_PROBE_SIZE = 4; // 魔数 + 版本 + 标志，足以判断有没有载荷
+constexpr uint8_t PAYLOAD_FLAG_COMPRESSED = 0x20;
+constexpr uint8_t PAYLOAD_FLAG_ENCRYPTED = 0x40;
+constexpr size_t PAYLOAD_NONCE_SIZE = 12;
+constexpr size_t PAYLOAD_TAG_SIZE = 16;
+constexpr size_t PAYLOAD_CIPHER_OVERHEAD = PAYLOAD_NONCE_SIZE + PAYLOAD_TAG_SIZE;
+constexpr uint32_t PAYLOAD_KDF_ITERATIONS = 100000;
+constexpr size_t PAYLOAD_KEY_CACHE_SIZE = 64;
+
+enum class ExtractStatus {
+    Ok,
+    Legacy,      // 没有容器头部，按旧的 0xFF 终止格式解出
+    NoPayload,   // 魔数或版本不符：没有嵌入信息或密钥错误
+    Unsupported, // 头部中有当前版本不认识的标志
+    BadLength,   // 长度超过图像容量
+    BadChecksum,
+    BadCompression, // 校验通过，但压缩数据无法解开
+    BadAuthentication, // 校验通过，但认证标签不符：数据被篡改
+    IoError,     // 流式提取时文件读取失败
+    Cancelled,   // 通过 Progress 取消
+};
+
+const char *extractStatusName(ExtractStatus status);
+
+struct PayloadHeader {
+    uint8_t version = PAYLOAD_VERSION;
+    uint8_t flags = 0;
+    uint64_t length = 0;
+    uint32_t crc = 0;
+};
+
+void encodePayloadHeader(const PayloadHeader &header, uint8_t *out);
+ExtractStatus decodePayloadHeader(const uint8_t *in, PayloadHeader &header);
+
+// 扣除头部之后可嵌入的正文字节数
+size_t payloadCapacity(ConstByteSpan imageData);
+size_t payloadCapacity(const ConstImageView &view, const EmbedLayout &layout = EmbedLayout());
+
+// 正文实际占用的字节数：compress 为 true 且压缩后更小时为压缩后的大小，否则为原长；
+// encrypt 为 true（带密钥）时再加上 PAYLOAD_CIPHER_OVERHEAD。与 payloadCapacity() 比较可以判断能否嵌入
+uint64_t storedPayloadSize(ConstByteSpan payload, bool compress, bool encrypt = false);
+
+// 带密钥时正文的一次性加密和解密，供按行带流式读写等不经过 PayloadWriter 的路径使用。
+// header 为头部的前 PAYLOAD_PROBE_SIZE 字节（标志中应含 PAYLOAD_FLAG_ENCRYPTED）。
+// openPayload 原地解密并去掉 nonce 和标签，长度不足或标签不符时返回 false
+std::vector<uint8_t> sealPayload(ConstByteSpan body, const std::string &key, const uint8_t *header);
+bool openPayload(std::string &body, const std::string &key, const uint8_t *header);
+
+// key 为空时顺序嵌入（版本 1），否则按 Philox 置换嵌入（版本 2）并加密正文。正文超过 payloadCapacity() 或布局无效时不修改图像并返回 false。
+// compress 为 true 时先压缩，压缩后不变小就原样嵌入。
+// 头部最后写入，取消时图像中只有部分正文、没有有效头部，调用方应丢弃这份像素。失败原因写入 error
+bool embedPayload(ByteSpan imageData, ConstByteSpan payload, const std::string &key = std::string());
+bool embedPayload(const ImageView &view, ConstByteSpan payload, const std::string &key = std::string(),
+                  Progress *progress = nullptr, const EmbedLayout &layout = EmbedLayout(), bool compress = false,
+                  std::string *error = nullptr);
+
+// 正文来自文件：按块读入并直接写进载体，内存中只有一块，CRC 边读边算。
+// 文件打不开、读取失败、正文超过容量或被取消时返回 false，原因写入 error；
+// 读取失败或取消时图像中只有部分正文、没有有效头部。
+// compress 为 true 时边读边压缩，压缩后的大小事先不知道，超出容量时同样只留下部分正文
+bool embedPayloadFile(const ImageView &view, const std::string &inputPath, const std::string &key = std::string(),
+                      Progress *progress = nullptr, const EmbedLayout &layout = EmbedLayout(), bool compress = false,
+                      std::string *error = nullptr);
+
+// 带密钥时依次尝试版本 2 和版本 1 的置换；版本 2 和无密钥时再依次尝试各种布局，默认布局最先。
+// legacyFallback 为 true 时，找不到容器头部就按旧格式（0xFF 终止）提取
+ExtractStatus extractPayload(ConstByteSpan imageData, std::string &payload, const std::string &key = std::string(),
+                             bool legacyFallback = false);
+ExtractStatus extractPayload(const ConstImageView &view, std::string &payload, const std::string &key = std::string(),
+                             bool legacyFallback = false, Progress *progress = nullptr);
+
+// 正文直接按块写入 outputPath（覆盖），不在内存中拼出整个正文，压缩的正文边读边解压。不支持旧格式。
+// 只有校验通过时才留下文件，其他情况下删除；文件写入失败时返回 IoError，原因写入 error
+ExtractStatus extractPayloadToFile(const ConstImageView &view, const std::string &outputPath,
+                                   const std::string &key = std::string(), Progress *progress = nullptr,
+                                   std::string *error = nullptr);
+
+// 口令搜索（找回口令、审计泄露的口令）：依次用 keys 中的口令尝试提取。每个口令先只按置换读出各版本、各布局
+// 头部的前几个字节，第一个字节不是魔数就换下一个布局，不派生加密密钥，各口令在 sharedPool() 上并行探测；
+// 头部相符的口令再完整提取（这时才派生密钥、解密和校验）。空口令按不带密钥探测。
+// 只支持载荷容器，旧格式和矩阵嵌入没有可以提前判断的头部
+struct KeySearchMatch {
+    size_t index = 0; // 在 keys 中的下标
+    ExtractStatus status = ExtractStatus::NoPayload;
+    std::string payload;
+};
+
+struct KeySearchResult {
+    std::vector<KeySearchMatch> matches; // 头部相符的口令，按下标排列，status 为完整提取的结果
+    uint64_t tried = 0;                  // 探测过头部的口令数
+    bool cancelled = false;
+};
+
+// firstOnly 为 true 时第一个提取成功的口令之后不再探测；progress 按批报告已探测的口令数
+KeySearchResult searchPayloadKeys(const ConstImageView &view, const std::vector<std::string> &keys,
+                                  bool firstOnly = true, Progress *progress = nullptr);
+
+} // namespace ld
+
+#endif // PAYLOAD_H
@@ -0,0 +1,46 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <cstdint>
+
+namespace ld {
+
+// Philox4x32-10 计数器型伪随机数生成器（Salmon 等, "Parallel Random Numbers: As Easy as 1, 2, 3"）。
+// 输出只由 (counter, key) 决定，第 i 个随机数可以直接算出，不依赖前面的状态，
+// 所以可以按任意分块在多个线程上并行生成，结果与分块方式无关。
+struct Philox4x32 {
+    static constexpr int ROUNDS = 10;
+
+    uint32_t key[2];
+
+    static inline void mulhilo(uint32_t a, uint32_t b, uint32_t &hi, uint32_t &lo) {
+        uint64_t product = static_cast<uint64_t>(a) * b;
+        hi = static_cast<uint32_t>(product >> 32);
+        lo = static_cast<uint32_t>(product);
+    }
+
+    // out 可以与 counter 相同
+    inline void operator()(const uint32_t counter[4], uint32_t out[4]) const {
+        uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int r = 0; r < ROUNDS; ++r) {
+            uint32_t hi0, lo0, hi1, lo1;
+            mulhilo(0xD2511F53u, c0, hi0, lo0);
+            mulhilo(0xCD9E8D57u, c2, hi1, lo1);
+            c0 = hi1 ^ c1 ^ k0;
+            c1 = lo1;
+            c2 = hi0 ^ c3 ^ k1;
+            c3 = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        out[0] = c0;
+        out[1] = c1;
+        out[2] = c2;
+        out[3] = c3;
+    }
+};
+
+} // namespace ld
+
+#endif // PHILOX_H
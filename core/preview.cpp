@@ -0,0 +1,216 @@
+#include "preview.h"
+#include "threadpool.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+
+namespace ld {
+
+namespace {
+
+uint32_t tileCount(uint32_t size) {
+    return (size + PREVIEW_TILE - 1) / PREVIEW_TILE;
+}
+
+uint32_t packRgb(uint64_t r, uint64_t g, uint64_t b, uint64_t count) {
+    // 四舍五入取平均
+    uint64_t half = count / 2;
+    return 0xFF000000u | static_cast<uint32_t>((r + half) / count) << 16 |
+           static_cast<uint32_t>((g + half) / count) << 8 | static_cast<uint32_t>((b + half) / count);
+}
+
+} // namespace
+
+void PreviewPyramid::build(const BmpInfo &info, const ConstImageView &view) {
+    LD_TRACE_SCOPE("preview");
+    this->info = info;
+    shift = 0;
+    levels.clear();
+    if (info.width <= 0 || info.height <= 0 || (info.bitCount != 24 && info.bitCount != 8)) {
+        return;
+    }
+    uint32_t width = static_cast<uint32_t>(info.width);
+    uint32_t height = static_cast<uint32_t>(info.height);
+    while (((width - 1) >> shift) + 1 > PREVIEW_MAX_SIDE || ((height - 1) >> shift) + 1 > PREVIEW_MAX_SIDE) {
+        ++shift;
+    }
+    width = ((width - 1) >> shift) + 1;
+    height = ((height - 1) >> shift) + 1;
+    for (;;) {
+        PreviewLevel level;
+        level.width = width;
+        level.height = height;
+        level.pixels.resize(static_cast<size_t>(width) * height);
+        levels.push_back(std::move(level));
+        if (std::max(width, height) <= PREVIEW_MIN_SIDE) {
+            break;
+        }
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    refresh(view, std::vector<uint8_t>(static_cast<size_t>(tileCount(levels[0].width)) * tileCount(levels[0].height), 1));
+}
+
+size_t PreviewPyramid::update(const ConstImageView &before, const ConstImageView &after) {
+    LD_TRACE_SCOPE("preview");
+    if (levels.empty()) {
+        return 0;
+    }
+    uint32_t tilesX = tileCount(levels[0].width);
+    uint32_t tilesY = tileCount(levels[0].height);
+    std::vector<uint8_t> dirty(static_cast<size_t>(tilesX) * tilesY, 0);
+    uint64_t width = static_cast<uint64_t>(info.width);
+    uint64_t height = static_cast<uint64_t>(info.height);
+    uint64_t channels = static_cast<uint64_t>(info.bitCount / 8);
+    uint64_t tileSide = static_cast<uint64_t>(PREVIEW_TILE) << shift; // 一块对应的源像素边长
+    // 每个任务只写自己那一行块的标记；已经判定有变化的块不再比较
+    parallelFor(tilesY, 1, [&](uint64_t begin, uint64_t end) {
+        for (uint64_t tileY = begin; tileY < end; ++tileY) {
+            uint8_t *flags = dirty.data() + tileY * tilesX;
+            uint64_t last = std::min((tileY + 1) * tileSide, height);
+            for (uint64_t y = tileY * tileSide; y < last; ++y) {
+                uint64_t storageRow = info.topDown ? y : height - 1 - y;
+                const uint8_t *a = before.row(storageRow);
+                const uint8_t *b = after.row(storageRow);
+                for (uint32_t tileX = 0; tileX < tilesX; ++tileX) {
+                    if (flags[tileX]) {
+                        continue;
+                    }
+                    uint64_t first = tileX * tileSide * channels;
+                    uint64_t stop = std::min((tileX + 1) * tileSide, width) * channels;
+                    flags[tileX] = std::memcmp(a + first, b + first, stop - first) != 0;
+                }
+            }
+        }
+    });
+    size_t changed = static_cast<size_t>(std::count(dirty.begin(), dirty.end(), 1));
+    if (changed > 0) {
+        refresh(after, std::move(dirty));
+    }
+    return changed;
+}
+
+const PreviewLevel &PreviewPyramid::levelFor(uint32_t width, uint32_t height) const {
+    static const PreviewLevel none;
+    if (levels.empty()) {
+        return none;
+    }
+    // 各级宽高比相同，有一边不小于显示区域，按比例缩放后的另一边也不会小于显示尺寸
+    for (size_t i = levels.size(); i-- > 0;) {
+        if (levels[i].width >= width || levels[i].height >= height) {
+            return levels[i];
+        }
+    }
+    return levels[0];
+}
+
+void PreviewPyramid::refresh(const ConstImageView &view, std::vector<uint8_t> dirty) {
+    uint32_t tilesX = tileCount(levels[0].width);
+    std::vector<uint32_t> tiles;
+    for (size_t level = 0; level < levels.size(); ++level) {
+        if (level > 0) {
+            // 上一级的块 (x, y) 落在这一级的块 (x / 2, y / 2) 里
+            uint32_t childTilesX = tilesX;
+            uint32_t childTilesY = tileCount(levels[level - 1].height);
+            tilesX = tileCount(levels[level].width);
+            std::vector<uint8_t> parents(static_cast<size_t>(tilesX) * tileCount(levels[level].height), 0);
+            for (uint32_t y = 0; y < childTilesY; ++y) {
+                for (uint32_t x = 0; x < childTilesX; ++x) {
+                    if (dirty[static_cast<size_t>(y) * childTilesX + x]) {
+                        parents[static_cast<size_t>(y / 2) * tilesX + x / 2] = 1;
+                    }
+                }
+            }
+            dirty = std::move(parents);
+        }
+        tiles.clear();
+        for (size_t i = 0; i < dirty.size(); ++i) {
+            if (dirty[i]) {
+                tiles.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        // 第 0 级的一块要读 (64 << shift)² 个源像素，每块一个任务；上面各级只读上一级，合并成较大的任务
+        parallelFor(tiles.size(), level == 0 ? 1 : 16, [&](uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; ++i) {
+                uint32_t tileX = tiles[i] % tilesX;
+                uint32_t tileY = tiles[i] / tilesX;
+                if (level == 0) {
+                    computeBaseTile(view, tileX, tileY);
+                } else {
+                    computeTile(level, tileX, tileY);
+                }
+            }
+        });
+    }
+}
+
+void PreviewPyramid::computeBaseTile(const ConstImageView &view, uint32_t tileX, uint32_t tileY) {
+    PreviewLevel &base = levels[0];
+    uint32_t x0 = tileX * PREVIEW_TILE, x1 = std::min(x0 + PREVIEW_TILE, base.width);
+    uint32_t y0 = tileY * PREVIEW_TILE, y1 = std::min(y0 + PREVIEW_TILE, base.height);
+    uint64_t width = static_cast<uint64_t>(info.width);
+    uint64_t height = static_cast<uint64_t>(info.height);
+    uint64_t block = uint64_t(1) << shift;
+    bool color = info.bitCount == 24;
+    uint64_t sums[PREVIEW_TILE * 3];
+    for (uint32_t y = y0; y < y1; ++y) {
+        std::fill(sums, sums + (x1 - x0) * 3, 0);
+        uint64_t rowFirst = static_cast<uint64_t>(y) << shift;
+        uint64_t rowLast = std::min(rowFirst + block, height);
+        for (uint64_t sy = rowFirst; sy < rowLast; ++sy) {
+            // 翻转放在行寻址里：自下而上存储时第 sy 个显示行是倒数第 sy + 1 个存储行
+            const uint8_t *row = view.row(info.topDown ? sy : height - 1 - sy);
+            for (uint32_t x = x0; x < x1; ++x) {
+                uint64_t first = static_cast<uint64_t>(x) << shift;
+                uint64_t last = std::min(first + block, width);
+                uint64_t *sum = sums + (x - x0) * 3;
+                if (color) {
+                    // 存储顺序是 BGR
+                    for (const uint8_t *p = row + first * 3, *stop = row + last * 3; p < stop; p += 3) {
+                        sum[0] += p[2];
+                        sum[1] += p[1];
+                        sum[2] += p[0];
+                    }
+                } else {
+                    for (const uint8_t *p = row + first, *stop = row + last; p < stop; ++p) {
+                        sum[0] += *p;
+                    }
+                }
+            }
+        }
+        uint32_t *out = base.pixels.data() + static_cast<size_t>(y) * base.width;
+        for (uint32_t x = x0; x < x1; ++x) {
+            uint64_t first = static_cast<uint64_t>(x) << shift;
+            uint64_t count = (std::min(first + block, width) - first) * (rowLast - rowFirst);
+            const uint64_t *sum = sums + (x - x0) * 3;
+            out[x] = color ? packRgb(sum[0], sum[1], sum[2], count) : packRgb(sum[0], sum[0], sum[0], count);
+        }
+    }
+}
+
+void PreviewPyramid::computeTile(size_t index, uint32_t tileX, uint32_t tileY) {
+    const PreviewLevel &source = levels[index - 1];
+    PreviewLevel &target = levels[index];
+    uint32_t x0 = tileX * PREVIEW_TILE, x1 = std::min(x0 + PREVIEW_TILE, target.width);
+    uint32_t y0 = tileY * PREVIEW_TILE, y1 = std::min(y0 + PREVIEW_TILE, target.height);
+    for (uint32_t y = y0; y < y1; ++y) {
+        // 奇数边长时最后一行、一列只有一个源像素
+        uint32_t rows = std::min(2u, source.height - 2 * y);
+        uint32_t *out = target.pixels.data() + static_cast<size_t>(y) * target.width;
+        for (uint32_t x = x0; x < x1; ++x) {
+            uint32_t columns = std::min(2u, source.width - 2 * x);
+            uint64_t r = 0, g = 0, b = 0;
+            for (uint32_t dy = 0; dy < rows; ++dy) {
+                const uint32_t *in = source.row(2 * y + dy) + 2 * x;
+                for (uint32_t dx = 0; dx < columns; ++dx) {
+                    r += (in[dx] >> 16) & 0xFF;
+                    g += (in[dx] >> 8) & 0xFF;
+                    b += in[dx] & 0xFF;
+                }
+            }
+            out[x] = packRgb(r, g, b, static_cast<uint64_t>(rows) * columns);
+        }
+    }
+}
+
+} // namespace ld
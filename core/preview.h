@@ -0,0 +1,56 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include "bmp.h"
+#include <cstdint>
+#include <vector>
+
+namespace ld {
+
+constexpr uint32_t PREVIEW_MAX_SIDE = 2048; // 第 0 级长边的上限
+constexpr uint32_t PREVIEW_MIN_SIDE = 64;   // 长边不超过它的一级是最后一级
+constexpr uint32_t PREVIEW_TILE = 64;       // 各级都按 64×64 像素分块刷新
+
+// 一级预览。像素为 0xFFRRGGBB（与 QImage::Format_RGB32 相同），行从上往下排列，没有填充
+struct PreviewLevel {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint32_t> pixels;
+
+    const uint32_t *row(uint32_t y) const { return pixels.data() + static_cast<size_t>(y) * width; }
+};
+
+// 显示用的多分辨率预览（mip 链）。第 0 级把原图按 2^shift × 2^shift 的方块取平均，shift 取使长边
+// 不超过 PREVIEW_MAX_SIDE 的最小值；之后每级长宽减半（向上取整），直到长边不超过 PREVIEW_MIN_SIDE。
+// 自下而上存储的 BMP 在读源行时倒序寻址，不生成翻转后的副本。8 位图和原来的显示一样按灰度显示，不使用调色板。
+// 各级按 PREVIEW_TILE 见方的块在 sharedPool() 上并行计算
+class PreviewPyramid {
+public:
+    void build(const BmpInfo &info, const ConstImageView &view);
+
+    // before 是 build() 时的像素，after 是同一尺寸和格式的修改后图像（例如嵌入后的副本）。
+    // 只重新计算源像素有变化的块和上面各级覆盖它们的块，返回第 0 级刷新的块数
+    size_t update(const ConstImageView &before, const ConstImageView &after);
+
+    bool empty() const { return levels.empty(); }
+    size_t levelCount() const { return levels.size(); }
+    const PreviewLevel &level(size_t index) const { return levels[index]; }
+
+    // 保持宽高比缩放到 width × height 以内时仍不小于显示尺寸的最小一级，它不超过显示尺寸的两倍；
+    // 显示区域比第 0 级还大时返回第 0 级。调用方只需再缩放这一级
+    const PreviewLevel &levelFor(uint32_t width, uint32_t height) const;
+
+private:
+    // dirty 按第 0 级的块排列，非 0 的块连同上面各级覆盖它们的块从 view 重新计算
+    void refresh(const ConstImageView &view, std::vector<uint8_t> dirty);
+    void computeBaseTile(const ConstImageView &view, uint32_t tileX, uint32_t tileY);
+    void computeTile(size_t index, uint32_t tileX, uint32_t tileY);
+
+    BmpInfo info;
+    uint32_t shift = 0;
+    std::vector<PreviewLevel> levels;
+};
+
+} // namespace ld
+
+#endif // PREVIEW_H
@@ -0,0 +1,42 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+namespace ld {
+
+// 长时间操作的进度回调和取消标志。操作每处理完一块调用 report()，
+// 返回 false 表示已被取消，操作应尽快停止。回调在执行操作的线程上调用，
+// cancel() 可以从任何线程调用。
+class Progress {
+public:
+    using Callback = std::function<void(uint64_t done, uint64_t total)>;
+
+    Progress() = default;
+    explicit Progress(Callback callback) : callback(std::move(callback)) {}
+
+    void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+    bool report(uint64_t done, uint64_t total) {
+        if (callback) {
+            callback(done, total);
+        }
+        return !isCancelled();
+    }
+
+private:
+    Callback callback;
+    std::atomic<bool> cancelled{false};
+};
+
+// 每处理这么多字节报告一次进度
+constexpr size_t PROGRESS_CHUNK = size_t(1) << 20;
+
+} // namespace ld
+
+#endif // PROGRESS_H
@@ -0,0 +1,181 @@
+#include "sha256.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace ld {
+
+namespace {
+
+constexpr uint32_t ROUND_CONSTANTS[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+inline uint32_t readBE32(const uint8_t *in) {
+    return static_cast<uint32_t>(in[0]) << 24 | static_cast<uint32_t>(in[1]) << 16 |
+           static_cast<uint32_t>(in[2]) << 8 | in[3];
+}
+
+inline void writeBE32(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (24 - 8 * i));
+    }
+}
+
+} // namespace
+
+Sha256::Sha256()
+    : state{0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19} {}
+
+void Sha256::compress(const uint8_t *block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = readBE32(block + 4 * i);
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + ROUND_CONSTANTS[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+void Sha256::update(ConstByteSpan data) {
+    const uint8_t *bytes = data.data();
+    size_t size = data.size();
+    length += size;
+    if (buffered > 0) {
+        size_t count = std::min(size, sizeof(buffer) - buffered);
+        std::memcpy(buffer + buffered, bytes, count);
+        buffered += count;
+        bytes += count;
+        size -= count;
+        if (buffered < sizeof(buffer)) {
+            return;
+        }
+        compress(buffer);
+        buffered = 0;
+    }
+    for (; size >= sizeof(buffer); size -= sizeof(buffer), bytes += sizeof(buffer)) {
+        compress(bytes);
+    }
+    std::memcpy(buffer, bytes, size);
+    buffered = size;
+}
+
+void Sha256::finish(uint8_t digest[SHA256_SIZE]) {
+    uint64_t bits = length * 8;
+    uint8_t padding[72] = {0x80};
+    size_t padSize = (buffered < 56 ? 56 : 120) - buffered;
+    for (int i = 0; i < 8; ++i) {
+        padding[padSize + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    }
+    update(ConstByteSpan(padding, padSize + 8));
+    for (int i = 0; i < 8; ++i) {
+        writeBE32(digest + 4 * i, state[i]);
+    }
+}
+
+namespace {
+
+// 填充后的内外两个密钥块只压缩一次，PBKDF2 每次迭代只需复制状态
+class Hmac {
+public:
+    explicit Hmac(ConstByteSpan key) {
+        uint8_t block[64] = {};
+        if (key.size() > sizeof(block)) {
+            Sha256 hash;
+            hash.update(key);
+            hash.finish(block);
+        } else {
+            std::copy(key.begin(), key.end(), block);
+        }
+        uint8_t pad[64];
+        for (size_t i = 0; i < sizeof(pad); ++i) {
+            pad[i] = block[i] ^ 0x36;
+        }
+        inner.update(ConstByteSpan(pad, sizeof(pad)));
+        for (size_t i = 0; i < sizeof(pad); ++i) {
+            pad[i] = block[i] ^ 0x5C;
+        }
+        outer.update(ConstByteSpan(pad, sizeof(pad)));
+    }
+
+    void operator()(ConstByteSpan message, uint8_t mac[SHA256_SIZE]) const {
+        uint8_t digest[SHA256_SIZE];
+        Sha256 innerHash = inner;
+        innerHash.update(message);
+        innerHash.finish(digest);
+        Sha256 outerHash = outer;
+        outerHash.update(ConstByteSpan(digest, sizeof(digest)));
+        outerHash.finish(mac);
+    }
+
+private:
+    Sha256 inner;
+    Sha256 outer;
+};
+
+} // namespace
+
+void hmacSha256(ConstByteSpan key, ConstByteSpan message, uint8_t mac[SHA256_SIZE]) {
+    Hmac hmac(key);
+    hmac(message, mac);
+}
+
+void pbkdf2Sha256(ConstByteSpan password, ConstByteSpan salt, uint32_t iterations, uint8_t *out, size_t size) {
+    Hmac hmac(password);
+    std::vector<uint8_t> first(salt.begin(), salt.end());
+    first.resize(salt.size() + 4);
+    for (uint32_t block = 1; size > 0; ++block) {
+        writeBE32(first.data() + salt.size(), block);
+        uint8_t u[SHA256_SIZE];
+        uint8_t t[SHA256_SIZE];
+        hmac(first, u);
+        std::copy(u, u + SHA256_SIZE, t);
+        for (uint32_t i = 1; i < iterations; ++i) {
+            hmac(ConstByteSpan(u, SHA256_SIZE), u);
+            for (size_t j = 0; j < SHA256_SIZE; ++j) {
+                t[j] ^= u[j];
+            }
+        }
+        size_t count = std::min(size, SHA256_SIZE);
+        std::copy(t, t + count, out);
+        out += count;
+        size -= count;
+    }
+}
+
+} // namespace ld
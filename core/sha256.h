@@ -0,0 +1,36 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include "ldspan.h"
+#include <cstdint>
+
+namespace ld {
+
+constexpr size_t SHA256_SIZE = 32;
+
+// SHA-256（FIPS 180-4），可以分段 update()。只用于从口令派生密钥，不在热路径上，只有标量实现
+class Sha256 {
+public:
+    Sha256();
+
+    void update(ConstByteSpan data);
+    // 调用后对象不能再使用
+    void finish(uint8_t digest[SHA256_SIZE]);
+
+private:
+    void compress(const uint8_t *block);
+
+    uint32_t state[8];
+    uint8_t buffer[64];
+    size_t buffered = 0;
+    uint64_t length = 0;
+};
+
+void hmacSha256(ConstByteSpan key, ConstByteSpan message, uint8_t mac[SHA256_SIZE]);
+
+// PBKDF2-HMAC-SHA256（RFC 8018），输出 size 字节
+void pbkdf2Sha256(ConstByteSpan password, ConstByteSpan salt, uint32_t iterations, uint8_t *out, size_t size);
+
+} // namespace ld
+
+#endif // SHA256_H
@@ -0,0 +1,307 @@
+#include "shard.h"
+#include "compress.h"
+#include "crc32c.h"
+#include "ldutil.h"
+#include "threadpool.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+namespace ld {
+
+namespace {
+
+constexpr uint8_t MAGIC_0 = 'L';
+constexpr uint8_t MAGIC_1 = 'S';
+// 错误信息中最多列出的缺失分片数
+constexpr size_t MAX_LISTED_MISSING = 8;
+
+struct ShardHeader {
+    uint8_t flags = 0;
+    uint32_t index = 0;
+    uint32_t count = 0;
+    uint64_t offset = 0;
+    uint64_t total = 0;
+    uint32_t crc = 0;
+};
+
+void encodeShardHeader(const ShardHeader &header, uint8_t *out) {
+    out[0] = MAGIC_0;
+    out[1] = MAGIC_1;
+    out[2] = SHARD_VERSION;
+    out[3] = header.flags;
+    writeLE(out + 4, header.index, 4);
+    writeLE(out + 8, header.count, 4);
+    writeLE(out + 12, header.offset, 8);
+    writeLE(out + 20, header.total, 8);
+    writeLE(out + 28, header.crc, 4);
+}
+
+// 不是本版本的分片（普通载荷、其他版本）时返回 false
+bool decodeShardHeader(const std::string &body, ShardHeader &header) {
+    const uint8_t *in = reinterpret_cast<const uint8_t *>(body.data());
+    if (body.size() < SHARD_HEADER_SIZE || in[0] != MAGIC_0 || in[1] != MAGIC_1 || in[2] != SHARD_VERSION ||
+        (in[3] & ~SHARD_FLAG_COMPRESSED)) {
+        return false;
+    }
+    header.flags = in[3];
+    header.index = static_cast<uint32_t>(readLE(in + 4, 4));
+    header.count = static_cast<uint32_t>(readLE(in + 8, 4));
+    header.offset = readLE(in + 12, 8);
+    header.total = readLE(in + 20, 8);
+    header.crc = static_cast<uint32_t>(readLE(in + 28, 4));
+    uint64_t bytes = body.size() - SHARD_HEADER_SIZE;
+    return header.index < header.count && header.offset <= header.total && bytes <= header.total - header.offset;
+}
+
+// 放得下分片头部时返回 true，room 为还能放的数据字节数（可以为 0）
+bool shardRoom(const ConstImageView &view, const std::string &key, const EmbedLayout &layout, uint64_t &room) {
+    uint64_t overhead = SHARD_HEADER_SIZE + (key.empty() ? 0 : PAYLOAD_CIPHER_OVERHEAD);
+    uint64_t capacity = payloadCapacity(view, layout);
+    room = capacity > overhead ? capacity - overhead : 0;
+    return capacity >= overhead;
+}
+
+// 两个分片来自同一次嵌入
+bool sameSpan(const ShardHeader &a, const ShardHeader &b) {
+    return a.count == b.count && a.total == b.total && a.crc == b.crc && a.flags == b.flags;
+}
+
+// 头部相同的一组分片，byIndex 按序号给出载体（SIZE_MAX 为缺失）
+struct ShardGroup {
+    const ShardHeader *header;
+    std::vector<size_t> byIndex;
+    size_t found;
+};
+
+// 齐全的一组按序号拼接，检查偏移、长度和整份 CRC，必要时解压
+ExtractStatus assembleGroup(const ShardGroup &group, const std::vector<std::string> &bodies,
+                            const std::vector<ShardHeader> &headers, const std::vector<ShardInfo> &infos,
+                            std::string &payload, std::string *error) {
+    uint64_t expected = 0;
+    for (uint32_t index = 0; index < group.header->count; ++index) {
+        size_t carrier = group.byIndex[index];
+        if (headers[carrier].offset != expected) {
+            fail(error, "Shard " + std::to_string(index) + " is out of place");
+            return ExtractStatus::BadChecksum;
+        }
+        expected += infos[carrier].bytes;
+    }
+    if (expected != group.header->total) {
+        fail(error, "Shards do not add up to the payload length");
+        return ExtractStatus::BadChecksum;
+    }
+
+    std::string stored;
+    stored.reserve(static_cast<size_t>(group.header->total));
+    for (size_t carrier : group.byIndex) {
+        stored.append(bodies[carrier], SHARD_HEADER_SIZE, std::string::npos);
+    }
+    if (crc32c(asBytes(stored)) != group.header->crc) {
+        fail(error, "Payload checksum mismatch");
+        return ExtractStatus::BadChecksum;
+    }
+    if (group.header->flags & SHARD_FLAG_COMPRESSED) {
+        if (!decompressPayload(asBytes(stored), payload)) {
+            payload.clear();
+            fail(error, "Bad compressed data");
+            return ExtractStatus::BadCompression;
+        }
+    } else {
+        payload.swap(stored);
+    }
+    return ExtractStatus::Ok;
+}
+
+// 提取结果中标出不属于 chosen 这一组的分片
+void markForeign(const ShardGroup &chosen, const std::vector<ShardHeader> &headers, const std::vector<ShardInfo> &infos,
+                 std::vector<ShardInfo> *shards) {
+    if (shards) {
+        for (size_t i = 0; i < infos.size(); ++i) {
+            (*shards)[i].foreign = infos[i].used && !sameSpan(headers[i], *chosen.header);
+        }
+    }
+}
+
+} // namespace
+
+uint64_t shardCapacity(const ConstImageView &view, const std::string &key, const EmbedLayout &layout) {
+    uint64_t room = 0;
+    shardRoom(view, key, layout, room);
+    return room;
+}
+
+bool embedSharded(const std::vector<ImageView> &carriers, ConstByteSpan payload, const std::string &key,
+                  const EmbedLayout &layout, bool compress, std::vector<ShardInfo> *shards, std::string *error) {
+    LD_TRACE_SCOPE("shard-embed");
+    if (shards) {
+        shards->assign(carriers.size(), ShardInfo());
+    }
+    if (!layout.valid()) {
+        return fail(error, "Invalid layout");
+    }
+    ShardHeader header;
+    std::vector<uint8_t> compressed;
+    ConstByteSpan stored = payload;
+    if (compress) {
+        compressed = compressPayload(payload);
+        if (compressed.size() < payload.size()) {
+            stored = ConstByteSpan(compressed.data(), compressed.size());
+            header.flags |= SHARD_FLAG_COMPRESSED;
+        }
+    }
+
+    // 按顺序装满，先确定每幅载体放多少，容量不够时一幅也不修改
+    std::vector<size_t> used;
+    std::vector<uint64_t> offsets;
+    std::vector<uint64_t> sizes;
+    uint64_t placed = 0;
+    for (size_t i = 0; i < carriers.size() && (used.empty() || placed < stored.size()); ++i) {
+        // 放不下数据的载体跳过；只有空正文才用一个没有数据的分片
+        uint64_t room = 0;
+        if (!shardRoom(carriers[i], key, layout, room) || (room == 0 && !stored.empty())) {
+            continue;
+        }
+        uint64_t take = std::min<uint64_t>(room, stored.size() - placed);
+        used.push_back(i);
+        offsets.push_back(placed);
+        sizes.push_back(take);
+        placed += take;
+    }
+    if (used.empty() || placed < stored.size()) {
+        return fail(error, "Payload too large for the carriers");
+    }
+    if (used.size() > UINT32_MAX) {
+        return fail(error, "Too many shards");
+    }
+
+    header.count = static_cast<uint32_t>(used.size());
+    header.total = stored.size();
+    header.crc = crc32c(stored);
+    std::atomic<bool> ok{true};
+    parallelFor(used.size(), 1, [&](uint64_t begin, uint64_t end) {
+        std::vector<uint8_t> body;
+        for (uint64_t k = begin; k < end; ++k) {
+            ShardHeader shard = header;
+            shard.index = static_cast<uint32_t>(k);
+            shard.offset = offsets[k];
+            body.resize(SHARD_HEADER_SIZE + sizes[k]);
+            encodeShardHeader(shard, body.data());
+            std::memcpy(body.data() + SHARD_HEADER_SIZE, stored.data() + offsets[k], sizes[k]);
+            if (!embedPayload(carriers[used[k]], ConstByteSpan(body.data(), body.size()), key, nullptr, layout)) {
+                ok.store(false, std::memory_order_relaxed);
+            }
+        }
+    });
+    if (!ok.load()) {
+        return fail(error, "Unable to embed a shard");
+    }
+    if (shards) {
+        for (size_t k = 0; k < used.size(); ++k) {
+            ShardInfo &info = (*shards)[used[k]];
+            info.used = true;
+            info.index = static_cast<uint32_t>(k);
+            info.bytes = sizes[k];
+            info.status = ExtractStatus::Ok;
+        }
+    }
+    return true;
+}
+
+ExtractStatus extractSharded(const std::vector<ConstImageView> &carriers, std::string &payload, const std::string &key,
+                             std::vector<ShardInfo> *shards, std::string *error) {
+    LD_TRACE_SCOPE("shard-extract");
+    payload.clear();
+    std::vector<std::string> bodies(carriers.size());
+    std::vector<ShardHeader> headers(carriers.size());
+    std::vector<ShardInfo> infos(carriers.size());
+    parallelFor(carriers.size(), 1, [&](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; ++i) {
+            ShardInfo &info = infos[i];
+            info.status = extractPayload(carriers[i], bodies[i], key);
+            if (info.status == ExtractStatus::Ok && decodeShardHeader(bodies[i], headers[i])) {
+                info.used = true;
+                info.index = headers[i].index;
+                info.bytes = bodies[i].size() - SHARD_HEADER_SIZE;
+            } else {
+                std::string().swap(bodies[i]);
+            }
+        }
+    });
+    if (shards) {
+        *shards = infos;
+    }
+
+    // 按头部（总数、长度、CRC、标志）分组，其他几次嵌入留下的分片自成一组，不影响拼接。
+    // 同一序号出现多次（例如复制过的载体）时用第一个，拼接后的整份校验兜底
+    std::vector<ShardGroup> groups;
+    for (size_t i = 0; i < carriers.size(); ++i) {
+        if (!infos[i].used) {
+            continue;
+        }
+        const ShardHeader &header = headers[i];
+        auto group = std::find_if(groups.begin(), groups.end(),
+                                  [&](const ShardGroup &candidate) { return sameSpan(*candidate.header, header); });
+        if (group == groups.end()) {
+            groups.push_back(ShardGroup{&header, {}, 0});
+            group = groups.end() - 1;
+            // 分片比载体还多的组不可能齐全，不分配序号表
+            if (header.count <= carriers.size()) {
+                group->byIndex.assign(header.count, SIZE_MAX);
+            }
+        }
+        if (!group->byIndex.empty() && group->byIndex[header.index] == SIZE_MAX) {
+            group->byIndex[header.index] = i;
+            ++group->found;
+        }
+    }
+    if (groups.empty()) {
+        return ExtractStatus::NoPayload;
+    }
+
+    // 用第一个齐全且校验通过的组。都不成功时报告第一个齐全的组的错误，没有齐全的组时按找到分片最多的组报告缺失
+    const ShardGroup *best = nullptr;
+    ExtractStatus bestStatus = ExtractStatus::BadChecksum;
+    for (const ShardGroup &group : groups) {
+        bool complete = group.found == group.header->count;
+        bool bestComplete = best && best->found == best->header->count;
+        if (complete) {
+            std::string groupError;
+            ExtractStatus status = assembleGroup(group, bodies, headers, infos, payload, &groupError);
+            if (status == ExtractStatus::Ok) {
+                markForeign(group, headers, infos, shards);
+                return status;
+            }
+            if (!bestComplete) {
+                best = &group;
+                bestStatus = status;
+                fail(error, groupError);
+            }
+        } else if (!best || (!bestComplete && group.found > best->found)) {
+            best = &group;
+        }
+    }
+    markForeign(*best, headers, infos, shards);
+    if (best->found == best->header->count) {
+        return bestStatus;
+    }
+    if (best->byIndex.empty()) {
+        fail(error, "Missing shards: " + std::to_string(best->header->count) + " expected, " +
+                        std::to_string(carriers.size()) + " carriers");
+        return ExtractStatus::BadChecksum;
+    }
+    std::string missing;
+    size_t missingCount = 0;
+    for (uint32_t index = 0; index < best->header->count; ++index) {
+        if (best->byIndex[index] == SIZE_MAX && missingCount++ < MAX_LISTED_MISSING) {
+            missing += (missing.empty() ? "" : ", ") + std::to_string(index);
+        }
+    }
+    fail(error, "Missing " + std::to_string(missingCount) + " of " + std::to_string(best->header->count) +
+                    " shards: " + missing + (missingCount > MAX_LISTED_MISSING ? ", ..." : ""));
+    return ExtractStatus::BadChecksum;
+}
+
+} // namespace ld
@@ -0,0 +1,63 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "imageview.h"
+#include "layout.h"
+#include "ldspan.h"
+#include "payload.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ld {
+
+// 一份正文跨多幅载体嵌入。正文按载体顺序切成分片，每片装满一幅载体（最后一片是剩下的部分），
+// 放不下分片数据的载体和用不到的载体不修改。每个分片是一个普通的载荷容器（见 payload.h），容器正文为分片头部 + 分片数据：
+//
+//   偏移  大小  内容
+//   0     2     魔数 'L' 'S'
+//   2     1     SHARD_VERSION
+//   3     1     标志：0x01 整份正文先压缩再切分
+//   4     4     分片序号（从 0 开始，小端）
+//   8     4     分片总数
+//   12    8     这片数据在整份（压缩后的）正文中的偏移
+//   20    8     整份正文的字节数
+//   28    4     整份正文的 CRC-32C
+//
+// 每个分片由容器的 CRC-32C 校验（带密钥时另有各自的 nonce 和认证标签），拼接后再按整份的长度和 CRC 校验。
+// 提取时载体的顺序任意，不含分片的载体忽略；分片按头部（总数、长度、CRC、标志）分组，
+// 其他几次嵌入留下的分片跳过，用第一个齐全且校验通过的组。
+// 嵌入和提取都在 sharedPool() 上并行，每幅载体一个任务
+constexpr uint8_t SHARD_VERSION = 1;
+constexpr size_t SHARD_HEADER_SIZE = 32;
+constexpr uint8_t SHARD_FLAG_COMPRESSED = 0x01;
+
+// 每幅载体的分片情况
+struct ShardInfo {
+    bool used = false; // 这幅载体放了（或提取出）一个分片
+    uint32_t index = 0;
+    uint64_t bytes = 0; // 分片数据的字节数
+    ExtractStatus status = ExtractStatus::NoPayload; // 提取时这幅载体上容器的结果
+    bool foreign = false; // 提取时：分片属于另一次嵌入，拼接时跳过
+};
+
+// 一幅载体能放下的分片数据字节数：扣除容器头部、带密钥时的加密开销和分片头部
+uint64_t shardCapacity(const ConstImageView &view, const std::string &key = std::string(),
+                       const EmbedLayout &layout = EmbedLayout());
+
+// 总容量不够或布局无效时不修改任何载体，返回 false，原因写入 error。
+// compress 为 true 时整份正文先压缩，压缩后不变小就原样切分。
+// shards 不为空时按载体顺序写入每幅载体的分片
+bool embedSharded(const std::vector<ImageView> &carriers, ConstByteSpan payload,
+                  const std::string &key = std::string(), const EmbedLayout &layout = EmbedLayout(),
+                  bool compress = false, std::vector<ShardInfo> *shards = nullptr, std::string *error = nullptr);
+
+// 找不到分片时返回 NoPayload；没有一组分片齐全、齐全的组互相矛盾或整份校验失败时返回 BadChecksum，
+// 压缩的正文解不开时返回 BadCompression，原因写入 error
+ExtractStatus extractSharded(const std::vector<ConstImageView> &carriers, std::string &payload,
+                             const std::string &key = std::string(), std::vector<ShardInfo> *shards = nullptr,
+                             std::string *error = nullptr);
+
+} // namespace ld
+
+#endif // SHARD_H
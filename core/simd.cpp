@@ -0,0 +1,91 @@
+#include "simd.h"
+#include <atomic>
+
+#if defined(LD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ld {
+
+namespace {
+
+SimdLevel probeCpu() {
+#if defined(LD_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) {
+            return SimdLevel::AVX2;
+        }
+    }
+    return sse2 ? SimdLevel::SSE2 : SimdLevel::Scalar;
+#elif defined(LD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    return __builtin_cpu_supports("sse2") ? SimdLevel::SSE2 : SimdLevel::Scalar;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+bool probeCrc32() {
+#if defined(LD_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#elif defined(LD_X86)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return false;
+#endif
+}
+
+std::atomic<int> &activeLevel() {
+    static std::atomic<int> level{static_cast<int>(detectSimdLevel())};
+    return level;
+}
+
+} // namespace
+
+SimdLevel detectSimdLevel() {
+    static const SimdLevel level = probeCpu();
+    return level;
+}
+
+SimdLevel activeSimdLevel() {
+    return static_cast<SimdLevel>(activeLevel().load(std::memory_order_relaxed));
+}
+
+void setSimdLevel(SimdLevel level) {
+    if (static_cast<int>(level) > static_cast<int>(detectSimdLevel())) {
+        level = detectSimdLevel();
+    }
+    activeLevel().store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool cpuHasCrc32() {
+    static const bool supported = probeCrc32();
+    return supported;
+}
+
+const char *simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX2:
+        return "avx2";
+    case SimdLevel::SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+} // namespace ld
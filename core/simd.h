@@ -0,0 +1,35 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// 运行时选择指令集。各内核用 LD_TARGET 单独开启 SSE2/AVX2，
+// 整个工程不需要额外的编译选项，在不支持的 CPU 上回退到标量实现。
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LD_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define LD_TARGET(isa)
+#endif
+
+namespace ld {
+
+enum class SimdLevel { Scalar = 0, SSE2 = 1, AVX2 = 2 };
+
+SimdLevel detectSimdLevel();
+SimdLevel activeSimdLevel();
+
+// 供基准测试和对比使用，超过 detectSimdLevel() 的等级会被降到 CPU 支持的最高等级
+void setSimdLevel(SimdLevel level);
+
+const char *simdLevelName(SimdLevel level);
+
+// SSE4.2 的 crc32 指令，不在上面的等级序列里单独检测
+bool cpuHasCrc32();
+
+} // namespace ld
+
+#endif // SIMD_H
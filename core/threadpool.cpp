@@ -0,0 +1,191 @@
+#include "threadpool.h"
+#include "trace.h"
+#include <algorithm>
+
+namespace ld {
+
+namespace {
+
+// 当前线程所属的线程池和队列编号，用于把子任务放进自己的队列
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local unsigned currentIndex = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    unsigned index = currentPool == this
+                         ? currentIndex
+                         : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    queued.fetch_add(1);
+    {
+        // 空的临界区保证等待中的线程不会错过这次通知
+        std::lock_guard<std::mutex> lock(stateMutex);
+    }
+    workAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    allDone.wait(lock, [this] { return pending.load() == 0; });
+    if (firstError) {
+        std::exception_ptr error = firstError;
+        firstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+bool ThreadPool::popLocal(unsigned index, std::function<void()> &task) {
+    Queue &queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    queued.fetch_sub(1);
+    return true;
+}
+
+bool ThreadPool::steal(unsigned index, std::function<void()> &task) {
+    for (size_t offset = 1; offset < queues.size(); ++offset) {
+        Queue &victim = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(std::function<void()> &task) {
+    try {
+        task();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (!firstError) {
+            firstError = std::current_exception();
+        }
+    }
+    task = nullptr;
+    if (pending.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        allDone.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+    currentPool = this;
+    currentIndex = index;
+    std::function<void()> task;
+    while (true) {
+        if (popLocal(index, task) || steal(index, task)) {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(stateMutex);
+        workAvailable.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0) {
+            return;
+        }
+    }
+}
+
+ThreadPool &sharedPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void parallelFor(uint64_t count, uint64_t grain, const std::function<void(uint64_t, uint64_t)> &body) {
+    grain = std::max<uint64_t>(grain, 1);
+    uint64_t chunks = (count + grain - 1) / grain;
+    if (chunks <= 1 || currentPool != nullptr) {
+        if (count > 0) {
+            body(0, count);
+        }
+        return;
+    }
+
+    // 辅助任务可能在所有块都完成之后才被调度到；它只有领到块时才会访问 body，
+    // 而调用方要等到所有块完成才返回，所以 body 按引用传递是安全的
+    struct State {
+        std::atomic<uint64_t> next{0};
+        std::atomic<bool> failed{false};
+        uint64_t done = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+    const auto *function = &body;
+    auto work = [state, function, chunks, grain, count] {
+        uint64_t completed = 0;
+        for (uint64_t chunk; (chunk = state->next.fetch_add(1)) < chunks; ++completed) {
+            if (state->failed.load(std::memory_order_relaxed)) {
+                continue;
+            }
+            try {
+                LD_TRACE_DETAIL("parallel-chunk");
+                (*function)(chunk * grain, std::min(count, (chunk + 1) * grain));
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error) {
+                    state->error = std::current_exception();
+                }
+                state->failed.store(true, std::memory_order_relaxed);
+            }
+        }
+        if (completed > 0) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->done += completed;
+            if (state->done == chunks) {
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    ThreadPool &pool = sharedPool();
+    uint64_t helpers = std::min<uint64_t>(pool.size(), chunks - 1);
+    for (uint64_t i = 0; i < helpers; ++i) {
+        pool.submit(work);
+    }
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&] { return state->done == chunks; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+} // namespace ld
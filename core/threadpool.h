@@ -0,0 +1,72 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ld {
+
+// 每个工作线程有自己的任务队列：从自己队列的尾部取任务，
+// 空闲时从其他线程队列的头部窃取。外部提交的任务轮流分配到各队列，
+// 工作线程内部提交的任务进入自己的队列。
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount = 0); // 0 表示使用全部硬件线程
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void submit(std::function<void()> task);
+
+    // 等待目前提交的所有任务完成，任务抛出的第一个异常在这里重新抛出。
+    // 不要在工作线程内部调用。
+    void wait();
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(unsigned index);
+    bool popLocal(unsigned index, std::function<void()> &task);
+    bool steal(unsigned index, std::function<void()> &task);
+    void run(std::function<void()> &task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex stateMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> pending{0};
+    std::atomic<unsigned> nextQueue{0};
+    bool stopping = false;
+    std::exception_ptr firstError;
+};
+
+// 进程内共用的线程池，线程数等于硬件线程数，第一次使用时创建
+ThreadPool &sharedPool();
+
+// 把 [0, count) 按 grain 分块，在 sharedPool() 上并行执行 body(begin, end)，
+// 调用线程也参与，全部完成后返回；body 抛出的第一个异常在这里重新抛出。
+// 分块只由 count 和 grain 决定，结果不依赖线程数和调度顺序。
+// 在任何 ThreadPool 的工作线程中调用时直接串行执行，避免嵌套并行占满线程。
+void parallelFor(uint64_t count, uint64_t grain, const std::function<void(uint64_t, uint64_t)> &body);
+
+} // namespace ld
+
+#endif // THREADPOOL_H
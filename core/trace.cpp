@@ -0,0 +1,213 @@
+#include "trace.h"
+#include "ldutil.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+namespace ld {
+
+std::atomic<bool> traceRecording{false};
+
+namespace {
+
+// 环形缓冲：满了以后新事件覆盖最早的，next 为下一个写入位置
+struct TraceLog {
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    size_t next = 0;
+    uint64_t dropped = 0;
+};
+
+TraceLog &traceLog() {
+    static TraceLog log;
+    return log;
+}
+
+// 各线程读时间时不加锁，起点用原子量保存
+std::atomic<int64_t> traceEpoch{0};
+std::atomic<uint32_t> nextThread{1};
+
+int64_t steadyNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+uint32_t threadNumber() {
+    thread_local uint32_t number = nextThread.fetch_add(1);
+    return number;
+}
+
+void record(TraceEvent event) {
+    event.thread = threadNumber();
+    TraceLog &log = traceLog();
+    std::lock_guard<std::mutex> lock(log.mutex);
+    if (log.events.size() < TRACE_MAX_EVENTS) {
+        log.events.push_back(event);
+        return;
+    }
+    log.events[log.next] = event;
+    log.next = (log.next + 1) % TRACE_MAX_EVENTS;
+    ++log.dropped;
+}
+
+void appendJsonString(std::string &out, const char *text) {
+    out += '"';
+    for (const char *p = text; *p; ++p) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+void startTrace() {
+    {
+        TraceLog &log = traceLog();
+        std::lock_guard<std::mutex> lock(log.mutex);
+        log.events.clear();
+        log.next = 0;
+        log.dropped = 0;
+    }
+    traceEpoch.store(steadyNanoseconds(), std::memory_order_relaxed);
+    traceRecording.store(true, std::memory_order_relaxed);
+}
+
+void stopTrace() {
+    traceRecording.store(false, std::memory_order_relaxed);
+}
+
+uint64_t traceNow() {
+    int64_t elapsed = steadyNanoseconds() - traceEpoch.load(std::memory_order_relaxed);
+    return elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0;
+}
+
+void recordTraceSpan(const char *name, uint64_t start, uint64_t end) {
+    TraceEvent event;
+    event.name = name;
+    event.start = start;
+    event.duration = end > start ? end - start : 0;
+    record(event);
+}
+
+void recordTraceCount(const char *name, uint64_t value) {
+    TraceEvent event;
+    event.name = name;
+    event.start = traceNow();
+    event.value = value;
+    event.counter = true;
+    record(event);
+}
+
+std::vector<TraceEvent> traceEvents() {
+    TraceLog &log = traceLog();
+    std::lock_guard<std::mutex> lock(log.mutex);
+    std::vector<TraceEvent> events(log.events.begin() + static_cast<std::ptrdiff_t>(log.next), log.events.end());
+    events.insert(events.end(), log.events.begin(), log.events.begin() + static_cast<std::ptrdiff_t>(log.next));
+    return events;
+}
+
+uint64_t traceDropped() {
+    TraceLog &log = traceLog();
+    std::lock_guard<std::mutex> lock(log.mutex);
+    return log.dropped;
+}
+
+bool writeChromeTrace(const std::string &path, std::string *error) {
+    std::vector<TraceEvent> events = traceEvents();
+    // 计数器按时间顺序累加
+    std::stable_sort(events.begin(), events.end(),
+                     [](const TraceEvent &a, const TraceEvent &b) { return a.start < b.start; });
+    std::map<std::string, uint64_t> totals;
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    char number[96];
+    for (size_t i = 0; i < events.size(); ++i) {
+        const TraceEvent &event = events[i];
+        json += i == 0 ? "\n{\"name\":" : ",\n{\"name\":";
+        appendJsonString(json, event.name);
+        if (event.counter) {
+            uint64_t &total = totals[event.name];
+            total += event.value;
+            std::snprintf(number, sizeof(number), ",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%llu}}",
+                          event.thread, static_cast<double>(event.start) / 1000.0,
+                          static_cast<unsigned long long>(total));
+        } else {
+            std::snprintf(number, sizeof(number), ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                          event.thread, static_cast<double>(event.start) / 1000.0,
+                          static_cast<double>(event.duration) / 1000.0);
+        }
+        json += number;
+    }
+    json += "\n]}\n";
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return fail(error, "Unable to create trace file");
+    }
+    file.write(json.data(), static_cast<std::streamsize>(json.size()));
+    file.close();
+    return file ? true : fail(error, "Unable to write trace file");
+}
+
+std::string traceSummary() {
+    struct Stage {
+        uint64_t count = 0;
+        uint64_t total = 0;
+        uint64_t longest = 0;
+    };
+    std::map<std::string, Stage> stages;
+    std::map<std::string, Stage> counters;
+    for (const TraceEvent &event : traceEvents()) {
+        Stage &stage = (event.counter ? counters : stages)[event.name];
+        ++stage.count;
+        stage.total += event.counter ? event.value : event.duration;
+        stage.longest = std::max(stage.longest, event.duration);
+    }
+
+    std::vector<std::pair<std::string, Stage>> sorted(stages.begin(), stages.end());
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const std::pair<std::string, Stage> &a, const std::pair<std::string, Stage> &b) {
+                         return a.second.total > b.second.total;
+                     });
+    std::string text;
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-24s %8s %12s %12s %12s\n", "stage", "count", "total ms", "mean ms", "max ms");
+    text += line;
+    for (const auto &entry : sorted) {
+        const Stage &stage = entry.second;
+        std::snprintf(line, sizeof(line), "%-24s %8llu %12.3f %12.3f %12.3f\n", entry.first.c_str(),
+                      static_cast<unsigned long long>(stage.count), static_cast<double>(stage.total) / 1e6,
+                      static_cast<double>(stage.total) / 1e6 / static_cast<double>(stage.count),
+                      static_cast<double>(stage.longest) / 1e6);
+        text += line;
+    }
+    if (!counters.empty()) {
+        std::snprintf(line, sizeof(line), "%-24s %8s %12s\n", "counter", "count", "total");
+        text += line;
+        for (const auto &entry : counters) {
+            std::snprintf(line, sizeof(line), "%-24s %8llu %12llu\n", entry.first.c_str(),
+                          static_cast<unsigned long long>(entry.second.count),
+                          static_cast<unsigned long long>(entry.second.total));
+            text += line;
+        }
+    }
+    if (uint64_t dropped = traceDropped()) {
+        std::snprintf(line, sizeof(line), "(%llu earlier events dropped)\n", static_cast<unsigned long long>(dropped));
+        text += line;
+    }
+    return text;
+}
+
+} // namespace ld
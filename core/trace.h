@@ -0,0 +1,102 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// 热路径的阶段计时和计数。编译期等级由 CMake 的 LD_TRACE_LEVEL 设置：
+//   0  关闭，下面的宏展开为空语句，参数不求值，不产生任何代码
+//   1  各阶段（读、写、置乱、嵌入、提取、压缩、密钥派生等），每次操作只有几个事件（默认）
+//   2  另外记录并行分块、逐块加解密和逐个布局的探测等细粒度事件
+// 编进去的事件只在 startTrace() 之后记录，没有开始时每个作用域只读一次原子标志。
+// 最多保留 TRACE_MAX_EVENTS 个事件，超出后丢弃最早的，长时间记录（例如 GUI）内存不会一直增长。
+// 事件名必须是字符串字面量或生命周期不短于记录的字符串，记录时只保存指针
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef LD_TRACE_LEVEL
+#define LD_TRACE_LEVEL 1
+#endif
+
+namespace ld {
+
+constexpr size_t TRACE_MAX_EVENTS = size_t(1) << 18;
+
+struct TraceEvent {
+    const char *name = nullptr;
+    uint64_t start = 0;    // 相对 startTrace() 的纳秒
+    uint64_t duration = 0; // 计数器为 0
+    uint64_t value = 0;    // 计数器本次增加的数量
+    uint32_t thread = 0;   // 按线程第一次记录的顺序编号，从 1 开始
+    bool counter = false;
+};
+
+extern std::atomic<bool> traceRecording;
+
+inline bool traceActive() {
+    return traceRecording.load(std::memory_order_relaxed);
+}
+
+// 清空之前的记录并开始记录；stopTrace() 之后记录保留到下一次 startTrace()
+void startTrace();
+void stopTrace();
+
+uint64_t traceNow();
+void recordTraceSpan(const char *name, uint64_t start, uint64_t end);
+void recordTraceCount(const char *name, uint64_t value);
+
+// 保留的事件，按记录顺序
+std::vector<TraceEvent> traceEvents();
+// 缓冲满了以后丢弃的事件数
+uint64_t traceDropped();
+
+// Chrome 跟踪格式（chrome://tracing 或 Perfetto 可以打开）：阶段为 "X" 事件，计数器为累计值的 "C" 事件
+bool writeChromeTrace(const std::string &path, std::string *error = nullptr);
+
+// 按名字汇总的文本表格：阶段的次数、总耗时、平均和最长耗时，计数器的次数和总和（只含保留的事件）
+std::string traceSummary();
+
+// 作用域计时，构造时没有在记录就什么也不做
+class TraceScope {
+public:
+    explicit TraceScope(const char *name) : name(traceActive() ? name : nullptr), start(this->name ? traceNow() : 0) {}
+    ~TraceScope() {
+        if (name) {
+            recordTraceSpan(name, start, traceNow());
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name;
+    uint64_t start;
+};
+
+} // namespace ld
+
+#define LD_TRACE_JOIN2(a, b) a##b
+#define LD_TRACE_JOIN(a, b) LD_TRACE_JOIN2(a, b)
+
+#if LD_TRACE_LEVEL >= 1
+#define LD_TRACE_SCOPE(name) ::ld::TraceScope LD_TRACE_JOIN(ldTraceScope, __LINE__)(name)
+#define LD_TRACE_COUNT(name, value)                                                                                   \
+    do {                                                                                                              \
+        if (::ld::traceActive()) {                                                                                    \
+            ::ld::recordTraceCount(name, static_cast<uint64_t>(value));                                               \
+        }                                                                                                             \
+    } while (0)
+#else
+#define LD_TRACE_SCOPE(name) ((void)0)
+#define LD_TRACE_COUNT(name, value) ((void)0)
+#endif
+
+#if LD_TRACE_LEVEL >= 2
+#define LD_TRACE_DETAIL(name) LD_TRACE_SCOPE(name)
+#else
+#define LD_TRACE_DETAIL(name) ((void)0)
+#endif
+
+#endif // TRACE_H
@@ -1,190 +1,252 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "metrics.h"
+#include "payload.h"
+#include "trace.h"
 #include <QFileDialog>
+#include <QFutureWatcher>
 #include <QMessageBox>
+#include <QThreadPool>
+#include <QtConcurrent>
 #include <QDebug>
-#include <fstream>
-#include <vector>
 #include <algorithm>
-#include <random>
-#include <ctime>
+#include <cmath>
+
+namespace {
+
+// 后台任务的结果，在 GUI 线程中取出
+struct ImageResult {
+    std::shared_ptr<const ld::BmpImage> bmp;
+    std::shared_ptr<const ld::PreviewPyramid> preview;
+    QString error;
+    ld::QualityReport quality; // 嵌入时与原图比较
+};
+
+struct ExtractResult {
+    ld::ExtractStatus status = ld::ExtractStatus::NoPayload;
+    QString message;
+};
+
+} // namespace
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow) {
     ui->setupUi(this);
+    connect(this, &MainWindow::progressChanged, ui->progressBar, &QProgressBar::setValue);
+    setBusy(false);
+    // 阶段级事件每次操作只有几个，窗口打开期间一直记录，随时可以导出；只保留最近的 TRACE_MAX_EVENTS 个
+    ld::startTrace();
 }
 
 MainWindow::~MainWindow() {
+    // 工作线程会访问窗口的信号，先取消并等待它结束
+    if (progress) {
+        progress->cancel();
+    }
+    QThreadPool::globalInstance()->waitForDone();
     delete ui;
 }
 
-std::vector<int> MainWindow::generateRandomSequence(const std::string &key, int length) {
-    std::vector<int> sequence(length);
-    std::iota(sequence.begin(), sequence.end(), 0);
-
-    std::seed_seq seed(key.begin(), key.end());
-    std::mt19937 generator(seed);
-
-    std::shuffle(sequence.begin(), sequence.end(), generator);
-
-    return sequence;
-}
-
-void MainWindow::embedMessageWithKey(std::vector<uint8_t> &imageData, const std::string &message, const std::string &key) {
-    size_t max_length = calculateMaxEmbedLength(imageData);
-    std::vector<uint8_t> encodedMessage;
-
-    for (char c : message) {
-        encodedMessage.push_back(static_cast<uint8_t>(c));
-    }
-
-    auto sequence = generateRandomSequence(key, imageData.size());
-
-    size_t data_index = 0;
-    for (uint8_t byte : encodedMessage) {
-        if (data_index + 8 > sequence.size()) {
-            break;
+template <typename T>
+void MainWindow::runTask(const QString &title, std::function<T(ld::Progress &)> work, std::function<void(const T &)> done) {
+    // 百分比变化时才发信号，避免按块报告时把事件队列塞满
+    auto lastPercent = std::make_shared<int>(-1);
+    progress = std::make_shared<ld::Progress>([this, lastPercent](uint64_t finished, uint64_t total) {
+        int percent = total ? static_cast<int>(finished * 100 / total) : 100;
+        if (percent != *lastPercent) {
+            *lastPercent = percent;
+            emit progressChanged(percent);
         }
-        qDebug() << "Embedding byte:" << QString::number(byte, 2).rightJustified(8, '0');
-        for (int bit = 0; bit < 8; ++bit) {
-            int index = sequence[data_index];
-            imageData[index] = (imageData[index] & 0xFE) | ((byte >> bit) & 1);
-            ++data_index;
-        }
-    }
-
-    if (data_index + 8 <= sequence.size()) {
-        for (int bit = 0; bit < 8; ++bit) {
-            int index = sequence[data_index];
-            imageData[index] = (imageData[index] & 0xFE) | ((END_MARKER >> bit) & 1);
-            ++data_index;
+    });
+    setBusy(true, title);
+
+    auto *watcher = new QFutureWatcher<T>(this);
+    connect(watcher, &QFutureWatcher<T>::finished, this, [this, watcher, done] {
+        T result = watcher->result();
+        watcher->deleteLater();
+        bool cancelled = progress->isCancelled();
+        progress.reset();
+        setBusy(false);
+        if (cancelled) {
+            qDebug() << "Task cancelled";
+            return;
         }
-    }
+        done(result);
+    });
+    std::shared_ptr<ld::Progress> taskProgress = progress;
+    watcher->setFuture(QtConcurrent::run([work, taskProgress] { return work(*taskProgress); }));
 }
 
-std::string MainWindow::extractMessageWithKey(const std::vector<uint8_t> &imageData, const std::string &key) {
-    std::string message;
-    auto sequence = generateRandomSequence(key, imageData.size());
-
-    size_t data_index = 0;
-    while (data_index + 8 <= sequence.size()) {
-        uint8_t byte = 0;
-        for (int bit = 0; bit < 8; ++bit) {
-            int index = sequence[data_index];
-            byte |= (imageData[index] & 1) << bit;
-            ++data_index;
-        }
-
-        if (byte == END_MARKER) {
-            break;
-        }
-
-        message.push_back(byte);
-    }
-
-    return message;
+void MainWindow::setBusy(bool busy, const QString &title) {
+    ui->readImageButton->setEnabled(!busy);
+    ui->embedButton->setEnabled(!busy);
+    ui->saveImageButton->setEnabled(!busy);
+    ui->extractButton->setEnabled(!busy);
+    ui->clearButton->setEnabled(!busy);
+    ui->cancelButton->setEnabled(busy);
+    ui->progressBar->setValue(0);
+    ui->progressBar->setFormat(busy ? title + " %p%" : QString());
+    ui->progressBar->setVisible(busy);
 }
 
-
 void MainWindow::on_readImageButton_clicked() {
     QString filePath = QFileDialog::getOpenFileName(this, tr("Open Image"), "", tr("Image Files (*.bmp)"));
-    if (!filePath.isEmpty()) {
-        qDebug() << "Selected file path:" << filePath;
-        if (readBMP(filePath)) {
-            currentFilePath = filePath;
-            size_t maxLength = calculateMaxEmbedLength(imageData);
-            ui->maxLengthLabel->setText("最大可嵌入信息长度: " + QString::number(maxLength) + " 字节");
-
-            if (bitCount == 24) {
-                originalImage = QImage(imageData.data(), width, height, QImage::Format_RGB888);
-            } else if (bitCount == 8) {
-                originalImage = QImage(imageData.data(), width, height, QImage::Format_Indexed8);
-                QVector<QRgb> colorTable;
-                for (int i = 0; i < 256; ++i) {
-                    colorTable.append(qRgb(i, i, i));
-                }
-                originalImage.setColorTable(colorTable);
-            }
-            displayImage(ui->originalImageLabel, originalImage);
-            displayImageInfo();
-        } else {
+    if (filePath.isEmpty()) {
+        return;
+    }
+    qDebug() << "Selected file path:" << filePath;
+
+    std::string path = filePath.toStdString();
+    runTask<ImageResult>(tr("读取图片"), [path](ld::Progress &progress) {
+        ImageResult result;
+        std::string error;
+        auto loaded = std::make_shared<ld::BmpImage>();
+        if (!ld::readBMP(path, *loaded, &error, &progress)) {
+            result.error = QString::fromStdString(error);
+            return result;
+        }
+        auto preview = std::make_shared<ld::PreviewPyramid>();
+        preview->build(*loaded, loaded->view());
+        result.preview = std::move(preview);
+        result.bmp = std::move(loaded);
+        return result;
+    }, [this, filePath](const ImageResult &result) {
+        if (!result.bmp) {
+            qDebug() << "Error:" << result.error;
             QMessageBox::warning(this, tr("Warning"), tr("Failed to read the image."));
+            return;
         }
-    }
+        original = result.bmp;
+        modified.reset();
+        originalPreview = result.preview;
+        modifiedPreview.reset();
+        currentFilePath = filePath;
+        qDebug() << "Width:" << original->width << "Height:" << original->height << "BitCount:" << original->bitCount << "DataOffset:" << original->dataOffset;
+
+        size_t maxLength = ld::payloadCapacity(original->view());
+        ui->maxLengthLabel->setText("最大可嵌入信息长度: " + QString::number(maxLength) + " 字节");
+        displayImage(ui->originalImageLabel, *originalPreview);
+        ui->modifiedImageLabel->clear();
+        ui->modifiedImageLabel->setText("嵌入信息后的图片");
+        ui->qualityLabel->setText("失真：PSNR，SSIM");
+        ui->qualityLabel->setToolTip(QString());
+        displayImageInfo();
+    });
 }
 
 void MainWindow::on_embedButton_clicked() {
-    if (imageData.empty()) {
+    if (!original) {
         QMessageBox::warning(this, tr("Warning"), tr("Please load an image first."));
         return;
     }
 
-    QString message = ui->messageTextEdit->toPlainText();
-    size_t maxLength = calculateMaxEmbedLength(imageData);
-    if (message.length() > maxLength) {
-        QMessageBox::warning(this, tr("Warning"), tr("Message too long to embed."));
-        return;
-    }
-
+    QString key;
     if (ui->useEncryptionCheckBox->isChecked()) {
-        QString key = ui->encryptionKeyLineEdit->text();
+        key = ui->encryptionKeyLineEdit->text();
         if (key.isEmpty()) {
             QMessageBox::warning(this, tr("Warning"), tr("Please enter an encryption key."));
             return;
         }
-        embedMessageWithKey(imageData, message.toStdString(), key.toStdString());
-    } else {
-        embedMessage(imageData, message.toStdString());
     }
 
-    // 图片用QImage展示，仅展示没有用QImage类的方法处理图像
-    if (bitCount == 24) {
-        modifiedImage = QImage(imageData.data(), width, height, QImage::Format_RGB888);
-    } else if (bitCount == 8) {
-        modifiedImage = QImage(imageData.data(), width, height, QImage::Format_Indexed8);
-        QVector<QRgb> colorTable;
-        for (int i = 0; i < 256; ++i) {
-            colorTable.append(qRgb(i, i, i));
-        }
-        modifiedImage.setColorTable(colorTable);
+    // 按压缩、加密后实际存放的大小判断能否嵌入
+    std::string message = ui->messageTextEdit->toPlainText().toStdString();
+    bool compress = ui->compressCheckBox->isChecked();
+    size_t maxLength = ld::payloadCapacity(original->view());
+    if (ld::storedPayloadSize(ld::asBytes(message), compress, !key.isEmpty()) > maxLength) {
+        QMessageBox::warning(this, tr("Warning"), tr("Message too long to embed."));
+        return;
     }
-    displayImage(ui->modifiedImageLabel, modifiedImage);
+
+    // 每次都从原图复制一份再嵌入，完成后替换 modified；预览从原图的金字塔复制，只刷新像素有变化的块
+    std::shared_ptr<const ld::BmpImage> source = original;
+    std::shared_ptr<const ld::PreviewPyramid> sourcePreview = originalPreview;
+    std::string keyString = key.toStdString();
+    runTask<ImageResult>(tr("嵌入"), [source, sourcePreview, message, keyString, compress](ld::Progress &progress) {
+        ImageResult result;
+        auto carrier = std::make_shared<ld::BmpImage>(*source);
+        std::string error;
+        if (!ld::embedPayload(carrier->view(), ld::asBytes(message), keyString, &progress, ld::EmbedLayout(),
+                              compress, &error)) {
+            result.error = QString::fromStdString(error);
+            return result;
+        }
+        ld::measureQuality(source->view(), carrier->view(), result.quality);
+        auto preview = std::make_shared<ld::PreviewPyramid>(*sourcePreview);
+        preview->update(source->view(), carrier->view());
+        result.preview = std::move(preview);
+        result.bmp = std::move(carrier);
+        return result;
+    }, [this, message](const ImageResult &result) {
+        if (!result.bmp) {
+            qDebug() << "Error:" << result.error;
+            QMessageBox::warning(this, tr("Warning"), tr("Failed to embed the message: %1").arg(result.error));
+            return;
+        }
+        qDebug() << "Embedded message bytes:" << message.size();
+        modified = result.bmp;
+        modifiedPreview = result.preview;
+        displayImage(ui->modifiedImageLabel, *modifiedPreview);
+        displayQuality(result.quality);
+    });
 }
 
 void MainWindow::on_saveImageButton_clicked() {
-    if (imageData.empty()) {
+    std::shared_ptr<const ld::BmpImage> source = modified ? modified : original;
+    if (!source) {
         QMessageBox::warning(this, tr("Warning"), tr("No modified image to save."));
         return;
     }
 
     QString filePath = QFileDialog::getSaveFileName(this, tr("Save Image"), "", tr("Image Files (*.bmp)"));
-    if (!filePath.isEmpty()) {
-        if (!writeBMP(filePath, imageData)) {
+    if (filePath.isEmpty()) {
+        return;
+    }
+    std::string path = filePath.toStdString();
+    runTask<QString>(tr("存储图片"), [source, path](ld::Progress &progress) {
+        std::string error;
+        return ld::writeBMP(path, *source, &error, &progress) ? QString() : QString::fromStdString(error);
+    }, [this](const QString &error) {
+        if (!error.isEmpty()) {
+            qDebug() << "Error:" << error;
             QMessageBox::warning(this, tr("Warning"), tr("Failed to save the image."));
         }
-    }
+    });
 }
 
 void MainWindow::on_extractButton_clicked() {
-    if (imageData.empty()) {
+    std::shared_ptr<const ld::BmpImage> source = modified ? modified : original;
+    if (!source) {
         QMessageBox::warning(this, tr("Warning"), tr("Please load an image first."));
         return;
     }
 
-    std::string message;
+    QString key;
     if (ui->useEncryptionCheckBox->isChecked()) {
-        QString key = ui->encryptionKeyLineEdit->text();
+        key = ui->encryptionKeyLineEdit->text();
         if (key.isEmpty()) {
             QMessageBox::warning(this, tr("Warning"), tr("Please enter an encryption key."));
             return;
         }
-        message = extractMessageWithKey(imageData, key.toStdString());
-    } else {
-        message = extractMessage(imageData);
     }
 
-    ui->extractedMessageTextEdit->setPlainText(QString::fromStdString(message));
+    // 没有容器头部的旧图像仍按 0xFF 终止格式提取
+    std::string keyString = key.toStdString();
+    runTask<ExtractResult>(tr("提取"), [source, keyString](ld::Progress &progress) {
+        ExtractResult result;
+        std::string message;
+        result.status = ld::extractPayload(source->view(), message, keyString, true, &progress);
+        result.message = QString::fromStdString(message);
+        return result;
+    }, [this](const ExtractResult &result) {
+        qDebug() << "Extract status:" << ld::extractStatusName(result.status) << "bytes:" << result.message.size();
+        if (result.status != ld::ExtractStatus::Ok && result.status != ld::ExtractStatus::Legacy) {
+            QMessageBox::warning(this, tr("Warning"), tr("Failed to extract message: %1").arg(ld::extractStatusName(result.status)));
+            return;
+        }
+        ui->extractedMessageTextEdit->setPlainText(result.message);
+    });
 }
 
 void MainWindow::on_clearButton_clicked() {
@@ -193,6 +255,8 @@ void MainWindow::on_clearButton_clicked() {
     ui->modifiedImageLabel->setText("嵌入信息后的图片");
     ui->originalImageLabel->setText("原始图片");
     ui->imageInfoLabel->setText("图片信息：宽度，高度，类型");
+    ui->qualityLabel->setText("失真：PSNR，SSIM");
+    ui->qualityLabel->setToolTip(QString());
     ui->maxLengthLabel->setText("最大可嵌入信息长度：");
 
     ui->messageTextEdit->clear();
@@ -200,218 +264,65 @@ void MainWindow::on_clearButton_clicked() {
     ui->encryptionKeyLineEdit->clear();
 }
 
-size_t MainWindow::calculateMaxEmbedLength(const std::vector<uint8_t> &imageData) {
-    return imageData.size() / 8;
-}
-
-void MainWindow::embedMessage(std::vector<uint8_t> &imageData, const std::string &message) {
-    size_t max_length = calculateMaxEmbedLength(imageData);
-    std::vector<uint8_t> encodedMessage;
-
-    for (char c : message) {
-        encodedMessage.push_back(static_cast<uint8_t>(c));
-    }
-
-    size_t data_index = 0;
-    for (uint8_t byte : encodedMessage) {
-        if (data_index + 8 > imageData.size()) {
-            break;
-        }
-        qDebug() << "Embedding byte:" << QString::number(byte, 2).rightJustified(8, '0');
-        for (int bit = 0; bit < 8; ++bit) {
-            //qDebug() << "Before: " << QString::number(imageData[data_index], 2).rightJustified(8, '0');
-            imageData[data_index] = (imageData[data_index] & 0xFE) | ((byte >> bit) & 1);
-            //qDebug() << "After: " << QString::number(imageData[data_index], 2).rightJustified(8, '0');
-            ++data_index;
-        }
-    }
-
-    // 判断是否有空间嵌入文件尾
-    if (data_index + 8 <= imageData.size()) {
-        qDebug() << "Embedding END_MARKER";
-        for (int bit = 0; bit < 8; ++bit) {
-            imageData[data_index] = (imageData[data_index] & 0xFE) | ((END_MARKER >> bit) & 1);
-            qDebug() << "Embedding END_MARKER byte: " << QString::number(imageData[data_index], 2).rightJustified(8, '0');
-            ++data_index;
-        }
-    } else {
-        qDebug() << "No space to embed END_MARKER.";
-    }
-
-    // 打印嵌入的信息及其二进制表示
-    qDebug() << "Embedded message:" << QString::fromStdString(message);
-    qDebug() << "Binary representation:";
-    for (uint8_t byte : encodedMessage) {
-        //qDebug() << QString::number(byte, 2).rightJustified(8, '0');
-    }
-}
-
-std::string MainWindow::extractMessage(const std::vector<uint8_t> &imageData) {
-    std::string message;
-    size_t data_index = 0;
-
-    while (data_index + 8 <= imageData.size()) {
-        uint8_t byte = 0;
-        for (int bit = 0; bit < 8; ++bit) {
-            byte |= (imageData[data_index] & 1) << bit;
-            ++data_index;
-        }
-
-        //qDebug() << "Extracted byte:" << QString::number(byte, 2).rightJustified(8, '0');
-
-        if (byte == END_MARKER) {
-            break;
-        }
-
-        message.push_back(byte);
-    }
-
-    // 打印提取的信息及其二进制表示
-    qDebug() << "Extracted message:" << QString::fromStdString(message);
-    qDebug() << "Binary representation:";
-    for (char c : message) {
-        //qDebug() << QString::number(static_cast<uint8_t>(c), 2).rightJustified(8, '0');
-    }
-
-    return message;
-}
-
-bool MainWindow::readBMP(const QString &filePath) {
-    qDebug() << "Attempting to open file: " << filePath;
-    std::ifstream file(filePath.toStdString(), std::ios::binary);
-    if (!file) {
-        qDebug() << "Error: Unable to open file " << filePath;
-        return false;
-    }
-
-    // BMP header
-    char header[14];
-    file.read(header, 14);
-    if (file.gcount() != 14) {
-        qDebug() << "Error: Unable to read BMP file header";
-        return false;
-    }
-
-    // DIB header
-    char dibHeader[40];
-    file.read(dibHeader, 40);
-    if (file.gcount() != 40) {
-        qDebug() << "Error: Unable to read BMP DIB header";
-        return false;
-    }
-
-    // 提取信息
-    width = *reinterpret_cast<int*>(&dibHeader[4]);
-    height = *reinterpret_cast<int*>(&dibHeader[8]);
-    bitCount = *reinterpret_cast<short*>(&dibHeader[14]);
-    dataOffset = *reinterpret_cast<int*>(&header[10]);
-
-    qDebug() << "Width:" << width << "Height:" << height << "BitCount:" << bitCount << "DataOffset:" << dataOffset;
-
-    // 检查BMP格式是否为24真彩或256灰度图
-    if (bitCount != 24 && bitCount != 8) {
-        qDebug() << "Error: Unsupported BMP format. Only 24-bit and 8-bit BMP files are supported.";
-        return false;
-    }
-
-    if (bitCount == 8) {
-        colorTable.resize(256 * 4);
-        file.read(reinterpret_cast<char*>(colorTable.data()), colorTable.size());
-    }
-
-    file.seekg(dataOffset, std::ios::beg);
-    imageData.resize(width * height * (bitCount / 8));
-    file.read(reinterpret_cast<char*>(imageData.data()), imageData.size());
-    if (file.gcount() != static_cast<std::streamsize>(imageData.size())) {
-        qDebug() << "Error: Unable to read BMP image data";
-        return false;
+void MainWindow::on_cancelButton_clicked() {
+    if (progress) {
+        progress->cancel();
+        ui->cancelButton->setEnabled(false);
     }
-
-    // BGR to RGB
-    if (bitCount == 24) {
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = (y * width + x) * 3;
-                std::swap(imageData[index], imageData[index + 2]); // BGR to RGB
-            }
-        }
-    }
-
-    return true;
 }
 
-bool MainWindow::writeBMP(const QString &filePath, const std::vector<uint8_t> &imageData) {
-    std::ofstream file(filePath.toStdString(), std::ios::binary);
-    if (!file) {
-        qDebug() << "Error: Unable to write file " << filePath;
-        return false;
-    }
-
-    char header[14] = {
-        'B', 'M', // Signature
-        0, 0, 0, 0, // File size
-        0, 0, 0, 0, // Reserved
-        static_cast<char>(dataOffset & 0xFF), static_cast<char>((dataOffset >> 8) & 0xFF),
-        static_cast<char>((dataOffset >> 16) & 0xFF), static_cast<char>((dataOffset >> 24) & 0xFF) // Data offset
-    };
-
-    uint32_t fileSize = static_cast<uint32_t>(dataOffset + imageData.size());
-    header[2] = static_cast<char>(fileSize & 0xFF);
-    header[3] = static_cast<char>((fileSize >> 8) & 0xFF);
-    header[4] = static_cast<char>((fileSize >> 16) & 0xFF);
-    header[5] = static_cast<char>((fileSize >> 24) & 0xFF);
-
-    file.write(header, sizeof(header));
-
-    char dibHeader[40] = {
-        40, 0, 0, 0, // Header size
-        static_cast<char>(width & 0xFF), static_cast<char>((width >> 8) & 0xFF),
-        static_cast<char>((width >> 16) & 0xFF), static_cast<char>((width >> 24) & 0xFF), // Width
-        static_cast<char>(height & 0xFF), static_cast<char>((height >> 8) & 0xFF),
-        static_cast<char>((height >> 16) & 0xFF), static_cast<char>((height >> 24) & 0xFF), // Height
-        1, 0, // Planes
-        static_cast<char>(bitCount & 0xFF), static_cast<char>((bitCount >> 8) & 0xFF), // Bit count
-        0, 0, 0, 0, // Compression
-        0, 0, 0, 0, // Image size
-        0, 0, 0, 0, // X pixels per meter
-        0, 0, 0, 0, // Y pixels per meter
-        0, 0, 0, 0, // Total colors
-        0, 0, 0, 0 // Important colors
-    };
-
-    file.write(dibHeader, sizeof(dibHeader));
-
-    // color table
-    if (bitCount == 8) {
-        file.write(reinterpret_cast<const char*>(colorTable.data()), colorTable.size());
+// 导出最近记录的各阶段（读、写、置乱、嵌入、提取等），汇总表同时显示出来
+void MainWindow::on_traceButton_clicked() {
+    QString filePath = QFileDialog::getSaveFileName(this, tr("Export Trace"), "", tr("Chrome Trace (*.json)"));
+    if (filePath.isEmpty()) {
+        return;
     }
-
-    // RGB to BGR
-    std::vector<uint8_t> convertedData = imageData;
-    if (bitCount == 24) {
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = (y * width + x) * 3;
-                std::swap(convertedData[index], convertedData[index + 2]);
-            }
-        }
+    std::string error;
+    if (!ld::writeChromeTrace(filePath.toStdString(), &error)) {
+        qDebug() << "Error:" << QString::fromStdString(error);
+        QMessageBox::warning(this, tr("Warning"), tr("Failed to export the trace."));
+        return;
     }
-
-    file.write(reinterpret_cast<const char*>(convertedData.data()), convertedData.size());
-    return true;
+    QMessageBox box(QMessageBox::Information, tr("Trace"), tr("Trace exported to %1").arg(filePath),
+                    QMessageBox::Ok, this);
+    box.setDetailedText(QString::fromStdString(ld::traceSummary()));
+    box.exec();
 }
 
-
-void MainWindow::displayImage(QLabel *label, const QImage &image) {
-    // 不知道为什么图像要翻转一下，不然显示的时候是上下颠倒的
-    QImage flippedImage = image.mirrored(false, true);
-    label->setPixmap(QPixmap::fromImage(flippedImage).scaled(label->size(), Qt::KeepAspectRatio));
+// 金字塔已经按显示方向排好行，这里直接包装像素、不复制；选出的一级不超过标签的两倍，缩放的开销与原图大小无关
+void MainWindow::displayImage(QLabel *label, const ld::PreviewPyramid &preview) {
+    QSize size = label->size();
+    const ld::PreviewLevel &level = preview.levelFor(static_cast<uint32_t>(std::max(size.width(), 0)),
+                                                     static_cast<uint32_t>(std::max(size.height(), 0)));
+    QImage image(reinterpret_cast<const uchar *>(level.pixels.data()), static_cast<int>(level.width),
+                 static_cast<int>(level.height), static_cast<int>(level.width * 4), QImage::Format_RGB32);
+    label->setPixmap(QPixmap::fromImage(image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation)));
 }
 
 void MainWindow::displayImageInfo() {
     QString imageInfo = QString("图片信息: 宽度: %1, 高度: %2, 类型: %3")
-                            .arg(width)
-                            .arg(height)
-                            .arg(bitCount == 24 ? "24位真彩图" : "256色度灰度图");
+                            .arg(original->width)
+                            .arg(original->height)
+                            .arg(original->bitCount == 24 ? "24位真彩图" : "256色度灰度图");
     ui->imageInfoLabel->setText(imageInfo);
 }
+
+void MainWindow::displayQuality(const ld::QualityReport &quality) {
+    QString psnr = std::isinf(quality.overall.psnr) ? QString("∞") : QString::number(quality.overall.psnr, 'f', 2);
+    ui->qualityLabel->setText(QString("失真: MSE %1, PSNR %2 dB, SSIM %3")
+                                  .arg(quality.overall.mse, 0, 'f', 4)
+                                  .arg(psnr)
+                                  .arg(quality.overall.ssim, 0, 'f', 5));
+    // 各通道的数值放在提示中
+    QStringList channels;
+    const char *names[] = {"R", "G", "B"};
+    for (int i = 0; i < quality.channels; ++i) {
+        channels << QString("%1: MSE %2, PSNR %3 dB, SSIM %4")
+                        .arg(quality.channels == 1 ? "灰度" : names[i])
+                        .arg(quality.channel[i].mse, 0, 'f', 4)
+                        .arg(quality.channel[i].psnr, 0, 'f', 2)
+                        .arg(quality.channel[i].ssim, 0, 'f', 5);
+    }
+    ui->qualityLabel->setToolTip(channels.join("\n"));
+    qDebug() << "PSNR:" << quality.overall.psnr << "SSIM:" << quality.overall.ssim;
+}
@@ -7,6 +7,11 @@
 #include <QImage>
 #include <QLabel>
 #include <QTextEdit>
+#include <functional>
+#include <memory>
+#include "bmp.h"
+#include "metrics.h"
+#include "preview.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -19,38 +24,39 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+signals:
+    // 由工作线程发出，排队连接到进度条
+    void progressChanged(int percent);
+
 private slots:
     void on_readImageButton_clicked();
     void on_embedButton_clicked();
     void on_saveImageButton_clicked();
     void on_extractButton_clicked();
     void on_clearButton_clicked();
+    void on_cancelButton_clicked();
+    void on_traceButton_clicked();
 
 private:
     Ui::MainWindow *ui;
     QString currentFilePath;
-    std::vector<uint8_t> imageData;
-    std::vector<uint8_t> colorTable;
-    int width;
-    int height;
-    int bitCount;
-    int dataOffset;
-    QImage originalImage;
-    QImage modifiedImage;
-
-    // Functions for BMP image processing
-    std::vector<int> generateRandomSequence(const std::string &key, int length);
-    std::string extractMessageWithKey(const std::vector<uint8_t> &imageData, const std::string &key);
-    void embedMessageWithKey(std::vector<uint8_t> &imageData, const std::string &message, const std::string &key);
-    void embedMessage(std::vector<uint8_t> &imageData, const std::string &message);
-    std::string extractMessage(const std::vector<uint8_t> &imageData);
-    size_t calculateMaxEmbedLength(const std::vector<uint8_t> &imageData);
-    bool readBMP(const QString &filePath);
-    bool writeBMP(const QString &filePath, const std::vector<uint8_t> &imageData);
-    void displayImage(QLabel *label, const QImage &image);
+    // 双缓冲：工作线程只读这两份像素，结果做好之后在 GUI 线程中整体替换指针，
+    // 取消或失败时旧的图像不受影响
+    std::shared_ptr<const ld::BmpImage> original;
+    std::shared_ptr<const ld::BmpImage> modified;
+    // 在工作线程中建好的预览金字塔，显示时只缩放最接近标签大小的一级
+    std::shared_ptr<const ld::PreviewPyramid> originalPreview;
+    std::shared_ptr<const ld::PreviewPyramid> modifiedPreview;
+    std::shared_ptr<ld::Progress> progress; // 当前后台任务，没有任务时为空
+
+    // 嵌入/提取和 BMP 读写都在 ldcore 中实现，在 QtConcurrent 的线程池中执行，
+    // done 在 GUI 线程中调用
+    template <typename T>
+    void runTask(const QString &title, std::function<T(ld::Progress &)> work, std::function<void(const T &)> done);
+    void setBusy(bool busy, const QString &title = QString());
+    void displayImage(QLabel *label, const ld::PreviewPyramid &preview);
     void displayImageInfo();
-
-    const uint8_t END_MARKER = 0xFF; // 定义终止符
+    void displayQuality(const ld::QualityReport &quality);
 };
 
 #endif // MAINWINDOW_H
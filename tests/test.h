@@ -0,0 +1,79 @@
+#ifndef LD_TEST_H
+#define LD_TEST_H
+
+// 最小的单元测试框架，不依赖外部库。每个测试程序是一个 .cpp，用 TEST 定义若干用例，
+// 这里的 main() 按定义顺序依次运行；CHECK 失败时打印位置并继续，有失败时返回 1。
+// 每个测试程序只能包含一次本文件（main() 定义在这里）
+
+#include "imageview.h"
+#include "ldspan.h"
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace ldtest {
+
+struct Case {
+    const char *name;
+    void (*run)();
+};
+
+inline std::vector<Case> &cases() {
+    static std::vector<Case> all;
+    return all;
+}
+
+inline int &failures() {
+    static int count = 0;
+    return count;
+}
+
+struct Register {
+    Register(const char *name, void (*run)()) { cases().push_back(Case{name, run}); }
+};
+
+inline void fail(const char *file, int line, const char *expression) {
+    std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expression);
+    ++failures();
+}
+
+// 确定的伪随机字节，作为载体或正文
+inline std::vector<uint8_t> randomBytes(size_t size, uint32_t seed) {
+    std::mt19937 generator(seed);
+    std::vector<uint8_t> bytes(size);
+    for (uint8_t &byte : bytes) {
+        byte = static_cast<uint8_t>(generator());
+    }
+    return bytes;
+}
+
+inline std::vector<uint8_t> bytesOf(const std::string &text) {
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+} // namespace ldtest
+
+#define TEST(name)                                                                                                    \
+    static void name();                                                                                               \
+    static ldtest::Register name##Register(#name, name);                                                              \
+    static void name()
+
+#define CHECK(condition)                                                                                              \
+    do {                                                                                                              \
+        if (!(condition)) {                                                                                           \
+            ldtest::fail(__FILE__, __LINE__, #condition);                                                             \
+        }                                                                                                             \
+    } while (0)
+
+int main() {
+    for (const ldtest::Case &test : ldtest::cases()) {
+        int before = ldtest::failures();
+        test.run();
+        std::printf("%s %s\n", ldtest::failures() == before ? "PASS" : "FAIL", test.name);
+    }
+    return ldtest::failures() == 0 ? 0 : 1;
+}
+
+#endif // LD_TEST_H
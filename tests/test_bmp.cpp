@@ -0,0 +1,142 @@
+// BMP 读写、内存映射（bmp.h）和流式嵌入（bmpstream.h）
+
+#include "bmp.h"
+#include "bmpstream.h"
+#include "payload.h"
+#include "test.h"
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int32_t WIDTH = 61; // 行需要填充
+constexpr int32_t HEIGHT = 40;
+
+ld::BmpImage makeImage(uint32_t seed) {
+    ld::BmpImage image;
+    image.width = WIDTH;
+    image.height = HEIGHT;
+    image.bitCount = 24;
+    image.stride = (image.rowBytes() + 3) & ~size_t(3);
+    image.pixels = ldtest::randomBytes(static_cast<size_t>(image.pixelBytes()), seed);
+    return image;
+}
+
+fs::path tempFile(const char *name) {
+    fs::path dir = fs::temp_directory_path() / "ld_test_bmp";
+    fs::create_directories(dir);
+    return dir / name;
+}
+
+} // namespace
+
+TEST(writeReadRoundtrip) {
+    fs::path path = tempFile("roundtrip.bmp");
+    ld::BmpImage image = makeImage(1);
+    CHECK(ld::writeBMP(path.string(), image));
+
+    ld::BmpImage loaded;
+    CHECK(ld::readBMP(path.string(), loaded));
+    CHECK(loaded.width == WIDTH && loaded.height == HEIGHT && loaded.bitCount == 24);
+    CHECK(loaded.pixels == image.pixels);
+    fs::remove(path);
+}
+
+TEST(saveAsOverMappedSource) {
+    fs::path path = tempFile("inplace.bmp");
+    ld::BmpImage image = makeImage(2);
+    CHECK(ld::writeBMP(path.string(), image));
+    uintmax_t size = fs::file_size(path);
+
+    std::vector<uint8_t> payload = ldtest::bytesOf("embedded in place");
+    {
+        ld::MappedBmp mapped;
+        std::string error;
+        CHECK(mapped.open(path.string(), ld::MappedFile::Mode::CopyOnWrite, &error));
+        CHECK(ld::embedPayload(mapped.view(), payload));
+        // 输出路径就是映射着的源文件
+        CHECK(mapped.saveAs(path.string(), &error));
+        CHECK(error.empty());
+    }
+    CHECK(fs::file_size(path) == size);
+    CHECK(!fs::exists(path.string() + ".ldtmp"));
+
+    ld::BmpImage loaded;
+    CHECK(ld::readBMP(path.string(), loaded));
+    CHECK(loaded.width == WIDTH && loaded.height == HEIGHT);
+    std::string extracted;
+    CHECK(ld::extractPayload(loaded.view(), extracted) == ld::ExtractStatus::Ok);
+    CHECK(extracted == "embedded in place");
+    fs::remove(path);
+}
+
+TEST(streamEmbedRejectsAliasedOutput) {
+    fs::path path = tempFile("alias.bmp");
+    ld::BmpImage image = makeImage(3);
+    CHECK(ld::writeBMP(path.string(), image));
+    fs::path link = tempFile("alias-link.bmp");
+    fs::remove(link);
+    std::error_code ec;
+    fs::create_hard_link(path, link, ec);
+
+    std::vector<uint8_t> payload = ldtest::bytesOf("alias");
+    fs::path dotted = path.parent_path() / "." / path.filename();
+    for (const fs::path &output : {dotted, link}) {
+        if (output == link && ec) {
+            continue; // 文件系统不支持硬链接
+        }
+        std::string error;
+        CHECK(!ld::streamEmbedPayload(path.string(), output.string(), payload, "", &error));
+        CHECK(error == "Input and output must be different files");
+    }
+    ld::BmpImage loaded;
+    CHECK(ld::readBMP(path.string(), loaded));
+    CHECK(loaded.pixels == image.pixels);
+
+    // 输出文件不存在时正常写出
+    fs::path output = tempFile("alias-out.bmp");
+    fs::remove(output);
+    CHECK(ld::streamEmbedPayload(path.string(), output.string(), payload));
+    std::string extracted;
+    CHECK(ld::streamExtractPayload(output.string(), extracted) == ld::ExtractStatus::Ok);
+    CHECK(extracted == "alias");
+    fs::remove(path);
+    fs::remove(link);
+    fs::remove(output);
+}
+
+TEST(dataOffsetBeyondFileIsRejected) {
+    fs::path path = tempFile("offset.bmp");
+    ld::BmpImage image = makeImage(4);
+    CHECK(ld::writeBMP(path.string(), image));
+    {
+        // 文件头中的像素偏移改成接近 4 GiB
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        const char offset[4] = {'\xF0', '\xFF', '\xFF', '\xFF'};
+        file.seekp(10);
+        file.write(offset, sizeof(offset));
+    }
+    ld::BmpImage loaded;
+    std::string error;
+    CHECK(!ld::readBMP(path.string(), loaded, &error));
+    CHECK(error == "Invalid BMP data offset");
+    CHECK(loaded.header.empty());
+    ld::BmpInfo info;
+    CHECK(!ld::readBmpInfo(path.string(), info, &error));
+    ld::MappedBmp mapped;
+    CHECK(!mapped.open(path.string(), ld::MappedFile::Mode::ReadOnly, &error));
+    CHECK(error == "Invalid BMP data offset");
+    std::string extracted;
+    CHECK(ld::streamExtractPayload(path.string(), extracted, "", &error) != ld::ExtractStatus::Ok);
+    CHECK(error == "Invalid BMP data offset");
+
+    // 像素数组被截断
+    CHECK(ld::writeBMP(path.string(), image));
+    fs::resize_file(path, fs::file_size(path) - 1);
+    CHECK(!ld::readBMP(path.string(), loaded, &error));
+    CHECK(error == "Unable to read BMP image data");
+    CHECK(!mapped.open(path.string(), ld::MappedFile::Mode::ReadOnly, &error));
+    fs::remove(path);
+}
@@ -0,0 +1,164 @@
+// 载荷压缩（compress.h）。截断和损坏的输入都放在大小正好的缓冲区里，
+// 在 AddressSanitizer 构建中越界读会直接报错
+
+#include "bitplane.h"
+#include "compress.h"
+#include "crc32c.h"
+#include "payload.h"
+#include "test.h"
+#include <algorithm>
+
+namespace {
+
+// 可以压缩的数据：重复的短语加上少量变化
+std::vector<uint8_t> textBytes(size_t size) {
+    const std::string phrase = "the quick brown fox jumps over the lazy dog ";
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = static_cast<uint8_t>(phrase[i % phrase.size()] + (i % 997 == 0 ? 1 : 0));
+    }
+    return bytes;
+}
+
+bool roundtrips(const std::vector<uint8_t> &data) {
+    std::vector<uint8_t> stored = ld::compressPayload(data);
+    std::string out;
+    if (!ld::decompressPayload(stored, out) || out != std::string(data.begin(), data.end())) {
+        return false;
+    }
+    // 流式解压，输入在任意位置断开
+    ld::StreamDecompressor decompressor;
+    std::vector<uint8_t> streamed;
+    for (size_t pos = 0; pos < stored.size(); pos += 1237) {
+        size_t count = std::min<size_t>(1237, stored.size() - pos);
+        if (!decompressor.update(stored.data() + pos, count, streamed)) {
+            return false;
+        }
+    }
+    return decompressor.finish() && streamed == data;
+}
+
+// 解出的内容必须是原文的前若干整块
+bool isWholeBlockPrefix(const std::string &out, const std::vector<uint8_t> &data) {
+    return out.size() % ld::COMPRESS_BLOCK == 0 && out.size() <= data.size() &&
+           std::equal(out.begin(), out.end(), data.begin());
+}
+
+} // namespace
+
+TEST(emptyInput) {
+    std::vector<uint8_t> stored = ld::compressPayload(ld::ConstByteSpan());
+    CHECK(stored.empty());
+    std::string out = "stale";
+    CHECK(ld::decompressPayload(stored, out));
+    CHECK(out.empty());
+    CHECK(roundtrips(std::vector<uint8_t>()));
+
+    ld::StreamCompressor compressor;
+    std::vector<uint8_t> streamed;
+    compressor.finish(streamed);
+    CHECK(streamed.empty());
+}
+
+TEST(incompressibleInputIsStored) {
+    std::vector<uint8_t> data = ldtest::randomBytes(ld::COMPRESS_BLOCK + 1000, 1);
+    std::vector<uint8_t> stored = ld::compressPayload(data);
+    // 每块原样存放，只多 4 字节的块头
+    CHECK(stored.size() == data.size() + 2 * 4);
+    CHECK(roundtrips(data));
+    CHECK(roundtrips(ldtest::randomBytes(1, 2)));
+}
+
+TEST(multiBlockInput) {
+    std::vector<uint8_t> data = textBytes(3 * ld::COMPRESS_BLOCK + 12345);
+    std::vector<uint8_t> stored = ld::compressPayload(data);
+    CHECK(stored.size() < data.size() / 4);
+    CHECK(roundtrips(data));
+    // 正好落在块边界上
+    CHECK(roundtrips(textBytes(2 * ld::COMPRESS_BLOCK)));
+
+    // 边读边压缩的结果与整段压缩相同
+    ld::StreamCompressor compressor;
+    std::vector<uint8_t> streamed;
+    for (size_t pos = 0; pos < data.size(); pos += 10000) {
+        compressor.update(data.data() + pos, std::min<size_t>(10000, data.size() - pos), streamed);
+    }
+    compressor.finish(streamed);
+    CHECK(streamed == stored);
+}
+
+TEST(truncatedStreamsFail) {
+    std::vector<uint8_t> data = textBytes(2 * ld::COMPRESS_BLOCK + 500);
+    data.insert(data.end(), 3000, 0); // 最后一块有长匹配
+    std::vector<uint8_t> stored = ld::compressPayload(data);
+    for (size_t size = 1; size < stored.size(); size += (size < 64 ? 1 : 97)) {
+        std::vector<uint8_t> truncated(stored.begin(), stored.begin() + size);
+        std::string out;
+        if (ld::decompressPayload(truncated, out)) {
+            CHECK(isWholeBlockPrefix(out, data));
+        }
+        ld::StreamDecompressor decompressor;
+        std::vector<uint8_t> streamed;
+        if (decompressor.update(truncated.data(), truncated.size(), streamed) && decompressor.finish()) {
+            CHECK(isWholeBlockPrefix(std::string(streamed.begin(), streamed.end()), data));
+        }
+    }
+}
+
+TEST(corruptedStreamsFail) {
+    std::vector<uint8_t> data = textBytes(ld::COMPRESS_BLOCK + 4000);
+    std::vector<uint8_t> stored = ld::compressPayload(data);
+    std::vector<uint8_t> noise = ldtest::randomBytes(4096, 3);
+    for (size_t i = 0; i + 1 < noise.size(); i += 2) {
+        std::vector<uint8_t> corrupted = stored;
+        corrupted[(noise[i] << 8 | noise[i + 1]) % corrupted.size()] ^= static_cast<uint8_t>(noise[i] | 1);
+        std::string out;
+        // 改动可能落在字面量上、仍然能解开，但输出不会超过块数决定的上限
+        if (ld::decompressPayload(corrupted, out)) {
+            CHECK(out.size() <= 2 * ld::COMPRESS_BLOCK);
+        }
+    }
+
+    // 匹配偏移指向块开头之前
+    const uint8_t badOffset[] = {7, 0, 0, 0, 0x10, 'a', 0x05, 0x00, 0x10, 'b', 'c'};
+    std::string out;
+    CHECK(!ld::decompressPayload(ld::ConstByteSpan(badOffset, sizeof(badOffset)), out));
+    // 块头声明的长度超过剩余数据
+    const uint8_t badSize[] = {0x20, 0, 0, 0x80, 'x', 'y'};
+    CHECK(!ld::decompressPayload(ld::ConstByteSpan(badSize, sizeof(badSize)), out));
+    ld::StreamDecompressor decompressor;
+    std::vector<uint8_t> streamed;
+    CHECK(!decompressor.update(badOffset, sizeof(badOffset), streamed));
+    CHECK(!decompressor.finish());
+}
+
+TEST(containerReportsBadCompression) {
+    // CRC 覆盖的是压缩后的数据，校验通过但解不开时报告 BadCompression
+    std::vector<uint8_t> body = ld::compressPayload(textBytes(5000));
+    body[body.size() - 3] ^= 0xFF;
+    body.resize(body.size() - 1);
+    ld::PayloadHeader header;
+    header.flags = ld::PAYLOAD_FLAG_COMPRESSED;
+    header.length = body.size();
+    header.crc = ld::crc32c(body);
+    uint8_t encoded[ld::PAYLOAD_HEADER_SIZE];
+    ld::encodePayloadHeader(header, encoded);
+
+    std::vector<uint8_t> carrier = ldtest::randomBytes(64 * 1024, 4);
+    ld::embedBits(carrier.data(), encoded, 0, ld::PAYLOAD_HEADER_SIZE * 8);
+    ld::embedBits(carrier.data() + ld::PAYLOAD_HEADER_SIZE * 8, body.data(), 0, body.size() * 8);
+    std::string payload;
+    CHECK(ld::extractPayload(ld::ConstByteSpan(carrier.data(), carrier.size()), payload) ==
+          ld::ExtractStatus::BadCompression);
+
+    // 同一个载体，压缩数据完好时正常解出
+    body = ld::compressPayload(textBytes(5000));
+    header.length = body.size();
+    header.crc = ld::crc32c(body);
+    ld::encodePayloadHeader(header, encoded);
+    ld::embedBits(carrier.data(), encoded, 0, ld::PAYLOAD_HEADER_SIZE * 8);
+    ld::embedBits(carrier.data() + ld::PAYLOAD_HEADER_SIZE * 8, body.data(), 0, body.size() * 8);
+    CHECK(ld::extractPayload(ld::ConstByteSpan(carrier.data(), carrier.size()), payload) == ld::ExtractStatus::Ok);
+    std::vector<uint8_t> expected = textBytes(5000);
+    CHECK(payload == std::string(expected.begin(), expected.end()));
+}
@@ -0,0 +1,209 @@
+// ChaCha20-Poly1305（chacha20.h）、SHA-256 和 PBKDF2（sha256.h）的已知答案测试。
+// ChaCha20 按 activeSimdLevel() 选择内核，每个用例在 CPU 支持的各个等级下都运行一遍
+
+#include "chacha20.h"
+#include "payload.h"
+#include "sha256.h"
+#include "simd.h"
+#include "test.h"
+#include <algorithm>
+
+namespace {
+
+std::vector<uint8_t> fromHex(const char *hex) {
+    std::vector<uint8_t> bytes;
+    for (const char *p = hex; p[0] && p[1]; p += 2) {
+        auto digit = [](char c) { return c <= '9' ? c - '0' : c - 'a' + 10; };
+        bytes.push_back(static_cast<uint8_t>(digit(p[0]) << 4 | digit(p[1])));
+    }
+    return bytes;
+}
+
+std::vector<uint8_t> sequence(uint8_t first, size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = static_cast<uint8_t>(first + i);
+    }
+    return bytes;
+}
+
+const ld::SimdLevel LEVELS[] = {ld::SimdLevel::Scalar, ld::SimdLevel::SSE2, ld::SimdLevel::AVX2};
+
+// 超过 CPU 支持的等级会被降级，重复的等级跳过
+template <typename Body>
+void forEachSimdLevel(Body body) {
+    ld::SimdLevel detected = ld::detectSimdLevel();
+    for (ld::SimdLevel level : LEVELS) {
+        if (level > detected) {
+            break;
+        }
+        ld::setSimdLevel(level);
+        body(level);
+    }
+    ld::setSimdLevel(detected);
+}
+
+// RFC 8439 第 2.4.2 和 2.8.2 节共用的明文，114 字节
+const std::string SUNSCREEN = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the "
+                              "future, sunscreen would be it.";
+
+} // namespace
+
+TEST(chacha20Rfc8439) {
+    // RFC 8439 第 2.4.2 节
+    std::vector<uint8_t> key = sequence(0, 32);
+    std::vector<uint8_t> nonce = fromHex("000000000000004a00000000");
+    std::vector<uint8_t> expected = fromHex(
+        "6e2e359a2568f98041ba0728dd0d6981e97e7aec1d4360c20a27afccfd9fae0b"
+        "f91b65c5524733ab8f593dabcd62b3571639d624e65152ab8f530c359f0861d8"
+        "07ca0dbf500d6a6156a38e088a22b65e52bc514d16ccf806818ce91ab7793736"
+        "5af90bbf74a35be6b40b8eedf2785e42874d");
+    forEachSimdLevel([&](ld::SimdLevel) {
+        std::vector<uint8_t> data = ldtest::bytesOf(SUNSCREEN);
+        ld::ChaCha20(key.data(), nonce.data(), 1).apply(data.data(), data.size());
+        CHECK(data == expected);
+
+        // 分段处理与一次处理相同
+        data = ldtest::bytesOf(SUNSCREEN);
+        ld::ChaCha20 split(key.data(), nonce.data(), 1);
+        split.apply(data.data(), 7);
+        split.apply(data.data() + 7, 64);
+        split.apply(data.data() + 71, data.size() - 71);
+        CHECK(data == expected);
+    });
+}
+
+TEST(chacha20LevelsAgree) {
+    // 上面的向量不到两块，走不到 SSE2/AVX2 的多块内核；长数据各等级结果应与标量相同
+    std::vector<uint8_t> key = ldtest::randomBytes(32, 1);
+    std::vector<uint8_t> nonce = ldtest::randomBytes(12, 2);
+    std::vector<uint8_t> reference;
+    forEachSimdLevel([&](ld::SimdLevel level) {
+        std::vector<uint8_t> data(64 * 37 + 5, 0);
+        ld::ChaCha20(key.data(), nonce.data(), 7).apply(data.data(), data.size());
+        if (level == ld::SimdLevel::Scalar) {
+            reference = data;
+        }
+        CHECK(data == reference);
+    });
+}
+
+TEST(chacha20Poly1305Rfc8439) {
+    // RFC 8439 第 2.8.2 节
+    std::vector<uint8_t> key = sequence(0x80, 32);
+    std::vector<uint8_t> nonce = fromHex("070000004041424344454647");
+    std::vector<uint8_t> aad = fromHex("50515253c0c1c2c3c4c5c6c7");
+    std::vector<uint8_t> expected = fromHex(
+        "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+        "3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+        "92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+        "3ff4def08e4b7a9de576d26586cec64b6116");
+    std::vector<uint8_t> expectedTag = fromHex("1ae10b594f09e26a7e902ecbd0600691");
+    forEachSimdLevel([&](ld::SimdLevel) {
+        std::vector<uint8_t> data = ldtest::bytesOf(SUNSCREEN);
+        ld::ChaCha20Poly1305 sealer(key.data(), nonce.data(), aad);
+        sealer.encrypt(data.data(), data.size());
+        uint8_t tag[ld::POLY1305_TAG_SIZE];
+        sealer.finish(tag);
+        CHECK(data == expected);
+        CHECK(std::vector<uint8_t>(tag, tag + sizeof(tag)) == expectedTag);
+
+        ld::ChaCha20Poly1305 opener(key.data(), nonce.data(), aad);
+        opener.decrypt(data.data(), data.size());
+        CHECK(opener.verify(expectedTag.data()));
+        CHECK(data == ldtest::bytesOf(SUNSCREEN));
+    });
+}
+
+TEST(tamperingFailsAuthentication) {
+    std::vector<uint8_t> key = sequence(0x80, 32);
+    std::vector<uint8_t> nonce = fromHex("070000004041424344454647");
+    std::vector<uint8_t> aad = fromHex("50515253c0c1c2c3c4c5c6c7");
+    std::vector<uint8_t> sealed = ldtest::bytesOf(SUNSCREEN);
+    uint8_t tag[ld::POLY1305_TAG_SIZE];
+    {
+        ld::ChaCha20Poly1305 sealer(key.data(), nonce.data(), aad);
+        sealer.encrypt(sealed.data(), sealed.size());
+        sealer.finish(tag);
+    }
+    forEachSimdLevel([&](ld::SimdLevel) {
+        for (size_t bit : {size_t(0), size_t(8 * 57 + 3), sealed.size() * 8 - 1}) {
+            std::vector<uint8_t> data = sealed;
+            data[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+            ld::ChaCha20Poly1305 opener(key.data(), nonce.data(), aad);
+            opener.decrypt(data.data(), data.size());
+            CHECK(!opener.verify(tag));
+        }
+        for (size_t byte : {size_t(0), sizeof(tag) - 1}) {
+            uint8_t forged[ld::POLY1305_TAG_SIZE];
+            std::copy(tag, tag + sizeof(tag), forged);
+            forged[byte] ^= 0x80;
+            std::vector<uint8_t> data = sealed;
+            ld::ChaCha20Poly1305 opener(key.data(), nonce.data(), aad);
+            opener.decrypt(data.data(), data.size());
+            CHECK(!opener.verify(forged));
+        }
+        std::vector<uint8_t> otherAad = aad;
+        otherAad[0] ^= 1;
+        std::vector<uint8_t> data = sealed;
+        ld::ChaCha20Poly1305 opener(key.data(), nonce.data(), otherAad);
+        opener.decrypt(data.data(), data.size());
+        CHECK(!opener.verify(tag));
+    });
+}
+
+TEST(sealedPayloadTampering) {
+    const uint8_t header[ld::PAYLOAD_PROBE_SIZE] = {'L', 'D', ld::PAYLOAD_VERSION_PHILOX, ld::PAYLOAD_FLAG_ENCRYPTED};
+    std::vector<uint8_t> body = ldtest::randomBytes(300, 3);
+    std::vector<uint8_t> sealed = ld::sealPayload(body, "secret", header);
+    CHECK(sealed.size() == body.size() + ld::PAYLOAD_CIPHER_OVERHEAD);
+
+    std::string opened(sealed.begin(), sealed.end());
+    CHECK(ld::openPayload(opened, "secret", header));
+    CHECK(opened == std::string(body.begin(), body.end()));
+
+    // 正文、标签中任意一位被改都无法通过认证；密钥或关联数据不同也一样
+    for (size_t bit : {ld::PAYLOAD_NONCE_SIZE * 8 + 5, sealed.size() * 8 - 1}) {
+        std::string tampered(sealed.begin(), sealed.end());
+        tampered[bit / 8] = static_cast<char>(tampered[bit / 8] ^ (1 << (bit % 8)));
+        CHECK(!ld::openPayload(tampered, "secret", header));
+    }
+    std::string copy(sealed.begin(), sealed.end());
+    CHECK(!ld::openPayload(copy, "wrong", header));
+    const uint8_t otherHeader[ld::PAYLOAD_PROBE_SIZE] = {'L', 'D', ld::PAYLOAD_VERSION_PHILOX, 0};
+    copy.assign(sealed.begin(), sealed.end());
+    CHECK(!ld::openPayload(copy, "secret", otherHeader));
+    std::string tooShort(ld::PAYLOAD_CIPHER_OVERHEAD - 1, '\0');
+    CHECK(!ld::openPayload(tooShort, "secret", header));
+}
+
+TEST(hmacSha256Rfc4231) {
+    // RFC 4231 测试用例 2
+    uint8_t mac[ld::SHA256_SIZE];
+    ld::hmacSha256(ldtest::bytesOf("Jefe"), ldtest::bytesOf("what do ya want for nothing?"), mac);
+    CHECK(std::vector<uint8_t>(mac, mac + sizeof(mac)) ==
+          fromHex("5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"));
+}
+
+TEST(pbkdf2Sha256KnownAnswers) {
+    struct Vector {
+        const char *password;
+        const char *salt;
+        uint32_t iterations;
+        const char *expected;
+    };
+    const Vector vectors[] = {
+        {"password", "salt", 1, "120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b"},
+        {"password", "salt", 4096, "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a"},
+        // 输出超过一个 SHA-256 块
+        {"passwordPASSWORDpassword", "saltSALTsaltSALTsaltSALTsaltSALTsalt", 4096,
+         "348c89dbcbd32b2f32d814b8116e84cf2b17347ebc1800181c4e2a1fb8dd53e1c635518c7dac47e9"},
+    };
+    for (const Vector &vector : vectors) {
+        std::vector<uint8_t> expected = fromHex(vector.expected);
+        std::vector<uint8_t> out(expected.size());
+        ld::pbkdf2Sha256(ldtest::bytesOf(vector.password), ldtest::bytesOf(vector.salt), vector.iterations,
+                         out.data(), out.size());
+        CHECK(out == expected);
+    }
+}
@@ -0,0 +1,152 @@
+// 矩阵嵌入（matrix.h）：Hamming 和校验子网格码的往返、修改次数和网格码内核
+
+#include "matrix.h"
+#include "simd.h"
+#include "test.h"
+
+namespace {
+
+constexpr size_t WIDTH = 256;
+constexpr uint64_t HEIGHT = 192;
+
+struct Image {
+    std::vector<uint8_t> pixels;
+    ld::ImageView view() { return ld::ImageView(pixels.data(), WIDTH, WIDTH, HEIGHT, false); }
+};
+
+Image makeImage(uint32_t seed) {
+    return Image{ldtest::randomBytes(WIDTH * HEIGHT, seed)};
+}
+
+uint64_t changedLsbs(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b, size_t first) {
+    uint64_t changed = 0;
+    for (size_t i = first; i < a.size(); ++i) {
+        changed += (a[i] ^ b[i]) & 1;
+    }
+    return changed;
+}
+
+std::vector<ld::MatrixParams> allParams() {
+    std::vector<ld::MatrixParams> params;
+    for (const char *text : {"hamming", "hamming:1", "hamming:3", "stc:3", "stc", "stc:10", "adaptive"}) {
+        ld::MatrixParams parsed;
+        CHECK(ld::MatrixParams::parse(text, parsed));
+        params.push_back(parsed);
+    }
+    return params;
+}
+
+} // namespace
+
+TEST(roundtripAcrossCodesAndLengths) {
+    uint32_t seed = 1;
+    for (const ld::MatrixParams &params : allParams()) {
+        for (size_t length : {size_t(0), size_t(1), size_t(100), size_t(1000)}) {
+            for (const std::string key : {"", "secret"}) {
+                Image image = makeImage(seed++);
+                std::vector<uint8_t> message = ldtest::randomBytes(length, seed++);
+                ld::MatrixStats stats;
+                CHECK(ld::embedMessageMatrix(image.view(), message, key, params, &stats));
+                CHECK(stats.messageBits == (length + (key.empty() ? 0 : ld::PAYLOAD_CIPHER_OVERHEAD)) * 8);
+                std::string extracted;
+                CHECK(ld::extractMessageMatrix(image.view(), extracted, key) == ld::ExtractStatus::Ok);
+                CHECK(extracted == std::string(message.begin(), message.end()));
+                if (!key.empty()) {
+                    CHECK(ld::extractMessageMatrix(image.view(), extracted, "wrong") != ld::ExtractStatus::Ok);
+                    CHECK(extracted.empty());
+                }
+            }
+        }
+    }
+}
+
+TEST(fewerChangesThanPlainLsb) {
+    // 随机载体上普通 LSB 每个消息比特平均改 0.5 位
+    for (const ld::MatrixParams &params : allParams()) {
+        Image image = makeImage(100);
+        std::vector<uint8_t> original = image.pixels;
+        std::vector<uint8_t> message = ldtest::randomBytes(600, 101);
+        ld::MatrixStats stats;
+        CHECK(ld::embedMessageMatrix(image.view(), message, "", params, &stats));
+        // 无密钥时码字紧跟在头部之后，统计的修改数与实际改动的最低位一致
+        CHECK(stats.changes == changedLsbs(original, image.pixels, ld::MATRIX_HEADER_SIZE * 8));
+        if (params.code == ld::MatrixCode::Hamming && params.parameter == 1) {
+            // p = 1 每个载体位携带一个比特，就是普通 LSB
+            CHECK(stats.changesPerBit() > 0.45 && stats.changesPerBit() < 0.55);
+        } else {
+            CHECK(stats.changesPerBit() < 0.4);
+        }
+    }
+}
+
+TEST(tooLongIsRejected) {
+    for (const ld::MatrixParams &params : allParams()) {
+        for (const std::string key : {"", "secret"}) {
+            Image image = makeImage(200);
+            std::vector<uint8_t> original = image.pixels;
+            std::vector<uint8_t> message(ld::matrixCapacity(image.view(), key) + 1);
+            std::string error;
+            CHECK(!ld::embedMessageMatrix(image.view(), message, key, params, nullptr, &error));
+            CHECK(error == "Message too long to embed");
+            CHECK(image.pixels == original);
+        }
+    }
+    // 一个消息比特至少要一个载体位
+    Image image = makeImage(201);
+    std::vector<uint8_t> message(ld::matrixCapacity(image.view()));
+    CHECK(ld::embedMessageMatrix(image.view(), message, "", ld::MatrixParams()));
+
+    ld::MatrixParams invalid;
+    invalid.code = ld::MatrixCode::Hamming;
+    invalid.adaptive = true;
+    std::string error;
+    CHECK(!ld::embedMessageMatrix(image.view(), ld::ConstByteSpan(), "", invalid, nullptr, &error));
+    CHECK(error == "Adaptive embedding needs the trellis code");
+}
+
+TEST(corruptedCodewordFailsChecksum) {
+    Image image = makeImage(300);
+    std::vector<uint8_t> message = ldtest::randomBytes(200, 301);
+    ld::MatrixParams params;
+    CHECK(ld::embedMessageMatrix(image.view(), message, "", params));
+    for (size_t i = ld::MATRIX_HEADER_SIZE * 8; i < ld::MATRIX_HEADER_SIZE * 8 + 64; ++i) {
+        image.pixels[i] ^= 1;
+    }
+    std::string extracted;
+    CHECK(ld::extractMessageMatrix(image.view(), extracted) == ld::ExtractStatus::BadChecksum);
+}
+
+TEST(stcKernelsAgree) {
+    // 前向递推的各个 SIMD 内核结果相同，解码得到原消息
+    constexpr uint64_t MESSAGE_BITS = 500;
+    constexpr uint64_t COVER_BITS = MESSAGE_BITS * 4;
+    std::vector<uint8_t> cover = ldtest::randomBytes(COVER_BITS, 400);
+    std::vector<uint8_t> message = ldtest::randomBytes(MESSAGE_BITS, 401);
+    for (uint8_t &bit : cover) {
+        bit &= 1;
+    }
+    for (uint8_t &bit : message) {
+        bit &= 1;
+    }
+    ld::SimdLevel detected = ld::detectSimdLevel();
+    for (int height : {ld::STC_MIN_HEIGHT, ld::STC_DEFAULT_HEIGHT, ld::STC_MAX_HEIGHT}) {
+        std::vector<uint8_t> reference;
+        for (ld::SimdLevel level : {ld::SimdLevel::Scalar, ld::SimdLevel::SSE2, ld::SimdLevel::AVX2}) {
+            if (level > detected) {
+                break;
+            }
+            ld::setSimdLevel(level);
+            std::vector<uint8_t> stego(COVER_BITS);
+            CHECK(ld::stcEncode(cover.data(), nullptr, COVER_BITS, message.data(), MESSAGE_BITS, height,
+                                stego.data()));
+            if (reference.empty()) {
+                reference = stego;
+            }
+            CHECK(stego == reference);
+            std::vector<uint8_t> decoded(MESSAGE_BITS);
+            ld::stcDecode(stego.data(), COVER_BITS, MESSAGE_BITS, height, decoded.data());
+            CHECK(decoded == message);
+        }
+    }
+    ld::setSimdLevel(detected);
+}
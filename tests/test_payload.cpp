@@ -0,0 +1,114 @@
+// 载荷容器（payload.h）和 CRC-32C（crc32c.h）
+
+#include "crc32c.h"
+#include "lsb.h"
+#include "payload.h"
+#include "test.h"
+
+namespace {
+
+constexpr size_t CARRIER_SIZE = 64 * 1024;
+
+ld::ExtractStatus extract(const std::vector<uint8_t> &carrier, std::string &payload, const std::string &key = "",
+                          bool legacy = false) {
+    return ld::extractPayload(ld::ConstByteSpan(carrier.data(), carrier.size()), payload, key, legacy);
+}
+
+} // namespace
+
+TEST(crc32cCheckValue) {
+    std::vector<uint8_t> data = ldtest::bytesOf("123456789");
+    CHECK(ld::crc32c(data) == 0xE3069283u);
+    // 分段计算与整段相同
+    CHECK(ld::crc32c(ld::ConstByteSpan(data.data() + 4, 5), ld::crc32c(ld::ConstByteSpan(data.data(), 4))) ==
+          0xE3069283u);
+    CHECK(ld::crc32c(ld::ConstByteSpan()) == 0);
+}
+
+TEST(headerRoundtripBothVersions) {
+    for (uint8_t version : {ld::PAYLOAD_VERSION, ld::PAYLOAD_VERSION_PHILOX}) {
+        ld::PayloadHeader header;
+        header.version = version;
+        header.flags = ld::PAYLOAD_FLAG_COMPRESSED | ld::PAYLOAD_FLAG_ENCRYPTED;
+        header.length = 0x0123456789ull;
+        header.crc = 0xCAFEF00Du;
+        uint8_t encoded[ld::PAYLOAD_HEADER_SIZE];
+        ld::encodePayloadHeader(header, encoded);
+        CHECK(encoded[0] == 'L' && encoded[1] == 'D' && encoded[2] == version);
+
+        ld::PayloadHeader decoded;
+        CHECK(ld::decodePayloadHeader(encoded, decoded) == ld::ExtractStatus::Ok);
+        CHECK(decoded.version == version);
+        CHECK(decoded.flags == header.flags);
+        CHECK(decoded.length == header.length);
+        CHECK(decoded.crc == header.crc);
+    }
+    uint8_t unknown[ld::PAYLOAD_HEADER_SIZE] = {'L', 'D', 9};
+    ld::PayloadHeader decoded;
+    CHECK(ld::decodePayloadHeader(unknown, decoded) == ld::ExtractStatus::NoPayload);
+}
+
+TEST(embedExtractWithoutKey) {
+    std::vector<uint8_t> carrier = ldtest::randomBytes(CARRIER_SIZE, 1);
+    std::vector<uint8_t> payload = ldtest::randomBytes(1000, 2); // 随机正文中会出现 0xFF
+    CHECK(ld::embedPayload(ld::ByteSpan(carrier.data(), carrier.size()), payload));
+    std::string extracted;
+    CHECK(extract(carrier, extracted) == ld::ExtractStatus::Ok);
+    CHECK(extracted == std::string(payload.begin(), payload.end()));
+
+    // 空正文也有头部
+    CHECK(ld::embedPayload(ld::ByteSpan(carrier.data(), carrier.size()), ld::ConstByteSpan()));
+    CHECK(extract(carrier, extracted) == ld::ExtractStatus::Ok);
+    CHECK(extracted.empty());
+}
+
+TEST(embedExtractWithKey) {
+    std::vector<uint8_t> carrier = ldtest::randomBytes(CARRIER_SIZE, 3);
+    std::vector<uint8_t> payload = ldtest::bytesOf("keyed payload");
+    CHECK(ld::embedPayload(ld::ByteSpan(carrier.data(), carrier.size()), payload, "secret"));
+    std::string extracted;
+    CHECK(extract(carrier, extracted, "secret") == ld::ExtractStatus::Ok);
+    CHECK(extracted == "keyed payload");
+
+    CHECK(extract(carrier, extracted, "wrong") != ld::ExtractStatus::Ok);
+    CHECK(extracted.empty());
+    CHECK(extract(carrier, extracted) != ld::ExtractStatus::Ok);
+}
+
+TEST(tooLargeIsRejected) {
+    std::vector<uint8_t> carrier = ldtest::randomBytes(1024, 4);
+    std::vector<uint8_t> original = carrier;
+    std::vector<uint8_t> payload(ld::payloadCapacity(ld::ConstByteSpan(carrier.data(), carrier.size())) + 1);
+    CHECK(!ld::embedPayload(ld::ByteSpan(carrier.data(), carrier.size()), payload));
+    CHECK(carrier == original);
+}
+
+TEST(corruptedLengthIsRejected) {
+    std::vector<uint8_t> carrier = ldtest::randomBytes(CARRIER_SIZE, 5);
+    CHECK(ld::embedPayload(ld::ByteSpan(carrier.data(), carrier.size()), ldtest::bytesOf("length")));
+    // 无密钥时头部第 k 字节在载体字节 8k 到 8k + 7 的最低位；把长度的最高字节改成 0xFF
+    for (size_t i = 11 * 8; i < 12 * 8; ++i) {
+        carrier[i] ^= 1;
+    }
+    std::string extracted;
+    CHECK(extract(carrier, extracted) == ld::ExtractStatus::BadLength);
+
+    // 长度的最低位变了：读出的正文与 CRC 不符
+    carrier = ldtest::randomBytes(CARRIER_SIZE, 5);
+    CHECK(ld::embedPayload(ld::ByteSpan(carrier.data(), carrier.size()), ldtest::bytesOf("length")));
+    for (size_t i = 4 * 8; i < 5 * 8; ++i) {
+        carrier[i] ^= 1;
+    }
+    CHECK(extract(carrier, extracted) == ld::ExtractStatus::BadChecksum);
+    CHECK(extracted.empty());
+}
+
+TEST(legacyFormatInCompatibilityMode) {
+    std::vector<uint8_t> carrier(CARRIER_SIZE, 0x80);
+    std::vector<uint8_t> message = ldtest::bytesOf("legacy message");
+    CHECK(ld::embedMessage(ld::ByteSpan(carrier.data(), carrier.size()), message) == message.size());
+    std::string extracted;
+    CHECK(extract(carrier, extracted, "", true) == ld::ExtractStatus::Legacy);
+    CHECK(extracted == "legacy message");
+    CHECK(extract(carrier, extracted, "", false) == ld::ExtractStatus::NoPayload);
+}
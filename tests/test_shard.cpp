@@ -0,0 +1,159 @@
+// 跨载体分片（shard.h）
+
+#include "shard.h"
+#include "test.h"
+
+namespace {
+
+using Carriers = std::vector<std::vector<uint8_t>>;
+
+Carriers makeCarriers(std::initializer_list<size_t> sizes, uint32_t seed) {
+    Carriers carriers;
+    for (size_t size : sizes) {
+        carriers.push_back(ldtest::randomBytes(size, seed++));
+    }
+    return carriers;
+}
+
+std::vector<ld::ImageView> views(Carriers &carriers) {
+    std::vector<ld::ImageView> result;
+    for (std::vector<uint8_t> &carrier : carriers) {
+        result.push_back(ld::ImageView::fromBytes(ld::ByteSpan(carrier.data(), carrier.size())));
+    }
+    return result;
+}
+
+std::vector<ld::ConstImageView> constViews(const std::vector<const std::vector<uint8_t> *> &carriers) {
+    std::vector<ld::ConstImageView> result;
+    for (const std::vector<uint8_t> *carrier : carriers) {
+        result.push_back(ld::ConstImageView::fromBytes(ld::ConstByteSpan(carrier->data(), carrier->size())));
+    }
+    return result;
+}
+
+std::vector<const std::vector<uint8_t> *> pointers(const Carriers &carriers) {
+    std::vector<const std::vector<uint8_t> *> result;
+    for (const std::vector<uint8_t> &carrier : carriers) {
+        result.push_back(&carrier);
+    }
+    return result;
+}
+
+uint64_t capacityOf(const std::vector<uint8_t> &carrier, const std::string &key = std::string()) {
+    return ld::shardCapacity(ld::ConstImageView::fromBytes(ld::ConstByteSpan(carrier.data(), carrier.size())), key);
+}
+
+} // namespace
+
+TEST(splitAcrossCarriers) {
+    for (const std::string key : {"", "secret"}) {
+        Carriers carriers = makeCarriers({16 * 1024, 24 * 1024, 16 * 1024, 16 * 1024}, 1);
+        Carriers original = carriers;
+        uint64_t first = capacityOf(carriers[0], key);
+        uint64_t second = capacityOf(carriers[1], key);
+        std::vector<uint8_t> payload = ldtest::randomBytes(first + second + 10, 10);
+
+        std::vector<ld::ShardInfo> shards;
+        std::string error;
+        CHECK(ld::embedSharded(views(carriers), payload, key, ld::EmbedLayout(), false, &shards, &error));
+        CHECK(shards.size() == 4);
+        // 按载体顺序装满，最后一片是剩下的部分，用不到的载体不修改
+        CHECK(shards[0].used && shards[0].index == 0 && shards[0].bytes == first);
+        CHECK(shards[1].used && shards[1].index == 1 && shards[1].bytes == second);
+        CHECK(shards[2].used && shards[2].index == 2 && shards[2].bytes == 10);
+        CHECK(!shards[3].used);
+        CHECK(carriers[3] == original[3]);
+
+        // 提取时载体顺序任意
+        std::vector<const std::vector<uint8_t> *> order = {&carriers[3], &carriers[2], &carriers[0], &carriers[1]};
+        std::string extracted;
+        std::vector<ld::ShardInfo> found;
+        CHECK(ld::extractSharded(constViews(order), extracted, key, &found, &error) == ld::ExtractStatus::Ok);
+        CHECK(extracted == std::string(payload.begin(), payload.end()));
+        CHECK(!found[0].used && found[1].index == 2 && found[2].index == 0 && found[3].index == 1);
+    }
+}
+
+TEST(compressedSpan) {
+    Carriers carriers = makeCarriers({8 * 1024, 8 * 1024}, 20);
+    std::vector<uint8_t> payload(20 * 1024, 'a');
+    std::vector<ld::ShardInfo> shards;
+    CHECK(ld::embedSharded(views(carriers), payload, "", ld::EmbedLayout(), true, &shards));
+    CHECK(shards[0].used && !shards[1].used);
+    std::string extracted;
+    CHECK(ld::extractSharded(constViews(pointers(carriers)), extracted) == ld::ExtractStatus::Ok);
+    CHECK(extracted == std::string(payload.begin(), payload.end()));
+}
+
+TEST(missingShardIsReported) {
+    Carriers carriers = makeCarriers({8 * 1024, 8 * 1024, 8 * 1024}, 30);
+    std::vector<uint8_t> payload = ldtest::randomBytes(capacityOf(carriers[0]) * 2 + 1, 31);
+    CHECK(ld::embedSharded(views(carriers), payload));
+
+    std::string extracted = "stale";
+    std::string error;
+    CHECK(ld::extractSharded(constViews({&carriers[0], &carriers[2]}), extracted, "", nullptr, &error) ==
+          ld::ExtractStatus::BadChecksum);
+    CHECK(extracted.empty());
+    // 载体比分片总数还少，报告不了具体缺哪片
+    CHECK(error == "Missing shards: 3 expected, 2 carriers");
+
+    Carriers blank = makeCarriers({4096}, 32);
+    CHECK(ld::extractSharded(constViews({&carriers[0], &blank[0], &carriers[2]}), extracted, "", nullptr, &error) ==
+          ld::ExtractStatus::BadChecksum);
+    CHECK(error == "Missing 1 of 3 shards: 1");
+
+    CHECK(ld::extractSharded(constViews({}), extracted, "", nullptr, &error) == ld::ExtractStatus::NoPayload);
+    CHECK(ld::extractSharded(constViews(pointers(blank)), extracted) == ld::ExtractStatus::NoPayload);
+}
+
+TEST(foreignAndDuplicateShards) {
+    Carriers first = makeCarriers({8 * 1024, 8 * 1024}, 40);
+    Carriers second = makeCarriers({8 * 1024, 8 * 1024}, 42);
+    std::vector<uint8_t> payloadA = ldtest::randomBytes(capacityOf(first[0]) + 100, 44);
+    std::vector<uint8_t> payloadB = ldtest::randomBytes(capacityOf(second[0]) + 200, 45);
+    CHECK(ld::embedSharded(views(first), payloadA));
+    CHECK(ld::embedSharded(views(second), payloadB));
+
+    // 另一次嵌入的分片混在一起：用第一个齐全的组，其余标为 foreign
+    std::vector<ld::ShardInfo> shards;
+    std::string extracted;
+    CHECK(ld::extractSharded(constViews({&second[1], &first[0], &first[1], &second[0]}), extracted, "", &shards) ==
+          ld::ExtractStatus::Ok);
+    CHECK(extracted == std::string(payloadB.begin(), payloadB.end()));
+    CHECK(!shards[0].foreign && shards[1].foreign && shards[2].foreign && !shards[3].foreign);
+
+    // 第一组不齐全时用齐全的另一组
+    CHECK(ld::extractSharded(constViews({&second[1], &first[0], &first[1]}), extracted, "", &shards) ==
+          ld::ExtractStatus::Ok);
+    CHECK(extracted == std::string(payloadA.begin(), payloadA.end()));
+    CHECK(shards[0].foreign && !shards[1].foreign && !shards[2].foreign);
+
+    // 同一个分片出现两次（复制过的载体）
+    std::vector<uint8_t> copy = first[0];
+    CHECK(ld::extractSharded(constViews({&first[0], &copy, &first[1]}), extracted) == ld::ExtractStatus::Ok);
+    CHECK(extracted == std::string(payloadA.begin(), payloadA.end()));
+}
+
+TEST(zeroRoomCarriersAreSkipped) {
+    // 中间的载体连容器头部和分片头部都放不下
+    Carriers carriers = makeCarriers({8 * 1024, 256, 8 * 1024}, 50);
+    Carriers original = carriers;
+    CHECK(capacityOf(carriers[1]) == 0);
+    std::vector<uint8_t> payload = ldtest::randomBytes(capacityOf(carriers[0]) + 50, 51);
+    std::vector<ld::ShardInfo> shards;
+    CHECK(ld::embedSharded(views(carriers), payload, "", ld::EmbedLayout(), false, &shards));
+    CHECK(shards[0].used && !shards[1].used && shards[2].used && shards[2].index == 1);
+    CHECK(carriers[1] == original[1]);
+    std::string extracted;
+    CHECK(ld::extractSharded(constViews(pointers(carriers)), extracted) == ld::ExtractStatus::Ok);
+    CHECK(extracted == std::string(payload.begin(), payload.end()));
+
+    // 总容量不够时不修改任何载体
+    carriers = original;
+    std::vector<uint8_t> tooLarge(capacityOf(carriers[0]) + capacityOf(carriers[2]) + 1);
+    std::string error;
+    CHECK(!ld::embedSharded(views(carriers), tooLarge, "", ld::EmbedLayout(), false, nullptr, &error));
+    CHECK(!error.empty());
+    CHECK(carriers == original);
+}
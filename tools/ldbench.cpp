@@ -0,0 +1,716 @@
+// ldbench: ldcore 各操作在自带图像集和合成大图上的性能
+//
+//   ldbench [--json 文件] [--baseline 文件] [--tolerance 0.25] [--large MB] [--min-time 秒] [目录...]
+//
+// 默认图像集为源码中的 color/、grey/、Noise_Exp/，另加一幅 --large MB 的合成 24 位图（0 表示不用）。
+// 每项报告处理的字节数、ns/byte、MB/s 和到该项为止的峰值 RSS：读写、容量和预览金字塔按载体字节计，
+// 嵌入/提取按正文字节计。顺序嵌入内核在各指令集等级下的输出仍和逐位实现逐字节比较，
+// 网格码的 Viterbi 内核在各等级下的输出也必须一致。普通 LSB 和矩阵嵌入另外报告每个消息比特平均修改的载体位数。
+//
+// --json 写出结果；--baseline 读入之前保存的结果逐项比较，MB/s 低于基线的 (1 - tolerance) 倍
+// 视为回退，返回 1。基线与机器有关，发布前在同一台机器上重新生成（tools/ldbench_baseline.json）。
+
+#include "bmp.h"
+#include "bmpstream.h"
+#include "chacha20.h"
+#include "costmap.h"
+#include "lsb.h"
+#include "matrix.h"
+#include "metrics.h"
+#include "noise.h"
+#include "payload.h"
+#include "preview.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 矩阵嵌入的消息约为容量的 1/64（网格码的子矩阵宽度取到上限），大图上限制长度，控制运行时间
+constexpr size_t MATRIX_BENCH_BYTES = 64 * 1024;
+
+struct Options {
+    std::vector<std::string> dirs;
+    std::string jsonPath;
+    std::string baselinePath;
+    double tolerance = 0.25;
+    uint64_t largeMegabytes = 64;
+    double minSeconds = 0.25;
+};
+
+struct Result {
+    std::string name;
+    uint64_t bytes = 0;    // 每次运行处理的字节数
+    double seconds = 0;    // 每次运行的平均耗时
+    uint64_t peakRssKb = 0;
+    double changesPerBit = -1; // 小于 0 表示不适用
+
+    double nsPerByte() const { return bytes ? seconds * 1e9 / static_cast<double>(bytes) : 0.0; }
+    double megabytesPerSecond() const {
+        return seconds > 0 ? static_cast<double>(bytes) / (1024.0 * 1024.0) / seconds : 0.0;
+    }
+};
+
+struct Corpus {
+    std::string name;
+    std::vector<std::string> paths; // 读写测试用到的文件
+    std::vector<ld::BmpImage> images;
+};
+
+uint64_t peakRssKb() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize / 1024;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return static_cast<uint64_t>(usage.ru_maxrss) / 1024; // macOS 以字节为单位
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+#endif
+}
+
+// 原来 MainWindow::embedMessage 的逐位写法，作为对照
+void embedReference(std::vector<uint8_t> &imageData, const std::vector<uint8_t> &message) {
+    size_t data_index = 0;
+    for (uint8_t byte : message) {
+        for (int bit = 0; bit < 8; ++bit) {
+            imageData[data_index] = (imageData[data_index] & 0xFE) | ((byte >> bit) & 1);
+            ++data_index;
+        }
+    }
+    if (data_index + 8 <= imageData.size()) {
+        for (int bit = 0; bit < 8; ++bit) {
+            imageData[data_index] = (imageData[data_index] & 0xFE) | ((ld::END_MARKER >> bit) & 1);
+            ++data_index;
+        }
+    }
+}
+
+// 先预热一次，然后重复运行到累计至少 minSeconds，返回每次的平均秒数
+template <typename F>
+double secondsPerRun(F &&run, double minSeconds) {
+    run();
+    int iterations = 0;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    do {
+        run();
+        ++iterations;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < minSeconds);
+    return elapsed / iterations;
+}
+
+bool parseArgs(int argc, char *argv[], Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            options.dirs.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--json") {
+            options.jsonPath = value;
+        } else if (arg == "--baseline") {
+            options.baselinePath = value;
+        } else if (arg == "--tolerance") {
+            options.tolerance = std::stod(value);
+        } else if (arg == "--large") {
+            options.largeMegabytes = std::stoull(value);
+        } else if (arg == "--min-time") {
+            options.minSeconds = std::stod(value);
+        } else {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    if (options.dirs.empty()) {
+        options.dirs = {LD_SOURCE_DIR "/color", LD_SOURCE_DIR "/grey", LD_SOURCE_DIR "/Noise_Exp"};
+    }
+    return true;
+}
+
+Corpus loadCorpus(const std::string &dir) {
+    Corpus corpus;
+    corpus.name = fs::path(dir).lexically_normal().parent_path().filename().string();
+    if (fs::path(dir).lexically_normal().has_filename()) {
+        corpus.name = fs::path(dir).lexically_normal().filename().string();
+    }
+    std::vector<fs::path> files;
+    std::error_code ec;
+    for (const fs::directory_entry &entry : fs::directory_iterator(dir, ec)) {
+        if (entry.is_regular_file()) {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    for (const fs::path &file : files) {
+        ld::BmpImage image;
+        if (ld::readBMP(file.string(), image)) {
+            corpus.paths.push_back(file.string());
+            corpus.images.push_back(std::move(image));
+        }
+    }
+    return corpus;
+}
+
+// 随机像素的 24 位图，宽度取奇数让每行都有填充
+Corpus syntheticCorpus(uint64_t megabytes, const fs::path &tempDir) {
+    Corpus corpus;
+    corpus.name = "synthetic-" + std::to_string(megabytes) + "MB";
+    ld::BmpImage image;
+    image.bitCount = 24;
+    image.width = 4099;
+    image.stride = (static_cast<size_t>(image.width) * 3 + 3) / 4 * 4;
+    image.height = static_cast<int32_t>(std::max<uint64_t>(1, megabytes * 1024 * 1024 / image.stride));
+    image.pixels.resize(static_cast<size_t>(image.pixelBytes()));
+    std::mt19937_64 generator(42);
+    for (size_t i = 0; i + 8 <= image.pixels.size(); i += 8) {
+        uint64_t value = generator();
+        std::copy(reinterpret_cast<const uint8_t *>(&value), reinterpret_cast<const uint8_t *>(&value) + 8,
+                  image.pixels.begin() + static_cast<std::ptrdiff_t>(i));
+    }
+    std::string path = (tempDir / "synthetic.bmp").string();
+    if (ld::writeBMP(path, image)) {
+        corpus.paths.push_back(path);
+        corpus.images.push_back(std::move(image));
+    }
+    return corpus;
+}
+
+std::vector<uint8_t> randomPayload(size_t size, std::mt19937 &generator) {
+    std::vector<uint8_t> payload(size);
+    for (uint8_t &byte : payload) {
+        byte = static_cast<uint8_t>(generator());
+    }
+    return payload;
+}
+
+// 类似日志的文本，压缩率与真实的文本载荷相近
+std::vector<uint8_t> textPayload(size_t size, std::mt19937 &generator) {
+    static const char *const levels[] = {"INFO", "WARN", "DEBUG", "ERROR"};
+    std::string text;
+    while (text.size() < size) {
+        char line[128];
+        std::snprintf(line, sizeof(line), "2024-05-%02u %02u:%02u:%02u %s worker-%u request=%08x took %ums\n",
+                      static_cast<unsigned>(generator() % 28 + 1), static_cast<unsigned>(generator() % 24),
+                      static_cast<unsigned>(generator() % 60), static_cast<unsigned>(generator() % 60),
+                      levels[generator() % 4], static_cast<unsigned>(generator() % 16),
+                      static_cast<unsigned>(generator()), static_cast<unsigned>(generator() % 1000));
+        text += line;
+    }
+    return std::vector<uint8_t>(text.begin(), text.begin() + size);
+}
+
+void benchCorpus(const Corpus &corpus, const Options &options, const fs::path &tempDir, std::vector<Result> &results) {
+    auto add = [&](const std::string &operation, uint64_t bytes, double seconds) {
+        results.push_back(Result{corpus.name + "/" + operation, bytes, seconds, peakRssKb()});
+    };
+
+    uint64_t carrierBytes = 0;
+    for (const ld::BmpImage &image : corpus.images) {
+        carrierBytes += image.pixelBytes();
+    }
+
+    add("read", carrierBytes, secondsPerRun([&] {
+        for (const std::string &path : corpus.paths) {
+            ld::BmpImage image;
+            ld::readBMP(path, image);
+        }
+    }, options.minSeconds));
+
+    std::string writePath = (tempDir / "write.bmp").string();
+    add("write", carrierBytes, secondsPerRun([&] {
+        for (const ld::BmpImage &image : corpus.images) {
+            ld::writeBMP(writePath, image);
+        }
+    }, options.minSeconds));
+
+    size_t capacity = 0;
+    add("capacity", carrierBytes, secondsPerRun([&] {
+        capacity = 0;
+        for (const std::string &path : corpus.paths) {
+            ld::BmpInfo info;
+            if (ld::readBmpInfo(path, info)) {
+                capacity += static_cast<size_t>(ld::streamPayloadCapacity(info));
+            }
+        }
+    }, options.minSeconds));
+
+    // 顺序模式写满容量；带密钥的位置是随机访问，只写 1/16 容量，控制运行时间。
+    // 放不下容器头部的小图不参加嵌入/提取
+    std::mt19937 generator(12345);
+    std::vector<ld::BmpImage> carriers;
+    std::vector<std::string> carrierPaths;
+    std::vector<size_t> sources; // carriers[i] 来自 corpus.images[sources[i]]
+    std::vector<std::vector<uint8_t>> full;
+    std::vector<std::vector<uint8_t>> sparse;
+    std::vector<std::vector<uint8_t>> twoPlanes; // 低 2 位平面的满容量
+    std::vector<std::vector<uint8_t>> texts;     // 两倍容量的文本，压缩后能放下
+    std::vector<std::vector<uint8_t>> matrixMessages; // 约 1/64 容量，不超过 MATRIX_BENCH_BYTES
+    uint64_t fullBytes = 0;
+    uint64_t sparseBytes = 0;
+    uint64_t twoPlaneBytes = 0;
+    uint64_t textBytes = 0;
+    uint64_t matrixBytes = 0;
+    ld::EmbedLayout twoPlaneLayout;
+    twoPlaneLayout.planes = 2;
+    for (size_t i = 0; i < corpus.images.size(); ++i) {
+        if (ld::calculateMaxEmbedLength(corpus.images[i].view()) < ld::PAYLOAD_HEADER_SIZE) {
+            continue;
+        }
+        size_t size = ld::payloadCapacity(corpus.images[i].view());
+        carriers.push_back(corpus.images[i]);
+        carrierPaths.push_back(corpus.paths[i]);
+        sources.push_back(i);
+        full.push_back(randomPayload(size, generator));
+        sparse.push_back(randomPayload(size / 16, generator));
+        fullBytes += size;
+        sparseBytes += size / 16;
+        size_t twoPlaneSize = ld::payloadCapacity(corpus.images[i].view(), twoPlaneLayout);
+        twoPlanes.push_back(randomPayload(twoPlaneSize, generator));
+        twoPlaneBytes += twoPlaneSize;
+        // 小图上的短文本压缩不到一半，退回到不压缩也能放下的长度
+        std::vector<uint8_t> text = textPayload(size * 2, generator);
+        if (ld::storedPayloadSize(text, true) > size) {
+            text.resize(size);
+        }
+        textBytes += text.size();
+        texts.push_back(std::move(text));
+        size_t matrixSize = std::min(ld::matrixCapacity(corpus.images[i].view()) / 64, MATRIX_BENCH_BYTES);
+        matrixMessages.push_back(randomPayload(matrixSize, generator));
+        matrixBytes += matrixSize;
+    }
+
+    // 在原图上嵌入一次，改动的载体字节数除以消息位数（两种方式都只改最低位）。
+    // 结束后 carriers 仍是嵌入后的图像
+    auto changesPerBit = [&](uint64_t messageBytes, const std::function<void(size_t)> &embed) {
+        uint64_t changes = 0;
+        for (size_t i = 0; i < carriers.size(); ++i) {
+            const std::vector<uint8_t> &cover = corpus.images[sources[i]].pixels;
+            carriers[i].pixels = cover;
+            embed(i);
+            for (size_t j = 0; j < cover.size(); ++j) {
+                changes += cover[j] != carriers[i].pixels[j] ? 1 : 0;
+            }
+        }
+        return messageBytes ? static_cast<double>(changes) / static_cast<double>(messageBytes * 8) : 0.0;
+    };
+
+    std::string message;
+    bool ok = true;
+    add("embed-seq", fullBytes, secondsPerRun([&] {
+        for (size_t i = 0; i < carriers.size(); ++i) {
+            ld::embedPayload(carriers[i].view(), full[i]);
+        }
+    }, options.minSeconds));
+    results.back().changesPerBit =
+        changesPerBit(fullBytes, [&](size_t i) { ld::embedPayload(carriers[i].view(), full[i]); });
+    add("extract-seq", fullBytes, secondsPerRun([&] {
+        for (size_t i = 0; i < carriers.size(); ++i) {
+            ok = ok && ld::extractPayload(carriers[i].view(), message) == ld::ExtractStatus::Ok;
+        }
+    }, options.minSeconds));
+
+    add("embed-seq-k2", twoPlaneBytes, secondsPerRun([&] {
+        for (size_t i = 0; i < carriers.size(); ++i) {
+            ld::embedPayload(carriers[i].view(), twoPlanes[i], std::string(), nullptr, twoPlaneLayout);
+        }
+    }, options.minSeconds));
+    add("extract-seq-k2", twoPlaneBytes, secondsPerRun([&] {
+        for (size_t i = 0; i < carriers.size(); ++i) {
+            ok = ok && ld::extractPayload(carriers[i].view(), message) == ld::ExtractStatus::Ok;
+        }
+    }, options.minSeconds));
+
+    // 按压缩前的正文字节计
+    add("embed-compressed", textBytes, secondsPerRun([&] {
+        for (size_t i = 0; i < carriers.size(); ++i) {
+            ok = ld::embedPayload(carriers[i].view(), texts[i], std::string(), nullptr, ld::EmbedLayout(), true) && ok;
+        }
+    }, options.minSeconds));
+    add("extract-compressed", textBytes, secondsPerRun([&] {
+        for (size_t i = 0; i < carriers.size(); ++i) {
+            ok = ok && ld::extractPayload(carriers[i].view(), message) == ld::ExtractStatus::Ok;
+        }
+    }, options.minSeconds));
+
+    // 纹理代价图，按载体字节计
+    std::vector<uint16_t> texture;
+    add("costmap", carrierBytes, secondsPerRun([&] {
+        for (const ld::BmpImage &carrier : carriers) {
+            ld::computeTextureMap(carrier.view(), texture);
+        }
+    }, options.minSeconds));
+
+    // 预览金字塔，按载体字节计；update 把原图的金字塔刷新为前面嵌入过的载体，包含逐块比较的时间
+    std::vector<ld::PreviewPyramid> previews(corpus.images.size());
+    add("preview", carrierBytes, secondsPerRun([&] {
+        for (size_t i = 0; i < corpus.images.size(); ++i) {
+            previews[i].build(corpus.images[i], corpus.images[i].view());
+        }
+    }, options.minSeconds));
+    uint64_t updateBytes = 0;
+    for (const ld::BmpImage &carrier : carriers) {
+        updateBytes += carrier.pixelBytes();
+    }
+    add("preview-update", updateBytes, secondsPerRun([&] {
+        for (size_t i = 0; i < carriers.size(); ++i) {
+            ld::PreviewPyramid preview = previews[sources[i]];
+            preview.update(corpus.images[sources[i]].view(), carriers[i].view());
+        }
+    }, options.minSeconds));
+
+    // 矩阵嵌入，按消息字节计；自适应模式带密钥，包含计算代价图的时间
+    struct MatrixCase {
+        const char *name;
+        const char *key;
+        ld::MatrixParams params;
+    };
+    ld::MatrixParams hamming;
+    hamming.code = ld::MatrixCode::Hamming;
+    ld::MatrixParams adaptive;
+    adaptive.adaptive = true;
+    for (const MatrixCase &matrix : {MatrixCase{"hamming", "", hamming}, MatrixCase{"stc", "", ld::MatrixParams()},
+                                     MatrixCase{"adaptive", "ldbench", adaptive}}) {
+        std::string name = matrix.name;
+        // 带密钥时消息加密，另占 nonce 和标签，最小的几幅图放不下（这些图的消息为空，不影响字节数）
+        auto fits = [&](size_t i) {
+            size_t overhead = *matrix.key ? ld::PAYLOAD_CIPHER_OVERHEAD : 0;
+            return matrixMessages[i].size() + overhead <= ld::matrixCapacity(carriers[i].view());
+        };
+        add("embed-" + name, matrixBytes, secondsPerRun([&] {
+            for (size_t i = 0; i < carriers.size(); ++i) {
+                if (fits(i)) {
+                    ok = ld::embedMessageMatrix(carriers[i].view(), matrixMessages[i], matrix.key, matrix.params) && ok;
+                }
+            }
+        }, options.minSeconds));
+        results.back().changesPerBit = changesPerBit(matrixBytes, [&](size_t i) {
+            ld::embedMessageMatrix(carriers[i].view(), matrixMessages[i], matrix.key, matrix.params);
+        });
+        add("extract-" + name, matrixBytes, secondsPerRun([&] {
+            for (size_t i = 0; i < carriers.size(); ++i) {
+                ok = ok && (!fits(i) ||
+                            ld::extractMessageMatrix(carriers[i].view(), message, matrix.key) == ld::ExtractStatus::Ok);
+            }
+        }, options.minSeconds));
+    }
+
+    // 带密钥时正文加密，另占 nonce 和标签，最小的几幅图放不下
+    std::vector<size_t> keyed;
+    uint64_t keyedBytes = 0;
+    for (size_t i = 0; i < carriers.size(); ++i) {
+        if (sparse[i].size() + ld::PAYLOAD_CIPHER_OVERHEAD <= ld::payloadCapacity(carriers[i].view())) {
+            keyed.push_back(i);
+            keyedBytes += sparse[i].size();
+        }
+    }
+    add("embed-keyed", keyedBytes, secondsPerRun([&] {
+        for (size_t i : keyed) {
+            ok = ld::embedPayload(carriers[i].view(), sparse[i], "ldbench") && ok;
+        }
+    }, options.minSeconds));
+    add("extract-keyed", keyedBytes, secondsPerRun([&] {
+        for (size_t i : keyed) {
+            ok = ok && ld::extractPayload(carriers[i].view(), message, "ldbench") == ld::ExtractStatus::Ok;
+        }
+    }, options.minSeconds));
+
+    std::string streamPath = (tempDir / "stream.bmp").string();
+    add("stream-embed-seq", fullBytes, secondsPerRun([&] {
+        for (size_t i = 0; i < carrierPaths.size(); ++i) {
+            ld::streamEmbedPayload(carrierPaths[i], streamPath, full[i]);
+        }
+    }, options.minSeconds));
+
+    // 与原图比较嵌入后的图像，按载体字节计
+    uint64_t compareBytes = 0;
+    for (const ld::BmpImage &carrier : carriers) {
+        compareBytes += carrier.pixelBytes();
+    }
+    add("metrics", compareBytes, secondsPerRun([&] {
+        ld::QualityReport quality;
+        for (size_t i = 0; i < carriers.size(); ++i) {
+            ld::measureQuality(corpus.images[sources[i]].view(), carriers[i].view(), quality);
+        }
+    }, options.minSeconds));
+
+    // 10% 的位置加噪声，按载体字节计
+    ld::NoiseScratch scratch;
+    for (ld::NoiseType type : {ld::NoiseType::SaltAndPepper, ld::NoiseType::Random, ld::NoiseType::Gaussian}) {
+        uint64_t seed = 0;
+        add(std::string("noise-") + ld::noiseTypeName(type), carrierBytes, secondsPerRun([&] {
+            for (ld::BmpImage &carrier : carriers) {
+                ld::addNoise(carrier.view(), type, 0.1, ++seed, scratch);
+            }
+        }, options.minSeconds));
+    }
+
+    if (!ok) {
+        std::fprintf(stderr, "%s: extracted payload did not verify\n", corpus.name.c_str());
+    }
+}
+
+// 旧格式的顺序内核：逐位实现和各指令集等级，输出必须逐字节一致
+bool benchKernels(const std::vector<Corpus> &corpora, const Options &options, std::vector<Result> &results) {
+    std::vector<std::vector<uint8_t>> originals;
+    std::vector<std::vector<uint8_t>> payloads;
+    std::vector<std::vector<uint8_t>> trellisMessages;
+    uint64_t carrierBytes = 0;
+    // 载荷不含 0xFF，提取时会读满整个容量
+    std::mt19937 generator(12345);
+    for (const Corpus &corpus : corpora) {
+        for (const ld::BmpImage &image : corpus.images) {
+            std::vector<uint8_t> payload(std::max<size_t>(ld::calculateMaxEmbedLength(image.pixels), 1) - 1);
+            for (uint8_t &byte : payload) {
+                byte = static_cast<uint8_t>(generator() % 255);
+            }
+            payloads.push_back(std::move(payload));
+            originals.push_back(image.pixels);
+            carrierBytes += image.pixels.size();
+            std::vector<uint8_t> message(std::min<size_t>(ld::matrixCapacity(image.view()) / 64, 4096));
+            for (uint8_t &byte : message) {
+                byte = static_cast<uint8_t>(generator());
+            }
+            trellisMessages.push_back(std::move(message));
+        }
+    }
+
+    // 网格码按参与编码的载体位数计，各等级的结果都与标量等级比较
+    ld::setSimdLevel(ld::SimdLevel::Scalar);
+    uint64_t trellisBits = 0;
+    std::vector<std::vector<uint8_t>> trellisExpected = originals;
+    for (size_t i = 0; i < originals.size(); ++i) {
+        ld::MatrixStats stats;
+        ld::embedMessageMatrix(ld::ImageView::fromBytes(trellisExpected[i]), trellisMessages[i], std::string(),
+                               ld::MatrixParams(), &stats);
+        trellisBits += stats.coverBits;
+    }
+
+    // 载荷加密按正文字节计，密文和标签与标量等级比较
+    const uint8_t cipherKey[ld::CHACHA20_KEY_SIZE] = {1, 2, 3};
+    const uint8_t cipherNonce[ld::CHACHA20_NONCE_SIZE] = {4, 5, 6};
+    auto sealAll = [&](std::vector<std::vector<uint8_t>> &buffers) {
+        for (std::vector<uint8_t> &buffer : buffers) {
+            ld::ChaCha20Poly1305 cipher(cipherKey, cipherNonce, ld::ConstByteSpan());
+            cipher.encrypt(buffer.data(), buffer.size());
+            buffer.resize(buffer.size() + ld::POLY1305_TAG_SIZE);
+            cipher.finish(buffer.data() + buffer.size() - ld::POLY1305_TAG_SIZE);
+        }
+    };
+    uint64_t payloadBytes = 0;
+    for (const std::vector<uint8_t> &payload : payloads) {
+        payloadBytes += payload.size();
+    }
+    std::vector<std::vector<uint8_t>> sealedExpected = payloads;
+    sealAll(sealedExpected);
+
+    std::vector<std::vector<uint8_t>> expected = originals;
+    results.push_back(Result{"kernel/bitwise/embed", carrierBytes, secondsPerRun([&] {
+        for (size_t i = 0; i < expected.size(); ++i) {
+            embedReference(expected[i], payloads[i]);
+        }
+    }, options.minSeconds), peakRssKb()});
+
+    bool allIdentical = true;
+    for (int level = 0; level <= static_cast<int>(ld::detectSimdLevel()); ++level) {
+        ld::setSimdLevel(static_cast<ld::SimdLevel>(level));
+        std::string prefix = std::string("kernel/") + ld::simdLevelName(static_cast<ld::SimdLevel>(level));
+        std::vector<std::vector<uint8_t>> carriers = originals;
+
+        results.push_back(Result{prefix + "/embed", carrierBytes, secondsPerRun([&] {
+            for (size_t i = 0; i < carriers.size(); ++i) {
+                ld::embedMessage(carriers[i], payloads[i]);
+            }
+        }, options.minSeconds), peakRssKb()});
+        results.push_back(Result{prefix + "/extract", carrierBytes, secondsPerRun([&] {
+            for (size_t i = 0; i < carriers.size(); ++i) {
+                ld::extractMessage(carriers[i]);
+            }
+        }, options.minSeconds), peakRssKb()});
+
+        bool identical = true;
+        for (size_t i = 0; i < carriers.size(); ++i) {
+            identical = identical && carriers[i] == expected[i]
+                        && ld::extractMessage(carriers[i]).size() == payloads[i].size();
+        }
+        if (!identical) {
+            std::fprintf(stderr, "%s output differs from the bitwise reference\n", prefix.c_str());
+        }
+        allIdentical = allIdentical && identical;
+
+        std::vector<std::vector<uint8_t>> trellis = originals;
+        results.push_back(Result{prefix + "/stc", trellisBits, secondsPerRun([&] {
+            for (size_t i = 0; i < trellis.size(); ++i) {
+                trellis[i] = originals[i];
+                ld::embedMessageMatrix(ld::ImageView::fromBytes(trellis[i]), trellisMessages[i]);
+            }
+        }, options.minSeconds), peakRssKb()});
+        if (trellis != trellisExpected) {
+            std::fprintf(stderr, "%s/stc output differs from the scalar kernel\n", prefix.c_str());
+            allIdentical = false;
+        }
+
+        std::vector<std::vector<uint8_t>> sealed;
+        results.push_back(Result{prefix + "/chacha20poly1305", payloadBytes, secondsPerRun([&] {
+            sealed = payloads;
+            sealAll(sealed);
+        }, options.minSeconds), peakRssKb()});
+        if (sealed != sealedExpected) {
+            std::fprintf(stderr, "%s/chacha20poly1305 output differs from the scalar kernel\n", prefix.c_str());
+            allIdentical = false;
+        }
+    }
+    ld::setSimdLevel(ld::detectSimdLevel());
+    return allIdentical;
+}
+
+bool writeJson(const std::string &path, const std::vector<Result> &results) {
+    std::ofstream out(path);
+    out << "{\n  \"simd\": \"" << ld::simdLevelName(ld::detectSimdLevel()) << "\",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &result = results[i];
+        char line[512];
+        std::snprintf(line, sizeof(line),
+                      "    {\"name\": \"%s\", \"bytes\": %llu, \"ns_per_byte\": %.4f, \"mb_per_s\": %.4f, "
+                      "\"peak_rss_kb\": %llu",
+                      result.name.c_str(), static_cast<unsigned long long>(result.bytes), result.nsPerByte(),
+                      result.megabytesPerSecond(), static_cast<unsigned long long>(result.peakRssKb));
+        out << line;
+        if (result.changesPerBit >= 0) {
+            std::snprintf(line, sizeof(line), ", \"changes_per_bit\": %.4f", result.changesPerBit);
+            out << line;
+        }
+        std::snprintf(line, sizeof(line), "}%s\n", i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+// 只认 writeJson 写出的格式：按顺序取每个对象的 name 和 mb_per_s
+bool readBaseline(const std::string &path, std::map<std::string, double> &baseline) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+    const std::string nameKey = "\"name\": \"";
+    const std::string speedKey = "\"mb_per_s\": ";
+    for (size_t pos = text.find(nameKey); pos != std::string::npos; pos = text.find(nameKey, pos)) {
+        pos += nameKey.size();
+        size_t end = text.find('"', pos);
+        size_t speed = text.find(speedKey, end);
+        if (end == std::string::npos || speed == std::string::npos) {
+            break;
+        }
+        baseline[text.substr(pos, end - pos)] = std::strtod(text.c_str() + speed + speedKey.size(), nullptr);
+        pos = speed;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        return 2;
+    }
+
+    std::error_code ec;
+    fs::path tempDir = fs::temp_directory_path(ec) / ("ldbench-" + std::to_string(std::random_device()()));
+    fs::create_directories(tempDir, ec);
+
+    std::vector<Corpus> corpora;
+    for (const std::string &dir : options.dirs) {
+        Corpus corpus = loadCorpus(dir);
+        if (!corpus.images.empty()) {
+            corpora.push_back(std::move(corpus));
+        }
+    }
+    if (corpora.empty()) {
+        std::fprintf(stderr, "No BMP images found\n");
+        return 1;
+    }
+
+    std::vector<Result> results;
+    bool identical = benchKernels(corpora, options, results);
+    if (options.largeMegabytes > 0) {
+        corpora.push_back(syntheticCorpus(options.largeMegabytes, tempDir));
+    }
+    for (const Corpus &corpus : corpora) {
+        benchCorpus(corpus, options, tempDir, results);
+    }
+    fs::remove_all(tempDir, ec);
+
+    std::map<std::string, double> baseline;
+    if (!options.baselinePath.empty() && !readBaseline(options.baselinePath, baseline)) {
+        std::fprintf(stderr, "Unable to read baseline %s\n", options.baselinePath.c_str());
+        return 2;
+    }
+
+    std::printf("%-32s %12s %10s %10s %10s %8s %10s\n", "benchmark", "bytes", "ns/byte", "MB/s", "RSS MB", "chg/bit",
+                baseline.empty() ? "" : "vs base");
+    size_t regressions = 0;
+    for (const Result &result : results) {
+        std::string comparison;
+        auto found = baseline.find(result.name);
+        if (found != baseline.end() && found->second > 0) {
+            double ratio = result.megabytesPerSecond() / found->second;
+            char text[32];
+            std::snprintf(text, sizeof(text), "%.2fx%s", ratio, ratio < 1.0 - options.tolerance ? " !" : "");
+            comparison = text;
+            regressions += ratio < 1.0 - options.tolerance ? 1 : 0;
+        }
+        char changes[16] = "";
+        if (result.changesPerBit >= 0) {
+            std::snprintf(changes, sizeof(changes), "%.3f", result.changesPerBit);
+        }
+        std::printf("%-32s %12llu %10.3f %10.1f %10.1f %8s %10s\n", result.name.c_str(),
+                    static_cast<unsigned long long>(result.bytes), result.nsPerByte(), result.megabytesPerSecond(),
+                    static_cast<double>(result.peakRssKb) / 1024.0, changes, comparison.c_str());
+    }
+
+    if (!options.jsonPath.empty() && !writeJson(options.jsonPath, results)) {
+        std::fprintf(stderr, "Unable to write %s\n", options.jsonPath.c_str());
+        return 2;
+    }
+    if (regressions > 0) {
+        std::fprintf(stderr, "%zu benchmarks regressed by more than %.0f%%\n", regressions, options.tolerance * 100);
+    }
+    return identical && regressions == 0 ? 0 : 1;
+}
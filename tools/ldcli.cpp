@@ -0,0 +1,756 @@
+// ldcli: 无界面的批量嵌入/提取工具，与 GUI 使用同一个 ldcore
+//
+//   ldcli embed    <目录|清单文件> --out <目录> (--message 文本 | --message-file 文件) [--key 密钥] [--layout K[:通道]]
+//                  [--compress] [--matrix 码[:参数]] [--threads N] [--stream | --span]
+//   ldcli extract  <目录|清单文件> [--out <目录>] [--key 密钥] [--legacy] [--threads N] [--stream | --span]
+//   ldcli capacity <目录|清单文件> [--layout K[:通道]] [--message 文本 | --message-file 文件] [--key 密钥]
+//                  [--compress] [--matrix 码[:参数]] [--threads N] [--stream | --span]
+//   ldcli analyze  <目录|清单文件> [--threads N]
+//   ldcli keysearch <目录|清单文件> --keys 口令文件 [--all] [--out <目录>]
+//
+// 各命令都可以加 --trace 文件（写出 Chrome 跟踪 JSON）和 --trace-summary（在标准错误输出各阶段的耗时汇总），
+// 记录的阶段由编译期的 LD_TRACE_LEVEL 决定（见 trace.h），为 0 时两者都只输出空记录。
+//
+// 清单文件每行一个 BMP 路径，相对路径以清单所在目录为基准，# 开头的行忽略。
+// --message-file：任意二进制文件，按块读入直接写进载体，不整体读进内存；
+//                 extract 指定 --out 时正文也按块直接写入文件。
+// --key：按密钥置换嵌入位置，并用 ChaCha20-Poly1305 加密正文（见 payload.h），提取时校验认证标签；
+//        capacity 给出消息时把加密的 28 字节开销计入实际占用。
+// --compress：嵌入前压缩（压缩后不变小时原样嵌入），提取时自动解压。
+//             capacity 同时给出消息时，说明栏给出消息实际占用的字节数和能否嵌入。
+// --legacy：没有容器头部的图像按旧的 0xFF 终止格式提取。
+// --layout：每个样本用低 K 位（1-4），只用列出的通道（r、g、b 的组合，默认全部），例如 2:rg；
+//           提取时从头部自动识别，不需要指定。
+// --matrix：矩阵嵌入，hamming[:p]、stc[:h] 或 adaptive[:h]（见 matrix.h），修改的像素比普通 LSB 少；
+//           adaptive 把修改集中到边缘和纹理区域。可以与 --key 同用（消息同样加密），不能与 --layout、--compress 同用，
+//           embed 的说明栏给出修改位数和每比特修改数。
+//           extract 找不到载荷容器时自动尝试矩阵嵌入的头部。
+// --stream：按行带流式读写，不映射整个文件，用于比内存还大的图像（不能与 --legacy、--layout、--compress 同用）。
+// --span：所有图像合起来放一份正文（见 shard.h），按文件顺序切成分片，每幅图装满后再用下一幅，
+//         各图在全部硬件线程上并行嵌入/提取，--threads 不起作用。embed 只写出放了分片的图像；
+//         extract 与图像顺序无关，最后一行给出拼接后的正文，--out 时写入 <目录>/span.txt；
+//         capacity 最后一行给出合计的容量。不能与 --stream、--matrix、--legacy 同用。
+// analyze：对每幅图做卡方、RS 和样本对分析，说明栏给出卡方 p 值和两个嵌入率估计。
+// keysearch：用口令文件（每行一个口令，原样使用，跳过空行）中的口令依次尝试提取（见 payload.h 的 searchPayloadKeys），
+//            说明栏给出提取成功的口令的行号和内容，以及探测的口令数和每秒口令数；--all 时不在第一个成功的口令处停止，
+//            --out 时正文写入文件。图像逐幅处理，每幅图的口令在全部硬件线程上并行探测，--threads 不起作用。
+// embed（不带 --stream）在说明栏附上与原图相比的 PSNR 和 SSIM。
+
+#include "analysis.h"
+#include "bmp.h"
+#include "bmpstream.h"
+#include "mappedfile.h"
+#include "matrix.h"
+#include "metrics.h"
+#include "payload.h"
+#include "shard.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+enum class Command { Embed, Extract, Capacity, Analyze, KeySearch };
+
+struct Options {
+    Command command = Command::Capacity;
+    std::string input;
+    std::string outDir;
+    std::string message;
+    std::string messageFile; // --message-file：嵌入时按块读取，不整体读进内存
+    uint64_t messageSize = 0;
+    uint64_t storedSize = 0; // 消息实际占用的字节数（--compress 时为压缩后的大小）
+    bool haveMessage = false;
+    std::string key;
+    ld::EmbedLayout layout;
+    bool legacy = false;
+    bool stream = false;
+    bool compress = false;
+    bool matrix = false;
+    ld::MatrixParams matrixParams;
+    unsigned threads = 0;
+    std::string tracePath;     // --trace：Chrome 跟踪 JSON
+    bool traceSummary = false; // --trace-summary
+    std::vector<std::string> keys; // --keys：keysearch 的候选口令
+    bool allKeys = false;          // --all
+    bool span = false;             // --span：一份正文跨全部图像
+};
+
+struct FileResult {
+    bool ok = false;
+    uint64_t bytes = 0;  // 读入的像素字节数
+    size_t payload = 0;  // 嵌入/提取的消息长度，或可嵌入容量
+    uint64_t keysTried = 0; // keysearch 探测过的口令数
+    double millis = 0;
+    std::string detail;
+};
+
+void printUsage() {
+    std::cerr << "Usage:\n"
+                 "  ldcli embed    <dir|manifest> --out <dir> (--message TEXT | --message-file FILE) [--key KEY]\n"
+                 "                 [--layout K[:rgb]] [--compress] [--matrix hamming[:p]|stc[:h]|adaptive[:h]]\n"
+                 "                 [--threads N] [--stream | --span]\n"
+                 "  ldcli extract  <dir|manifest> [--out <dir>] [--key KEY] [--legacy] [--threads N]\n"
+                 "                 [--stream | --span]\n"
+                 "  ldcli capacity <dir|manifest> [--layout K[:rgb]] [--message TEXT | --message-file FILE] [--key KEY]\n"
+                 "                 [--compress] [--matrix hamming[:p]|stc[:h]|adaptive[:h]] [--threads N]\n"
+                 "                 [--stream | --span]\n"
+                 "  ldcli analyze  <dir|manifest> [--threads N]\n"
+                 "  ldcli keysearch <dir|manifest> --keys FILE [--all] [--out <dir>]\n"
+                 "Every command also accepts [--trace FILE] [--trace-summary].\n";
+}
+
+bool parseArgs(int argc, char *argv[], Options &options) {
+    if (argc < 3) {
+        return false;
+    }
+    std::string command = argv[1];
+    if (command == "embed") {
+        options.command = Command::Embed;
+    } else if (command == "extract") {
+        options.command = Command::Extract;
+    } else if (command == "capacity") {
+        options.command = Command::Capacity;
+    } else if (command == "analyze") {
+        options.command = Command::Analyze;
+    } else if (command == "keysearch") {
+        options.command = Command::KeySearch;
+    } else {
+        return false;
+    }
+    options.input = argv[2];
+
+    bool &haveMessage = options.haveMessage;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--legacy") {
+            options.legacy = true;
+            continue;
+        }
+        if (arg == "--stream") {
+            options.stream = true;
+            continue;
+        }
+        if (arg == "--compress") {
+            options.compress = true;
+            continue;
+        }
+        if (arg == "--trace-summary") {
+            options.traceSummary = true;
+            continue;
+        }
+        if (arg == "--all") {
+            options.allKeys = true;
+            continue;
+        }
+        if (arg == "--span") {
+            options.span = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--out") {
+            options.outDir = value;
+        } else if (arg == "--message") {
+            options.message = value;
+            options.messageFile.clear();
+            options.messageSize = value.size();
+            haveMessage = true;
+        } else if (arg == "--message-file") {
+            std::error_code ec;
+            options.messageSize = fs::file_size(value, ec);
+            if (ec) {
+                std::cerr << "Unable to read message file " << value << "\n";
+                return false;
+            }
+            options.messageFile = value;
+            haveMessage = true;
+        } else if (arg == "--key") {
+            options.key = value;
+        } else if (arg == "--layout") {
+            if (!ld::EmbedLayout::parse(value, options.layout)) {
+                std::cerr << "Invalid layout " << value << "\n";
+                return false;
+            }
+        } else if (arg == "--matrix") {
+            if (!ld::MatrixParams::parse(value, options.matrixParams)) {
+                std::cerr << "Invalid matrix code " << value << "\n";
+                return false;
+            }
+            options.matrix = true;
+        } else if (arg == "--threads") {
+            // 0 表示全部硬件线程
+            if (value.empty() || value.size() > 4 ||
+                !std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c) != 0; })) {
+                std::cerr << "Invalid thread count " << value << "\n";
+                return false;
+            }
+            options.threads = static_cast<unsigned>(std::stoul(value));
+        } else if (arg == "--trace") {
+            options.tracePath = value;
+        } else if (arg == "--keys") {
+            std::ifstream file(value, std::ios::binary);
+            if (!file) {
+                std::cerr << "Unable to read key file " << value << "\n";
+                return false;
+            }
+            std::string line;
+            while (std::getline(file, line)) {
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                if (!line.empty()) {
+                    options.keys.push_back(line);
+                }
+            }
+        } else {
+            std::cerr << "Unknown option " << arg << "\n";
+            return false;
+        }
+    }
+
+    if (options.command == Command::Embed && (options.outDir.empty() || !haveMessage)) {
+        std::cerr << "embed needs --out and a message\n";
+        return false;
+    }
+    if (options.stream && options.legacy) {
+        std::cerr << "--stream does not support --legacy\n";
+        return false;
+    }
+    if (options.stream && (!options.layout.isDefault() || options.compress)) {
+        std::cerr << "--stream does not support --layout or --compress\n";
+        return false;
+    }
+    if (options.matrix && (options.stream || !options.layout.isDefault() || options.compress)) {
+        std::cerr << "--matrix does not support --stream, --layout or --compress\n";
+        return false;
+    }
+    if (options.stream && options.command == Command::Analyze) {
+        std::cerr << "analyze does not support --stream\n";
+        return false;
+    }
+    if (options.span && (options.stream || options.matrix || options.legacy || options.command == Command::Analyze ||
+                         options.command == Command::KeySearch)) {
+        std::cerr << "--span works with embed, extract and capacity, without --stream, --matrix or --legacy\n";
+        return false;
+    }
+    if (options.command == Command::KeySearch && (options.keys.empty() || options.stream)) {
+        std::cerr << "keysearch needs a non-empty --keys file and does not support --stream\n";
+        return false;
+    }
+    return true;
+}
+
+bool isBmp(const fs::path &path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".bmp";
+}
+
+// 与 ldserve 相同：绝对路径并去掉 "."、".."，同一文件的不同写法得到同一个路径
+fs::path absolutePath(const fs::path &path) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(path, ec);
+    return ec ? path : absolute.lexically_normal();
+}
+
+// 目录：收集其中所有 .bmp 文件；否则按清单文件读取
+bool collectInputs(const std::string &input, std::vector<fs::path> &files) {
+    std::error_code ec;
+    if (fs::is_directory(input, ec)) {
+        for (const fs::directory_entry &entry : fs::directory_iterator(input, ec)) {
+            if (entry.is_regular_file() && isBmp(entry.path())) {
+                files.push_back(absolutePath(entry.path()));
+            }
+        }
+        std::sort(files.begin(), files.end());
+        return !ec;
+    }
+
+    std::ifstream manifest(input);
+    if (!manifest) {
+        return false;
+    }
+    fs::path base = fs::path(input).parent_path();
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        fs::path path(line);
+        files.push_back(absolutePath(path.is_absolute() ? path : base / path));
+    }
+    return true;
+}
+
+// 流式嵌入需要随机访问正文，消息文件只读映射，不复制进内存
+bool mapMessage(const Options &options, ld::MappedFile &file, ld::ConstByteSpan &message, std::string *error) {
+    message = ld::asBytes(options.message);
+    if (options.messageFile.empty() || options.messageSize == 0) {
+        return true;
+    }
+    if (!file.open(options.messageFile, ld::MappedFile::Mode::ReadOnly, error)) {
+        return false;
+    }
+    message = ld::ConstByteSpan(file.data(), static_cast<size_t>(file.size()));
+    return true;
+}
+
+// capacity 给出消息时，说明栏写消息占用的字节数和能否放进这幅图
+void describeFit(const Options &options, uint64_t capacity, FileResult &result) {
+    if (!options.haveMessage) {
+        return;
+    }
+    char detail[96];
+    std::snprintf(detail, sizeof(detail), "message %llu stored %llu %s",
+                  static_cast<unsigned long long>(options.messageSize),
+                  static_cast<unsigned long long>(options.storedSize),
+                  options.storedSize <= capacity ? "fits" : "too large");
+    result.detail = detail;
+}
+
+bool writeMessage(const fs::path &outPath, const std::string &message) {
+    std::ofstream out(outPath, std::ios::binary);
+    out.write(message.data(), static_cast<std::streamsize>(message.size()));
+    return static_cast<bool>(out);
+}
+
+// 按行带流式处理，内存占用与图像大小无关
+void processStream(const Options &options, const fs::path &path, FileResult &result) {
+    std::string error;
+    ld::BmpInfo info;
+    if (!ld::readBmpInfo(path.string(), info, &error)) {
+        result.detail = error;
+        return;
+    }
+    result.bytes = info.pixelBytes();
+
+    switch (options.command) {
+    case Command::Capacity:
+        result.payload = static_cast<size_t>(ld::streamPayloadCapacity(info));
+        result.ok = true;
+        describeFit(options, result.payload, result);
+        break;
+    case Command::Analyze:
+    case Command::KeySearch:
+        break; // parseArgs 已拒绝
+    case Command::Embed: {
+        fs::path outPath = fs::path(options.outDir) / path.filename();
+        ld::MappedFile messageFile;
+        ld::ConstByteSpan message;
+        result.ok = mapMessage(options, messageFile, message, &error) &&
+                    ld::streamEmbedPayload(path.string(), outPath.string(), message, options.key, &error);
+        result.payload = result.ok ? message.size() : 0;
+        result.detail = result.ok ? outPath.string() : error;
+        break;
+    }
+    case Command::Extract: {
+        std::string message;
+        ld::ExtractStatus status = ld::streamExtractPayload(path.string(), message, options.key, &error);
+        if (status != ld::ExtractStatus::Ok) {
+            result.detail = status == ld::ExtractStatus::IoError ? error : ld::extractStatusName(status);
+            break;
+        }
+        result.payload = message.size();
+        if (options.outDir.empty()) {
+            result.detail = message;
+            result.ok = true;
+        } else {
+            fs::path outPath = fs::path(options.outDir) / path.filename().replace_extension(".txt");
+            result.ok = writeMessage(outPath, message);
+            result.detail = result.ok ? outPath.string() : "Unable to write " + outPath.string();
+        }
+        break;
+    }
+    }
+}
+
+FileResult processFile(const Options &options, const fs::path &path) {
+    FileResult result;
+    auto start = std::chrono::steady_clock::now();
+    if (options.stream) {
+        processStream(options, path, result);
+        result.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    // 嵌入时使用写时复制映射，在文件的像素行上直接修改，最后一次写出到输出目录
+    ld::MappedBmp image;
+    std::string error;
+    ld::MappedFile::Mode mode = options.command == Command::Embed ? ld::MappedFile::Mode::CopyOnWrite
+                                                                  : ld::MappedFile::Mode::ReadOnly;
+    if (!image.open(path.string(), mode, &error)) {
+        result.detail = error;
+        result.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+    result.bytes = image.info().pixelBytes();
+
+    switch (options.command) {
+    case Command::Capacity:
+        result.payload = options.matrix ? ld::matrixCapacity(image.constView(), options.key)
+                                        : ld::payloadCapacity(image.constView(), options.layout);
+        result.ok = true;
+        describeFit(options, result.payload, result);
+        break;
+    case Command::Analyze: {
+        ld::AnalysisReport report = ld::analyzeImage(image.constView());
+        char detail[128];
+        std::snprintf(detail, sizeof(detail), "chi2 p=%.4f rs=%.3f spa=%.3f", report.chiSquare.pValue,
+                      report.rs.estimate, report.samplePairEstimate);
+        result.detail = detail;
+        result.ok = true;
+        break;
+    }
+    case Command::KeySearch: {
+        auto searchStart = std::chrono::steady_clock::now();
+        ld::KeySearchResult search = ld::searchPayloadKeys(image.constView(), options.keys, !options.allKeys);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - searchStart).count();
+        result.keysTried = search.tried;
+        // 行号从 1 开始，对应口令文件中去掉空行后的顺序
+        for (const ld::KeySearchMatch &match : search.matches) {
+            if (match.status != ld::ExtractStatus::Ok) {
+                continue;
+            }
+            if (result.ok) {
+                result.detail += ", ";
+            }
+            result.detail += "key " + std::to_string(match.index + 1) + " \"" + options.keys[match.index] + "\"";
+            if (!options.outDir.empty()) {
+                fs::path outPath = fs::path(options.outDir) / path.filename().replace_extension(
+                                       ".key" + std::to_string(match.index + 1) + ".txt");
+                if (!writeMessage(outPath, match.payload)) {
+                    result.detail += " (unable to write " + outPath.string() + ")";
+                }
+            }
+            result.payload = match.payload.size();
+            result.ok = true;
+        }
+        if (!result.ok) {
+            result.detail = "no key";
+        }
+        char rate[96];
+        std::snprintf(rate, sizeof(rate), " (%llu tried, %.0f keys/s)", static_cast<unsigned long long>(search.tried),
+                      seconds > 0 ? static_cast<double>(search.tried) / seconds : 0.0);
+        result.detail += rate;
+        break;
+    }
+    case Command::Embed: {
+        ld::MatrixStats matrixStats;
+        if (options.matrix) {
+            ld::MappedFile messageFile;
+            ld::ConstByteSpan message;
+            if (!mapMessage(options, messageFile, message, &error)) {
+                result.detail = error;
+                break;
+            }
+            if (!ld::embedMessageMatrix(image.view(), message, options.key, options.matrixParams, &matrixStats,
+                                        &error)) {
+                result.detail = error;
+                break;
+            }
+        } else if (options.messageFile.empty()) {
+            if (!ld::embedPayload(image.view(), ld::asBytes(options.message), options.key, nullptr, options.layout,
+                                  options.compress, &error)) {
+                result.detail = error;
+                break;
+            }
+        } else if (!ld::embedPayloadFile(image.view(), options.messageFile, options.key, nullptr, options.layout,
+                                         options.compress, &error)) {
+            result.detail = error;
+            break;
+        }
+        result.payload = static_cast<size_t>(options.messageSize);
+        fs::path outPath = fs::path(options.outDir) / path.filename();
+        result.ok = image.saveAs(outPath.string(), &error);
+        result.detail = result.ok ? outPath.string() : error;
+        if (result.ok && options.matrix) {
+            char changes[96];
+            std::snprintf(changes, sizeof(changes), " (%s:%d, %llu changes, %.3f/bit)",
+                          options.matrixParams.adaptive ? "adaptive" : ld::matrixCodeName(options.matrixParams.code),
+                          matrixStats.parameter,
+                          static_cast<unsigned long long>(matrixStats.changes), matrixStats.changesPerBit());
+            result.detail += changes;
+        }
+        // 写时复制映射不改动原文件，再只读映射一次作为对照
+        ld::MappedBmp cover;
+        ld::QualityReport quality;
+        if (result.ok && cover.open(path.string(), ld::MappedFile::Mode::ReadOnly) &&
+            ld::measureQuality(cover.constView(), image.constView(), quality)) {
+            char metrics[96];
+            std::snprintf(metrics, sizeof(metrics), " (PSNR %.2f dB, SSIM %.5f)", quality.overall.psnr,
+                          quality.overall.ssim);
+            result.detail += metrics;
+        }
+        break;
+    }
+    case Command::Extract: {
+        // 输出到目录时正文直接写进文件；矩阵嵌入和旧格式仍在内存中解出
+        if (!options.outDir.empty()) {
+            fs::path outPath = fs::path(options.outDir) / path.filename().replace_extension(".txt");
+            ld::ExtractStatus status =
+                ld::extractPayloadToFile(image.constView(), outPath.string(), options.key, nullptr, &error);
+            if (status == ld::ExtractStatus::Ok) {
+                std::error_code ec;
+                result.payload = static_cast<size_t>(fs::file_size(outPath, ec));
+                result.detail = outPath.string();
+                result.ok = true;
+                break;
+            }
+            if (status != ld::ExtractStatus::NoPayload) {
+                result.detail = status == ld::ExtractStatus::IoError ? error : ld::extractStatusName(status);
+                break;
+            }
+        }
+        std::string message;
+        ld::ExtractStatus status = ld::extractPayload(image.constView(), message, options.key);
+        if (status == ld::ExtractStatus::NoPayload) {
+            status = ld::extractMessageMatrix(image.constView(), message, options.key);
+        }
+        if (status == ld::ExtractStatus::NoPayload && options.legacy) {
+            status = ld::extractPayload(image.constView(), message, options.key, true);
+        }
+        if (status != ld::ExtractStatus::Ok && status != ld::ExtractStatus::Legacy) {
+            result.detail = ld::extractStatusName(status);
+            break;
+        }
+        result.payload = message.size();
+        if (options.outDir.empty()) {
+            result.detail = message;
+            result.ok = true;
+        } else {
+            fs::path outPath = fs::path(options.outDir) / path.filename().replace_extension(".txt");
+            result.ok = writeMessage(outPath, message);
+            result.detail = result.ok ? outPath.string() : "Unable to write " + outPath.string();
+        }
+        break;
+    }
+    }
+
+    result.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// --span：所有图像一起映射，一份正文切成分片跨图像嵌入/提取；results 为各图像的分片，total 为整份正文
+void processSpan(const Options &options, const std::vector<fs::path> &files, std::vector<FileResult> &results,
+                 FileResult &total) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<ld::MappedBmp> images(files.size());
+    ld::MappedFile::Mode mode = options.command == Command::Embed ? ld::MappedFile::Mode::CopyOnWrite
+                                                                  : ld::MappedFile::Mode::ReadOnly;
+    ld::parallelFor(files.size(), 1, [&](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; ++i) {
+            results[i].ok = images[i].open(files[i].string(), mode, &results[i].detail);
+            results[i].bytes = results[i].ok ? images[i].info().pixelBytes() : 0;
+        }
+    });
+    // 打不开的文件不参与，opened 把载体序号映射回文件
+    std::vector<size_t> opened;
+    std::vector<ld::ImageView> views;
+    std::vector<ld::ConstImageView> constViews;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (results[i].ok) {
+            opened.push_back(i);
+            total.bytes += results[i].bytes;
+            if (mode == ld::MappedFile::Mode::CopyOnWrite) {
+                views.push_back(images[i].view());
+            }
+            constViews.push_back(images[i].constView());
+        }
+    }
+
+    std::vector<ld::ShardInfo> shards;
+    std::string error;
+    switch (options.command) {
+    case Command::Capacity:
+        for (size_t k = 0; k < opened.size(); ++k) {
+            FileResult &result = results[opened[k]];
+            result.payload = static_cast<size_t>(ld::shardCapacity(constViews[k], options.key, options.layout));
+            total.payload += result.payload;
+        }
+        total.ok = true;
+        describeFit(options, total.payload, total);
+        break;
+    case Command::Embed: {
+        ld::MappedFile messageFile;
+        ld::ConstByteSpan message;
+        if (!mapMessage(options, messageFile, message, &error) ||
+            !ld::embedSharded(views, message, options.key, options.layout, options.compress, &shards, &error)) {
+            total.detail = error;
+            // 一个分片也没有写出
+            for (size_t k : opened) {
+                results[k].ok = false;
+                results[k].detail = "not embedded";
+            }
+            break;
+        }
+        total.payload = message.size();
+        // 只写出放了分片的图像，各图并行写
+        std::vector<uint8_t> saved(opened.size(), 1);
+        ld::parallelFor(opened.size(), 1, [&](uint64_t begin, uint64_t end) {
+            for (uint64_t k = begin; k < end; ++k) {
+                FileResult &result = results[opened[k]];
+                if (!shards[k].used) {
+                    result.detail = "unused";
+                    continue;
+                }
+                fs::path outPath = fs::path(options.outDir) / files[opened[k]].filename();
+                std::string saveError;
+                saved[k] = images[opened[k]].saveAs(outPath.string(), &saveError) ? 1 : 0;
+                result.ok = saved[k] != 0;
+                result.payload = static_cast<size_t>(shards[k].bytes);
+                result.detail = result.ok ? "shard " + std::to_string(shards[k].index) + " " + outPath.string()
+                                          : saveError;
+            }
+        });
+        total.ok = std::find(saved.begin(), saved.end(), 0) == saved.end();
+        total.detail = total.ok ? "spanned" : "Unable to write every shard";
+        break;
+    }
+    case Command::Extract: {
+        std::string message;
+        ld::ExtractStatus status = ld::extractSharded(constViews, message, options.key, &shards, &error);
+        for (size_t k = 0; k < opened.size(); ++k) {
+            FileResult &result = results[opened[k]];
+            result.payload = static_cast<size_t>(shards[k].bytes);
+            result.detail = !shards[k].used ? std::string("no shard (") + ld::extractStatusName(shards[k].status) + ")"
+                            : shards[k].foreign ? "shard " + std::to_string(shards[k].index) + " of another payload"
+                                                : "shard " + std::to_string(shards[k].index);
+        }
+        if (status != ld::ExtractStatus::Ok) {
+            total.detail = error.empty() ? ld::extractStatusName(status) : error;
+            break;
+        }
+        total.payload = message.size();
+        if (options.outDir.empty()) {
+            total.detail = message;
+            total.ok = true;
+        } else {
+            fs::path outPath = fs::path(options.outDir) / "span.txt";
+            total.ok = writeMessage(outPath, message);
+            total.detail = total.ok ? outPath.string() : "Unable to write " + outPath.string();
+        }
+        break;
+    }
+    case Command::Analyze:
+    case Command::KeySearch:
+        break; // parseArgs 已拒绝
+    }
+    total.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+
+    options.storedSize = options.messageSize;
+    if (options.command == Command::Capacity && options.compress) {
+        ld::MappedFile messageFile;
+        ld::ConstByteSpan message;
+        std::string error;
+        if (!mapMessage(options, messageFile, message, &error)) {
+            std::cerr << error << "\n";
+            return 2;
+        }
+        options.storedSize = ld::storedPayloadSize(message, true, !options.key.empty() && !options.span);
+    } else if (options.command == Command::Capacity && !options.key.empty() && !options.matrix && !options.span) {
+        options.storedSize += ld::PAYLOAD_CIPHER_OVERHEAD;
+    }
+
+    std::vector<fs::path> files;
+    if (!collectInputs(options.input, files)) {
+        std::cerr << "Unable to read input " << options.input << "\n";
+        return 2;
+    }
+    if (!options.outDir.empty()) {
+        options.outDir = absolutePath(options.outDir).string();
+        std::error_code ec;
+        fs::create_directories(options.outDir, ec);
+    }
+
+    bool tracing = !options.tracePath.empty() || options.traceSummary;
+    if (tracing) {
+        ld::startTrace();
+    }
+    std::vector<FileResult> results(files.size());
+    FileResult spanResult;
+    auto start = std::chrono::steady_clock::now();
+    if (options.span) {
+        processSpan(options, files, results, spanResult);
+    } else if (options.command == Command::KeySearch) {
+        // 口令在 sharedPool() 上并行探测，放进这里的线程池会串行执行
+        for (size_t i = 0; i < files.size(); ++i) {
+            results[i] = processFile(options, files[i]);
+        }
+    } else {
+        ld::ThreadPool pool(options.threads);
+        for (size_t i = 0; i < files.size(); ++i) {
+            pool.submit([&, i] { results[i] = processFile(options, files[i]); });
+        }
+        pool.wait();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (tracing) {
+        ld::stopTrace();
+    }
+
+    // 每个文件一行：状态、路径、像素字节数、消息/容量字节数、耗时、说明
+    size_t failed = 0;
+    uint64_t totalBytes = 0;
+    uint64_t keysTried = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        const FileResult &result = results[i];
+        failed += result.ok ? 0 : 1;
+        totalBytes += result.bytes;
+        keysTried += result.keysTried;
+        std::printf("%s\t%s\t%llu\t%zu\t%.2fms\t%s\n", result.ok ? "OK" : "FAIL", files[i].string().c_str(),
+                    static_cast<unsigned long long>(result.bytes), result.payload, result.millis,
+                    result.detail.c_str());
+    }
+    // --span：最后一行是整份正文，路径栏为输入
+    if (options.span) {
+        std::printf("%s\t%s\t%llu\t%zu\t%.2fms\t%s\n", spanResult.ok ? "OK" : "FAIL", options.input.c_str(),
+                    static_cast<unsigned long long>(spanResult.bytes), spanResult.payload, spanResult.millis,
+                    spanResult.detail.c_str());
+    }
+
+    double images = static_cast<double>(files.size());
+    double megabytes = static_cast<double>(totalBytes) / (1024.0 * 1024.0);
+    std::fprintf(stderr, "%zu files, %zu failed, %.3fs, %.1f images/s, %.1f MB/s\n", files.size(), failed, seconds,
+                 seconds > 0 ? images / seconds : 0.0, seconds > 0 ? megabytes / seconds : 0.0);
+    if (options.command == Command::KeySearch) {
+        std::fprintf(stderr, "%llu keys tried, %.0f keys/s\n", static_cast<unsigned long long>(keysTried),
+                     seconds > 0 ? static_cast<double>(keysTried) / seconds : 0.0);
+    }
+    if (options.traceSummary) {
+        std::fprintf(stderr, "%s", ld::traceSummary().c_str());
+    }
+    std::string error;
+    if (!options.tracePath.empty() && !ld::writeChromeTrace(options.tracePath, &error)) {
+        std::cerr << error << "\n";
+        return 2;
+    }
+    return failed == 0 && (!options.span || spanResult.ok) ? 0 : 1;
+}
@@ -0,0 +1,283 @@
+// ldnoise: 嵌入信息在噪声下的鲁棒性测试，噪声模型来自 Noise_Exp/addnoise.cpp
+//
+//   ldnoise [--key 密钥] [--payload 字节数] [--types salt-pepper,random,gaussian]
+//           [--levels 0.0001,0.001,0.01,0.05,0.1] [--trials N] [--seed S] [--csv 文件] [目录...]
+//
+// 对每幅图嵌入一段随机正文（按容量截断），然后对每种噪声、每个比例做 trials 次独立加噪，
+// 统计容器（头部 + 正文）所在比特的误码率，以及 extractPayload 仍能完整取回正文的比例。
+// 所有 (图像, 噪声, 比例, 次数) 组合在 sharedPool() 上并行执行，每个线程复用自己的像素和位图缓冲区。
+// 默认图像集为源码中的 color/ 和 grey/。
+
+#include "bmp.h"
+#include "keyedpermutation.h"
+#include "noise.h"
+#include "payload.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Options {
+    std::vector<std::string> dirs;
+    std::string key;
+    std::string csvPath;
+    size_t payloadBytes = 256;
+    std::vector<ld::NoiseType> types = {ld::NoiseType::SaltAndPepper, ld::NoiseType::Random,
+                                        ld::NoiseType::Gaussian};
+    std::vector<double> levels = {0.0001, 0.001, 0.01, 0.05, 0.1};
+    unsigned trials = 4;
+    uint64_t seed = 1;
+};
+
+// 一幅嵌入了信息的图像，以及容器各比特所在的逻辑位置
+struct Stego {
+    std::string name;
+    ld::BmpImage image;
+    std::string payload;
+    std::vector<uint64_t> positions;
+};
+
+struct TrialResult {
+    uint64_t bitErrors = 0;
+    bool survived = false;
+};
+
+// 每个 (噪声, 比例) 的汇总
+struct Cell {
+    uint64_t bits = 0;
+    uint64_t bitErrors = 0;
+    uint64_t trials = 0;
+    uint64_t survived = 0;
+
+    double bitErrorRate() const { return bits ? static_cast<double>(bitErrors) / static_cast<double>(bits) : 0.0; }
+    double survivalRate() const {
+        return trials ? static_cast<double>(survived) / static_cast<double>(trials) : 0.0;
+    }
+};
+
+template <typename T, typename Parse>
+bool parseList(const std::string &value, std::vector<T> &list, Parse &&parse) {
+    list.clear();
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        T parsed;
+        if (!parse(item, parsed)) {
+            return false;
+        }
+        list.push_back(parsed);
+    }
+    return !list.empty();
+}
+
+bool parseArgs(int argc, char *argv[], Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            options.dirs.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--key") {
+            options.key = value;
+        } else if (arg == "--payload") {
+            options.payloadBytes = static_cast<size_t>(std::stoull(value));
+        } else if (arg == "--types") {
+            if (!parseList(value, options.types, ld::parseNoiseType)) {
+                std::fprintf(stderr, "Bad noise types %s\n", value.c_str());
+                return false;
+            }
+        } else if (arg == "--levels") {
+            bool ok = parseList(value, options.levels, [](const std::string &item, double &level) {
+                level = std::stod(item);
+                return level >= 0.0 && level <= 1.0;
+            });
+            if (!ok) {
+                std::fprintf(stderr, "Bad noise levels %s\n", value.c_str());
+                return false;
+            }
+        } else if (arg == "--trials") {
+            options.trials = std::max(1u, static_cast<unsigned>(std::stoul(value)));
+        } else if (arg == "--seed") {
+            options.seed = std::stoull(value);
+        } else if (arg == "--csv") {
+            options.csvPath = value;
+        } else {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    if (options.dirs.empty()) {
+        options.dirs = {LD_SOURCE_DIR "/color", LD_SOURCE_DIR "/grey"};
+    }
+    return true;
+}
+
+// 读入目录中的 BMP 并嵌入随机正文；放不下容器头部的图像跳过
+void loadStego(const Options &options, std::vector<Stego> &stegos) {
+    std::mt19937_64 generator(options.seed);
+    for (const std::string &dir : options.dirs) {
+        std::vector<fs::path> files;
+        std::error_code ec;
+        for (const fs::directory_entry &entry : fs::directory_iterator(dir, ec)) {
+            if (entry.is_regular_file()) {
+                files.push_back(entry.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+
+        for (const fs::path &file : files) {
+            Stego stego;
+            if (!ld::readBMP(file.string(), stego.image)) {
+                continue;
+            }
+            ld::ImageView view = stego.image.view();
+            // 带密钥时正文加密，另占 nonce 和标签
+            size_t overhead = options.key.empty() ? 0 : ld::PAYLOAD_CIPHER_OVERHEAD;
+            size_t capacity = ld::payloadCapacity(view);
+            size_t size = std::min(options.payloadBytes, capacity > overhead ? capacity - overhead : 0);
+            stego.payload.resize(size);
+            for (char &byte : stego.payload) {
+                byte = static_cast<char>(generator());
+            }
+            if (!ld::embedPayload(view, ld::asBytes(stego.payload), options.key)) {
+                continue;
+            }
+
+            uint64_t bits = (ld::PAYLOAD_HEADER_SIZE + size + overhead) * 8;
+            stego.positions.resize(static_cast<size_t>(bits));
+            ld::KeyedPermutation permutation(options.key, options.key.empty() ? 0 : view.size(),
+                                             ld::KeyedPermutation::Kind::Philox);
+            for (uint64_t i = 0; i < bits; ++i) {
+                stego.positions[i] = options.key.empty() ? i : permutation(i);
+            }
+            stego.name = (fs::path(dir).filename().empty() ? fs::path(dir).parent_path().filename()
+                                                           : fs::path(dir).filename()).string() +
+                         "/" + file.filename().string();
+            stegos.push_back(std::move(stego));
+        }
+    }
+}
+
+// 每个工作线程复用的缓冲区
+struct Scratch {
+    std::vector<uint8_t> pixels;
+    ld::NoiseScratch noise;
+    std::string extracted;
+};
+
+TrialResult runTrial(const Stego &stego, ld::NoiseType type, double level, uint64_t seed, const std::string &key) {
+    thread_local Scratch scratch;
+    scratch.pixels.assign(stego.image.pixels.begin(), stego.image.pixels.end());
+    ld::ConstImageView clean = stego.image.view();
+    ld::ImageView noisy(scratch.pixels.data(), clean.rowBytes, clean.stride, clean.rows, clean.swapChannels);
+
+    ld::addNoise(noisy, type, level, seed, scratch.noise);
+
+    TrialResult result;
+    for (uint64_t position : stego.positions) {
+        result.bitErrors += (clean[position] ^ noisy[position]) & 1;
+    }
+    result.survived = ld::extractPayload(noisy, scratch.extracted, key) == ld::ExtractStatus::Ok &&
+                      scratch.extracted == stego.payload;
+    return result;
+}
+
+void printTable(const char *title, const Options &options, const std::vector<Cell> &cells, bool survival) {
+    std::printf("\n%s\n%-10s", title, "level");
+    for (ld::NoiseType type : options.types) {
+        std::printf(" %14s", ld::noiseTypeName(type));
+    }
+    std::printf("\n");
+    for (size_t l = 0; l < options.levels.size(); ++l) {
+        std::printf("%-10g", options.levels[l]);
+        for (size_t t = 0; t < options.types.size(); ++t) {
+            const Cell &cell = cells[t * options.levels.size() + l];
+            if (survival) {
+                std::printf(" %13.1f%%", cell.survivalRate() * 100.0);
+            } else {
+                std::printf(" %14.6f", cell.bitErrorRate());
+            }
+        }
+        std::printf("\n");
+    }
+}
+
+bool writeCsv(const std::string &path, const Options &options, const std::vector<Cell> &cells) {
+    std::ofstream out(path);
+    out << "type,level,bits,bit_errors,ber,trials,survived,survival\n";
+    for (size_t t = 0; t < options.types.size(); ++t) {
+        for (size_t l = 0; l < options.levels.size(); ++l) {
+            const Cell &cell = cells[t * options.levels.size() + l];
+            out << ld::noiseTypeName(options.types[t]) << ',' << options.levels[l] << ',' << cell.bits << ','
+                << cell.bitErrors << ',' << cell.bitErrorRate() << ',' << cell.trials << ',' << cell.survived << ','
+                << cell.survivalRate() << '\n';
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        return 2;
+    }
+
+    std::vector<Stego> stegos;
+    loadStego(options, stegos);
+    if (stegos.empty()) {
+        std::fprintf(stderr, "No usable BMP images\n");
+        return 1;
+    }
+
+    // 组合按 (噪声, 比例, 图像, 次数) 编号，结果写到各自的位置，汇总顺序固定
+    uint64_t perCell = stegos.size() * options.trials;
+    uint64_t cellCount = options.types.size() * options.levels.size();
+    std::vector<TrialResult> trials(static_cast<size_t>(cellCount * perCell));
+    ld::parallelFor(trials.size(), 1, [&](uint64_t begin, uint64_t end) {
+        for (uint64_t job = begin; job < end; ++job) {
+            uint64_t cell = job / perCell;
+            const Stego &stego = stegos[static_cast<size_t>(job % perCell / options.trials)];
+            ld::NoiseType type = options.types[static_cast<size_t>(cell / options.levels.size())];
+            double level = options.levels[static_cast<size_t>(cell % options.levels.size())];
+            uint64_t seed = options.seed * 0x9E3779B97F4A7C15ull + job;
+            trials[job] = runTrial(stego, type, level, seed, options.key);
+        }
+    });
+
+    std::vector<Cell> cells(static_cast<size_t>(cellCount));
+    for (uint64_t job = 0; job < trials.size(); ++job) {
+        Cell &cell = cells[static_cast<size_t>(job / perCell)];
+        cell.bits += stegos[static_cast<size_t>(job % perCell / options.trials)].positions.size();
+        cell.bitErrors += trials[job].bitErrors;
+        cell.trials += 1;
+        cell.survived += trials[job].survived ? 1 : 0;
+    }
+
+    std::printf("%zu images, %u trials each, %s embedding\n", stegos.size(), options.trials,
+                options.key.empty() ? "sequential" : "keyed");
+    printTable("Bit error rate", options, cells, false);
+    printTable("Payload survival", options, cells, true);
+
+    if (!options.csvPath.empty() && !writeCsv(options.csvPath, options, cells)) {
+        std::fprintf(stderr, "Unable to write %s\n", options.csvPath.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,894 @@
+// ldserve: 常驻的本地嵌入/提取服务，监听 Unix 域套接字，省掉每幅图启动进程和解析 BMP 的开销。
+// 同一个程序也是测试客户端和吞吐量测试
+//
+//   ldserve serve    --socket 路径 [--cache MB]
+//   ldserve capacity --socket 路径 <BMP>...
+//   ldserve embed    --socket 路径 <输入 BMP> <输出 BMP> (--message 文本 | --message-file 文件) [--key 密钥] [--compress]
+//   ldserve extract  --socket 路径 <BMP>... [--key 密钥]
+//   ldserve stats    --socket 路径
+//   ldserve bench    --socket 路径 <目录|BMP...> [--batch N] [--connections N] [--rounds N] [--key 密钥]
+//
+// 协议：每帧为 u32 长度（小端）+ 正文。请求帧是一个批次：u32 个数，每个请求为 u8 操作（1 embed、2 extract、
+// 3 capacity、4 stats）、u8 标志（bit 0 压缩）、u16 保留，再依次是载体路径、输出路径、密钥、正文四个字符串
+// （各为 u32 长度 + 字节）。应答帧按请求顺序，每个应答为 u8 成功、u8 ExtractStatus、u16 保留、u64 数值
+// （capacity 为可嵌入字节数，embed 为嵌入的字节数）、一个字符串（extract 的正文、stats 的文本或失败原因）。
+//
+// serve：每个连接一个线程，连接内的帧依次处理，一帧中的请求在 sharedPool() 上并行执行。
+// 解码后的载体按绝对路径放在 LRU 缓存里（--cache 按像素字节计，默认 512 MB），文件大小或修改时间变化时重新读取，
+// embed 写出的图像也放进缓存；口令派生的加密密钥由 ldcore 的 LRU 缓存保存（PAYLOAD_KEY_CACHE_SIZE 个）。
+// 套接字文件权限为 0600；已有服务在监听同一路径时拒绝启动。SIGINT/SIGTERM 时关闭所有连接、删除套接字文件后退出。
+// 客户端把路径转成绝对路径再发送，服务端的工作目录不影响结果。
+//
+// bench：分别测量 capacity（第一遍单独报告，服务刚启动时不命中缓存）、embed（每幅图嵌入一条短消息，
+// 写到临时目录）、extract 请求的吞吐量。N 个连接同时发送，每帧 batch 个请求，每个操作共 rounds × 图像数个请求；
+// extract 的结果与嵌入的消息逐一比较。
+
+#include "bmp.h"
+#include "lrucache.h"
+#include "payload.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+enum class Op : uint8_t { Embed = 1, Extract = 2, Capacity = 3, Stats = 4 };
+
+constexpr uint32_t MAX_FRAME = 256u << 20; // 超过这个长度的帧视为协议错误，不分配内存
+constexpr uint32_t MAX_BATCH = 4096;
+constexpr uint8_t FLAG_COMPRESS = 0x01;
+
+struct Request {
+    Op op = Op::Capacity;
+    bool compress = false;
+    std::string input;
+    std::string output;
+    std::string key;
+    std::string message;
+};
+
+Request makeRequest(Op op, const std::string &input, const std::string &output = std::string(),
+                    const std::string &key = std::string(), const std::string &message = std::string(),
+                    bool compress = false) {
+    Request request;
+    request.op = op;
+    request.compress = compress;
+    request.input = input;
+    request.output = output;
+    request.key = key;
+    request.message = message;
+    return request;
+}
+
+struct Response {
+    bool ok = false;
+    ld::ExtractStatus status = ld::ExtractStatus::NoPayload;
+    uint64_t value = 0;
+    std::string data;
+};
+
+struct Options {
+    std::string command;
+    std::string socketPath;
+    std::vector<std::string> paths;
+    std::string message;
+    std::string key;
+    bool haveMessage = false;
+    bool compress = false;
+    uint64_t cacheMegabytes = 512;
+    unsigned batch = 16;
+    unsigned connections = 4;
+    unsigned rounds = 20;
+};
+
+// ---- 编解码 ----
+
+void put32(std::vector<uint8_t> &out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void put64(std::vector<uint8_t> &out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void putString(std::vector<uint8_t> &out, const std::string &text) {
+    put32(out, static_cast<uint32_t>(text.size()));
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+// 越界后所有读取都返回 0，最后用 ok() 一次检查
+class Reader {
+public:
+    explicit Reader(const std::vector<uint8_t> &data) : data(data) {}
+
+    uint8_t u8() { return static_cast<uint8_t>(take(1)); }
+    uint16_t u16() { return static_cast<uint16_t>(take(2)); }
+    uint32_t u32() { return static_cast<uint32_t>(take(4)); }
+    uint64_t u64() { return take(8); }
+    std::string string() {
+        uint32_t size = u32();
+        if (!valid || size > data.size() - offset) {
+            valid = false;
+            return std::string();
+        }
+        std::string text(data.begin() + static_cast<std::ptrdiff_t>(offset),
+                         data.begin() + static_cast<std::ptrdiff_t>(offset + size));
+        offset += size;
+        return text;
+    }
+    bool ok() const { return valid; }
+    bool finished() const { return valid && offset == data.size(); }
+
+private:
+    uint64_t take(size_t size) {
+        if (!valid || size > data.size() - offset) {
+            valid = false;
+            return 0;
+        }
+        uint64_t value = 0;
+        for (size_t i = 0; i < size; ++i) {
+            value |= static_cast<uint64_t>(data[offset + i]) << (8 * i);
+        }
+        offset += size;
+        return value;
+    }
+
+    const std::vector<uint8_t> &data;
+    size_t offset = 0;
+    bool valid = true;
+};
+
+void encodeRequests(const std::vector<Request> &requests, std::vector<uint8_t> &out) {
+    out.clear();
+    put32(out, static_cast<uint32_t>(requests.size()));
+    for (const Request &request : requests) {
+        out.push_back(static_cast<uint8_t>(request.op));
+        out.push_back(request.compress ? FLAG_COMPRESS : 0);
+        out.push_back(0);
+        out.push_back(0);
+        putString(out, request.input);
+        putString(out, request.output);
+        putString(out, request.key);
+        putString(out, request.message);
+    }
+}
+
+bool decodeRequests(const std::vector<uint8_t> &frame, std::vector<Request> &requests) {
+    Reader reader(frame);
+    uint32_t count = reader.u32();
+    if (!reader.ok() || count > MAX_BATCH) {
+        return false;
+    }
+    requests.assign(count, Request());
+    for (Request &request : requests) {
+        uint8_t op = reader.u8();
+        uint8_t flags = reader.u8();
+        reader.u16();
+        if (op < static_cast<uint8_t>(Op::Embed) || op > static_cast<uint8_t>(Op::Stats) || (flags & ~FLAG_COMPRESS)) {
+            return false;
+        }
+        request.op = static_cast<Op>(op);
+        request.compress = (flags & FLAG_COMPRESS) != 0;
+        request.input = reader.string();
+        request.output = reader.string();
+        request.key = reader.string();
+        request.message = reader.string();
+    }
+    return reader.finished();
+}
+
+void encodeResponses(const std::vector<Response> &responses, std::vector<uint8_t> &out) {
+    out.clear();
+    put32(out, static_cast<uint32_t>(responses.size()));
+    for (const Response &response : responses) {
+        out.push_back(response.ok ? 1 : 0);
+        out.push_back(static_cast<uint8_t>(response.status));
+        out.push_back(0);
+        out.push_back(0);
+        put64(out, response.value);
+        putString(out, response.data);
+    }
+}
+
+bool decodeResponses(const std::vector<uint8_t> &frame, std::vector<Response> &responses) {
+    Reader reader(frame);
+    uint32_t count = reader.u32();
+    if (!reader.ok() || count > MAX_BATCH) {
+        return false;
+    }
+    responses.assign(count, Response());
+    for (Response &response : responses) {
+        response.ok = reader.u8() != 0;
+        response.status = static_cast<ld::ExtractStatus>(reader.u8());
+        reader.u16();
+        response.value = reader.u64();
+        response.data = reader.string();
+    }
+    return reader.finished();
+}
+
+// ---- 套接字 ----
+
+bool readAll(int fd, uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t count = ::read(fd, data, size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        data += count;
+        size -= static_cast<size_t>(count);
+    }
+    return true;
+}
+
+bool writeAll(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t count = ::write(fd, data, size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        data += count;
+        size -= static_cast<size_t>(count);
+    }
+    return true;
+}
+
+bool readFrame(int fd, std::vector<uint8_t> &frame) {
+    uint8_t prefix[4];
+    if (!readAll(fd, prefix, sizeof(prefix))) {
+        return false;
+    }
+    uint32_t size = static_cast<uint32_t>(prefix[0]) | static_cast<uint32_t>(prefix[1]) << 8 |
+                    static_cast<uint32_t>(prefix[2]) << 16 | static_cast<uint32_t>(prefix[3]) << 24;
+    if (size > MAX_FRAME) {
+        return false;
+    }
+    frame.resize(size);
+    return readAll(fd, frame.data(), size);
+}
+
+bool writeFrame(int fd, const std::vector<uint8_t> &body) {
+    if (body.size() > MAX_FRAME) {
+        return false;
+    }
+    std::vector<uint8_t> prefix;
+    put32(prefix, static_cast<uint32_t>(body.size()));
+    return writeAll(fd, prefix.data(), prefix.size()) && writeAll(fd, body.data(), body.size());
+}
+
+bool socketAddress(const std::string &path, sockaddr_un &address, std::string &error) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        error = "Socket path is empty or too long";
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+int connectTo(const std::string &path, std::string &error) {
+    sockaddr_un address;
+    if (!socketAddress(path, address, error)) {
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = std::strerror(errno);
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+        error = "Unable to connect to " + path + ": " + std::strerror(errno);
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// ---- 服务端 ----
+
+class Service {
+public:
+    explicit Service(uint64_t cacheBytes) : carriers(cacheBytes) {}
+
+    // 同一批次的请求并行执行，responses 与 requests 一一对应
+    void run(const std::vector<Request> &requests, std::vector<Response> &responses) {
+        responses.assign(requests.size(), Response());
+        ld::parallelFor(requests.size(), 1, [&](uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; ++i) {
+                responses[i] = handle(requests[i]);
+            }
+        });
+    }
+
+private:
+    struct Carrier {
+        std::shared_ptr<const ld::BmpImage> image;
+        uint64_t fileSize = 0;
+        int64_t modified = 0;
+    };
+
+    static bool fileStamp(const std::string &path, uint64_t &size, int64_t &modified) {
+        std::error_code ec;
+        size = fs::file_size(path, ec);
+        if (ec) {
+            return false;
+        }
+        modified = static_cast<int64_t>(fs::last_write_time(path, ec).time_since_epoch().count());
+        return !ec;
+    }
+
+    static std::string normalize(const std::string &path) {
+        std::error_code ec;
+        fs::path absolute = fs::absolute(path, ec);
+        return ec ? path : absolute.lexically_normal().string();
+    }
+
+    std::shared_ptr<const ld::BmpImage> load(const std::string &path, std::string &error) {
+        uint64_t size = 0;
+        int64_t modified = 0;
+        if (!fileStamp(path, size, modified)) {
+            error = "Unable to open file";
+            return nullptr;
+        }
+        Carrier cached;
+        if (carriers.get(path, cached) && cached.fileSize == size && cached.modified == modified) {
+            return cached.image;
+        }
+        auto image = std::make_shared<ld::BmpImage>();
+        if (!ld::readBMP(path, *image, &error)) {
+            return nullptr;
+        }
+        carriers.put(path, Carrier{image, size, modified}, image->pixels.size());
+        return image;
+    }
+
+    Response handle(const Request &request) {
+        Response response;
+        std::string error;
+        std::string input = normalize(request.input);
+        switch (request.op) {
+        case Op::Capacity: {
+            std::shared_ptr<const ld::BmpImage> image = load(input, error);
+            if (image) {
+                response.value = ld::payloadCapacity(image->view());
+                response.ok = true;
+            }
+            break;
+        }
+        case Op::Extract: {
+            std::shared_ptr<const ld::BmpImage> image = load(input, error);
+            if (image) {
+                response.status = ld::extractPayload(image->view(), response.data, request.key);
+                response.ok = response.status == ld::ExtractStatus::Ok;
+                error = ld::extractStatusName(response.status);
+            }
+            break;
+        }
+        case Op::Embed: {
+            std::string output = normalize(request.output);
+            if (request.output.empty() || output == input) {
+                error = "Output must be a different file";
+                break;
+            }
+            std::shared_ptr<const ld::BmpImage> image = load(input, error);
+            if (!image) {
+                break;
+            }
+            auto carrier = std::make_shared<ld::BmpImage>(*image);
+            if (!ld::embedPayload(carrier->view(), ld::asBytes(request.message), request.key, nullptr,
+                                  ld::EmbedLayout(), request.compress, &error)) {
+                break;
+            }
+            carriers.erase(output);
+            if (!ld::writeBMP(output, *carrier, &error)) {
+                break;
+            }
+            // 接下来通常是提取或校验这幅图，直接放进缓存
+            uint64_t size = 0;
+            int64_t modified = 0;
+            if (fileStamp(output, size, modified)) {
+                uint64_t cost = carrier->pixels.size();
+                carriers.put(output, Carrier{std::move(carrier), size, modified}, cost);
+            }
+            response.value = request.message.size();
+            response.ok = true;
+            break;
+        }
+        case Op::Stats:
+            response.data = stats();
+            response.ok = true;
+            break;
+        }
+        if (!response.ok) {
+            response.data = error;
+            failed.fetch_add(1, std::memory_order_relaxed);
+        }
+        handled.fetch_add(1, std::memory_order_relaxed);
+        return response;
+    }
+
+    std::string stats() const {
+        ld::LruCache<std::string, Carrier>::Stats cache = carriers.stats();
+        char text[256];
+        std::snprintf(text, sizeof(text),
+                      "requests %llu failed %llu carriers %llu cached %.1f MB hits %llu misses %llu",
+                      static_cast<unsigned long long>(handled.load()), static_cast<unsigned long long>(failed.load()),
+                      static_cast<unsigned long long>(cache.entries),
+                      static_cast<double>(cache.used) / (1024.0 * 1024.0),
+                      static_cast<unsigned long long>(cache.hits), static_cast<unsigned long long>(cache.misses));
+        return text;
+    }
+
+    ld::LruCache<std::string, Carrier> carriers;
+    std::atomic<uint64_t> handled{0};
+    std::atomic<uint64_t> failed{0};
+};
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void onSignal(int) {
+    stopRequested = 1;
+}
+
+// 连接线程不 join，退出时关闭它们的套接字，等计数归零
+class Connections {
+public:
+    void start(int fd, Service &service) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            open.insert(fd);
+        }
+        std::thread([this, fd, &service] {
+            serveConnection(fd, service);
+            std::lock_guard<std::mutex> lock(mutex);
+            open.erase(fd);
+            ::close(fd);
+            idle.notify_all();
+        }).detach();
+    }
+
+    void closeAll() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (int fd : open) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+        idle.wait(lock, [this] { return open.empty(); });
+    }
+
+private:
+    static void serveConnection(int fd, Service &service) {
+        std::vector<uint8_t> frame;
+        std::vector<Request> requests;
+        std::vector<Response> responses;
+        while (readFrame(fd, frame)) {
+            if (!decodeRequests(frame, requests)) {
+                std::fprintf(stderr, "Malformed request, closing connection\n");
+                return;
+            }
+            service.run(requests, responses);
+            encodeResponses(responses, frame);
+            if (!writeFrame(fd, frame)) {
+                return;
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable idle;
+    std::set<int> open;
+};
+
+int serve(const Options &options) {
+    sockaddr_un address;
+    std::string error;
+    if (!socketAddress(options.socketPath, address, error)) {
+        std::cerr << error << "\n";
+        return 2;
+    }
+    // 上次没有正常退出留下的套接字文件：连不上就删除，连得上说明已有服务
+    struct stat status;
+    if (::lstat(options.socketPath.c_str(), &status) == 0) {
+        if (!S_ISSOCK(status.st_mode)) {
+            std::cerr << options.socketPath << " exists and is not a socket\n";
+            return 2;
+        }
+        int existing = connectTo(options.socketPath, error);
+        if (existing >= 0) {
+            ::close(existing);
+            std::cerr << "Another server is listening on " << options.socketPath << "\n";
+            return 2;
+        }
+        ::unlink(options.socketPath.c_str());
+    }
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || ::bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+        ::chmod(options.socketPath.c_str(), 0600) != 0 || ::listen(listener, SOMAXCONN) != 0) {
+        std::cerr << "Unable to listen on " << options.socketPath << ": " << std::strerror(errno) << "\n";
+        if (listener >= 0) {
+            ::close(listener);
+        }
+        return 2;
+    }
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    Service service(options.cacheMegabytes << 20);
+    Connections connections;
+    std::fprintf(stderr, "Listening on %s, cache %llu MB, %u worker threads\n", options.socketPath.c_str(),
+                 static_cast<unsigned long long>(options.cacheMegabytes), ld::sharedPool().size());
+    while (!stopRequested) {
+        pollfd waiting{listener, POLLIN, 0};
+        int ready = ::poll(&waiting, 1, 250);
+        if (ready <= 0) {
+            continue;
+        }
+        int fd = ::accept(listener, nullptr, nullptr);
+        if (fd >= 0) {
+            connections.start(fd, service);
+        }
+    }
+    ::close(listener);
+    ::unlink(options.socketPath.c_str());
+    connections.closeAll();
+    std::fprintf(stderr, "Stopped\n");
+    return 0;
+}
+
+// ---- 客户端 ----
+
+class Client {
+public:
+    ~Client() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    bool connect(const std::string &path, std::string &error) {
+        fd = connectTo(path, error);
+        return fd >= 0;
+    }
+
+    bool call(const std::vector<Request> &requests, std::vector<Response> &responses, std::string &error) {
+        encodeRequests(requests, buffer);
+        if (!writeFrame(fd, buffer) || !readFrame(fd, buffer)) {
+            error = "Connection closed by server";
+            return false;
+        }
+        if (!decodeResponses(buffer, responses) || responses.size() != requests.size()) {
+            error = "Malformed response";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    int fd = -1;
+    std::vector<uint8_t> buffer;
+};
+
+std::string absolutePath(const std::string &path) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(path, ec);
+    return ec ? path : absolute.lexically_normal().string();
+}
+
+// capacity、embed、extract、stats：一个批次发完，每个应答一行
+int runClient(const Options &options) {
+    std::vector<Request> requests;
+    if (options.command == "stats") {
+        requests.push_back(makeRequest(Op::Stats, std::string()));
+    } else if (options.command == "embed") {
+        requests.push_back(makeRequest(Op::Embed, absolutePath(options.paths[0]), absolutePath(options.paths[1]),
+                                       options.key, options.message, options.compress));
+    } else {
+        Op op = options.command == "capacity" ? Op::Capacity : Op::Extract;
+        for (const std::string &path : options.paths) {
+            requests.push_back(makeRequest(op, absolutePath(path), std::string(), options.key));
+        }
+    }
+
+    Client client;
+    std::vector<Response> responses;
+    std::string error;
+    if (!client.connect(options.socketPath, error) || !client.call(requests, responses, error)) {
+        std::cerr << error << "\n";
+        return 2;
+    }
+    size_t failed = 0;
+    for (size_t i = 0; i < responses.size(); ++i) {
+        const Response &response = responses[i];
+        failed += response.ok ? 0 : 1;
+        std::printf("%s\t%s\t%llu\t%s\n", response.ok ? "OK" : "FAIL", requests[i].input.c_str(),
+                    static_cast<unsigned long long>(response.value), response.data.c_str());
+    }
+    return failed == 0 ? 0 : 1;
+}
+
+bool isBmp(const fs::path &path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".bmp";
+}
+
+struct Phase {
+    const char *name;
+    uint64_t requests = 0;
+    uint64_t failed = 0;
+    uint64_t bytes = 0; // 涉及的载体文件字节数
+    double seconds = 0;
+};
+
+// connections 个连接同时发送，连接 c 负责第 c、c + connections、… 个请求，每帧 batch 个
+Phase runPhase(const Options &options, const char *name, const std::vector<Request> &all,
+               const std::vector<uint64_t> &bytes, const std::string &expected) {
+    Phase phase;
+    phase.name = name;
+    phase.requests = all.size();
+    std::atomic<uint64_t> failed{0};
+    std::atomic<bool> broken{false};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned c = 0; c < options.connections; ++c) {
+        threads.emplace_back([&, c] {
+            Client client;
+            std::string error;
+            if (!client.connect(options.socketPath, error)) {
+                std::fprintf(stderr, "%s\n", error.c_str());
+                broken = true;
+                return;
+            }
+            std::vector<Request> batch;
+            std::vector<Response> responses;
+            for (size_t first = c; first < all.size();) {
+                batch.clear();
+                for (; first < all.size() && batch.size() < options.batch; first += options.connections) {
+                    batch.push_back(all[first]);
+                }
+                if (!client.call(batch, responses, error)) {
+                    std::fprintf(stderr, "%s\n", error.c_str());
+                    broken = true;
+                    return;
+                }
+                for (const Response &response : responses) {
+                    bool ok = response.ok && (batch[0].op != Op::Extract || response.data == expected);
+                    failed += ok ? 0 : 1;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    phase.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    phase.failed = broken ? all.size() : failed.load();
+    for (uint64_t size : bytes) {
+        phase.bytes += size;
+    }
+    phase.bytes *= all.size() / std::max<size_t>(bytes.size(), 1);
+    return phase;
+}
+
+int runBench(const Options &options) {
+    std::vector<std::string> files;
+    for (const std::string &path : options.paths) {
+        std::error_code ec;
+        if (fs::is_directory(path, ec)) {
+            for (const fs::directory_entry &entry : fs::directory_iterator(path, ec)) {
+                if (entry.is_regular_file() && isBmp(entry.path())) {
+                    files.push_back(absolutePath(entry.path().string()));
+                }
+            }
+        } else {
+            files.push_back(absolutePath(path));
+        }
+    }
+    std::sort(files.begin(), files.end());
+    if (files.empty() || options.batch == 0 || options.connections == 0 || options.rounds == 0) {
+        std::cerr << "Nothing to benchmark\n";
+        return 2;
+    }
+    fs::path tempDir = fs::temp_directory_path() / ("ldserve-bench-" + std::to_string(::getpid()));
+    std::error_code ec;
+    fs::create_directories(tempDir, ec);
+
+    std::string message = options.haveMessage ? options.message : std::string("ldserve bench message 0123456789");
+    std::vector<uint64_t> bytes;
+    for (const std::string &file : files) {
+        bytes.push_back(fs::file_size(file, ec));
+    }
+    // 每个 embed 请求写自己的输出文件，同一批次里的请求并行执行，写同一个文件的结果是不确定的
+    auto stego = [&](size_t index) { return (tempDir / (std::to_string(index) + ".bmp")).string(); };
+    std::vector<Request> cold, capacity, embed, extract;
+    for (size_t i = 0; i < files.size(); ++i) {
+        cold.push_back(makeRequest(Op::Capacity, files[i]));
+    }
+    for (unsigned round = 0; round < options.rounds; ++round) {
+        for (size_t i = 0; i < files.size(); ++i) {
+            capacity.push_back(makeRequest(Op::Capacity, files[i]));
+            embed.push_back(
+                makeRequest(Op::Embed, files[i], stego(embed.size()), options.key, message, options.compress));
+            // 都读第一轮的输出
+            extract.push_back(makeRequest(Op::Extract, stego(i), std::string(), options.key));
+        }
+    }
+
+    std::vector<Phase> phases;
+    phases.push_back(runPhase(options, "capacity-cold", cold, bytes, message));
+    phases.push_back(runPhase(options, "capacity", capacity, bytes, message));
+    phases.push_back(runPhase(options, "embed", embed, bytes, message));
+    phases.push_back(runPhase(options, "extract", extract, bytes, message));
+    fs::remove_all(tempDir, ec);
+
+    std::printf("%-16s %10s %8s %10s %12s %10s\n", "operation", "requests", "failed", "seconds", "requests/s",
+                "MB/s");
+    uint64_t failed = 0;
+    for (const Phase &phase : phases) {
+        failed += phase.failed;
+        double seconds = std::max(phase.seconds, 1e-9);
+        std::printf("%-16s %10llu %8llu %10.3f %12.1f %10.1f\n", phase.name,
+                    static_cast<unsigned long long>(phase.requests), static_cast<unsigned long long>(phase.failed),
+                    phase.seconds, static_cast<double>(phase.requests) / seconds,
+                    static_cast<double>(phase.bytes) / (1024.0 * 1024.0) / seconds);
+    }
+    std::fprintf(stderr, "%zu images, %u connections, batch %u, %u rounds\n", files.size(), options.connections,
+                 options.batch, options.rounds);
+    return failed == 0 ? 0 : 1;
+}
+
+void printUsage() {
+    std::cerr << "Usage:\n"
+                 "  ldserve serve    --socket PATH [--cache MB]\n"
+                 "  ldserve capacity --socket PATH <bmp>...\n"
+                 "  ldserve embed    --socket PATH <in.bmp> <out.bmp> (--message TEXT | --message-file FILE)\n"
+                 "                   [--key KEY] [--compress]\n"
+                 "  ldserve extract  --socket PATH <bmp>... [--key KEY]\n"
+                 "  ldserve stats    --socket PATH\n"
+                 "  ldserve bench    --socket PATH <dir|bmp>... [--batch N] [--connections N] [--rounds N]\n"
+                 "                   [--key KEY] [--compress] [--message TEXT]\n";
+}
+
+bool parseArgs(int argc, char *argv[], Options &options) {
+    if (argc < 2) {
+        return false;
+    }
+    options.command = argv[1];
+    static const char *const commands[] = {"serve", "capacity", "embed", "extract", "stats", "bench"};
+    if (std::find_if(std::begin(commands), std::end(commands),
+                     [&](const char *name) { return options.command == name; }) == std::end(commands)) {
+        return false;
+    }
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            options.paths.push_back(arg);
+            continue;
+        }
+        if (arg == "--compress") {
+            options.compress = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--socket") {
+            options.socketPath = value;
+        } else if (arg == "--message") {
+            options.message = value;
+            options.haveMessage = true;
+        } else if (arg == "--message-file") {
+            std::ifstream file(value, std::ios::binary);
+            if (!file) {
+                std::cerr << "Unable to read message file " << value << "\n";
+                return false;
+            }
+            options.message.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            options.haveMessage = true;
+        } else if (arg == "--key") {
+            options.key = value;
+        } else if (arg == "--cache" || arg == "--batch" || arg == "--connections" || arg == "--rounds") {
+            unsigned long long number = 0;
+            try {
+                size_t used = 0;
+                number = std::stoull(value, &used);
+                if (used != value.size() || value[0] == '-') {
+                    throw std::invalid_argument(value);
+                }
+            } catch (const std::exception &) {
+                std::cerr << "Invalid value for " << arg << ": " << value << "\n";
+                return false;
+            }
+            if (arg == "--cache") {
+                options.cacheMegabytes = number;
+            } else if (arg == "--batch") {
+                options.batch = static_cast<unsigned>(std::min<unsigned long long>(number, MAX_BATCH));
+            } else if (arg == "--connections") {
+                options.connections = static_cast<unsigned>(std::min<unsigned long long>(number, UINT_MAX));
+            } else {
+                options.rounds = static_cast<unsigned>(std::min<unsigned long long>(number, UINT_MAX));
+            }
+        } else {
+            std::cerr << "Unknown option " << arg << "\n";
+            return false;
+        }
+    }
+    if (options.socketPath.empty()) {
+        std::cerr << "--socket is required\n";
+        return false;
+    }
+    if (options.command == "embed" && (options.paths.size() != 2 || !options.haveMessage)) {
+        std::cerr << "embed needs an input, an output and a message\n";
+        return false;
+    }
+    if ((options.command == "capacity" || options.command == "extract" || options.command == "bench") &&
+        options.paths.empty()) {
+        std::cerr << options.command << " needs at least one image\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+    // 对端关闭后写套接字返回错误，而不是收到 SIGPIPE 退出
+    std::signal(SIGPIPE, SIG_IGN);
+    if (options.command == "serve") {
+        return serve(options);
+    }
+    if (options.command == "bench") {
+        return runBench(options);
+    }
+    return runClient(options);
+}